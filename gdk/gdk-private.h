@@ -18,11 +18,17 @@ void            gdk_pre_parse                   (void);
 GdkGLFlags      gdk_gl_get_flags                (void);
 void            gdk_gl_set_flags                (GdkGLFlags flags);
 
+gboolean        gdk_disk_cache_enabled          (GdkDiskCacheFlags cache);
+void            gdk_disk_cache_prune            (const char       *dir,
+                                                 const char       *prefix);
+
 void            gdk_window_freeze_toplevel_updates      (GdkWindow *window);
 void            gdk_window_thaw_toplevel_updates        (GdkWindow *window);
 
 gboolean        gdk_window_supports_edge_constraints    (GdkWindow *window);
 
+cairo_region_t *gdk_window_take_exposed_area            (GdkWindow *window);
+
 GdkRenderingMode gdk_display_get_rendering_mode (GdkDisplay       *display);
 void             gdk_display_set_rendering_mode (GdkDisplay       *display,
                                                  GdkRenderingMode  mode);
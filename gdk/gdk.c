@@ -41,6 +41,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <glib/gstdio.h>
+
 
 /**
  * SECTION:general
@@ -155,6 +157,12 @@ static const GDebugKey gdk_vulkan_keys[] = {
   { "validate",              GDK_VULKAN_VALIDATE },
 };
 
+static const GDebugKey gdk_disk_cache_keys[] = {
+  { "themes",                GDK_DISK_CACHE_THEMES },
+  { "icons",                 GDK_DISK_CACHE_ICONS },
+  { "shaders",               GDK_DISK_CACHE_SHADERS },
+};
+
 #ifdef G_ENABLE_DEBUG
 static const GDebugKey gdk_debug_keys[] = {
   { "events",        GDK_DEBUG_EVENTS },
@@ -190,6 +198,86 @@ gdk_ensure_resources (void)
   g_once (&register_resources_once, register_resources, NULL);
 }
 
+/*< private >
+ * gdk_disk_cache_enabled:
+ * @cache: the cache to check for
+ *
+ * Checks whether the caches of @cache may be kept in the user's cache
+ * directory. The GTK_NO_DISK_CACHE environment variable lists the caches
+ * that are turned off, or can be set to "all".
+ *
+ * This can be called from any thread, and before GDK is initialized.
+ *
+ * Returns: %TRUE if @cache may be stored on disk
+ */
+gboolean
+gdk_disk_cache_enabled (GdkDiskCacheFlags cache)
+{
+  static gsize initialized = 0;
+  static guint disabled_caches = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      const char *string = g_getenv ("GTK_NO_DISK_CACHE");
+
+      if (string != NULL)
+        disabled_caches = g_parse_debug_string (string,
+                                                gdk_disk_cache_keys,
+                                                G_N_ELEMENTS (gdk_disk_cache_keys));
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return (disabled_caches & cache) == 0;
+}
+
+/* Files of other drivers that were written to in this time are kept */
+#define DISK_CACHE_PRUNE_AGE (7 * 24 * 60 * 60)
+
+/*< private >
+ * gdk_disk_cache_prune:
+ * @dir: a cache directory
+ * @prefix: the prefix of the files that are current
+ *
+ * Removes the files in @dir whose names don't start with @prefix. Caches
+ * that depend on the graphics driver name their files after it, so this
+ * removes the files written for other drivers, or other versions of GTK+.
+ *
+ * On systems with several GPUs, other drivers may still be in use, so
+ * files that were written to in the last week are kept.
+ */
+void
+gdk_disk_cache_prune (const char *dir,
+                      const char *prefix)
+{
+  GDir *cache_dir;
+  const char *name;
+  gint64 now;
+
+  cache_dir = g_dir_open (dir, 0, NULL);
+  if (cache_dir == NULL)
+    return;
+
+  now = g_get_real_time () / G_USEC_PER_SEC;
+
+  while ((name = g_dir_read_name (cache_dir)) != NULL)
+    {
+      GStatBuf buf;
+      char *path;
+
+      if (g_str_has_prefix (name, prefix))
+        continue;
+
+      path = g_build_filename (dir, name, NULL);
+      if (g_stat (path, &buf) == 0 &&
+          now - (gint64) buf.st_mtime > DISK_CACHE_PRUNE_AGE)
+        g_unlink (path);
+      g_free (path);
+    }
+
+  g_dir_close (cache_dir);
+}
+
 void
 gdk_pre_parse (void)
 {
@@ -93,6 +93,12 @@ typedef enum {
   GDK_VULKAN_VALIDATE               = 1 << 1,
 } GdkVulkanFlags;
 
+typedef enum {
+  GDK_DISK_CACHE_THEMES             = 1 << 0,
+  GDK_DISK_CACHE_ICONS              = 1 << 1,
+  GDK_DISK_CACHE_SHADERS            = 1 << 2
+} GdkDiskCacheFlags;
+
 extern GList            *_gdk_default_filters;
 extern GdkWindow        *_gdk_parent_root;
 
@@ -222,6 +228,10 @@ struct _GdkWindow
   cairo_region_t *active_update_area;
   /* We store the old expose areas to support buffer-age optimizations */
   cairo_region_t *old_updated_area[2];
+  /* The areas the windowing system exposed since they were last taken
+     with gdk_window_take_exposed_area(). Unlike our own invalidations,
+     these mean that the window contents there were lost. */
+  cairo_region_t *exposed_area;
 
   GdkWindowState old_state;
   GdkWindowState state;
@@ -1458,6 +1458,7 @@ _gdk_window_destroy_hierarchy (GdkWindow *window,
 	    }
 
 	  _gdk_window_clear_update_area (window);
+	  g_clear_pointer (&window->exposed_area, cairo_region_destroy);
 
 	  impl_class = GDK_WINDOW_IMPL_GET_CLASS (window->impl);
 
@@ -3051,12 +3052,53 @@ void
 _gdk_window_invalidate_for_expose (GdkWindow       *window,
 				   cairo_region_t       *region)
 {
+  GdkWindow *impl_window = window->impl_window;
+  cairo_region_t *exposed;
+
+  exposed = cairo_region_copy (region);
+  cairo_region_translate (exposed, window->abs_x, window->abs_y);
+  if (impl_window->exposed_area)
+    {
+      cairo_region_union (impl_window->exposed_area, exposed);
+      cairo_region_destroy (exposed);
+    }
+  else
+    impl_window->exposed_area = exposed;
+
   gdk_window_invalidate_maybe_recurse_full (window, region,
 					    (gboolean (*) (GdkWindow *, gpointer))gdk_window_has_no_impl,
 					    NULL);
 }
 
 
+/*< private >
+ * gdk_window_take_exposed_area:
+ * @window: a native #GdkWindow
+ *
+ * Transfers the area of @window that the windowing system exposed
+ * since the last call to the caller. The window contents in this area
+ * may have been lost, so it must be repainted even if nothing changed
+ * there.
+ *
+ * Returns: (transfer full) (nullable): the exposed area, or %NULL if
+ *     nothing was exposed
+ */
+cairo_region_t *
+gdk_window_take_exposed_area (GdkWindow *window)
+{
+  cairo_region_t *exposed;
+
+  g_return_val_if_fail (GDK_IS_WINDOW (window), NULL);
+
+  exposed = window->impl_window->exposed_area;
+  window->impl_window->exposed_area = NULL;
+
+  if (exposed && window != window->impl_window)
+    cairo_region_translate (exposed, -window->abs_x, -window->abs_y);
+
+  return exposed;
+}
+
 /**
  * gdk_window_get_update_area:
  * @window: a #GdkWindow
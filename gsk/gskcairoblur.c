@@ -38,38 +38,317 @@
 
 #define get_box_filter_size(radius) ((int)(GAUSSIAN_SCALE_FACTOR * (radius)))
 
-/* Sadly, clang is picky about get_box_filter_size(2) not being a
- * constant expression, thus we have to use precomputed values.
+/* The blur is done as three box blur passes in each direction, using
+ * a sliding window: since the box blur has the same weight for all
+ * pixels, we add in pixels coming into the window and remove them
+ * when they leave it.
+ *
+ * The window always slides down a set of adjacent columns, keeping
+ * one running sum per column, so every step works on a whole row of
+ * pixels at once. The vertical blur runs directly on the buffer, in
+ * blocks of columns so that all three passes stay in cache. For the
+ * horizontal blur, strips of rows are transposed into a small buffer
+ * and blurred the same way.
+ *
+ * The per-row steps are provided by the kernels below, with SSE2 and
+ * AVX2 variants picked at runtime where available. All variants give
+ * the same results. The vector variants handle their leftover pixels
+ * themselves instead of calling the portable kernels, which the
+ * compiler vectorizes without VEX encoding; mixing the two is slow.
  */
-#define BOX_FILTER_SIZE_2 3
-#define BOX_FILTER_SIZE_3 5
-#define BOX_FILTER_SIZE_4 7
-#define BOX_FILTER_SIZE_5 9
-#define BOX_FILTER_SIZE_6 11
-#define BOX_FILTER_SIZE_7 13
-#define BOX_FILTER_SIZE_8 15
-#define BOX_FILTER_SIZE_9 16
-#define BOX_FILTER_SIZE_10 18
-
-/* This applies a single box blur pass to a horizontal range of pixels;
- * since the box blur has the same weight for all pixels, we can
- * implement an efficient sliding window algorithm where we add
- * in pixels coming into the window from the right and remove
- * them when they leave the windw to the left.
+#define COLUMN_BLOCK_SIZE 256
+#define ROW_STRIP_SIZE 32
+
+typedef struct {
+  void (* add_row)   (int          *sums,
+                      const guchar *row,
+                      int           n);
+  void (* sub_row)   (int          *sums,
+                      const guchar *row,
+                      int           n);
+  void (* store_row) (guchar       *row,
+                      const int    *sums,
+                      int           n,
+                      int           d);
+} BlurKernels;
+
+/* Rounded division of the sums by d. Doing this in floating point
+ * instead of integers allows vectorizing it, and is exact: sums stay
+ * below 2^24, so the quotient is computed to within 2^-16 of the
+ * correct value, and any non-integer quotient is at least 1/d away
+ * from the next integer, which is more than that as long as d is
+ * smaller than 2^16.
+ */
+#define MAX_FLOAT_DIVISOR 65536
+
+static void
+blur_add_row_c (int          *sums,
+                const guchar *row,
+                int           n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    sums[i] += row[i];
+}
+
+static void
+blur_sub_row_c (int          *sums,
+                const guchar *row,
+                int           n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    sums[i] -= row[i];
+}
+
+static void
+blur_store_row_c (guchar    *row,
+                  const int *sums,
+                  int        n,
+                  int        d)
+{
+  int i;
+
+  if (d < MAX_FLOAT_DIVISOR)
+    {
+      float divisor = d;
+
+      for (i = 0; i < n; i++)
+        row[i] = (int) ((float) (sums[i] + d / 2) / divisor);
+    }
+  else
+    {
+      for (i = 0; i < n; i++)
+        row[i] = (sums[i] + d / 2) / d;
+    }
+}
+
+static const BlurKernels blur_kernels_c = {
+  blur_add_row_c,
+  blur_sub_row_c,
+  blur_store_row_c
+};
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_BLUR_X86_KERNELS 1
+
+#include <immintrin.h>
+
+__attribute__ ((target ("sse2")))
+static void
+blur_add_row_sse2 (int          *sums,
+                   const guchar *row,
+                   int           n)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) (row + i));
+      __m128i lo = _mm_unpacklo_epi8 (pixels, zero);
+      __m128i hi = _mm_unpackhi_epi8 (pixels, zero);
+      __m128i *s = (__m128i *) (sums + i);
+
+      _mm_storeu_si128 (s + 0, _mm_add_epi32 (_mm_loadu_si128 (s + 0), _mm_unpacklo_epi16 (lo, zero)));
+      _mm_storeu_si128 (s + 1, _mm_add_epi32 (_mm_loadu_si128 (s + 1), _mm_unpackhi_epi16 (lo, zero)));
+      _mm_storeu_si128 (s + 2, _mm_add_epi32 (_mm_loadu_si128 (s + 2), _mm_unpacklo_epi16 (hi, zero)));
+      _mm_storeu_si128 (s + 3, _mm_add_epi32 (_mm_loadu_si128 (s + 3), _mm_unpackhi_epi16 (hi, zero)));
+    }
+
+  for (; i < n; i++)
+    sums[i] += row[i];
+}
+
+__attribute__ ((target ("sse2")))
+static void
+blur_sub_row_sse2 (int          *sums,
+                   const guchar *row,
+                   int           n)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) (row + i));
+      __m128i lo = _mm_unpacklo_epi8 (pixels, zero);
+      __m128i hi = _mm_unpackhi_epi8 (pixels, zero);
+      __m128i *s = (__m128i *) (sums + i);
+
+      _mm_storeu_si128 (s + 0, _mm_sub_epi32 (_mm_loadu_si128 (s + 0), _mm_unpacklo_epi16 (lo, zero)));
+      _mm_storeu_si128 (s + 1, _mm_sub_epi32 (_mm_loadu_si128 (s + 1), _mm_unpackhi_epi16 (lo, zero)));
+      _mm_storeu_si128 (s + 2, _mm_sub_epi32 (_mm_loadu_si128 (s + 2), _mm_unpacklo_epi16 (hi, zero)));
+      _mm_storeu_si128 (s + 3, _mm_sub_epi32 (_mm_loadu_si128 (s + 3), _mm_unpackhi_epi16 (hi, zero)));
+    }
+
+  for (; i < n; i++)
+    sums[i] -= row[i];
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+blur_divide_sse2 (const int *sums,
+                  __m128i    half,
+                  __m128     divisor)
+{
+  __m128i s = _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *) sums), half);
+
+  return _mm_cvttps_epi32 (_mm_div_ps (_mm_cvtepi32_ps (s), divisor));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+blur_store_row_sse2 (guchar    *row,
+                     const int *sums,
+                     int        n,
+                     int        d)
+{
+  const __m128i half = _mm_set1_epi32 (d / 2);
+  const __m128 divisor = _mm_set1_ps (d);
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      __m128i q0 = blur_divide_sse2 (sums + i + 0, half, divisor);
+      __m128i q1 = blur_divide_sse2 (sums + i + 4, half, divisor);
+      __m128i q2 = blur_divide_sse2 (sums + i + 8, half, divisor);
+      __m128i q3 = blur_divide_sse2 (sums + i + 12, half, divisor);
+
+      _mm_storeu_si128 ((__m128i *) (row + i),
+                        _mm_packus_epi16 (_mm_packs_epi32 (q0, q1),
+                                          _mm_packs_epi32 (q2, q3)));
+    }
+
+  for (; i < n; i++)
+    row[i] = (sums[i] + d / 2) / d;
+}
+
+static const BlurKernels blur_kernels_sse2 = {
+  blur_add_row_sse2,
+  blur_sub_row_sse2,
+  blur_store_row_sse2
+};
+
+__attribute__ ((target ("avx2")))
+static void
+blur_add_row_avx2 (int          *sums,
+                   const guchar *row,
+                   int           n)
+{
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m256i pixels = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) (row + i)));
+      __m256i *s = (__m256i *) (sums + i);
+
+      _mm256_storeu_si256 (s, _mm256_add_epi32 (_mm256_loadu_si256 (s), pixels));
+    }
+
+  for (; i < n; i++)
+    sums[i] += row[i];
+}
+
+__attribute__ ((target ("avx2")))
+static void
+blur_sub_row_avx2 (int          *sums,
+                   const guchar *row,
+                   int           n)
+{
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m256i pixels = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) (row + i)));
+      __m256i *s = (__m256i *) (sums + i);
+
+      _mm256_storeu_si256 (s, _mm256_sub_epi32 (_mm256_loadu_si256 (s), pixels));
+    }
+
+  for (; i < n; i++)
+    sums[i] -= row[i];
+}
+
+__attribute__ ((target ("avx2")))
+static void
+blur_store_row_avx2 (guchar    *row,
+                     const int *sums,
+                     int        n,
+                     int        d)
+{
+  const __m256i half = _mm256_set1_epi32 (d / 2);
+  const __m256 divisor = _mm256_set1_ps (d);
+  int i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      __m256i s = _mm256_add_epi32 (_mm256_loadu_si256 ((const __m256i *) (sums + i)), half);
+      __m256i q = _mm256_cvttps_epi32 (_mm256_div_ps (_mm256_cvtepi32_ps (s), divisor));
+      __m128i q16 = _mm_packs_epi32 (_mm256_castsi256_si128 (q),
+                                     _mm256_extracti128_si256 (q, 1));
+
+      _mm_storel_epi64 ((__m128i *) (row + i), _mm_packus_epi16 (q16, q16));
+    }
+
+  for (; i < n; i++)
+    row[i] = (sums[i] + d / 2) / d;
+}
+
+static const BlurKernels blur_kernels_avx2 = {
+  blur_add_row_avx2,
+  blur_sub_row_avx2,
+  blur_store_row_avx2
+};
+#endif
+
+static const BlurKernels *
+get_blur_kernels (int d)
+{
+  static const BlurKernels *kernels = NULL;
+
+  if (d >= MAX_FLOAT_DIVISOR)
+    return &blur_kernels_c;
+
+  if (g_once_init_enter (&kernels))
+    {
+      const BlurKernels *k = &blur_kernels_c;
+
+#ifdef HAVE_BLUR_X86_KERNELS
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2"))
+        k = &blur_kernels_avx2;
+      else if (__builtin_cpu_supports ("sse2"))
+        k = &blur_kernels_sse2;
+#endif
+
+      g_once_init_leave (&kernels, k);
+    }
+
+  return kernels;
+}
+
+/* This applies a single box blur pass to n_columns adjacent columns
+ * of src, writing the result to dst.
  *
  * d is the filter width; for even d shift indicates how the blurred
  * result is aligned with the original - does ' x ' go to ' yy' (shift=1)
  * or 'yy ' (shift=-1)
  */
 static void
-blur_xspan (guchar *row,
-            guchar *tmp_buffer,
-            int     row_width,
-            int     d,
-            int     shift)
+blur_column_span (const BlurKernels *kernels,
+                  guchar            *dst,
+                  const guchar      *src,
+                  int               *sums,
+                  int                n_columns,
+                  int                n_rows,
+                  int                stride,
+                  int                d,
+                  int                shift)
 {
   int offset;
-  int sum = 0;
   int i;
 
   if (d % 2 == 1)
@@ -77,83 +356,56 @@ blur_xspan (guchar *row,
   else
     offset = (d - shift) / 2;
 
-  /* All the conditionals in here look slow, but the branches will
-   * be well predicted and there are enough different possibilities
-   * that trying to write this as a series of unconditional loops
-   * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division per pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
-   */
+  memset (sums, 0, n_columns * sizeof (int));
 
-#define BLUR_ROW_KERNEL(D)                                      \
-  for (i = -(D) + offset; i < row_width + offset; i++)		\
-    {                                                           \
-      if (i >= 0 && i < row_width)                              \
-        sum += row[i];                                          \
-                                                                \
-      if (i >= offset)						\
-	{							\
-	  if (i >= (D))						\
-	    sum -= row[i - (D)];				\
-                                                                \
-	  tmp_buffer[i - offset] = (sum + (D) / 2) / (D);	\
-	}							\
-    }								\
-  break;
-
-  /* We unroll the values for d for radius 2-10 to avoid a generic
-   * divide operation (not radius 1, because its a no-op) */
-  switch (d)
+  for (i = -d + offset; i < n_rows + offset; i++)
     {
-    case BOX_FILTER_SIZE_2: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_2);
-    case BOX_FILTER_SIZE_3: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_3);
-    case BOX_FILTER_SIZE_4: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_4);
-    case BOX_FILTER_SIZE_5: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_5);
-    case BOX_FILTER_SIZE_6: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_6);
-    case BOX_FILTER_SIZE_7: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_7);
-    case BOX_FILTER_SIZE_8: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_8);
-    case BOX_FILTER_SIZE_9: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_9);
-    case BOX_FILTER_SIZE_10: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_10);
-    default: BLUR_ROW_KERNEL (d);
-    }
+      if (i >= 0 && i < n_rows)
+        kernels->add_row (sums, src + i * stride, n_columns);
+
+      if (i >= offset)
+        {
+          if (i >= d)
+            kernels->sub_row (sums, src + (i - d) * stride, n_columns);
 
-  memcpy (row, tmp_buffer, row_width);
+          kernels->store_row (dst + (i - offset) * stride, sums, n_columns, d);
+        }
+    }
 }
 
 static void
-blur_rows (guchar *dst_buffer,
-           guchar *tmp_buffer,
-           int     buffer_width,
-           int     buffer_height,
-           int     d)
+blur_columns (const BlurKernels *kernels,
+              guchar            *buffer,
+              guchar            *tmp_buffer,
+              int               *sums,
+              int                n_columns,
+              int                n_rows,
+              int                stride,
+              int                d)
 {
   int i;
 
-  for (i = 0; i < buffer_height; i++)
+  /* We want to produce a symmetric blur that spreads a pixel
+   * equally far to the left and right. If d is odd that happens
+   * naturally, but for d even, we approximate by using a blur
+   * on either side and then a centered blur of size d + 1.
+   * (technique also from the SVG specification)
+   */
+  if (d % 2 == 1)
     {
-      guchar *row = dst_buffer + i * buffer_width;
-
-      /* We want to produce a symmetric blur that spreads a pixel
-       * equally far to the left and right. If d is odd that happens
-       * naturally, but for d even, we approximate by using a blur
-       * on either side and then a centered blur of size d + 1.
-       * (technique also from the SVG specification)
-       */
-      if (d % 2 == 1)
-        {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-        }
-      else
-        {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 1);
-          blur_xspan (row, tmp_buffer, buffer_width, d, -1);
-          blur_xspan (row, tmp_buffer, buffer_width, d + 1, 0);
-        }
+      blur_column_span (kernels, tmp_buffer, buffer, sums, n_columns, n_rows, stride, d, 0);
+      blur_column_span (kernels, buffer, tmp_buffer, sums, n_columns, n_rows, stride, d, 0);
+      blur_column_span (kernels, tmp_buffer, buffer, sums, n_columns, n_rows, stride, d, 0);
     }
+  else
+    {
+      blur_column_span (kernels, tmp_buffer, buffer, sums, n_columns, n_rows, stride, d, 1);
+      blur_column_span (kernels, buffer, tmp_buffer, sums, n_columns, n_rows, stride, d, -1);
+      blur_column_span (kernels, tmp_buffer, buffer, sums, n_columns, n_rows, stride, d + 1, 0);
+    }
+
+  for (i = 0; i < n_rows; i++)
+    memcpy (buffer + i * stride, tmp_buffer + i * stride, n_columns);
 }
 
 /* Swaps width and height.
@@ -192,30 +444,51 @@ _boxblur (guchar      *buffer,
           int          radius,
           GskBlurFlags flags)
 {
-  guchar *flipped_buffer;
+  const BlurKernels *kernels;
   int d = get_box_filter_size (radius);
+  int *sums;
+  int i;
 
-  flipped_buffer = g_malloc (width * height);
+  kernels = get_blur_kernels (d + 1);
+  sums = g_new (int, MAX (COLUMN_BLOCK_SIZE, ROW_STRIP_SIZE));
 
   if (flags & GSK_BLUR_Y)
     {
-      /* Step 1: swap rows and columns */
-      flip_buffer (flipped_buffer, buffer, width, height);
+      guchar *tmp_buffer = g_malloc (width * height);
 
-      /* Step 2: blur rows (really columns) */
-      blur_rows (flipped_buffer, buffer, height, width, d);
+      for (i = 0; i < width; i += COLUMN_BLOCK_SIZE)
+        blur_columns (kernels,
+                      buffer + i, tmp_buffer + i, sums,
+                      MIN (COLUMN_BLOCK_SIZE, width - i), height, width,
+                      d);
 
-      /* Step 3: swap rows and columns */
-      flip_buffer (buffer, flipped_buffer, height, width);
+      g_free (tmp_buffer);
     }
 
   if (flags & GSK_BLUR_X)
     {
-      /* Step 4: blur rows */
-      blur_rows (buffer, flipped_buffer, width, height, d);
+      guchar *strip = g_malloc (ROW_STRIP_SIZE * width);
+      guchar *tmp_strip = g_malloc (ROW_STRIP_SIZE * width);
+
+      for (i = 0; i < height; i += ROW_STRIP_SIZE)
+        {
+          int n_rows = MIN (ROW_STRIP_SIZE, height - i);
+
+          /* Step 1: swap rows and columns of the strip */
+          flip_buffer (strip, buffer + i * width, width, n_rows);
+
+          /* Step 2: blur columns (really rows) */
+          blur_columns (kernels, strip, tmp_strip, sums, n_rows, width, n_rows, d);
+
+          /* Step 3: swap rows and columns back */
+          flip_buffer (buffer + i * width, strip, n_rows, width);
+        }
+
+      g_free (tmp_strip);
+      g_free (strip);
     }
 
-  g_free (flipped_buffer);
+  g_free (sums);
 }
 
 /*
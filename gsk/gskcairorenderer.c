@@ -7,6 +7,13 @@
 #include "gskrendernodeprivate.h"
 #include "gsktextureprivate.h"
 
+#include <math.h>
+
+/* Size of the tiles, in device pixels, that GSK_RENDERING_MODE=tiled
+ * splits the target into
+ */
+#define TILE_SIZE 256
+
 #ifdef G_ENABLE_DEBUG
 typedef struct {
   GQuark cpu_time;
@@ -14,10 +21,37 @@ typedef struct {
 } ProfileTimers;
 #endif
 
+typedef struct {
+  GskRenderNode *root;
+
+  /* Target pixels and the state of the cairo_t we are replacing */
+  unsigned char *data;
+  cairo_format_t format;
+  int stride;
+  double x_scale, y_scale;
+  double x_offset, y_offset;
+  cairo_matrix_t matrix;
+  cairo_rectangle_list_t *clip;
+
+  /* GskRenderNode => image surface, see gsk_cairo_renderer_prepare_tiles() */
+  GHashTable *snapshots;
+
+  GMutex lock;
+  GCond cond;
+  guint n_pending;
+} TiledFrame;
+
+typedef struct {
+  TiledFrame *frame;
+  cairo_rectangle_int_t area;
+} Tile;
+
 struct _GskCairoRenderer
 {
   GskRenderer parent_instance;
 
+  GThreadPool *tile_pool;
+
 #ifdef G_ENABLE_DEBUG
   ProfileTimers profile_timers;
 #endif
@@ -44,6 +78,341 @@ gsk_cairo_renderer_unrealize (GskRenderer *renderer)
 
 }
 
+static void
+gsk_cairo_renderer_finalize (GObject *gobject)
+{
+  GskCairoRenderer *self = GSK_CAIRO_RENDERER (gobject);
+
+  if (self->tile_pool)
+    g_thread_pool_free (self->tile_pool, TRUE, TRUE);
+
+  G_OBJECT_CLASS (gsk_cairo_renderer_parent_class)->finalize (gobject);
+}
+
+/* Returns an image surface with the contents of @surface, which is
+ * @width x @height units large. Image surfaces are used as they are.
+ */
+static cairo_surface_t *
+gsk_cairo_renderer_snapshot_surface (cairo_surface_t *surface,
+                                     int              width,
+                                     int              height)
+{
+  cairo_surface_t *image;
+  double x_scale, y_scale;
+  cairo_t *cr;
+
+  if (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE)
+    {
+      cairo_surface_flush (surface);
+      return cairo_surface_reference (surface);
+    }
+
+  cairo_surface_get_device_scale (surface, &x_scale, &y_scale);
+  image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                      ceil (width * x_scale),
+                                      ceil (height * y_scale));
+  cairo_surface_set_device_scale (image, x_scale, y_scale);
+
+  cr = cairo_create (image);
+  cairo_set_source_surface (cr, surface, 0, 0);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  return image;
+}
+
+/* Walks the tree before handing it to the worker threads. This
+ * forces lazily created state (like the scaled fonts of text nodes)
+ * to be created on this thread, and returns %FALSE for trees that
+ * contain nodes whose output depends on the clip extents they are
+ * drawn with, as blurs would otherwise differ at tile edges.
+ *
+ * The sources of Cairo and texture nodes are snapshotted into
+ * @snapshots, as the workers must not share cairo surfaces and
+ * textures may only be downloaded on this thread.
+ */
+static gboolean
+gsk_cairo_renderer_prepare_tiles (GskRenderNode *node,
+                                  GHashTable    *snapshots)
+{
+  guint i;
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      for (i = 0; i < gsk_container_node_get_n_children (node); i++)
+        {
+          if (!gsk_cairo_renderer_prepare_tiles (gsk_container_node_get_child (node, i), snapshots))
+            return FALSE;
+        }
+      return TRUE;
+
+    case GSK_TRANSFORM_NODE:
+      return gsk_cairo_renderer_prepare_tiles (gsk_transform_node_get_child (node), snapshots);
+
+    case GSK_OPACITY_NODE:
+      return gsk_cairo_renderer_prepare_tiles (gsk_opacity_node_get_child (node), snapshots);
+
+    case GSK_COLOR_MATRIX_NODE:
+      return gsk_cairo_renderer_prepare_tiles (gsk_color_matrix_node_get_child (node), snapshots);
+
+    case GSK_REPEAT_NODE:
+      return gsk_cairo_renderer_prepare_tiles (gsk_repeat_node_get_child (node), snapshots);
+
+    case GSK_CLIP_NODE:
+      return gsk_cairo_renderer_prepare_tiles (gsk_clip_node_get_child (node), snapshots);
+
+    case GSK_ROUNDED_CLIP_NODE:
+      return gsk_cairo_renderer_prepare_tiles (gsk_rounded_clip_node_get_child (node), snapshots);
+
+    case GSK_BLEND_NODE:
+      return gsk_cairo_renderer_prepare_tiles (gsk_blend_node_get_bottom_child (node), snapshots) &&
+             gsk_cairo_renderer_prepare_tiles (gsk_blend_node_get_top_child (node), snapshots);
+
+    case GSK_CROSS_FADE_NODE:
+      return gsk_cairo_renderer_prepare_tiles (gsk_cross_fade_node_get_start_child (node), snapshots) &&
+             gsk_cairo_renderer_prepare_tiles (gsk_cross_fade_node_get_end_child (node), snapshots);
+
+    case GSK_TEXT_NODE:
+      pango_cairo_font_get_scaled_font ((PangoCairoFont *) gsk_text_node_get_font (node));
+      return TRUE;
+
+    case GSK_CAIRO_NODE:
+      {
+        cairo_surface_t *surface = gsk_cairo_node_get_surface (node);
+        graphene_rect_t bounds;
+
+        if (surface == NULL || g_hash_table_contains (snapshots, node))
+          return TRUE;
+
+        gsk_render_node_get_bounds (node, &bounds);
+        g_hash_table_insert (snapshots, node,
+                             gsk_cairo_renderer_snapshot_surface (surface,
+                                                                  ceilf (bounds.size.width),
+                                                                  ceilf (bounds.size.height)));
+      }
+      return TRUE;
+
+    case GSK_TEXTURE_NODE:
+      {
+        GskTexture *texture = gsk_texture_node_get_texture (node);
+        cairo_surface_t *surface;
+
+        if (g_hash_table_contains (snapshots, node))
+          return TRUE;
+
+        surface = gsk_texture_download_surface (texture);
+        g_hash_table_insert (snapshots, node,
+                             gsk_cairo_renderer_snapshot_surface (surface,
+                                                                  gsk_texture_get_width (texture),
+                                                                  gsk_texture_get_height (texture)));
+        cairo_surface_destroy (surface);
+      }
+      return TRUE;
+
+    case GSK_INSET_SHADOW_NODE:
+      return gsk_inset_shadow_node_get_blur_radius (node) <= 0;
+
+    case GSK_OUTSET_SHADOW_NODE:
+      return gsk_outset_shadow_node_get_blur_radius (node) <= 0;
+
+    case GSK_SHADOW_NODE:
+    case GSK_BLUR_NODE:
+      return FALSE;
+
+    case GSK_NOT_A_RENDER_NODE:
+    case GSK_COLOR_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_BORDER_NODE:
+    default:
+      return TRUE;
+    }
+}
+
+static void
+gsk_cairo_renderer_draw_tile (gpointer data,
+                              gpointer user_data)
+{
+  Tile *tile = data;
+  TiledFrame *frame = tile->frame;
+  GskRenderNodeSources sources;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  int i;
+
+  /* Every tile gets its own surfaces pointing into the shared pixels,
+   * of the target and of the sources, so no cairo object is ever
+   * touched by two threads at once.
+   */
+  sources.snapshots = frame->snapshots;
+  sources.surfaces = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) cairo_surface_destroy);
+  gsk_render_node_set_thread_sources (&sources);
+
+  surface = cairo_image_surface_create_for_data (frame->data
+                                                 + tile->area.y * frame->stride
+                                                 + tile->area.x * 4,
+                                                 frame->format,
+                                                 tile->area.width,
+                                                 tile->area.height,
+                                                 frame->stride);
+  cairo_surface_set_device_scale (surface, frame->x_scale, frame->y_scale);
+  cairo_surface_set_device_offset (surface,
+                                   frame->x_offset - tile->area.x,
+                                   frame->y_offset - tile->area.y);
+
+  cr = cairo_create (surface);
+  cairo_set_matrix (cr, &frame->matrix);
+
+  for (i = 0; i < frame->clip->num_rectangles; i++)
+    {
+      const cairo_rectangle_t *r = &frame->clip->rectangles[i];
+
+      cairo_rectangle (cr, r->x, r->y, r->width, r->height);
+    }
+  cairo_clip (cr);
+
+  gsk_render_node_draw (frame->root, cr);
+
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  gsk_render_node_set_thread_sources (NULL);
+  g_hash_table_unref (sources.surfaces);
+
+  g_mutex_lock (&frame->lock);
+  frame->n_pending--;
+  if (frame->n_pending == 0)
+    g_cond_signal (&frame->cond);
+  g_mutex_unlock (&frame->lock);
+}
+
+/* Splits the device area covered by @cr into tiles and draws @root
+ * into each of them on the worker pool. Only image surfaces can be
+ * tiled; returns %FALSE if @cr can't be, so the caller can draw
+ * serially instead.
+ */
+static gboolean
+gsk_cairo_renderer_do_render_tiled (GskCairoRenderer *self,
+                                    cairo_t          *cr,
+                                    GskRenderNode    *root)
+{
+  cairo_surface_t *target;
+  cairo_rectangle_list_t *clip;
+  cairo_rectangle_int_t extents;
+  double x1, y1, x2, y2;
+  TiledFrame frame;
+  Tile *tiles;
+  int x, y, i, n_tiles, width, height;
+
+  target = cairo_get_target (cr);
+  if (cairo_surface_get_type (target) != CAIRO_SURFACE_TYPE_IMAGE)
+    return FALSE;
+
+  frame.format = cairo_image_surface_get_format (target);
+  if (frame.format != CAIRO_FORMAT_ARGB32 && frame.format != CAIRO_FORMAT_RGB24)
+    return FALSE;
+
+  /* Tile boundaries must fall on pixel boundaries in user space too,
+   * or antialiasing would differ from the serial path.
+   */
+  cairo_get_matrix (cr, &frame.matrix);
+  if (frame.matrix.xx != 1.0 || frame.matrix.yy != 1.0 ||
+      frame.matrix.xy != 0.0 || frame.matrix.yx != 0.0 ||
+      frame.matrix.x0 != floor (frame.matrix.x0) ||
+      frame.matrix.y0 != floor (frame.matrix.y0))
+    return FALSE;
+
+  clip = cairo_copy_clip_rectangle_list (cr);
+  if (clip->status != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_rectangle_list_destroy (clip);
+      return FALSE;
+    }
+
+  width = cairo_image_surface_get_width (target);
+  height = cairo_image_surface_get_height (target);
+
+  cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+  cairo_user_to_device (cr, &x1, &y1);
+  cairo_user_to_device (cr, &x2, &y2);
+  extents.x = MAX (floor (x1), 0);
+  extents.y = MAX (floor (y1), 0);
+  extents.width = MIN (ceil (x2), width) - extents.x;
+  extents.height = MIN (ceil (y2), height) - extents.y;
+
+  if (extents.width <= TILE_SIZE && extents.height <= TILE_SIZE)
+    {
+      cairo_rectangle_list_destroy (clip);
+      return FALSE;
+    }
+
+  frame.snapshots = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) cairo_surface_destroy);
+  if (!gsk_cairo_renderer_prepare_tiles (root, frame.snapshots))
+    {
+      GSK_NOTE (CAIRO, g_print ("Render tree can't be tiled, drawing serially\n"));
+      g_hash_table_unref (frame.snapshots);
+      cairo_rectangle_list_destroy (clip);
+      return FALSE;
+    }
+
+  if (self->tile_pool == NULL)
+    self->tile_pool = g_thread_pool_new (gsk_cairo_renderer_draw_tile,
+                                         NULL,
+                                         g_get_num_processors (),
+                                         FALSE,
+                                         NULL);
+
+  frame.root = root;
+  frame.data = cairo_image_surface_get_data (target);
+  frame.stride = cairo_image_surface_get_stride (target);
+  cairo_surface_get_device_scale (target, &frame.x_scale, &frame.y_scale);
+  cairo_surface_get_device_offset (target, &frame.x_offset, &frame.y_offset);
+  frame.clip = clip;
+  g_mutex_init (&frame.lock);
+  g_cond_init (&frame.cond);
+
+  tiles = g_new (Tile, ((extents.width + TILE_SIZE - 1) / TILE_SIZE) *
+                       ((extents.height + TILE_SIZE - 1) / TILE_SIZE));
+  n_tiles = 0;
+
+  cairo_surface_flush (target);
+
+  for (y = extents.y; y < extents.y + extents.height; y += TILE_SIZE)
+    {
+      for (x = extents.x; x < extents.x + extents.width; x += TILE_SIZE)
+        {
+          Tile *tile = &tiles[n_tiles++];
+
+          tile->frame = &frame;
+          tile->area.x = x;
+          tile->area.y = y;
+          tile->area.width = MIN (TILE_SIZE, extents.x + extents.width - x);
+          tile->area.height = MIN (TILE_SIZE, extents.y + extents.height - y);
+        }
+    }
+
+  GSK_NOTE (CAIRO, g_print ("Rendering %d tiles of %dx%d\n", n_tiles, TILE_SIZE, TILE_SIZE));
+
+  g_mutex_lock (&frame.lock);
+  frame.n_pending = n_tiles;
+  for (i = 0; i < n_tiles; i++)
+    g_thread_pool_push (self->tile_pool, &tiles[i], NULL);
+  while (frame.n_pending > 0)
+    g_cond_wait (&frame.cond, &frame.lock);
+  g_mutex_unlock (&frame.lock);
+
+  cairo_surface_mark_dirty_rectangle (target, extents.x, extents.y, extents.width, extents.height);
+
+  g_mutex_clear (&frame.lock);
+  g_cond_clear (&frame.cond);
+  g_free (tiles);
+  g_hash_table_unref (frame.snapshots);
+  cairo_rectangle_list_destroy (clip);
+
+  return TRUE;
+}
+
 static void
 gsk_cairo_renderer_do_render (GskRenderer   *renderer,
                               cairo_t       *cr,
@@ -60,7 +429,13 @@ gsk_cairo_renderer_do_render (GskRenderer   *renderer,
   gsk_profiler_timer_begin (profiler, self->profile_timers.cpu_time);
 #endif
 
-  gsk_render_node_draw (root, cr);
+  /* Tiling is not a debugging aid, so it is checked for in all builds.
+   * Per-node draw times are collected on this thread only.
+   */
+  if (!gsk_check_rendering_flags (GSK_RENDERING_MODE_TILED) ||
+      gsk_renderer_get_profile_nodes (renderer) ||
+      !gsk_cairo_renderer_do_render_tiled (GSK_CAIRO_RENDERER (renderer), cr, root))
+    gsk_render_node_draw (root, cr);
 
 #ifdef G_ENABLE_DEBUG
   cpu_time = gsk_profiler_timer_end (profiler, self->profile_timers.cpu_time);
@@ -84,6 +459,10 @@ gsk_cairo_renderer_render_texture (GskRenderer           *renderer,
 
   cairo_translate (cr, - viewport->origin.x, - viewport->origin.y);
 
+  /* An explicit clip makes the target tileable, see do_render_tiled() */
+  cairo_rectangle (cr, viewport->origin.x, viewport->origin.y, viewport->size.width, viewport->size.height);
+  cairo_clip (cr);
+
   gsk_cairo_renderer_do_render (renderer, cr, root);
 
   cairo_destroy (cr);
@@ -129,8 +508,11 @@ gsk_cairo_renderer_render (GskRenderer   *renderer,
 static void
 gsk_cairo_renderer_class_init (GskCairoRendererClass *klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GskRendererClass *renderer_class = GSK_RENDERER_CLASS (klass);
 
+  gobject_class->finalize = gsk_cairo_renderer_finalize;
+
   renderer_class->realize = gsk_cairo_renderer_realize;
   renderer_class->unrealize = gsk_cairo_renderer_unrealize;
   renderer_class->render = gsk_cairo_renderer_render;
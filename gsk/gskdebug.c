@@ -21,7 +21,8 @@ static const GDebugKey gsk_rendering_keys[] = {
   { "sync", GSK_RENDERING_MODE_SYNC },
   { "full-redraw", GSK_RENDERING_MODE_FULL_REDRAW},
   { "staging-image", GSK_RENDERING_MODE_STAGING_IMAGE },
-  { "staging-buffer", GSK_RENDERING_MODE_STAGING_BUFFER }
+  { "staging-buffer", GSK_RENDERING_MODE_STAGING_BUFFER },
+  { "tiled", GSK_RENDERING_MODE_TILED }
 };
 
 gboolean
@@ -8,6 +8,8 @@
 #include <gdk/gdk.h>
 #include <epoxy/gl.h>
 
+typedef struct _TextureUploads TextureUploads;
+
 typedef struct {
   GLuint texture_id;
   int width;
@@ -15,8 +17,9 @@ typedef struct {
   GLuint min_filter;
   GLuint mag_filter;
   GArray *fbos;
-  GskTexture *user;
+  TextureUploads *uploads;
   gboolean in_use : 1;
+  gboolean permanent : 1;
 } Texture;
 
 typedef struct {
@@ -29,6 +32,63 @@ typedef struct {
   gboolean in_use : 1;
 } Vao;
 
+/* Small textures are packed into shared atlas pages, so that drawing
+ * many of them doesn't need as many texture objects and binds.
+ */
+#define ATLAS_SIZE              1024
+#define MAX_ATLAS_ITEM_SIZE     128
+#define MAX_ATLAS_PAGES         4
+
+/* Each item is surrounded by a copy of its edge pixels, so that linear
+ * filtering doesn't pick up its neighbours
+ */
+#define ATLAS_PADDING           1
+
+typedef struct {
+  int y;
+  int height;
+  /* The start of the free space */
+  int x;
+} AtlasShelf;
+
+typedef struct {
+  int texture_id;
+  int filter;
+
+  /* Pages are filled with a shelf packer */
+  GArray *shelves;
+
+  /* The AtlasEntry of every texture in the page */
+  GHashTable *entries;
+
+  /* The last frame the page was used in */
+  guint64 last_used;
+} AtlasPage;
+
+typedef struct {
+  AtlasPage *page;
+  TextureUploads *uploads;
+
+  /* The area of the texture in the page, excluding the padding */
+  int x;
+  int y;
+  int width;
+  int height;
+} AtlasEntry;
+
+/* The render data of a GskTexture. Drawing it with different filters
+ * needs separate uploads, so all of them are kept.
+ */
+struct _TextureUploads {
+  GskTexture *user;
+
+  /* Textures holding the whole GskTexture, one per filter pair */
+  GSList *textures;
+
+  /* AtlasEntries in pages with different filters */
+  GSList *atlas_entries;
+};
+
 typedef struct {
   GLuint fbo_id;
   GLuint depth_stencil_id;
@@ -44,15 +104,23 @@ struct _GskGLDriver
 
   GHashTable *textures;
   GHashTable *vaos;
+  GPtrArray *atlas_pages;
 
   Texture *bound_source_texture;
   Texture *bound_mask_texture;
   Vao *bound_vao;
   Fbo *bound_fbo;
 
+  /* The vertices of all batches in a frame, reused across frames */
+  GLuint batch_vao_id;
+  GLuint batch_buffer_id;
+
   int max_texture_size;
 
+  guint64 frame_counter;
+
   gboolean in_frame : 1;
+  gboolean batch_vao_bound : 1;
 };
 
 enum
@@ -72,13 +140,20 @@ texture_new (void)
   return g_slice_new0 (Texture);
 }
 
+static void texture_uploads_check_empty (TextureUploads *uploads);
+
 static void
 texture_free (gpointer data)
 {
   Texture *t = data;
 
-  if (t->user)
-    gsk_texture_clear_render_data (t->user);
+  if (t->uploads)
+    {
+      TextureUploads *uploads = t->uploads;
+
+      uploads->textures = g_slist_remove (uploads->textures, t);
+      texture_uploads_check_empty (uploads);
+    }
 
   g_clear_pointer (&t->fbos, g_array_unref);
   glDeleteTextures (1, &t->texture_id);
@@ -113,6 +188,98 @@ vao_free (gpointer data)
   g_slice_free (Vao, v);
 }
 
+static void
+atlas_entry_free (gpointer data)
+{
+  AtlasEntry *entry = data;
+
+  if (entry->page != NULL)
+    g_hash_table_remove (entry->page->entries, entry);
+
+  g_slice_free (AtlasEntry, entry);
+}
+
+static void
+atlas_page_clear (AtlasPage *page)
+{
+  GList *entries, *l;
+
+  entries = g_hash_table_get_keys (page->entries);
+  for (l = entries; l != NULL; l = l->next)
+    {
+      AtlasEntry *entry = l->data;
+      TextureUploads *uploads = entry->uploads;
+
+      uploads->atlas_entries = g_slist_remove (uploads->atlas_entries, entry);
+      atlas_entry_free (entry);
+      texture_uploads_check_empty (uploads);
+    }
+  g_list_free (entries);
+
+  g_array_set_size (page->shelves, 0);
+}
+
+static void
+texture_uploads_free (gpointer data)
+{
+  TextureUploads *uploads = data;
+  GSList *l;
+
+  for (l = uploads->textures; l != NULL; l = l->next)
+    {
+      Texture *t = l->data;
+
+      t->uploads = NULL;
+    }
+
+  g_slist_free (uploads->textures);
+  g_slist_free_full (uploads->atlas_entries, atlas_entry_free);
+  g_slice_free (TextureUploads, uploads);
+}
+
+/* Drops the render data of a texture once nothing of it is uploaded */
+static void
+texture_uploads_check_empty (TextureUploads *uploads)
+{
+  if (uploads->textures == NULL && uploads->atlas_entries == NULL)
+    gsk_texture_clear_render_data (uploads->user);
+}
+
+static TextureUploads *
+gsk_gl_driver_get_uploads (GskGLDriver *driver,
+                           GskTexture  *texture)
+{
+  TextureUploads *uploads;
+
+  uploads = gsk_texture_get_render_data (texture, driver);
+  if (uploads != NULL)
+    return uploads;
+
+  uploads = g_slice_new0 (TextureUploads);
+  uploads->user = texture;
+
+  /* The texture can only have render data for one user */
+  if (!gsk_texture_set_render_data (texture, driver, uploads, texture_uploads_free))
+    {
+      g_slice_free (TextureUploads, uploads);
+      return NULL;
+    }
+
+  return uploads;
+}
+
+static void
+atlas_page_free (gpointer data)
+{
+  AtlasPage *page = data;
+
+  atlas_page_clear (page);
+
+  g_array_unref (page->shelves);
+  g_hash_table_unref (page->entries);
+  g_slice_free (AtlasPage, page);
+}
+
 static void
 gsk_gl_driver_finalize (GObject *gobject)
 {
@@ -120,9 +287,17 @@ gsk_gl_driver_finalize (GObject *gobject)
 
   gdk_gl_context_make_current (self->gl_context);
 
+  /* The pages point to textures, so they must go first */
+  g_clear_pointer (&self->atlas_pages, g_ptr_array_unref);
   g_clear_pointer (&self->textures, g_hash_table_unref);
   g_clear_pointer (&self->vaos, g_hash_table_unref);
 
+  if (self->batch_vao_id != 0)
+    {
+      glDeleteBuffers (1, &self->batch_buffer_id);
+      glDeleteVertexArrays (1, &self->batch_vao_id);
+    }
+
   if (self->gl_context == gdk_gl_context_get_current ())
     gdk_gl_context_clear_current ();
 
@@ -191,6 +366,7 @@ gsk_gl_driver_init (GskGLDriver *self)
 {
   self->textures = g_hash_table_new_full (NULL, NULL, NULL, texture_free);
   self->vaos = g_hash_table_new_full (NULL, NULL, NULL, vao_free);
+  self->atlas_pages = g_ptr_array_new_with_free_func (atlas_page_free);
 
   self->max_texture_size = -1;
 }
@@ -212,6 +388,7 @@ gsk_gl_driver_begin_frame (GskGLDriver *driver)
   g_return_if_fail (!driver->in_frame);
 
   driver->in_frame = TRUE;
+  driver->frame_counter++;
 
   if (driver->max_texture_size < 0)
     {
@@ -248,6 +425,7 @@ gsk_gl_driver_end_frame (GskGLDriver *driver)
   driver->bound_mask_texture = NULL;
   driver->bound_vao = NULL;
   driver->bound_fbo = NULL;
+  driver->batch_vao_bound = FALSE;
 
   driver->default_fbo.fbo_id = 0;
 
@@ -276,7 +454,7 @@ gsk_gl_driver_collect_textures (GskGLDriver *driver)
     {
       Texture *t = value_p;
 
-      if (t->user)
+      if (t->uploads || t->permanent)
         continue;
 
       if (t->in_use)
@@ -407,7 +585,7 @@ create_texture (GskGLDriver *driver,
     }
 
   t = find_texture_by_size (driver->textures, width, height);
-  if (t != NULL && !t->in_use && t->user == NULL)
+  if (t != NULL && !t->in_use && t->uploads == NULL)
     {
       GSK_NOTE (OPENGL, g_print ("Reusing Texture(%d) for size %dx%d\n",
                                  t->texture_id, t->width, t->height));
@@ -429,38 +607,40 @@ create_texture (GskGLDriver *driver,
   return t;
 }
 
-static void
-gsk_gl_driver_release_texture (gpointer data)
-{
-  Texture *t = data;
-
-  t->user = NULL;
-}
-
 int
 gsk_gl_driver_get_texture_for_texture (GskGLDriver *driver,
                                        GskTexture  *texture,
                                        int          min_filter,
                                        int          mag_filter)
 {
+  TextureUploads *uploads;
   Texture *t;
   cairo_surface_t *surface;
+  GSList *l;
 
   g_return_val_if_fail (GSK_IS_GL_DRIVER (driver), -1);
   g_return_val_if_fail (GSK_IS_TEXTURE (texture), -1);
 
-  t = gsk_texture_get_render_data (texture, driver);
+  uploads = gsk_gl_driver_get_uploads (driver, texture);
 
-  if (t)
+  if (uploads)
     {
-      if (t->min_filter == min_filter && t->mag_filter == mag_filter)
-        return t->texture_id;
+      for (l = uploads->textures; l != NULL; l = l->next)
+        {
+          t = l->data;
+
+          if (t->min_filter == min_filter && t->mag_filter == mag_filter)
+            return t->texture_id;
+        }
     }
-  
+
   t = create_texture (driver, gsk_texture_get_width (texture), gsk_texture_get_height (texture));
 
-  if (gsk_texture_set_render_data (texture, driver, t, gsk_gl_driver_release_texture))
-    t->user = texture;
+  if (uploads)
+    {
+      t->uploads = uploads;
+      uploads->textures = g_slist_prepend (uploads->textures, t);
+    }
 
   surface = gsk_texture_download_surface (texture);
   gsk_gl_driver_bind_source_texture (driver, t->texture_id);
@@ -474,6 +654,288 @@ gsk_gl_driver_get_texture_for_texture (GskGLDriver *driver,
   return t->texture_id;
 }
 
+static void
+gsk_gl_driver_set_texture_parameters (GskGLDriver *driver,
+                                      int          min_filter,
+                                      int          mag_filter)
+{
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+static gboolean
+atlas_page_allocate (AtlasPage *page,
+                     int        width,
+                     int        height,
+                     int       *x,
+                     int       *y)
+{
+  AtlasShelf *shelf, *best = NULL;
+  int bottom = 0;
+  guint i;
+
+  /* Find the flattest shelf with enough room */
+  for (i = 0; i < page->shelves->len; i++)
+    {
+      shelf = &g_array_index (page->shelves, AtlasShelf, i);
+      bottom = shelf->y + shelf->height;
+
+      if (shelf->height >= height &&
+          ATLAS_SIZE - shelf->x >= width &&
+          (best == NULL || shelf->height < best->height))
+        best = shelf;
+    }
+
+  /* Don't waste much more than half of a shelf if we can start a new one */
+  if (best != NULL && best->height <= 2 * height)
+    shelf = best;
+  else if (ATLAS_SIZE - bottom >= height)
+    {
+      AtlasShelf new_shelf = { bottom, height, 0 };
+
+      g_array_append_val (page->shelves, new_shelf);
+      shelf = &g_array_index (page->shelves, AtlasShelf, page->shelves->len - 1);
+    }
+  else if (best != NULL)
+    shelf = best;
+  else
+    return FALSE;
+
+  *x = shelf->x;
+  *y = shelf->y;
+  shelf->x += width;
+
+  return TRUE;
+}
+
+static void
+atlas_page_set_filter (GskGLDriver *driver,
+                       AtlasPage   *page,
+                       int          filter)
+{
+  Texture *t = gsk_gl_driver_get_texture (driver, page->texture_id);
+
+  glActiveTexture (GL_TEXTURE0);
+  glBindTexture (GL_TEXTURE_2D, t->texture_id);
+  gsk_gl_driver_set_texture_parameters (driver, filter, filter);
+  glBindTexture (GL_TEXTURE_2D, 0);
+  driver->bound_source_texture = NULL;
+
+  page->filter = filter;
+  t->min_filter = filter;
+  t->mag_filter = filter;
+}
+
+static AtlasPage *
+gsk_gl_driver_add_atlas_page (GskGLDriver *driver,
+                              int          filter)
+{
+  AtlasPage *page;
+
+  page = g_slice_new0 (AtlasPage);
+  page->shelves = g_array_new (FALSE, FALSE, sizeof (AtlasShelf));
+  page->entries = g_hash_table_new (NULL, NULL);
+
+  page->texture_id = gsk_gl_driver_create_permanent_texture (driver, ATLAS_SIZE, ATLAS_SIZE);
+  gsk_gl_driver_bind_source_texture (driver, page->texture_id);
+  gsk_gl_driver_init_texture_empty (driver, page->texture_id);
+  atlas_page_set_filter (driver, page, filter);
+
+  g_ptr_array_add (driver->atlas_pages, page);
+
+  GSK_NOTE (OPENGL, g_print ("New atlas page, Texture(%d)\n", page->texture_id));
+
+  return page;
+}
+
+/* Finds room for a @width x @height item in a page using @filter,
+ * making a new page or evicting the least recently used one if needed
+ */
+static AtlasPage *
+gsk_gl_driver_allocate_atlas_area (GskGLDriver *driver,
+                                   int          filter,
+                                   int          width,
+                                   int          height,
+                                   int         *x,
+                                   int         *y)
+{
+  AtlasPage *page, *lru = NULL;
+  guint i;
+
+  for (i = 0; i < driver->atlas_pages->len; i++)
+    {
+      page = g_ptr_array_index (driver->atlas_pages, i);
+
+      if (page->filter == filter && atlas_page_allocate (page, width, height, x, y))
+        return page;
+
+      /* Pages used in this frame must keep their contents */
+      if (page->last_used != driver->frame_counter &&
+          (lru == NULL || page->last_used < lru->last_used))
+        lru = page;
+    }
+
+  if (driver->atlas_pages->len < MAX_ATLAS_PAGES)
+    page = gsk_gl_driver_add_atlas_page (driver, filter);
+  else if (lru != NULL)
+    {
+      GSK_NOTE (OPENGL, g_print ("Evicting %u textures from atlas page Texture(%d)\n",
+                                 g_hash_table_size (lru->entries),
+                                 lru->texture_id));
+
+      page = lru;
+      atlas_page_clear (page);
+      if (page->filter != filter)
+        atlas_page_set_filter (driver, page, filter);
+    }
+  else
+    return NULL;
+
+  if (!atlas_page_allocate (page, width, height, x, y))
+    return NULL;
+
+  return page;
+}
+
+static int
+gsk_gl_driver_get_atlas_texture (GskGLDriver     *driver,
+                                 GskTexture      *texture,
+                                 int              filter,
+                                 graphene_rect_t *uv_rect)
+{
+  TextureUploads *uploads;
+  AtlasEntry *entry = NULL;
+  AtlasPage *page;
+  cairo_surface_t *surface, *padded;
+  cairo_t *cr;
+  int width, height;
+  int x, y;
+  GSList *l;
+
+  uploads = gsk_texture_get_render_data (texture, driver);
+  if (uploads != NULL)
+    {
+      for (l = uploads->atlas_entries; l != NULL; l = l->next)
+        {
+          AtlasEntry *e = l->data;
+
+          if (e->page->filter == filter)
+            {
+              entry = e;
+              break;
+            }
+        }
+    }
+
+  if (entry == NULL)
+    {
+      /* Don't take up room in a page for a texture we can't track */
+      if (gsk_gl_driver_get_uploads (driver, texture) == NULL)
+        return 0;
+
+      width = gsk_texture_get_width (texture);
+      height = gsk_texture_get_height (texture);
+      page = gsk_gl_driver_allocate_atlas_area (driver, filter,
+                                                width + 2 * ATLAS_PADDING,
+                                                height + 2 * ATLAS_PADDING,
+                                                &x, &y);
+
+      /* Making room may have evicted the other uploads of the texture,
+       * taking its render data with them
+       */
+      uploads = gsk_gl_driver_get_uploads (driver, texture);
+
+      if (page == NULL)
+        {
+          texture_uploads_check_empty (uploads);
+          return 0;
+        }
+
+      entry = g_slice_new0 (AtlasEntry);
+      entry->uploads = uploads;
+      entry->page = page;
+      entry->x = x + ATLAS_PADDING;
+      entry->y = y + ATLAS_PADDING;
+      entry->width = width;
+      entry->height = height;
+      g_hash_table_add (page->entries, entry);
+      uploads->atlas_entries = g_slist_prepend (uploads->atlas_entries, entry);
+
+      surface = gsk_texture_download_surface (texture);
+      padded = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                           entry->width + 2 * ATLAS_PADDING,
+                                           entry->height + 2 * ATLAS_PADDING);
+      cr = cairo_create (padded);
+      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      cairo_set_source_surface (cr, surface, ATLAS_PADDING, ATLAS_PADDING);
+      cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_PAD);
+      cairo_paint (cr);
+      cairo_destroy (cr);
+
+      gsk_gl_driver_update_texture_region (driver, page->texture_id, padded, x, y);
+
+      cairo_surface_destroy (padded);
+      cairo_surface_destroy (surface);
+    }
+
+  entry->page->last_used = driver->frame_counter;
+
+  graphene_rect_init (uv_rect,
+                      (float) entry->x / ATLAS_SIZE,
+                      (float) entry->y / ATLAS_SIZE,
+                      (float) entry->width / ATLAS_SIZE,
+                      (float) entry->height / ATLAS_SIZE);
+
+  return entry->page->texture_id;
+}
+
+/*< private >
+ * gsk_gl_driver_get_texture_region:
+ * @driver: a #GskGLDriver
+ * @texture: a #GskTexture
+ * @min_filter: the minification filter
+ * @mag_filter: the magnification filter
+ * @uv_rect: (out): return location for the area of the GL texture
+ *   that holds @texture, in texture coordinates
+ *
+ * Like gsk_gl_driver_get_texture_for_texture(), but small textures are
+ * packed into shared atlas pages, so they only occupy a region of the
+ * returned GL texture.
+ *
+ * Returns: the texture id
+ */
+int
+gsk_gl_driver_get_texture_region (GskGLDriver     *driver,
+                                  GskTexture      *texture,
+                                  int              min_filter,
+                                  int              mag_filter,
+                                  graphene_rect_t *uv_rect)
+{
+  g_return_val_if_fail (GSK_IS_GL_DRIVER (driver), -1);
+  g_return_val_if_fail (GSK_IS_TEXTURE (texture), -1);
+  g_return_val_if_fail (driver->in_frame, -1);
+
+  /* Mipmaps would mix neighbouring items */
+  if (gsk_texture_get_width (texture) <= MAX_ATLAS_ITEM_SIZE &&
+      gsk_texture_get_height (texture) <= MAX_ATLAS_ITEM_SIZE &&
+      driver->max_texture_size > ATLAS_SIZE &&
+      min_filter == mag_filter &&
+      (min_filter == GL_NEAREST || min_filter == GL_LINEAR))
+    {
+      int texture_id = gsk_gl_driver_get_atlas_texture (driver, texture, min_filter, uv_rect);
+
+      if (texture_id != 0)
+        return texture_id;
+    }
+
+  graphene_rect_init (uv_rect, 0, 0, 1, 1);
+
+  return gsk_gl_driver_get_texture_for_texture (driver, texture, min_filter, mag_filter);
+}
+
 int
 gsk_gl_driver_create_texture (GskGLDriver *driver,
                               int          width,
@@ -488,6 +950,33 @@ gsk_gl_driver_create_texture (GskGLDriver *driver,
   return t->texture_id;
 }
 
+/*< private >
+ * gsk_gl_driver_create_permanent_texture:
+ * @driver: a #GskGLDriver
+ * @width: the width of the texture
+ * @height: the height of the texture
+ *
+ * Creates a texture like gsk_gl_driver_create_texture(), but the
+ * texture is never collected or reused; it stays around until it
+ * is destroyed with gsk_gl_driver_destroy_texture().
+ *
+ * Returns: the texture id
+ */
+int
+gsk_gl_driver_create_permanent_texture (GskGLDriver *driver,
+                                        int          width,
+                                        int          height)
+{
+  Texture *t;
+
+  g_return_val_if_fail (GSK_IS_GL_DRIVER (driver), -1);
+
+  t = create_texture (driver, width, height);
+  t->permanent = TRUE;
+
+  return t->texture_id;
+}
+
 static Vao *
 find_vao (GHashTable    *vaos,
           int            position_id,
@@ -722,6 +1211,70 @@ gsk_gl_driver_bind_vao (GskGLDriver *driver,
       glEnableVertexAttribArray (v->uv_id);
 
       driver->bound_vao = v;
+      driver->batch_vao_bound = FALSE;
+    }
+}
+
+void
+gsk_gl_driver_upload_batch_vertices (GskGLDriver          *driver,
+                                     int                   position_id,
+                                     int                   uv_id,
+                                     int                   color_id,
+                                     int                   n_vertices,
+                                     const GskBatchVertex *vertices)
+{
+  g_return_if_fail (GSK_IS_GL_DRIVER (driver));
+  g_return_if_fail (driver->in_frame);
+
+  if (driver->batch_vao_id == 0)
+    {
+      glGenVertexArrays (1, &driver->batch_vao_id);
+      glGenBuffers (1, &driver->batch_buffer_id);
+    }
+
+  glBindVertexArray (driver->batch_vao_id);
+  glBindBuffer (GL_ARRAY_BUFFER, driver->batch_buffer_id);
+
+  /* Orphan the previous contents, so we don't wait for the GPU to be
+   * done with the last frame
+   */
+  glBufferData (GL_ARRAY_BUFFER, sizeof (GskBatchVertex) * n_vertices, vertices, GL_STREAM_DRAW);
+
+  glEnableVertexAttribArray (position_id);
+  glVertexAttribPointer (position_id, 2, GL_FLOAT, GL_FALSE,
+                         sizeof (GskBatchVertex),
+                         (void *) G_STRUCT_OFFSET (GskBatchVertex, position));
+
+  glEnableVertexAttribArray (uv_id);
+  glVertexAttribPointer (uv_id, 2, GL_FLOAT, GL_FALSE,
+                         sizeof (GskBatchVertex),
+                         (void *) G_STRUCT_OFFSET (GskBatchVertex, uv));
+
+  glEnableVertexAttribArray (color_id);
+  glVertexAttribPointer (color_id, 4, GL_FLOAT, GL_FALSE,
+                         sizeof (GskBatchVertex),
+                         (void *) G_STRUCT_OFFSET (GskBatchVertex, color));
+
+  GSK_NOTE (OPENGL, g_print ("Uploaded %d batch vertices\n", n_vertices));
+
+  driver->bound_vao = NULL;
+  driver->batch_vao_bound = TRUE;
+}
+
+void
+gsk_gl_driver_bind_batch_vao (GskGLDriver *driver)
+{
+  g_return_if_fail (GSK_IS_GL_DRIVER (driver));
+  g_return_if_fail (driver->in_frame);
+  g_return_if_fail (driver->batch_vao_id != 0);
+
+  if (!driver->batch_vao_bound)
+    {
+      glBindVertexArray (driver->batch_vao_id);
+      glBindBuffer (GL_ARRAY_BUFFER, driver->batch_buffer_id);
+
+      driver->bound_vao = NULL;
+      driver->batch_vao_bound = TRUE;
     }
 }
 
@@ -780,18 +1333,6 @@ gsk_gl_driver_destroy_vao (GskGLDriver *driver,
   g_hash_table_remove (driver->vaos, GINT_TO_POINTER (vao_id));
 }
 
-static void
-gsk_gl_driver_set_texture_parameters (GskGLDriver *driver,
-                                      int          min_filter,
-                                      int          mag_filter)
-{
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
-
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-}
-
 void
 gsk_gl_driver_init_texture_empty (GskGLDriver *driver,
                                   int          texture_id)
@@ -859,3 +1400,58 @@ gsk_gl_driver_init_texture_with_surface (GskGLDriver     *driver,
 
   glBindTexture (GL_TEXTURE_2D, 0);
 }
+
+/*< private >
+ * gsk_gl_driver_update_texture_region:
+ * @driver: a #GskGLDriver
+ * @texture_id: an initialized texture
+ * @surface: an image surface in %CAIRO_FORMAT_ARGB32
+ * @x: the horizontal position in the texture
+ * @y: the vertical position in the texture
+ *
+ * Replaces the contents of the area at @x, @y of the texture with
+ * the contents of @surface.
+ */
+void
+gsk_gl_driver_update_texture_region (GskGLDriver     *driver,
+                                     int              texture_id,
+                                     cairo_surface_t *surface,
+                                     int              x,
+                                     int              y)
+{
+  int width, height;
+  Texture *t;
+
+  g_return_if_fail (GSK_IS_GL_DRIVER (driver));
+  g_return_if_fail (cairo_image_surface_get_format (surface) == CAIRO_FORMAT_ARGB32);
+
+  t = gsk_gl_driver_get_texture (driver, texture_id);
+  if (t == NULL)
+    {
+      g_critical ("No texture %d found.", texture_id);
+      return;
+    }
+
+  width = cairo_image_surface_get_width (surface);
+  height = cairo_image_surface_get_height (surface);
+
+  /* ARGB32 rows are never padded, so the data can be uploaded as is */
+  g_assert (cairo_image_surface_get_stride (surface) == width * 4);
+
+  cairo_surface_flush (surface);
+
+  glActiveTexture (GL_TEXTURE0);
+  glBindTexture (GL_TEXTURE_2D, t->texture_id);
+
+  if (gdk_gl_context_get_use_es (driver->gl_context))
+    glTexSubImage2D (GL_TEXTURE_2D, 0, x, y, width, height,
+                     GL_RGBA, GL_UNSIGNED_BYTE,
+                     cairo_image_surface_get_data (surface));
+  else
+    glTexSubImage2D (GL_TEXTURE_2D, 0, x, y, width, height,
+                     GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+                     cairo_image_surface_get_data (surface));
+
+  glBindTexture (GL_TEXTURE_2D, 0);
+  driver->bound_source_texture = NULL;
+}
@@ -18,6 +18,12 @@ typedef struct {
   float uv[2];
 } GskQuadVertex;
 
+typedef struct {
+  float position[2];
+  float uv[2];
+  float color[4];
+} GskBatchVertex;
+
 GskGLDriver *   gsk_gl_driver_new                       (GdkGLContext    *context);
 
 int             gsk_gl_driver_get_max_texture_size      (GskGLDriver     *driver);
@@ -29,9 +35,17 @@ int             gsk_gl_driver_get_texture_for_texture   (GskGLDriver     *driver
                                                          GskTexture      *texture,
                                                          int              min_filter,
                                                          int              mag_filter);
+int             gsk_gl_driver_get_texture_region        (GskGLDriver     *driver,
+                                                         GskTexture      *texture,
+                                                         int              min_filter,
+                                                         int              mag_filter,
+                                                         graphene_rect_t *uv_rect);
 int             gsk_gl_driver_create_texture            (GskGLDriver     *driver,
                                                          int              width,
                                                          int              height);
+int             gsk_gl_driver_create_permanent_texture  (GskGLDriver     *driver,
+                                                         int              width,
+                                                         int              height);
 int             gsk_gl_driver_create_vao_for_quad       (GskGLDriver     *driver,
                                                          int              position_id,
                                                          int              uv_id,
@@ -51,6 +65,14 @@ void            gsk_gl_driver_bind_vao                  (GskGLDriver     *driver
 gboolean        gsk_gl_driver_bind_render_target        (GskGLDriver     *driver,
                                                          int              texture_id);
 
+void            gsk_gl_driver_upload_batch_vertices     (GskGLDriver     *driver,
+                                                         int              position_id,
+                                                         int              uv_id,
+                                                         int              color_id,
+                                                         int              n_vertices,
+                                                         const GskBatchVertex *vertices);
+void            gsk_gl_driver_bind_batch_vao            (GskGLDriver     *driver);
+
 void            gsk_gl_driver_init_texture_empty        (GskGLDriver     *driver,
                                                          int              texture_id);
 void            gsk_gl_driver_init_texture_with_surface (GskGLDriver     *driver,
@@ -58,6 +80,11 @@ void            gsk_gl_driver_init_texture_with_surface (GskGLDriver     *driver
                                                          cairo_surface_t *surface,
                                                          int              min_filter,
                                                          int              mag_filter);
+void            gsk_gl_driver_update_texture_region     (GskGLDriver     *driver,
+                                                         int              texture_id,
+                                                         cairo_surface_t *surface,
+                                                         int              x,
+                                                         int              y);
 
 void            gsk_gl_driver_destroy_texture           (GskGLDriver     *driver,
                                                          int              texture_id);
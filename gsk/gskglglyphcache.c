@@ -0,0 +1,528 @@
+#include "config.h"
+
+#include "gskglglyphcacheprivate.h"
+
+#include "gskdebugprivate.h"
+#include "gskprivate.h"
+
+#include <pango/pangocairo.h>
+#include <epoxy/gl.h>
+
+/* Parameters for our cache eviction strategy, the same as for the Vulkan
+ * glyph cache.
+ *
+ * Each cached glyph has an age that gets reset every time a cached glyph gets used.
+ * Glyphs that have not been used for the MAX_AGE frames are considered old. We keep
+ * count of the pixels of each atlas that are taken up by old glyphs. We check the
+ * fraction of old pixels every CHECK_INTERVAL frames, and if it is above MAX_OLD, then
+ * we drop the atlas and all the glyphs contained in it from the cache.
+ */
+
+#define MAX_AGE 60
+#define CHECK_INTERVAL 10
+#define MAX_OLD 0.333
+
+#define ATLAS_SIZE 512
+
+typedef struct {
+  GskGLDriver *driver;
+  int texture_id;
+  int width, height;
+  int x, y, y0;
+  int num_glyphs;
+  GList *dirty_glyphs;
+  guint old_pixels;
+} Atlas;
+
+struct _GskGLGlyphCache {
+  GObject parent_instance;
+
+  GskGLDriver *driver;
+
+  GHashTable *hash_table;
+  GPtrArray *atlases;
+
+  guint64 timestamp;
+};
+
+struct _GskGLGlyphCacheClass {
+  GObjectClass parent_class;
+};
+
+G_DEFINE_TYPE (GskGLGlyphCache, gsk_gl_glyph_cache, G_TYPE_OBJECT)
+
+static guint    glyph_cache_hash       (gconstpointer v);
+static gboolean glyph_cache_equal      (gconstpointer v1,
+                                        gconstpointer v2);
+static void     glyph_cache_key_free   (gpointer      v);
+static void     glyph_cache_value_free (gpointer      v);
+
+typedef struct {
+  PangoFont *font;
+  PangoGlyph glyph;
+  int scale;
+} GlyphCacheKey;
+
+typedef struct {
+  GlyphCacheKey *key;
+  GskGLCachedGlyph *value;
+} DirtyGlyph;
+
+static Atlas *
+create_atlas (GskGLGlyphCache *cache)
+{
+  Atlas *atlas;
+
+  atlas = g_new0 (Atlas, 1);
+  atlas->driver = cache->driver;
+  atlas->width = ATLAS_SIZE;
+  atlas->height = ATLAS_SIZE;
+  atlas->y0 = 1;
+  atlas->y = 1;
+  atlas->x = 1;
+  atlas->texture_id = 0;
+  atlas->num_glyphs = 0;
+  atlas->dirty_glyphs = NULL;
+
+  return atlas;
+}
+
+static void
+free_atlas (gpointer v)
+{
+  Atlas *atlas = v;
+
+  if (atlas->texture_id != 0)
+    gsk_gl_driver_destroy_texture (atlas->driver, atlas->texture_id);
+  g_list_free_full (atlas->dirty_glyphs, g_free);
+  g_free (atlas);
+}
+
+static void
+gsk_gl_glyph_cache_init (GskGLGlyphCache *cache)
+{
+  cache->hash_table = g_hash_table_new_full (glyph_cache_hash, glyph_cache_equal,
+                                             glyph_cache_key_free, glyph_cache_value_free);
+  cache->atlases = g_ptr_array_new_with_free_func (free_atlas);
+}
+
+static void
+gsk_gl_glyph_cache_finalize (GObject *object)
+{
+  GskGLGlyphCache *cache = GSK_GL_GLYPH_CACHE (object);
+
+  g_ptr_array_unref (cache->atlases);
+  g_hash_table_unref (cache->hash_table);
+
+  G_OBJECT_CLASS (gsk_gl_glyph_cache_parent_class)->finalize (object);
+}
+
+static void
+gsk_gl_glyph_cache_class_init (GskGLGlyphCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gsk_gl_glyph_cache_finalize;
+}
+
+static gboolean
+glyph_cache_equal (gconstpointer v1, gconstpointer v2)
+{
+  const GlyphCacheKey *key1 = v1;
+  const GlyphCacheKey *key2 = v2;
+
+  return key1->font == key2->font &&
+         key1->glyph == key2->glyph &&
+         key1->scale == key2->scale;
+}
+
+static guint
+glyph_cache_hash (gconstpointer v)
+{
+  const GlyphCacheKey *key = v;
+
+  return GPOINTER_TO_UINT (key->font) ^ key->glyph ^ (key->scale << 24);
+}
+
+static void
+glyph_cache_key_free (gpointer v)
+{
+  GlyphCacheKey *f = v;
+
+  g_object_unref (f->font);
+  g_free (f);
+}
+
+static void
+glyph_cache_value_free (gpointer v)
+{
+  g_free (v);
+}
+
+static void
+add_to_cache (GskGLGlyphCache  *cache,
+              GlyphCacheKey    *key,
+              GskGLCachedGlyph *value)
+{
+  Atlas *atlas;
+  DirtyGlyph *dirty;
+  int width, height;
+  int i;
+
+  width = value->draw_width * key->scale;
+  height = value->draw_height * key->scale;
+
+  /* Glyphs that don't fit into an empty atlas are drawn as a fallback */
+  if (width + 2 >= ATLAS_SIZE || height + 2 >= ATLAS_SIZE)
+    {
+      value->texture_index = G_MAXUINT;
+      return;
+    }
+
+  for (i = 0; i < cache->atlases->len; i++)
+    {
+      int x, y, y0;
+
+      atlas = g_ptr_array_index (cache->atlases, i);
+      x = atlas->x;
+      y = atlas->y;
+      y0 = atlas->y0;
+
+      if (atlas->x + width + 1 >= atlas->width)
+        {
+          /* start a new row */
+          y0 = y + 1;
+          x = 1;
+        }
+
+      if (y0 + height + 1 >= atlas->height)
+        continue;
+
+      atlas->y0 = y0;
+      atlas->x = x;
+      atlas->y = y;
+      break;
+    }
+
+  if (i == cache->atlases->len)
+    {
+      atlas = create_atlas (cache);
+      g_ptr_array_add (cache->atlases, atlas);
+    }
+
+  value->tx = (float)atlas->x / atlas->width;
+  value->ty = (float)atlas->y0 / atlas->height;
+  value->tw = (float)width / atlas->width;
+  value->th = (float)height / atlas->height;
+
+  value->texture_index = i;
+
+  dirty = g_new (DirtyGlyph, 1);
+  dirty->key = key;
+  dirty->value = value;
+  atlas->dirty_glyphs = g_list_prepend (atlas->dirty_glyphs, dirty);
+
+  atlas->x = atlas->x + width + 1;
+  atlas->y = MAX (atlas->y, atlas->y0 + height + 1);
+
+  atlas->num_glyphs++;
+
+#ifdef G_ENABLE_DEBUG
+  if (GSK_DEBUG_CHECK(GLYPH_CACHE))
+    {
+      g_print ("Glyph cache:\n");
+      for (i = 0; i < cache->atlases->len; i++)
+        {
+          atlas = g_ptr_array_index (cache->atlases, i);
+          g_print ("\tAtlas %d (%dx%d): %d glyphs (%d dirty), %.2g%% old pixels, filled to %d, %d / %d\n",
+                   i, atlas->width, atlas->height,
+                   atlas->num_glyphs, g_list_length (atlas->dirty_glyphs),
+                   100.0 * (double)atlas->old_pixels / (double)(atlas->width * atlas->height),
+                   atlas->x, atlas->y0, atlas->y);
+        }
+    }
+#endif
+}
+
+static void
+upload_glyph (Atlas      *atlas,
+              DirtyGlyph *glyph)
+{
+  GlyphCacheKey *key = glyph->key;
+  GskGLCachedGlyph *value = glyph->value;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  cairo_scaled_font_t *scaled_font;
+  cairo_glyph_t cg;
+
+  scaled_font = pango_cairo_font_get_scaled_font ((PangoCairoFont *)key->font);
+  if (G_UNLIKELY (!scaled_font || cairo_scaled_font_status (scaled_font) != CAIRO_STATUS_SUCCESS))
+    return;
+
+  /* The atlas only keeps coverage, so we draw in white and let the
+   * text program apply the color.
+   */
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        value->draw_width * key->scale,
+                                        value->draw_height * key->scale);
+  cairo_surface_set_device_scale (surface, key->scale, key->scale);
+
+  cr = cairo_create (surface);
+
+  cairo_set_scaled_font (cr, scaled_font);
+  cairo_set_source_rgba (cr, 1, 1, 1, 1);
+
+  cg.index = key->glyph;
+  cg.x = - value->draw_x;
+  cg.y = - value->draw_y;
+
+  cairo_show_glyphs (cr, &cg, 1);
+
+  cairo_destroy (cr);
+
+  gsk_gl_driver_update_texture_region (atlas->driver,
+                                       atlas->texture_id,
+                                       surface,
+                                       value->tx * atlas->width,
+                                       value->ty * atlas->height);
+
+  cairo_surface_destroy (surface);
+}
+
+static void
+upload_dirty_glyphs (Atlas *atlas)
+{
+  GList *l;
+
+  GSK_NOTE (GLYPH_CACHE,
+            g_print ("uploading %d glyphs to cache\n", g_list_length (atlas->dirty_glyphs)));
+
+  for (l = atlas->dirty_glyphs; l; l = l->next)
+    upload_glyph (atlas, l->data);
+
+  g_list_free_full (atlas->dirty_glyphs, g_free);
+  atlas->dirty_glyphs = NULL;
+}
+
+GskGLGlyphCache *
+gsk_gl_glyph_cache_new (GskGLDriver *driver)
+{
+  GskGLGlyphCache *cache;
+
+  cache = GSK_GL_GLYPH_CACHE (g_object_new (GSK_TYPE_GL_GLYPH_CACHE, NULL));
+  cache->driver = driver;
+  g_ptr_array_add (cache->atlases, create_atlas (cache));
+
+  return cache;
+}
+
+/*< private >
+ * gsk_gl_glyph_cache_lookup:
+ * @cache: a #GskGLGlyphCache
+ * @create: whether to add the glyph to the cache if it isn't there yet
+ * @font: the font of the glyph
+ * @glyph: the glyph
+ * @scale: the scale factor the glyph is drawn at
+ *
+ * Looks up a glyph, and marks it as used in the current frame.
+ *
+ * New glyphs are only drawn into their atlas by the next call to
+ * gsk_gl_glyph_cache_get_glyph_texture() for that atlas.
+ *
+ * Returns: (nullable): the cached glyph
+ */
+GskGLCachedGlyph *
+gsk_gl_glyph_cache_lookup (GskGLGlyphCache *cache,
+                           gboolean         create,
+                           PangoFont       *font,
+                           PangoGlyph       glyph,
+                           int              scale)
+{
+  GlyphCacheKey lookup_key;
+  GskGLCachedGlyph *value;
+
+  lookup_key.font = font;
+  lookup_key.glyph = glyph;
+  lookup_key.scale = scale;
+
+  value = g_hash_table_lookup (cache->hash_table, &lookup_key);
+
+  if (value)
+    {
+      if (value->old)
+        {
+          Atlas *atlas = g_ptr_array_index (cache->atlases, value->texture_index);
+
+          atlas->old_pixels -= value->draw_width * value->draw_height * scale * scale;
+          value->old = FALSE;
+        }
+
+      value->timestamp = cache->timestamp;
+    }
+
+  if (create && value == NULL)
+    {
+      GlyphCacheKey *key;
+      PangoRectangle ink_rect;
+
+      key = g_new (GlyphCacheKey, 1);
+      value = g_new0 (GskGLCachedGlyph, 1);
+
+      pango_font_get_glyph_extents (font, glyph, &ink_rect, NULL);
+      pango_extents_to_pixels (&ink_rect, NULL);
+
+      value->draw_x = ink_rect.x;
+      value->draw_y = ink_rect.y;
+      value->draw_width = ink_rect.width;
+      value->draw_height = ink_rect.height;
+      value->timestamp = cache->timestamp;
+      value->texture_index = G_MAXUINT;
+
+      key->font = g_object_ref (font);
+      key->glyph = glyph;
+      key->scale = scale;
+
+      if (ink_rect.width > 0 && ink_rect.height > 0)
+        add_to_cache (cache, key, value);
+
+      g_hash_table_insert (cache->hash_table, key, value);
+    }
+
+  return value;
+}
+
+/*< private >
+ * gsk_gl_glyph_cache_get_glyph_texture:
+ * @cache: a #GskGLGlyphCache
+ * @index: the index of an atlas, as found in #GskGLCachedGlyph
+ *
+ * Returns the texture of an atlas, after drawing all glyphs that
+ * have been added to it since the last call.
+ *
+ * Returns: the GL texture id of the atlas
+ */
+int
+gsk_gl_glyph_cache_get_glyph_texture (GskGLGlyphCache *cache,
+                                      guint            index)
+{
+  Atlas *atlas;
+
+  g_return_val_if_fail (index < cache->atlases->len, 0);
+
+  atlas = g_ptr_array_index (cache->atlases, index);
+
+  if (atlas->texture_id == 0)
+    {
+      atlas->texture_id = gsk_gl_driver_create_permanent_texture (cache->driver,
+                                                                  atlas->width,
+                                                                  atlas->height);
+      gsk_gl_driver_bind_source_texture (cache->driver, atlas->texture_id);
+      gsk_gl_driver_init_texture_empty (cache->driver, atlas->texture_id);
+    }
+
+  if (atlas->dirty_glyphs)
+    upload_dirty_glyphs (atlas);
+
+  return atlas->texture_id;
+}
+
+/*< private >
+ * gsk_gl_glyph_cache_begin_frame:
+ * @cache: a #GskGLGlyphCache
+ *
+ * Ages the cached glyphs, and drops atlases that are mostly taken
+ * up by glyphs that haven't been used recently.
+ *
+ * This must be called outside of a frame of the #GskGLDriver, as it
+ * may destroy textures.
+ */
+void
+gsk_gl_glyph_cache_begin_frame (GskGLGlyphCache *cache)
+{
+  int i, j;
+  guint *drops;
+  guint *shifts;
+  guint len;
+  GHashTableIter iter;
+  GlyphCacheKey *key;
+  GskGLCachedGlyph *value;
+  guint dropped = 0;
+
+  cache->timestamp++;
+
+  if (cache->timestamp % CHECK_INTERVAL != 0)
+    return;
+
+  len = cache->atlases->len;
+
+  /* look for glyphs that have grown old since last time */
+  g_hash_table_iter_init (&iter, cache->hash_table);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&value))
+    {
+      if (value->texture_index == G_MAXUINT || value->old)
+        continue;
+
+      if (cache->timestamp - value->timestamp >= MAX_AGE)
+        {
+          Atlas *atlas = g_ptr_array_index (cache->atlases, value->texture_index);
+
+          atlas->old_pixels += value->draw_width * value->draw_height * key->scale * key->scale;
+          value->old = TRUE;
+        }
+    }
+
+  drops = g_alloca (sizeof (guint) * len);
+  shifts = g_alloca (sizeof (guint) * len);
+
+  for (i = 0; i < len; i++)
+    {
+      drops[i] = 0;
+      shifts[i] = i;
+    }
+
+  /* look for atlases to drop, and create a mapping of updated texture indices */
+  for (i = cache->atlases->len - 1; i >= 0; i--)
+    {
+      Atlas *atlas = g_ptr_array_index (cache->atlases, i);
+
+      if (atlas->old_pixels > MAX_OLD * atlas->width * atlas->height)
+        {
+          GSK_NOTE(GLYPH_CACHE,
+                   g_print ("Dropping atlas %d (%.2g%% old)\n", i, 100.0 * (double)atlas->old_pixels / (double)(atlas->width * atlas->height)));
+          g_ptr_array_remove_index (cache->atlases, i);
+
+          drops[i] = 1;
+          for (j = i + 1; j < len; j++)
+            shifts[j]--;
+        }
+    }
+
+  /* no atlas dropped, we're done */
+  if (len == cache->atlases->len)
+    return;
+
+  /* Always keep an atlas around, to pack new glyphs into */
+  if (cache->atlases->len == 0)
+    g_ptr_array_add (cache->atlases, create_atlas (cache));
+
+  /* purge glyphs and update texture indices */
+  g_hash_table_iter_init (&iter, cache->hash_table);
+
+  while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&value))
+    {
+      if (value->texture_index == G_MAXUINT)
+        continue;
+
+      if (drops[value->texture_index])
+        {
+          dropped++;
+          g_hash_table_iter_remove (&iter);
+        }
+      else
+        {
+          value->texture_index = shifts[value->texture_index];
+        }
+    }
+
+  GSK_NOTE(GLYPH_CACHE, g_print ("Dropped %d glyphs\n", dropped));
+}
@@ -0,0 +1,49 @@
+#ifndef __GSK_GL_GLYPH_CACHE_PRIVATE_H__
+#define __GSK_GL_GLYPH_CACHE_PRIVATE_H__
+
+#include <pango/pango.h>
+#include "gskgldriverprivate.h"
+
+G_BEGIN_DECLS
+
+#define GSK_TYPE_GL_GLYPH_CACHE (gsk_gl_glyph_cache_get_type ())
+
+G_DECLARE_FINAL_TYPE (GskGLGlyphCache, gsk_gl_glyph_cache, GSK, GL_GLYPH_CACHE, GObject)
+
+typedef struct
+{
+  /* The atlas the glyph lives in, or G_MAXUINT if it is not cached */
+  guint texture_index;
+
+  /* Texture coordinates of the glyph in the atlas */
+  float tx;
+  float ty;
+  float tw;
+  float th;
+
+  /* Ink rectangle of the glyph, in user space */
+  int draw_x;
+  int draw_y;
+  int draw_width;
+  int draw_height;
+
+  guint64 timestamp;
+  gboolean old : 1;
+} GskGLCachedGlyph;
+
+GskGLGlyphCache *       gsk_gl_glyph_cache_new                  (GskGLDriver     *driver);
+
+GskGLCachedGlyph *      gsk_gl_glyph_cache_lookup               (GskGLGlyphCache *cache,
+                                                                 gboolean         create,
+                                                                 PangoFont       *font,
+                                                                 PangoGlyph       glyph,
+                                                                 int              scale);
+
+int                     gsk_gl_glyph_cache_get_glyph_texture    (GskGLGlyphCache *cache,
+                                                                 guint            index);
+
+void                    gsk_gl_glyph_cache_begin_frame          (GskGLGlyphCache *cache);
+
+G_END_DECLS
+
+#endif /* __GSK_GL_GLYPH_CACHE_PRIVATE_H__ */
@@ -5,16 +5,22 @@
 #include "gskdebugprivate.h"
 #include "gskenums.h"
 #include "gskgldriverprivate.h"
+#include "gskglglyphcacheprivate.h"
 #include "gskglprofilerprivate.h"
 #include "gskprofilerprivate.h"
 #include "gskrendererprivate.h"
 #include "gskrendernodeprivate.h"
+#include "gskroundedrectprivate.h"
 #include "gskshaderbuilderprivate.h"
 #include "gsktextureprivate.h"
 
 #include "gskprivate.h"
 
 #include <epoxy/gl.h>
+#include <pango/pangocairo.h>
+#ifdef CAIRO_HAS_FT_FONT
+#include <cairo-ft.h>
+#endif
 
 #define SHADER_VERSION_GLES             100
 #define SHADER_VERSION_GL2_LEGACY       110
@@ -29,15 +35,26 @@ typedef struct {
   int mask_location;
   int uv_location;
   int position_location;
+  int color_location;
   int alpha_location;
   int blendMode_location;
-
-  /* Shader-specific locations */
-  union {
-    struct {
-      int color_location;
-    };
-  };
+  int clip_location;
+  int hasClip_location;
+
+  /* Locations of the shape programs */
+  int outline_location;
+  int widths_location;
+  int colors_location;
+  int gradientStart_location;
+  int gradientEnd_location;
+  int colorStopOffsets_location;
+  int colorStops_location;
+  int numColorStops_location;
+  int repeating_location;
+  int offset_location;
+  int spread_location;
+  int blurRadius_location;
+  int inset_location;
 } Program;
 
 typedef struct {
@@ -53,9 +70,20 @@ typedef struct {
 enum {
   MODE_COLOR = 1,
   MODE_TEXTURE,
+  MODE_TEXT,
+
+  /* The modes below pass the shape to draw as uniforms, so their
+   * items are never batched
+   */
+  MODE_BORDER,
+  MODE_LINEAR_GRADIENT,
+  MODE_BOX_SHADOW,
   N_MODES
 };
 
+/* Keep in sync with linear_gradient.fs.glsl */
+#define MAX_COLOR_STOPS 8
+
 typedef struct {
   int mode;
   /* Back pointer to the node, only meant for comparison */
@@ -78,8 +106,49 @@ typedef struct {
     struct {
       int a,b;
     } texture_data;
+    struct {
+      float outline[12];
+      float widths[4];
+      /* Premultiplied */
+      float colors[16];
+    } border_data;
+    struct {
+      float start[2];
+      float end[2];
+      int n_color_stops;
+      gboolean repeating;
+      float offsets[MAX_COLOR_STOPS];
+      float colors[MAX_COLOR_STOPS * 4];
+    } linear_gradient_data;
+    struct {
+      GdkRGBA color;
+      float outline[12];
+      float offset[2];
+      float spread;
+      float blur_radius;
+      gboolean inset;
+    } box_shadow_data;
   };
 
+  /* The current clip, in the coordinates of the item, if it has to be
+   * applied by the fragment shader. Rectangular clips are applied to
+   * the vertices instead.
+   */
+  gboolean has_rounded_clip;
+  float rounded_clip[12];
+
+  int n_vertices;
+
+  /* Batched items keep their vertices, in world coordinates, in the
+   * renderer's vertex array instead of in a VAO of their own
+   */
+  gboolean batched;
+  guint first_vertex;
+  graphene_rect_t bounds;
+
+  /* The index of the next item in the same batch, or -1 */
+  int next_in_batch;
+
   const char *name;
 
   GskBlendMode blend_mode;
@@ -90,7 +159,28 @@ typedef struct {
   GArray *children;
 } RenderItem;
 
+typedef struct {
+  /* Indices of the first and last render item in the batch */
+  int first_item;
+  int last_item;
+
+  /* An item that can't be batched, drawn on its own. Batches are
+   * never reordered across it.
+   */
+  gboolean barrier;
+
+  Program *program;
+  int texture_id;
+
+  /* The union of the bounds of all items */
+  graphene_rect_t bounds;
+
+  guint first_vertex;
+  guint n_vertices;
+} Batch;
 
+/* How many batches we look back to find one that an item can join */
+#define MAX_BATCH_LOOKBACK      16
 
 enum {
   MVP,
@@ -98,12 +188,28 @@ enum {
   MASK,
   ALPHA,
   BLEND_MODE,
+  CLIP,
+  HAS_CLIP,
+  OUTLINE,
+  WIDTHS,
+  COLORS,
+  GRADIENT_START,
+  GRADIENT_END,
+  COLOR_STOP_OFFSETS,
+  COLOR_STOPS,
+  NUM_COLOR_STOPS,
+  REPEATING,
+  OFFSET,
+  SPREAD,
+  BLUR_RADIUS,
+  INSET,
   N_UNIFORMS
 };
 
 enum {
   POSITION,
   UV,
+  COLOR,
   N_ATTRIBUTES
 };
 
@@ -111,6 +217,8 @@ enum {
 typedef struct {
   GQuark frames;
   GQuark draw_calls;
+  GQuark batches;
+  GQuark fallbacks;
 } ProfileCounters;
 
 typedef struct {
@@ -124,7 +232,7 @@ typedef enum {
   RENDER_SCISSOR
 } RenderMode;
 
-#define NUM_PROGRAMS 3
+#define NUM_PROGRAMS 7
 
 struct _GskGLRenderer
 {
@@ -143,6 +251,7 @@ struct _GskGLRenderer
   GdkGLContext *gl_context;
   GskGLDriver *gl_driver;
   GskGLProfiler *gl_profiler;
+  GskGLGlyphCache *glyph_cache;
   GskShaderBuilder *shader_builder;
 
   union {
@@ -150,6 +259,10 @@ struct _GskGLRenderer
       Program blend_program;
       Program blit_program;
       Program color_program;
+      Program text_program;
+      Program border_program;
+      Program linear_gradient_program;
+      Program box_shadow_program;
     };
     struct {
       Program programs[NUM_PROGRAMS];
@@ -158,12 +271,28 @@ struct _GskGLRenderer
 
   GArray *render_items;
 
+  /* The vertices of batched render items, in item order */
+  GArray *vertices;
+  /* The same vertices, in batch order */
+  GArray *batch_vertices;
+  GArray *batches;
+
 #ifdef G_ENABLE_DEBUG
   ProfileCounters profile_counters;
   ProfileTimers profile_timers;
 #endif
 
   RenderMode render_mode;
+  /* The area being redrawn in RENDER_SCISSOR mode, in the same units
+   * as the node bounds; only the GL scissor is in device pixels.
+   */
+  graphene_rect_t render_area;
+
+  /* The clip of the nodes being turned into render items, in device
+   * pixels
+   */
+  GskRoundedRect clip;
+  gboolean has_clip;
 
   gboolean has_buffers : 1;
 };
@@ -182,6 +311,9 @@ gsk_gl_renderer_dispose (GObject *gobject)
 
   g_clear_object (&self->gl_context);
   g_clear_pointer (&self->render_items, g_array_unref);
+  g_clear_pointer (&self->vertices, g_array_unref);
+  g_clear_pointer (&self->batch_vertices, g_array_unref);
+  g_clear_pointer (&self->batches, g_array_unref);
 
   G_OBJECT_CLASS (gsk_gl_renderer_parent_class)->dispose (gobject);
 }
@@ -247,11 +379,44 @@ init_common_locations (GskGLRenderer *self,
     gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[ALPHA]);
   prog->blendMode_location =
     gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[BLEND_MODE]);
+  prog->clip_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[CLIP]);
+  prog->hasClip_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[HAS_CLIP]);
+
+  prog->outline_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[OUTLINE]);
+  prog->widths_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[WIDTHS]);
+  prog->colors_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[COLORS]);
+  prog->gradientStart_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[GRADIENT_START]);
+  prog->gradientEnd_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[GRADIENT_END]);
+  prog->colorStopOffsets_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[COLOR_STOP_OFFSETS]);
+  prog->colorStops_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[COLOR_STOPS]);
+  prog->numColorStops_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[NUM_COLOR_STOPS]);
+  prog->repeating_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[REPEATING]);
+  prog->offset_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[OFFSET]);
+  prog->spread_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[SPREAD]);
+  prog->blurRadius_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[BLUR_RADIUS]);
+  prog->inset_location =
+    gsk_shader_builder_get_uniform_location (self->shader_builder, prog->id, self->uniforms[INSET]);
 
   prog->position_location =
     gsk_shader_builder_get_attribute_location (self->shader_builder, prog->id, self->attributes[POSITION]);
   prog->uv_location =
     gsk_shader_builder_get_attribute_location (self->shader_builder, prog->id, self->attributes[UV]);
+  prog->color_location =
+    gsk_shader_builder_get_attribute_location (self->shader_builder, prog->id, self->attributes[COLOR]);
 }
 
 static gboolean
@@ -271,9 +436,25 @@ gsk_gl_renderer_create_programs (GskGLRenderer  *self,
   self->uniforms[MASK] = gsk_shader_builder_add_uniform (builder, "uMask");
   self->uniforms[ALPHA] = gsk_shader_builder_add_uniform (builder, "uAlpha");
   self->uniforms[BLEND_MODE] = gsk_shader_builder_add_uniform (builder, "uBlendMode");
-  
+  self->uniforms[CLIP] = gsk_shader_builder_add_uniform (builder, "uClip");
+  self->uniforms[HAS_CLIP] = gsk_shader_builder_add_uniform (builder, "uHasClip");
+  self->uniforms[OUTLINE] = gsk_shader_builder_add_uniform (builder, "uOutline");
+  self->uniforms[WIDTHS] = gsk_shader_builder_add_uniform (builder, "uWidths");
+  self->uniforms[COLORS] = gsk_shader_builder_add_uniform (builder, "uColors");
+  self->uniforms[GRADIENT_START] = gsk_shader_builder_add_uniform (builder, "uGradientStart");
+  self->uniforms[GRADIENT_END] = gsk_shader_builder_add_uniform (builder, "uGradientEnd");
+  self->uniforms[COLOR_STOP_OFFSETS] = gsk_shader_builder_add_uniform (builder, "uColorStopOffsets");
+  self->uniforms[COLOR_STOPS] = gsk_shader_builder_add_uniform (builder, "uColorStops");
+  self->uniforms[NUM_COLOR_STOPS] = gsk_shader_builder_add_uniform (builder, "uNumColorStops");
+  self->uniforms[REPEATING] = gsk_shader_builder_add_uniform (builder, "uRepeating");
+  self->uniforms[OFFSET] = gsk_shader_builder_add_uniform (builder, "uOffset");
+  self->uniforms[SPREAD] = gsk_shader_builder_add_uniform (builder, "uSpread");
+  self->uniforms[BLUR_RADIUS] = gsk_shader_builder_add_uniform (builder, "uBlurRadius");
+  self->uniforms[INSET] = gsk_shader_builder_add_uniform (builder, "uInset");
+
   self->attributes[POSITION] = gsk_shader_builder_add_attribute (builder, "aPosition");
   self->attributes[UV] = gsk_shader_builder_add_attribute (builder, "aUv");
+  self->attributes[COLOR] = gsk_shader_builder_add_attribute (builder, "aColor");
 
   if (gdk_gl_context_get_use_es (self->gl_context))
     {
@@ -348,11 +529,54 @@ gsk_gl_renderer_create_programs (GskGLRenderer  *self,
       goto out;
     }
   init_common_locations (self, &self->color_program);
-  self->color_program.color_location = gsk_shader_builder_get_uniform_location (self->shader_builder,
-                                                                                self->color_program.id,
-                                                                                g_quark_from_string("uColor"));
-  self->color_program.color_location = glGetUniformLocation(self->color_program.id, "uColor");
-  g_assert(self->color_program.color_location >= 0);
+
+  self->text_program.id =
+    gsk_shader_builder_create_program (builder, "text.vs.glsl", "text.fs.glsl", &shader_error);
+  if (shader_error != NULL)
+    {
+      g_propagate_prefixed_error (error,
+                                  shader_error,
+                                  "Unable to create 'text' program: ");
+      g_object_unref (builder);
+      goto out;
+    }
+  init_common_locations (self, &self->text_program);
+
+  self->border_program.id =
+    gsk_shader_builder_create_program (builder, "border.vs.glsl", "border.fs.glsl", &shader_error);
+  if (shader_error != NULL)
+    {
+      g_propagate_prefixed_error (error,
+                                  shader_error,
+                                  "Unable to create 'border' program: ");
+      g_object_unref (builder);
+      goto out;
+    }
+  init_common_locations (self, &self->border_program);
+
+  self->linear_gradient_program.id =
+    gsk_shader_builder_create_program (builder, "linear_gradient.vs.glsl", "linear_gradient.fs.glsl", &shader_error);
+  if (shader_error != NULL)
+    {
+      g_propagate_prefixed_error (error,
+                                  shader_error,
+                                  "Unable to create 'linear_gradient' program: ");
+      g_object_unref (builder);
+      goto out;
+    }
+  init_common_locations (self, &self->linear_gradient_program);
+
+  self->box_shadow_program.id =
+    gsk_shader_builder_create_program (builder, "box_shadow.vs.glsl", "box_shadow.fs.glsl", &shader_error);
+  if (shader_error != NULL)
+    {
+      g_propagate_prefixed_error (error,
+                                  shader_error,
+                                  "Unable to create 'box_shadow' program: ");
+      g_object_unref (builder);
+      goto out;
+    }
+  init_common_locations (self, &self->box_shadow_program);
 
   res = TRUE;
 
@@ -391,6 +615,7 @@ gsk_gl_renderer_realize (GskRenderer  *renderer,
   g_assert (self->gl_driver == NULL);
   self->gl_driver = gsk_gl_driver_new (self->gl_context);
   self->gl_profiler = gsk_gl_profiler_new (self->gl_context);
+  self->glyph_cache = gsk_gl_glyph_cache_new (self->gl_driver);
 
   GSK_NOTE (OPENGL, g_print ("Creating buffers and programs\n"));
   if (!gsk_gl_renderer_create_programs (self, error))
@@ -417,6 +642,7 @@ gsk_gl_renderer_unrealize (GskRenderer *renderer)
   gsk_gl_renderer_destroy_buffers (self);
   gsk_gl_renderer_destroy_programs (self);
 
+  g_clear_object (&self->glyph_cache);
   g_clear_object (&self->gl_profiler);
   g_clear_object (&self->gl_driver);
 
@@ -455,9 +681,16 @@ gsk_gl_renderer_begin_draw_frame (GskRenderer          *renderer,
       cairo_region_union_rectangle (damage, &extents);
 
       if (gdk_rectangle_equal (&extents, &whole_window))
-        self->render_mode = RENDER_FULL;
+        {
+          self->render_mode = RENDER_FULL;
+        }
       else
-        self->render_mode = RENDER_SCISSOR;
+        {
+          self->render_mode = RENDER_SCISSOR;
+          graphene_rect_init (&self->render_area,
+                              extents.x, extents.y,
+                              extents.width, extents.height);
+        }
     }
 
   result = gdk_window_begin_draw_frame (window,
@@ -504,6 +737,16 @@ gsk_gl_renderer_update_frustum (GskGLRenderer           *self,
 
 #define N_VERTICES      6
 
+static void
+premultiply_color (const GdkRGBA *color,
+                   float          premultiplied[4])
+{
+  premultiplied[0] = color->red * color->alpha;
+  premultiplied[1] = color->green * color->alpha;
+  premultiplied[2] = color->blue * color->alpha;
+  premultiplied[3] = color->alpha;
+}
+
 static void
 render_item (GskGLRenderer *self,
              RenderItem    *item)
@@ -530,11 +773,24 @@ render_item (GskGLRenderer *self,
     {
       case MODE_COLOR:
         {
-          glUniform4f (item->render_data.program->color_location,
-                       item->color_data.color.red,
-                       item->color_data.color.green,
-                       item->color_data.color.blue,
-                       item->color_data.color.alpha);
+          float color[4];
+
+          /* The VAO has no colors, so pass a constant vertex attribute */
+          premultiply_color (&item->color_data.color, color);
+          glVertexAttrib4fv (item->render_data.program->color_location, color);
+        }
+      break;
+
+      case MODE_TEXT:
+        {
+          float color[4];
+
+          premultiply_color (&item->color_data.color, color);
+          glVertexAttrib4fv (item->render_data.program->color_location, color);
+
+          /* Use texture unit 0 for the glyph atlas */
+          glUniform1i (item->render_data.program->source_location, 0);
+          gsk_gl_driver_bind_source_texture (self->gl_driver, item->render_data.texture_id);
         }
       break;
 
@@ -559,10 +815,57 @@ render_item (GskGLRenderer *self,
         }
       break;
 
+      case MODE_BORDER:
+        {
+          Program *program = item->render_data.program;
+
+          glUniform4fv (program->outline_location, 3, item->border_data.outline);
+          glUniform4fv (program->widths_location, 1, item->border_data.widths);
+          glUniform4fv (program->colors_location, 4, item->border_data.colors);
+        }
+      break;
+
+      case MODE_LINEAR_GRADIENT:
+        {
+          Program *program = item->render_data.program;
+
+          glUniform2fv (program->gradientStart_location, 1, item->linear_gradient_data.start);
+          glUniform2fv (program->gradientEnd_location, 1, item->linear_gradient_data.end);
+          glUniform1fv (program->colorStopOffsets_location,
+                        item->linear_gradient_data.n_color_stops,
+                        item->linear_gradient_data.offsets);
+          glUniform4fv (program->colorStops_location,
+                        item->linear_gradient_data.n_color_stops,
+                        item->linear_gradient_data.colors);
+          glUniform1i (program->numColorStops_location, item->linear_gradient_data.n_color_stops);
+          glUniform1i (program->repeating_location, item->linear_gradient_data.repeating);
+        }
+      break;
+
+      case MODE_BOX_SHADOW:
+        {
+          Program *program = item->render_data.program;
+          float color[4];
+
+          premultiply_color (&item->box_shadow_data.color, color);
+          glVertexAttrib4fv (program->color_location, color);
+
+          glUniform4fv (program->outline_location, 3, item->box_shadow_data.outline);
+          glUniform2fv (program->offset_location, 1, item->box_shadow_data.offset);
+          glUniform1f (program->spread_location, item->box_shadow_data.spread);
+          glUniform1f (program->blurRadius_location, item->box_shadow_data.blur_radius);
+          glUniform1i (program->inset_location, item->box_shadow_data.inset);
+        }
+      break;
+
       default:
         g_assert_not_reached ();
     }
 
+  glUniform1i (item->render_data.program->hasClip_location, item->has_rounded_clip);
+  if (item->has_rounded_clip)
+    glUniform4fv (item->render_data.program->clip_location, 3, item->rounded_clip);
+
   /* Pass the opacity component */
   if (item->children != NULL)
     opacity = 1.0;
@@ -585,7 +888,7 @@ render_item (GskGLRenderer *self,
                       item->opacity,
                       item->blend_mode));
 
-  glDrawArrays (GL_TRIANGLES, 0, N_VERTICES);
+  glDrawArrays (GL_TRIANGLES, 0, item->n_vertices);
 
 #ifdef G_ENABLE_DEBUG
   gsk_profiler_counter_inc (gsk_renderer_get_profiler (GSK_RENDERER (self)),
@@ -706,6 +1009,469 @@ project_item (const graphene_matrix_t *projection,
   return graphene_vec4_get_z (&vec) / graphene_vec4_get_w (&vec);
 }
 
+static gboolean
+font_has_color_glyphs (PangoFont *font)
+{
+  gboolean has_color = FALSE;
+#ifdef CAIRO_HAS_FT_FONT
+  cairo_scaled_font_t *scaled_font;
+
+  scaled_font = pango_cairo_font_get_scaled_font ((PangoCairoFont *)font);
+  if (scaled_font && cairo_scaled_font_get_type (scaled_font) == CAIRO_FONT_TYPE_FT)
+    {
+      FT_Face ft_face = cairo_ft_scaled_font_lock_face (scaled_font);
+      has_color = (FT_HAS_COLOR (ft_face) != 0);
+      cairo_ft_scaled_font_unlock_face (scaled_font);
+    }
+#endif
+
+  return has_color;
+}
+
+/* Checks whether @matrix only scales and translates, so that it maps
+ * rectangles to rectangles. Clips are only tracked under such matrices.
+ */
+static gboolean
+matrix_is_axis_aligned (const graphene_matrix_t *matrix,
+                        float                    scale[2],
+                        float                    offset[2])
+{
+  double xx, yx, xy, yy, x0, y0;
+
+  if (!graphene_matrix_to_2d (matrix, &xx, &yx, &xy, &yy, &x0, &y0))
+    return FALSE;
+
+  if (yx != 0.0 || xy != 0.0 || xx <= 0.0 || yy <= 0.0)
+    return FALSE;
+
+  if (scale != NULL)
+    {
+      scale[0] = xx;
+      scale[1] = yy;
+    }
+
+  if (offset != NULL)
+    {
+      offset[0] = x0;
+      offset[1] = y0;
+    }
+
+  return TRUE;
+}
+
+static void
+rounded_rect_scale_offset (GskRoundedRect       *dest,
+                           const GskRoundedRect *src,
+                           const float           scale[2],
+                           const float           offset[2])
+{
+  guint i;
+
+  graphene_rect_init (&dest->bounds,
+                      src->bounds.origin.x * scale[0] + offset[0],
+                      src->bounds.origin.y * scale[1] + offset[1],
+                      src->bounds.size.width * scale[0],
+                      src->bounds.size.height * scale[1]);
+
+  for (i = 0; i < 4; i++)
+    {
+      dest->corner[i].width = src->corner[i].width * scale[0];
+      dest->corner[i].height = src->corner[i].height * scale[1];
+    }
+}
+
+/* Clips quads laid out like the ones of gsk_gl_renderer_add_render_item()
+ * to @clip, and adjusts their texture coordinates to match. Returns the
+ * number of vertices that are left.
+ */
+static int
+clip_quads (GskQuadVertex         *quads,
+            int                    n_vertices,
+            const graphene_rect_t *clip)
+{
+  float clip_x0 = clip->origin.x;
+  float clip_y0 = clip->origin.y;
+  float clip_x1 = clip->origin.x + clip->size.width;
+  float clip_y1 = clip->origin.y + clip->size.height;
+  int i, n;
+
+  for (i = 0, n = 0; i < n_vertices; i += N_VERTICES)
+    {
+      const GskQuadVertex *q = &quads[i];
+      float x0 = q[0].position[0], y0 = q[0].position[1];
+      float x1 = q[3].position[0], y1 = q[3].position[1];
+      float u0 = q[0].uv[0], v0 = q[0].uv[1];
+      float u1 = q[3].uv[0], v1 = q[3].uv[1];
+      float cx0 = MAX (x0, clip_x0);
+      float cy0 = MAX (y0, clip_y0);
+      float cx1 = MIN (x1, clip_x1);
+      float cy1 = MIN (y1, clip_y1);
+
+      if (cx0 >= cx1 || cy0 >= cy1)
+        continue;
+
+      {
+        float cu0 = u0 + (u1 - u0) * (cx0 - x0) / (x1 - x0);
+        float cu1 = u0 + (u1 - u0) * (cx1 - x0) / (x1 - x0);
+        float cv0 = v0 + (v1 - v0) * (cy0 - y0) / (y1 - y0);
+        float cv1 = v0 + (v1 - v0) * (cy1 - y0) / (y1 - y0);
+        GskQuadVertex clipped[N_VERTICES] = {
+          { { cx0, cy0 }, { cu0, cv0 }, },
+          { { cx0, cy1 }, { cu0, cv1 }, },
+          { { cx1, cy0 }, { cu1, cv0 }, },
+
+          { { cx1, cy1 }, { cu1, cv1 }, },
+          { { cx0, cy1 }, { cu0, cv1 }, },
+          { { cx1, cy0 }, { cu1, cv0 }, },
+        };
+
+        memcpy (&quads[n], clipped, sizeof (clipped));
+        n += N_VERTICES;
+      }
+    }
+
+  return n;
+}
+
+/* Applies the current clip to the quads of @item. Rectangular clips,
+ * and the bounds of rounded ones, are applied to the vertices, the
+ * corners of rounded clips are left to the fragment shader. Returns
+ * the number of vertices that are left.
+ *
+ * While there is a clip, @modelview always keeps rectangles: clips
+ * can only be pushed with such a modelview, and transform nodes that
+ * don't keep them are drawn with a fallback texture instead, see
+ * gsk_gl_renderer_add_render_item().
+ */
+static int
+gsk_gl_renderer_clip_item (GskGLRenderer           *self,
+                           RenderItem              *item,
+                           const graphene_matrix_t *modelview,
+                           GskQuadVertex           *quads,
+                           int                      n_vertices)
+{
+  GskRoundedRect local_clip;
+  graphene_rect_t bounds;
+  float scale[2], offset[2];
+  int i;
+
+  item->has_rounded_clip = FALSE;
+
+  if (!self->has_clip)
+    return n_vertices;
+
+  if (!matrix_is_axis_aligned (modelview, scale, offset))
+    g_assert_not_reached ();
+
+  scale[0] = 1.f / scale[0];
+  scale[1] = 1.f / scale[1];
+  offset[0] = -offset[0] * scale[0];
+  offset[1] = -offset[1] * scale[1];
+  rounded_rect_scale_offset (&local_clip, &self->clip, scale, offset);
+
+  n_vertices = clip_quads (quads, n_vertices, &local_clip.bounds);
+  if (n_vertices == 0 || gsk_rounded_rect_is_rectilinear (&local_clip))
+    return n_vertices;
+
+  /* Only items that reach into the corners need to be clipped
+   * when drawing
+   */
+  graphene_rect_init (&bounds, quads[0].position[0], quads[0].position[1], 0, 0);
+  for (i = 0; i < n_vertices; i++)
+    {
+      graphene_rect_t p = GRAPHENE_RECT_INIT (quads[i].position[0], quads[i].position[1], 0, 0);
+
+      graphene_rect_union (&bounds, &p, &bounds);
+    }
+
+  if (!gsk_rounded_rect_contains_rect (&local_clip, &bounds))
+    {
+      item->has_rounded_clip = TRUE;
+      gsk_rounded_rect_to_float (&local_clip, item->rounded_clip);
+    }
+
+  return n_vertices;
+}
+
+/* Sets up the geometry of @item: either appends its vertices to the
+ * renderer's vertex array, so that it can be batched with other items,
+ * or creates a VAO for it. Returns %FALSE if the item is clipped away
+ * and must not be drawn.
+ */
+static gboolean
+gsk_gl_renderer_add_item_vertices (GskGLRenderer           *self,
+                                   RenderItem              *item,
+                                   const graphene_matrix_t *modelview,
+                                   GskQuadVertex           *quads,
+                                   int                      n_vertices)
+{
+  float color[4] = { 1.f, 1.f, 1.f, 1.f };
+  float min_x, min_y, max_x, max_y;
+  GskBatchVertex *vertices;
+  int i;
+
+  n_vertices = gsk_gl_renderer_clip_item (self, item, modelview, quads, n_vertices);
+  if (n_vertices == 0)
+    return FALSE;
+
+  item->n_vertices = n_vertices;
+
+  /* Items with render targets or uniforms of their own need their own
+   * geometry, and we only transform 2D items on the CPU
+   */
+  if (item->children != NULL ||
+      item->parent_data != NULL ||
+      item->has_rounded_clip ||
+      item->mode > MODE_TEXT ||
+      !graphene_matrix_is_2d (modelview))
+    {
+      item->batched = FALSE;
+      item->render_data.vao_id =
+        gsk_gl_driver_create_vao_for_quad (self->gl_driver,
+                                           item->render_data.program->position_location,
+                                           item->render_data.program->uv_location,
+                                           n_vertices,
+                                           quads);
+      return TRUE;
+    }
+
+  if (item->mode == MODE_COLOR || item->mode == MODE_TEXT)
+    premultiply_color (&item->color_data.color, color);
+
+  item->batched = TRUE;
+  item->first_vertex = self->vertices->len;
+
+  g_array_set_size (self->vertices, self->vertices->len + n_vertices);
+  vertices = &g_array_index (self->vertices, GskBatchVertex, item->first_vertex);
+
+  min_x = min_y = G_MAXFLOAT;
+  max_x = max_y = -G_MAXFLOAT;
+
+  for (i = 0; i < n_vertices; i++)
+    {
+      graphene_point_t p = GRAPHENE_POINT_INIT (quads[i].position[0], quads[i].position[1]);
+
+      graphene_matrix_transform_point (modelview, &p, &p);
+
+      vertices[i].position[0] = p.x;
+      vertices[i].position[1] = p.y;
+      vertices[i].uv[0] = quads[i].uv[0];
+      vertices[i].uv[1] = quads[i].uv[1];
+      memcpy (vertices[i].color, color, sizeof (color));
+
+      min_x = MIN (min_x, p.x);
+      min_y = MIN (min_y, p.y);
+      max_x = MAX (max_x, p.x);
+      max_y = MAX (max_y, p.y);
+    }
+
+  graphene_rect_init (&item->bounds, min_x, min_y, max_x - min_x, max_y - min_y);
+
+  return TRUE;
+}
+
+static void
+gsk_gl_renderer_add_text_item (GskGLRenderer           *self,
+                               const graphene_matrix_t *modelview,
+                               GArray                  *render_items,
+                               RenderItem              *item,
+                               GArray                  *vertices,
+                               guint                    texture_index)
+{
+  item->render_data.texture_id = gsk_gl_glyph_cache_get_glyph_texture (self->glyph_cache, texture_index);
+  if (gsk_gl_renderer_add_item_vertices (self, item, modelview,
+                                         (GskQuadVertex *) vertices->data,
+                                         vertices->len))
+    g_array_append_vals (render_items, item, 1);
+
+  g_array_set_size (vertices, 0);
+}
+
+/* Draws a text node with the glyph atlas, using one render item for
+ * each run of glyphs that share an atlas. Returns %FALSE if the node
+ * needs to be drawn with a fallback.
+ */
+static gboolean
+gsk_gl_renderer_add_text_items (GskGLRenderer           *self,
+                                const graphene_matrix_t *modelview,
+                                GArray                  *render_items,
+                                RenderItem              *item,
+                                GskRenderNode           *node,
+                                int                      scale_factor)
+{
+  PangoFont *font = gsk_text_node_get_font (node);
+  PangoGlyphString *glyphs = gsk_text_node_get_glyphs (node);
+  float x = gsk_text_node_get_x (node);
+  float y = gsk_text_node_get_y (node);
+  GArray *vertices;
+  guint texture_index;
+  int x_position;
+  int i;
+
+  if (font_has_color_glyphs (font))
+    return FALSE;
+
+  /* Add all glyphs first, so the atlases don't change below */
+  for (i = 0; i < glyphs->num_glyphs; i++)
+    {
+      PangoGlyphInfo *gi = &glyphs->glyphs[i];
+      GskGLCachedGlyph *glyph;
+
+      if (gi->glyph == PANGO_GLYPH_EMPTY || (gi->glyph & PANGO_GLYPH_UNKNOWN_FLAG))
+        continue;
+
+      glyph = gsk_gl_glyph_cache_lookup (self->glyph_cache, TRUE, font, gi->glyph, scale_factor);
+      if (glyph->texture_index == G_MAXUINT && glyph->draw_width > 0 && glyph->draw_height > 0)
+        return FALSE;
+    }
+
+  item->mode = MODE_TEXT;
+  item->render_data.program = &self->text_program;
+  item->render_data.program_id = self->text_program.id;
+  item->color_data.color = *gsk_text_node_get_color (node);
+
+  vertices = g_array_new (FALSE, FALSE, sizeof (GskQuadVertex));
+  texture_index = G_MAXUINT;
+  x_position = 0;
+
+  for (i = 0; i < glyphs->num_glyphs; i++)
+    {
+      PangoGlyphInfo *gi = &glyphs->glyphs[i];
+      GskGLCachedGlyph *glyph;
+      int glyph_x = x_position + gi->geometry.x_offset;
+      float gx, gy, gw, gh;
+
+      x_position += gi->geometry.width;
+
+      if (gi->glyph == PANGO_GLYPH_EMPTY || (gi->glyph & PANGO_GLYPH_UNKNOWN_FLAG))
+        continue;
+
+      glyph = gsk_gl_glyph_cache_lookup (self->glyph_cache, FALSE, font, gi->glyph, scale_factor);
+      if (glyph->texture_index == G_MAXUINT)
+        continue;
+
+      if (glyph->texture_index != texture_index && vertices->len > 0)
+        gsk_gl_renderer_add_text_item (self, modelview, render_items, item, vertices, texture_index);
+      texture_index = glyph->texture_index;
+
+      gx = x + (float) glyph_x / PANGO_SCALE + glyph->draw_x;
+      gy = y + (float) gi->geometry.y_offset / PANGO_SCALE + glyph->draw_y;
+      gw = glyph->draw_width;
+      gh = glyph->draw_height;
+
+      {
+        GskQuadVertex quad[N_VERTICES] = {
+          { { gx,      gy      }, { glyph->tx,             glyph->ty             }, },
+          { { gx,      gy + gh }, { glyph->tx,             glyph->ty + glyph->th }, },
+          { { gx + gw, gy      }, { glyph->tx + glyph->tw, glyph->ty             }, },
+
+          { { gx + gw, gy + gh }, { glyph->tx + glyph->tw, glyph->ty + glyph->th }, },
+          { { gx,      gy + gh }, { glyph->tx,             glyph->ty + glyph->th }, },
+          { { gx + gw, gy      }, { glyph->tx + glyph->tw, glyph->ty             }, },
+        };
+
+        g_array_append_vals (vertices, quad, N_VERTICES);
+      }
+    }
+
+  if (vertices->len > 0)
+    gsk_gl_renderer_add_text_item (self, modelview, render_items, item, vertices, texture_index);
+
+  g_array_unref (vertices);
+
+  return TRUE;
+}
+
+/* Draws @node with Cairo, and uploads the result as the texture of @item */
+static void
+gsk_gl_renderer_add_fallback_texture (GskGLRenderer *self,
+                                      RenderItem    *item,
+                                      GskRenderNode *node,
+                                      int            scale_factor)
+{
+  cairo_surface_t *surface;
+  cairo_t *cr;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        item->size.width,
+                                        item->size.height);
+  cairo_surface_set_device_scale (surface, scale_factor, scale_factor);
+  cr = cairo_create (surface);
+  cairo_translate (cr, -node->bounds.origin.x, -node->bounds.origin.y);
+
+  gsk_render_node_draw (node, cr);
+
+  cairo_destroy (cr);
+
+  /* Upload the Cairo surface to a GL texture */
+  item->render_data.texture_id = gsk_gl_driver_create_texture (self->gl_driver,
+                                                               item->size.width,
+                                                               item->size.height);
+  gsk_gl_driver_bind_source_texture (self->gl_driver, item->render_data.texture_id);
+  gsk_gl_driver_init_texture_with_surface (self->gl_driver,
+                                           item->render_data.texture_id,
+                                           surface,
+                                           GL_NEAREST, GL_NEAREST);
+
+  cairo_surface_destroy (surface);
+  item->mode = MODE_TEXTURE;
+
+  GSK_NOTE (OPENGL, g_print ("Using a fallback texture for node <%s>[%p]\n",
+                             item->name,
+                             node));
+
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_inc (gsk_renderer_get_profiler (GSK_RENDERER (self)),
+                            self->profile_counters.fallbacks);
+#endif
+}
+
+/* Intersects the clip of the render items with @clip, in the coordinates
+ * of @modelview. Returns %FALSE if the result can't be tracked, i.e. if
+ * @modelview doesn't keep rectangles or if the intersection is not a
+ * rounded rectangle. If the intersection is empty, the clip is left with
+ * empty bounds.
+ */
+static gboolean
+gsk_gl_renderer_push_clip (GskGLRenderer           *self,
+                           const graphene_matrix_t *modelview,
+                           const GskRoundedRect    *clip)
+{
+  GskRoundedRect transformed;
+  float scale[2], offset[2];
+
+  if (!matrix_is_axis_aligned (modelview, scale, offset))
+    return FALSE;
+
+  rounded_rect_scale_offset (&transformed, clip, scale, offset);
+
+  if (!self->has_clip)
+    {
+      self->clip = transformed;
+      self->has_clip = TRUE;
+      return TRUE;
+    }
+
+  if (gsk_rounded_rect_contains_rect (&transformed, &self->clip.bounds))
+    return TRUE;
+
+  if (gsk_rounded_rect_contains_rect (&self->clip, &transformed.bounds))
+    {
+      self->clip = transformed;
+      return TRUE;
+    }
+
+  if (gsk_rounded_rect_is_rectilinear (&self->clip) &&
+      gsk_rounded_rect_is_rectilinear (&transformed))
+    {
+      if (!graphene_rect_intersection (&self->clip.bounds, &transformed.bounds, &self->clip.bounds))
+        graphene_rect_init (&self->clip.bounds, 0, 0, 0, 0);
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
 static gboolean
 render_node_needs_render_target (GskRenderNode *node)
 {
@@ -722,9 +1488,32 @@ gsk_gl_renderer_add_render_item (GskGLRenderer           *self,
 {
   RenderItem item;
   RenderItem *ritem = NULL;
+  graphene_rect_t uv_rect;
   int program_id;
   int scale_factor;
 
+  /* Skip nodes that are outside of the area being redrawn, so that we
+   * do not upload fallback textures for them.
+   */
+  if (self->render_mode == RENDER_SCISSOR)
+    {
+      graphene_rect_t transformed, unused;
+
+      graphene_matrix_transform_bounds (modelview, &node->bounds, &transformed);
+      if (!graphene_rect_intersection (&transformed, &self->render_area, &unused))
+        return;
+    }
+
+  /* Likewise for nodes that are clipped away */
+  if (self->has_clip)
+    {
+      graphene_rect_t transformed, unused;
+
+      graphene_matrix_transform_bounds (modelview, &node->bounds, &transformed);
+      if (!graphene_rect_intersection (&transformed, &self->clip.bounds, &unused))
+        return;
+    }
+
   memset (&item, 0, sizeof (RenderItem));
 
   scale_factor = gsk_renderer_get_scale_factor (GSK_RENDERER (self));
@@ -754,9 +1543,13 @@ gsk_gl_renderer_add_render_item (GskGLRenderer           *self,
   item.z = project_item (projection, modelview);
 
   item.opacity = 1.0;
+  item.n_vertices = N_VERTICES;
 
   item.blend_mode = GSK_BLEND_MODE_DEFAULT;
 
+  /* The area of the texture to draw, in texture coordinates */
+  graphene_rect_init (&uv_rect, 0, 0, 1, 1);
+
   /* Back-pointer to the parent node */
   if (parent != NULL)
     item.parent_data = &(parent->render_data);
@@ -799,10 +1592,12 @@ gsk_gl_renderer_add_render_item (GskGLRenderer           *self,
 
         get_gl_scaling_filters (node, &gl_min_filter, &gl_mag_filter);
 
-        item.render_data.texture_id = gsk_gl_driver_get_texture_for_texture (self->gl_driver,
-                                                                             texture,
-                                                                             gl_min_filter,
-                                                                             gl_mag_filter);
+        /* Small textures share atlas pages, so they can be batched */
+        item.render_data.texture_id = gsk_gl_driver_get_texture_region (self->gl_driver,
+                                                                        texture,
+                                                                        gl_min_filter,
+                                                                        gl_mag_filter,
+                                                                        &uv_rect);
         item.mode = MODE_TEXTURE;
       }
       break;
@@ -899,12 +1694,167 @@ gsk_gl_renderer_add_render_item (GskGLRenderer           *self,
       }
       return;
 
+    case GSK_BORDER_NODE:
+      {
+        const float *widths = gsk_border_node_peek_widths (node);
+        const GdkRGBA *colors = gsk_border_node_peek_colors (node);
+        int i;
+
+        gsk_rounded_rect_to_float (gsk_border_node_peek_outline (node), item.border_data.outline);
+        memcpy (item.border_data.widths, widths, sizeof (item.border_data.widths));
+        for (i = 0; i < 4; i++)
+          premultiply_color (&colors[i], &item.border_data.colors[i * 4]);
+
+        program_id = self->border_program.id;
+        item.render_data.program = &self->border_program;
+        item.mode = MODE_BORDER;
+      }
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        const graphene_point_t *start = gsk_linear_gradient_node_peek_start (node);
+        const graphene_point_t *end = gsk_linear_gradient_node_peek_end (node);
+        const GskColorStop *stops = gsk_linear_gradient_node_peek_color_stops (node);
+        gsize i, n_stops = gsk_linear_gradient_node_get_n_color_stops (node);
+
+        if (n_stops == 0 || n_stops > MAX_COLOR_STOPS ||
+            graphene_point_equal (start, end))
+          {
+            gsk_gl_renderer_add_fallback_texture (self, &item, node, scale_factor);
+            break;
+          }
+
+        item.linear_gradient_data.start[0] = start->x;
+        item.linear_gradient_data.start[1] = start->y;
+        item.linear_gradient_data.end[0] = end->x;
+        item.linear_gradient_data.end[1] = end->y;
+        item.linear_gradient_data.n_color_stops = n_stops;
+        item.linear_gradient_data.repeating =
+          gsk_render_node_get_node_type (node) == GSK_REPEATING_LINEAR_GRADIENT_NODE;
+
+        for (i = 0; i < n_stops; i++)
+          {
+            float *color = &item.linear_gradient_data.colors[i * 4];
+
+            item.linear_gradient_data.offsets[i] = stops[i].offset;
+            color[0] = stops[i].color.red;
+            color[1] = stops[i].color.green;
+            color[2] = stops[i].color.blue;
+            color[3] = stops[i].color.alpha;
+          }
+
+        program_id = self->linear_gradient_program.id;
+        item.render_data.program = &self->linear_gradient_program;
+        item.mode = MODE_LINEAR_GRADIENT;
+      }
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+      {
+        gboolean inset = gsk_render_node_get_node_type (node) == GSK_INSET_SHADOW_NODE;
+        const GskRoundedRect *outline;
+        float blur_radius;
+        guint i;
+
+        if (inset)
+          {
+            outline = gsk_inset_shadow_node_peek_outline (node);
+            item.box_shadow_data.color = *gsk_inset_shadow_node_peek_color (node);
+            item.box_shadow_data.offset[0] = gsk_inset_shadow_node_get_dx (node);
+            item.box_shadow_data.offset[1] = gsk_inset_shadow_node_get_dy (node);
+            item.box_shadow_data.spread = gsk_inset_shadow_node_get_spread (node);
+            blur_radius = gsk_inset_shadow_node_get_blur_radius (node);
+          }
+        else
+          {
+            outline = gsk_outset_shadow_node_peek_outline (node);
+            item.box_shadow_data.color = *gsk_outset_shadow_node_peek_color (node);
+            item.box_shadow_data.offset[0] = gsk_outset_shadow_node_get_dx (node);
+            item.box_shadow_data.offset[1] = gsk_outset_shadow_node_get_dy (node);
+            item.box_shadow_data.spread = gsk_outset_shadow_node_get_spread (node);
+            blur_radius = gsk_outset_shadow_node_get_blur_radius (node);
+          }
+
+        /* Like the Cairo code, don't blur for radii up to 1 */
+        if (blur_radius <= 1.0)
+          blur_radius = 0.0;
+
+        /* The blur in the shader only handles corners of a single,
+         * circular size
+         */
+        for (i = 1; i < 4 && blur_radius > 0.0; i++)
+          {
+            if (outline->corner[i].width != outline->corner[0].width)
+              break;
+          }
+
+        if (blur_radius > 0.0 && (i < 4 || !gsk_rounded_rect_is_circular (outline)))
+          {
+            gsk_gl_renderer_add_fallback_texture (self, &item, node, scale_factor);
+            break;
+          }
+
+        gsk_rounded_rect_to_float (outline, item.box_shadow_data.outline);
+        item.box_shadow_data.blur_radius = blur_radius;
+        item.box_shadow_data.inset = inset;
+
+        program_id = self->box_shadow_program.id;
+        item.render_data.program = &self->box_shadow_program;
+        item.mode = MODE_BOX_SHADOW;
+      }
+      break;
+
+    case GSK_CLIP_NODE:
+    case GSK_ROUNDED_CLIP_NODE:
+      {
+        GskRoundedRect clip, old_clip = self->clip;
+        gboolean old_has_clip = self->has_clip;
+        GskRenderNode *child;
+
+        if (gsk_render_node_get_node_type (node) == GSK_CLIP_NODE)
+          {
+            gsk_rounded_rect_init_from_rect (&clip, gsk_clip_node_peek_clip (node), 0);
+            child = gsk_clip_node_get_child (node);
+          }
+        else
+          {
+            clip = *gsk_rounded_clip_node_peek_clip (node);
+            child = gsk_rounded_clip_node_get_child (node);
+          }
+
+        if (!gsk_gl_renderer_push_clip (self, modelview, &clip))
+          {
+            gsk_gl_renderer_add_fallback_texture (self, &item, node, scale_factor);
+            break;
+          }
+
+        if (self->clip.bounds.size.width > 0 && self->clip.bounds.size.height > 0)
+          gsk_gl_renderer_add_render_item (self, projection, modelview, render_items, child, ritem);
+
+        self->clip = old_clip;
+        self->has_clip = old_has_clip;
+      }
+      return;
+
     case GSK_TRANSFORM_NODE:
       {
         graphene_matrix_t transform, transformed_mv;
 
         gsk_transform_node_get_transform (node, &transform);
         graphene_matrix_multiply (&transform, modelview, &transformed_mv);
+
+        /* Clips are tracked in device pixels, which only works as long
+         * as rectangles stay rectangles
+         */
+        if (self->has_clip && !matrix_is_axis_aligned (&transformed_mv, NULL, NULL))
+          {
+            gsk_gl_renderer_add_fallback_texture (self, &item, node, scale_factor);
+            break;
+          }
+
         gsk_gl_renderer_add_render_item (self,
                                          projection, &transformed_mv,
                                          render_items,
@@ -917,35 +1867,13 @@ gsk_gl_renderer_add_render_item (GskGLRenderer           *self,
       g_assert_not_reached ();
       return;
 
-    default:
-      {
-        cairo_surface_t *surface;
-        cairo_t *cr;
-
-        surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-                                              item.size.width,
-                                              item.size.height);
-        cairo_surface_set_device_scale (surface, scale_factor, scale_factor);
-        cr = cairo_create (surface);
-        cairo_translate (cr, -node->bounds.origin.x, -node->bounds.origin.y);
-
-        gsk_render_node_draw (node, cr);
+    case GSK_TEXT_NODE:
+      if (gsk_gl_renderer_add_text_items (self, modelview, render_items, &item, node, scale_factor))
+        return;
+      /* fall through */
 
-        cairo_destroy (cr);
-
-        /* Upload the Cairo surface to a GL texture */
-        item.render_data.texture_id = gsk_gl_driver_create_texture (self->gl_driver,
-                                                                    item.size.width,
-                                                                    item.size.height);
-        gsk_gl_driver_bind_source_texture (self->gl_driver, item.render_data.texture_id);
-        gsk_gl_driver_init_texture_with_surface (self->gl_driver,
-                                                 item.render_data.texture_id,
-                                                 surface,
-                                                 GL_NEAREST, GL_NEAREST);
-
-        cairo_surface_destroy (surface);
-        item.mode = MODE_TEXTURE;
-      }
+    default:
+      gsk_gl_renderer_add_fallback_texture (self, &item, node, scale_factor);
       break;
     }
 
@@ -953,22 +1881,22 @@ gsk_gl_renderer_add_render_item (GskGLRenderer           *self,
 
   /* Create the vertex buffers holding the geometry of the quad */
   {
+    float u0 = uv_rect.origin.x;
+    float v0 = uv_rect.origin.y;
+    float u1 = uv_rect.origin.x + uv_rect.size.width;
+    float v1 = uv_rect.origin.y + uv_rect.size.height;
     GskQuadVertex vertex_data[N_VERTICES] = {
-      { { item.min.x, item.min.y }, { 0, 0 }, },
-      { { item.min.x, item.max.y }, { 0, 1 }, },
-      { { item.max.x, item.min.y }, { 1, 0 }, },
+      { { item.min.x, item.min.y }, { u0, v0 }, },
+      { { item.min.x, item.max.y }, { u0, v1 }, },
+      { { item.max.x, item.min.y }, { u1, v0 }, },
 
-      { { item.max.x, item.max.y }, { 1, 1 }, },
-      { { item.min.x, item.max.y }, { 0, 1 }, },
-      { { item.max.x, item.min.y }, { 1, 0 }, },
+      { { item.max.x, item.max.y }, { u1, v1 }, },
+      { { item.min.x, item.max.y }, { u0, v1 }, },
+      { { item.max.x, item.min.y }, { u1, v0 }, },
     };
 
-    item.render_data.vao_id =
-      gsk_gl_driver_create_vao_for_quad (self->gl_driver,
-                                         item.render_data.program->position_location,
-                                         item.render_data.program->uv_location,
-                                         N_VERTICES,
-                                         vertex_data);
+    if (!gsk_gl_renderer_add_item_vertices (self, &item, modelview, vertex_data, N_VERTICES))
+      return;
   }
 
   GSK_NOTE (OPENGL, g_print ("Adding node <%s>[%p] to render items\n",
@@ -998,9 +1926,12 @@ gsk_gl_renderer_validate_tree (GskGLRenderer           *self,
 
   gdk_gl_context_make_current (self->gl_context);
 
+  gsk_gl_glyph_cache_begin_frame (self->glyph_cache);
+
   gsk_gl_driver_begin_frame (self->gl_driver);
 
   GSK_NOTE (OPENGL, g_print ("RenderNode -> RenderItem\n"));
+  self->has_clip = FALSE;
   gsk_gl_renderer_add_render_item (self, projection, &identity, self->render_items, root, NULL);
 
   GSK_NOTE (OPENGL, g_print ("Total render items: %d\n",
@@ -1022,6 +1953,7 @@ gsk_gl_renderer_clear_tree (GskGLRenderer *self)
   gdk_gl_context_make_current (self->gl_context);
 
   g_array_remove_range (self->render_items, 0, self->render_items->len);
+  g_array_set_size (self->vertices, 0);
 
   removed_textures = gsk_gl_driver_collect_textures (self->gl_driver);
   removed_vaos = gsk_gl_driver_collect_vaos (self->gl_driver);
@@ -1070,6 +2002,170 @@ gsk_gl_renderer_setup_render_mode (GskGLRenderer *self)
   }
 }
 
+/* Groups the render items into batches that can be drawn with a single
+ * draw call. An item joins an earlier batch with the same program and
+ * texture if it does not overlap any of the batches it would be moved
+ * in front of, so the result looks the same as drawing in order.
+ */
+static void
+gsk_gl_renderer_build_batches (GskGLRenderer *self)
+{
+  guint i;
+
+  g_array_set_size (self->batches, 0);
+
+  for (i = 0; i < self->render_items->len; i++)
+    {
+      RenderItem *item = &g_array_index (self->render_items, RenderItem, i);
+      Batch *batch = NULL;
+
+      item->next_in_batch = -1;
+
+      if (item->batched)
+        {
+          int j, n;
+
+          for (j = (int) self->batches->len - 1, n = 0; j >= 0 && n < MAX_BATCH_LOOKBACK; j--, n++)
+            {
+              Batch *b = &g_array_index (self->batches, Batch, j);
+              graphene_rect_t unused;
+
+              if (b->barrier)
+                break;
+
+              if (b->program == item->render_data.program &&
+                  b->texture_id == item->render_data.texture_id)
+                {
+                  batch = b;
+                  break;
+                }
+
+              if (graphene_rect_intersection (&b->bounds, &item->bounds, &unused))
+                break;
+            }
+        }
+
+      if (batch != NULL)
+        {
+          g_array_index (self->render_items, RenderItem, batch->last_item).next_in_batch = i;
+          batch->last_item = i;
+          batch->n_vertices += item->n_vertices;
+          graphene_rect_union (&batch->bounds, &item->bounds, &batch->bounds);
+        }
+      else
+        {
+          Batch new_batch;
+
+          new_batch.first_item = i;
+          new_batch.last_item = i;
+          new_batch.barrier = !item->batched;
+          new_batch.program = item->render_data.program;
+          new_batch.texture_id = item->render_data.texture_id;
+          new_batch.bounds = item->bounds;
+          new_batch.first_vertex = 0;
+          new_batch.n_vertices = item->n_vertices;
+
+          g_array_append_val (self->batches, new_batch);
+        }
+    }
+
+  GSK_NOTE (OPENGL, g_print ("Batched %u items into %u batches\n",
+                             self->render_items->len,
+                             self->batches->len));
+}
+
+static void
+gsk_gl_renderer_render_batches (GskGLRenderer *self)
+{
+  Program *program = NULL;
+  float mvp[16];
+  guint i;
+
+  /* Lay out the vertices of each batch next to each other, and upload
+   * them all at once
+   */
+  g_array_set_size (self->batch_vertices, 0);
+  for (i = 0; i < self->batches->len; i++)
+    {
+      Batch *batch = &g_array_index (self->batches, Batch, i);
+      int j;
+
+      if (batch->barrier)
+        continue;
+
+      batch->first_vertex = self->batch_vertices->len;
+
+      for (j = batch->first_item; j >= 0; )
+        {
+          RenderItem *item = &g_array_index (self->render_items, RenderItem, j);
+
+          g_array_append_vals (self->batch_vertices,
+                               &g_array_index (self->vertices, GskBatchVertex, item->first_vertex),
+                               item->n_vertices);
+          j = item->next_in_batch;
+        }
+    }
+
+  /* All programs share the attribute locations, see
+   * gsk_shader_builder_create_program()
+   */
+  if (self->batch_vertices->len > 0)
+    gsk_gl_driver_upload_batch_vertices (self->gl_driver,
+                                         POSITION, UV, COLOR,
+                                         self->batch_vertices->len,
+                                         (GskBatchVertex *) self->batch_vertices->data);
+
+  /* The vertices are already transformed by the modelview */
+  graphene_matrix_to_float (&self->mvp, mvp);
+
+  for (i = 0; i < self->batches->len; i++)
+    {
+      Batch *batch = &g_array_index (self->batches, Batch, i);
+
+      if (batch->barrier)
+        {
+          render_item (self, &g_array_index (self->render_items, RenderItem, batch->first_item));
+
+          /* render_item() changes the uniforms of the program */
+          program = NULL;
+          continue;
+        }
+
+      gsk_gl_driver_bind_batch_vao (self->gl_driver);
+
+      if (program != batch->program)
+        {
+          program = batch->program;
+
+          glUseProgram (program->id);
+          glUniformMatrix4fv (program->mvp_location, 1, GL_FALSE, mvp);
+          glUniform1f (program->alpha_location, 1.0);
+
+          /* Batched items are clipped on the CPU */
+          glUniform1i (program->hasClip_location, FALSE);
+
+          /* Use texture unit 0 for the source */
+          glUniform1i (program->source_location, 0);
+        }
+
+      if (batch->texture_id != 0)
+        gsk_gl_driver_bind_source_texture (self->gl_driver, batch->texture_id);
+
+      GSK_NOTE (OPENGL, g_print ("Drawing batch of %u vertices\n", batch->n_vertices));
+
+      glDrawArrays (GL_TRIANGLES, batch->first_vertex, batch->n_vertices);
+
+#ifdef G_ENABLE_DEBUG
+      {
+        GskProfiler *profiler = gsk_renderer_get_profiler (GSK_RENDERER (self));
+
+        gsk_profiler_counter_inc (profiler, self->profile_counters.draw_calls);
+        gsk_profiler_counter_inc (profiler, self->profile_counters.batches);
+      }
+#endif
+    }
+}
+
 #define ORTHO_NEAR_PLANE        -10000
 #define ORTHO_FAR_PLANE          10000
 
@@ -1081,7 +2177,6 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
 {
   GskGLRenderer *self = GSK_GL_RENDERER (renderer);
   graphene_matrix_t modelview, projection;
-  guint i;
 #ifdef G_ENABLE_DEBUG
   GskProfiler *profiler;
   gint64 gpu_time, cpu_time;
@@ -1128,12 +2223,8 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
   glBlendFunc (GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
   GSK_NOTE (OPENGL, g_print ("Rendering %u items\n", self->render_items->len));
-  for (i = 0; i < self->render_items->len; i++)
-    {
-      RenderItem *item = &g_array_index (self->render_items, RenderItem, i);
-
-      render_item (self, item);
-    }
+  gsk_gl_renderer_build_batches (self);
+  gsk_gl_renderer_render_batches (self);
 
   /* Draw the output of the GL rendering to the window */
   gsk_gl_driver_end_frame (self->gl_driver);
@@ -1190,6 +2281,13 @@ gsk_gl_renderer_render_texture (GskRenderer           *renderer,
   texture = gsk_texture_new_for_surface (surface);
   cairo_surface_destroy (surface);
 
+  /* Like after rendering to the window, so that the render items don't
+   * keep pointing to textures that the glyph cache drops later.
+   */
+  gdk_gl_context_make_current (self->gl_context);
+  gsk_gl_renderer_clear_tree (self);
+  gsk_gl_renderer_destroy_buffers (self);
+
   return texture;
 }
 
@@ -1239,6 +2337,9 @@ gsk_gl_renderer_init (GskGLRenderer *self)
   graphene_matrix_init_identity (&self->mvp);
 
   self->render_items = g_array_new (FALSE, FALSE, sizeof (RenderItem));
+  self->vertices = g_array_new (FALSE, FALSE, sizeof (GskBatchVertex));
+  self->batch_vertices = g_array_new (FALSE, FALSE, sizeof (GskBatchVertex));
+  self->batches = g_array_new (FALSE, FALSE, sizeof (Batch));
 
 #ifdef G_ENABLE_DEBUG
   {
@@ -1246,6 +2347,8 @@ gsk_gl_renderer_init (GskGLRenderer *self)
 
     self->profile_counters.frames = gsk_profiler_add_counter (profiler, "frames", "Frames", FALSE);
     self->profile_counters.draw_calls = gsk_profiler_add_counter (profiler, "draws", "glDrawArrays", TRUE);
+    self->profile_counters.batches = gsk_profiler_add_counter (profiler, "batches", "Batched draws", TRUE);
+    self->profile_counters.fallbacks = gsk_profiler_add_counter (profiler, "fallbacks", "Fallback textures", TRUE);
 
     self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
     self->profile_timers.gpu_time = gsk_profiler_add_timer (profiler, "gpu-time", "GPU time", FALSE, TRUE);
@@ -46,10 +46,14 @@
 
 #include "gskenumtypes.h"
 
+#include "gdk/gdk-private.h"
+
 #include <graphene-gobject.h>
 #include <cairo-gobject.h>
 #include <gdk/gdk.h>
 
+#include <string.h>
+
 #ifdef GDK_WINDOWING_X11
 #include <gdk/x11/gdkx.h>
 #endif
@@ -74,11 +78,23 @@ typedef struct
   GskRenderNode *root_node;
   GdkDisplay *display;
 
+  /* The last frame rendered to the window, for damage tracking */
+  GskRenderNode *prev_node;
+  int prev_width;
+  int prev_height;
+  int prev_scale_factor;
+
   GskProfiler *profiler;
 
+  /* Per-node-type statistics, see gsk_renderer_set_profile_nodes() */
+  GQuark node_counters[GSK_N_RENDER_NODE_TYPES];
+  GQuark node_timers[GSK_N_RENDER_NODE_TYPES];
+  gint64 node_draw_times[GSK_N_RENDER_NODE_TYPES];
+
   int scale_factor;
 
   gboolean is_realized : 1;
+  gboolean profile_nodes : 1;
 } GskRendererPrivate;
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (GskRenderer, gsk_renderer, G_TYPE_OBJECT)
@@ -613,9 +629,118 @@ gsk_renderer_unrealize (GskRenderer *renderer)
 
   GSK_RENDERER_GET_CLASS (renderer)->unrealize (renderer);
 
+  g_clear_pointer (&priv->prev_node, gsk_render_node_unref);
+
   priv->is_realized = FALSE;
 }
 
+#ifdef G_ENABLE_DEBUG
+static void
+gsk_renderer_count_nodes (GskRenderer   *renderer,
+                          GskRenderNode *node)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+  guint i;
+
+  gsk_profiler_counter_inc (priv->profiler, priv->node_counters[gsk_render_node_get_node_type (node)]);
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      for (i = 0; i < gsk_container_node_get_n_children (node); i++)
+        gsk_renderer_count_nodes (renderer, gsk_container_node_get_child (node, i));
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_transform_node_get_child (node));
+      break;
+
+    case GSK_OPACITY_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_opacity_node_get_child (node));
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_color_matrix_node_get_child (node));
+      break;
+
+    case GSK_REPEAT_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_repeat_node_get_child (node));
+      break;
+
+    case GSK_CLIP_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_clip_node_get_child (node));
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_rounded_clip_node_get_child (node));
+      break;
+
+    case GSK_SHADOW_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_shadow_node_get_child (node));
+      break;
+
+    case GSK_BLEND_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_blend_node_get_bottom_child (node));
+      gsk_renderer_count_nodes (renderer, gsk_blend_node_get_top_child (node));
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_cross_fade_node_get_start_child (node));
+      gsk_renderer_count_nodes (renderer, gsk_cross_fade_node_get_end_child (node));
+      break;
+
+    case GSK_BLUR_NODE:
+      gsk_renderer_count_nodes (renderer, gsk_blur_node_get_child (node));
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    case GSK_CAIRO_NODE:
+    case GSK_COLOR_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_BORDER_NODE:
+    case GSK_TEXTURE_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+    case GSK_TEXT_NODE:
+    default:
+      break;
+    }
+}
+
+static void
+gsk_renderer_begin_profile (GskRenderer   *renderer,
+                            GskRenderNode *root)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+
+  gsk_profiler_reset (priv->profiler);
+
+  if (!priv->profile_nodes)
+    return;
+
+  gsk_renderer_count_nodes (renderer, root);
+
+  memset (priv->node_draw_times, 0, sizeof (priv->node_draw_times));
+  gsk_render_node_set_draw_times (priv->node_draw_times);
+}
+
+static void
+gsk_renderer_end_profile (GskRenderer *renderer)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+  int i;
+
+  if (!priv->profile_nodes)
+    return;
+
+  gsk_render_node_set_draw_times (NULL);
+
+  for (i = 1; i < GSK_N_RENDER_NODE_TYPES; i++)
+    gsk_profiler_timer_set (priv->profiler, priv->node_timers[i], priv->node_draw_times[i]);
+}
+#endif
+
 /**
  * gsk_renderer_render_texture:
  * @renderer: a realized #GdkRenderer
@@ -658,12 +783,14 @@ gsk_renderer_render_texture (GskRenderer           *renderer,
     }
 
 #ifdef G_ENABLE_DEBUG
-  gsk_profiler_reset (priv->profiler);
+  gsk_renderer_begin_profile (renderer, root);
 #endif
 
   texture = GSK_RENDERER_GET_CLASS (renderer)->render_texture (renderer, root, viewport);
 
 #ifdef G_ENABLE_DEBUG
+  gsk_renderer_end_profile (renderer);
+
   if (GSK_DEBUG_CHECK (RENDERER))
     {
       GString *buf = g_string_new ("*** Texture stats ***\n\n");
@@ -716,12 +843,14 @@ gsk_renderer_render (GskRenderer       *renderer,
   priv->root_node = gsk_render_node_ref (root);
 
 #ifdef G_ENABLE_DEBUG
-  gsk_profiler_reset (priv->profiler);
+  gsk_renderer_begin_profile (renderer, root);
 #endif
 
   GSK_RENDERER_GET_CLASS (renderer)->render (renderer, root);
 
 #ifdef G_ENABLE_DEBUG
+  gsk_renderer_end_profile (renderer);
+
   if (GSK_DEBUG_CHECK (RENDERER))
     {
       GString *buf = g_string_new ("*** Frame stats ***\n\n");
@@ -738,7 +867,85 @@ gsk_renderer_render (GskRenderer       *renderer,
     }
 #endif
 
-  g_clear_pointer (&priv->root_node, gsk_render_node_unref);
+  g_clear_pointer (&priv->prev_node, gsk_render_node_unref);
+  priv->prev_node = priv->root_node;
+  priv->prev_width = gdk_window_get_width (priv->window);
+  priv->prev_height = gdk_window_get_height (priv->window);
+  priv->prev_scale_factor = priv->scale_factor;
+  priv->root_node = NULL;
+}
+
+/*< private >
+ * gsk_renderer_compute_redraw_region:
+ * @renderer: a #GskRenderer
+ * @root: the #GskRenderNode that is about to be rendered
+ * @region: the region of the window that has been invalidated
+ *
+ * Computes the region of the window that needs to be redrawn when
+ * rendering @root, by comparing it with the previous frame rendered
+ * by @renderer via gsk_render_node_diff().
+ *
+ * If there is no previous frame that can be compared against, or the
+ * windowing system might have discarded the window contents, the
+ * result is a copy of @region. Areas the windowing system exposed since
+ * the last frame are always redrawn, since their contents were lost.
+ *
+ * The returned region is meant to be passed to
+ * gsk_renderer_begin_draw_frame(), so that renderers only redraw and
+ * present the pixels that actually changed.
+ *
+ * Returns: (transfer full): the region to redraw
+ */
+cairo_region_t *
+gsk_renderer_compute_redraw_region (GskRenderer          *renderer,
+                                    GskRenderNode        *root,
+                                    const cairo_region_t *region)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+  cairo_rectangle_int_t whole_window;
+  cairo_region_t *damage, *exposed;
+
+  g_return_val_if_fail (GSK_IS_RENDERER (renderer), NULL);
+  g_return_val_if_fail (GSK_IS_RENDER_NODE (root), NULL);
+  g_return_val_if_fail (region != NULL, NULL);
+
+  /* Part of @region, but it must not be reduced to the diff */
+  exposed = gdk_window_take_exposed_area (priv->window);
+
+  whole_window = (cairo_rectangle_int_t) {
+                     0, 0,
+                     gdk_window_get_width (priv->window),
+                     gdk_window_get_height (priv->window)
+                 };
+
+  /* Without compositing, expose events mean that the window contents
+   * were lost, and we cannot tell them apart from our own invalidations.
+   */
+  if (priv->prev_node == NULL ||
+      priv->prev_width != whole_window.width ||
+      priv->prev_height != whole_window.height ||
+      priv->prev_scale_factor != priv->scale_factor ||
+      !gdk_display_is_composited (gdk_window_get_display (priv->window)) ||
+      GSK_RENDER_MODE_CHECK (FULL_REDRAW))
+    {
+      g_clear_pointer (&exposed, cairo_region_destroy);
+      return cairo_region_copy (region);
+    }
+
+  damage = cairo_region_create ();
+  gsk_render_node_diff (priv->prev_node, root, damage);
+  if (exposed)
+    {
+      cairo_region_union (damage, exposed);
+      cairo_region_destroy (exposed);
+    }
+  cairo_region_intersect_rectangle (damage, &whole_window);
+
+  GSK_NOTE (RENDERER, g_print ("Damage: %d rectangles, invalidated: %d rectangles\n",
+                               cairo_region_num_rectangles (damage),
+                               cairo_region_num_rectangles (region)));
+
+  return damage;
 }
 
 /*< private >
@@ -759,6 +966,116 @@ gsk_renderer_get_profiler (GskRenderer *renderer)
   return priv->profiler;
 }
 
+/*< private >
+ * gsk_renderer_set_profile_nodes:
+ * @renderer: a #GskRenderer
+ * @profile_nodes: whether to collect per-node-type statistics
+ *
+ * Makes @renderer count the nodes of each #GskRenderNodeType in every
+ * frame it renders, and the time spent drawing them with Cairo. The
+ * numbers are kept in the renderer's #GskProfiler and can be queried
+ * with gsk_renderer_get_node_profile() after each frame.
+ *
+ * The draw time of a node excludes the time spent on its children, and
+ * only covers nodes drawn through gsk_render_node_draw(); nodes that a
+ * GL or Vulkan renderer handles natively are counted, but not timed.
+ *
+ * Profiling is only available if GTK was built with debugging enabled.
+ */
+void
+gsk_renderer_set_profile_nodes (GskRenderer *renderer,
+                                gboolean     profile_nodes)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+
+  g_return_if_fail (GSK_IS_RENDERER (renderer));
+  g_return_if_fail (priv->root_node == NULL);
+
+#ifdef G_ENABLE_DEBUG
+  if (profile_nodes && priv->node_counters[GSK_CONTAINER_NODE] == 0)
+    {
+      GEnumClass *enum_class = g_type_class_ref (GSK_TYPE_RENDER_NODE_TYPE);
+      int i;
+
+      for (i = 1; i < GSK_N_RENDER_NODE_TYPES; i++)
+        {
+          GEnumValue *value = g_enum_get_value (enum_class, i);
+          char *name;
+
+          priv->node_counters[i] = gsk_profiler_add_counter (priv->profiler,
+                                                             value->value_nick,
+                                                             "Number of nodes of this type",
+                                                             TRUE);
+
+          name = g_strconcat (value->value_nick, "-draw", NULL);
+          priv->node_timers[i] = gsk_profiler_add_timer (priv->profiler,
+                                                         name,
+                                                         "Time spent drawing nodes of this type",
+                                                         FALSE, TRUE);
+          g_free (name);
+        }
+
+      g_type_class_unref (enum_class);
+    }
+
+  priv->profile_nodes = !!profile_nodes;
+#endif
+}
+
+/*< private >
+ * gsk_renderer_get_profile_nodes:
+ * @renderer: a #GskRenderer
+ *
+ * Retrieves whether @renderer collects per-node-type statistics.
+ *
+ * Returns: %TRUE if gsk_renderer_set_profile_nodes() is in effect
+ */
+gboolean
+gsk_renderer_get_profile_nodes (GskRenderer *renderer)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+
+  g_return_val_if_fail (GSK_IS_RENDERER (renderer), FALSE);
+
+  return priv->profile_nodes;
+}
+
+/*< private >
+ * gsk_renderer_get_node_profile:
+ * @renderer: a #GskRenderer
+ * @node_type: a #GskRenderNodeType
+ * @n_nodes: (out) (optional): return location for the number of nodes
+ * @draw_time: (out) (optional): return location for the draw time,
+ *   in nanoseconds
+ *
+ * Retrieves the statistics for @node_type collected during the last
+ * frame rendered by @renderer.
+ *
+ * Returns: %FALSE if no statistics are available, either because
+ *   profiling is not enabled or not supported by this build
+ */
+gboolean
+gsk_renderer_get_node_profile (GskRenderer       *renderer,
+                               GskRenderNodeType  node_type,
+                               gint64            *n_nodes,
+                               gint64            *draw_time)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+
+  g_return_val_if_fail (GSK_IS_RENDERER (renderer), FALSE);
+  g_return_val_if_fail (node_type > GSK_NOT_A_RENDER_NODE && node_type < GSK_N_RENDER_NODE_TYPES, FALSE);
+
+  if (!priv->profile_nodes)
+    return FALSE;
+
+  if (n_nodes)
+    *n_nodes = gsk_profiler_counter_get (priv->profiler, priv->node_counters[node_type]);
+  if (draw_time)
+    *draw_time = gsk_profiler_timer_get (priv->profiler, priv->node_timers[node_type]);
+
+  return TRUE;
+}
+
 static GType
 get_renderer_for_name (const char *renderer_name)
 {
@@ -69,6 +69,18 @@ cairo_surface_t *       gsk_renderer_create_cairo_surface       (GskRenderer
 
 GskProfiler *           gsk_renderer_get_profiler               (GskRenderer    *renderer);
 
+cairo_region_t *        gsk_renderer_compute_redraw_region      (GskRenderer          *renderer,
+                                                                 GskRenderNode        *root,
+                                                                 const cairo_region_t *region);
+
+gboolean                gsk_renderer_get_profile_nodes          (GskRenderer          *renderer);
+void                    gsk_renderer_set_profile_nodes          (GskRenderer          *renderer,
+                                                                 gboolean              profile_nodes);
+gboolean                gsk_renderer_get_node_profile           (GskRenderer          *renderer,
+                                                                 GskRenderNodeType     node_type,
+                                                                 gint64               *n_nodes,
+                                                                 gint64               *draw_time);
+
 G_END_DECLS
 
 #endif /* __GSK_RENDERER_PRIVATE_H__ */
@@ -45,6 +45,7 @@
 
 #include "gskdebugprivate.h"
 #include "gskrendererprivate.h"
+#include "gskrendernodebinaryprivate.h"
 #include "gsktexture.h"
 
 #include <graphene-gobject.h>
@@ -74,7 +75,10 @@ gsk_render_node_finalize (GskRenderNode *self)
 
   g_clear_pointer (&self->name, g_free);
 
-  g_free (self);
+  if (self->arena_chunk != NULL)
+    gsk_render_node_arena_release (self->arena_chunk);
+  else
+    g_free (self);
 }
 
 /*< private >
@@ -87,13 +91,15 @@ GskRenderNode *
 gsk_render_node_new (const GskRenderNodeClass *node_class, gsize extra_size)
 {
   GskRenderNode *self;
+  gpointer chunk;
 
   g_return_val_if_fail (node_class != NULL, NULL);
   g_return_val_if_fail (node_class->node_type != GSK_NOT_A_RENDER_NODE, NULL);
 
-  self = g_malloc0 (node_class->struct_size + extra_size);
+  self = gsk_render_node_arena_alloc (node_class->struct_size + extra_size, &chunk);
 
   self->node_class = node_class;
+  self->arena_chunk = chunk;
 
   self->ref_count = 1;
 
@@ -246,6 +252,94 @@ gsk_render_node_get_name (GskRenderNode *node)
   return node->name;
 }
 
+#ifdef G_ENABLE_DEBUG
+static gint64 *node_draw_times;
+static gint64 draw_children_time;
+#endif
+
+static GPrivate thread_sources = G_PRIVATE_INIT (NULL);
+
+/*< private >
+ * gsk_render_node_set_thread_sources:
+ * @sources: (nullable): the sources to use, or %NULL
+ *
+ * Makes Cairo and texture nodes drawn by the calling thread use the
+ * image snapshots in @sources instead of their own surfaces, see
+ * gsk_render_node_get_thread_source(). Pass %NULL to go back to
+ * drawing the nodes' own surfaces.
+ */
+void
+gsk_render_node_set_thread_sources (GskRenderNodeSources *sources)
+{
+  g_private_set (&thread_sources, sources);
+}
+
+/*< private >
+ * gsk_render_node_get_thread_source:
+ * @node: a Cairo or texture node
+ *
+ * Retrieves the surface the calling thread should draw @node with.
+ * Cairo surfaces can't be used by two threads at once, not even as
+ * a source, so every thread gets its own image surface sharing the
+ * pixels of the snapshot.
+ *
+ * Returns: (transfer none) (nullable): the surface, or %NULL if the
+ *   node's own surface should be used
+ */
+cairo_surface_t *
+gsk_render_node_get_thread_source (GskRenderNode *node)
+{
+  GskRenderNodeSources *sources = g_private_get (&thread_sources);
+  cairo_surface_t *snapshot, *surface;
+  double x_scale, y_scale, x_offset, y_offset;
+
+  if (sources == NULL)
+    return NULL;
+
+  surface = g_hash_table_lookup (sources->surfaces, node);
+  if (surface)
+    return surface;
+
+  snapshot = g_hash_table_lookup (sources->snapshots, node);
+  if (snapshot == NULL)
+    return NULL;
+
+  surface = cairo_image_surface_create_for_data (cairo_image_surface_get_data (snapshot),
+                                                 cairo_image_surface_get_format (snapshot),
+                                                 cairo_image_surface_get_width (snapshot),
+                                                 cairo_image_surface_get_height (snapshot),
+                                                 cairo_image_surface_get_stride (snapshot));
+  cairo_surface_get_device_scale (snapshot, &x_scale, &y_scale);
+  cairo_surface_set_device_scale (surface, x_scale, y_scale);
+  cairo_surface_get_device_offset (snapshot, &x_offset, &y_offset);
+  cairo_surface_set_device_offset (surface, x_offset, y_offset);
+
+  g_hash_table_insert (sources->surfaces, node, surface);
+
+  return surface;
+}
+
+/*< private >
+ * gsk_render_node_set_draw_times:
+ * @draw_times: (nullable): an array of %GSK_N_RENDER_NODE_TYPES
+ *   times in nanoseconds, or %NULL
+ *
+ * Makes gsk_render_node_draw() add the time spent drawing each node,
+ * excluding the time spent drawing its children, to the entry for the
+ * node's type in @draw_times. Pass %NULL to stop recording.
+ *
+ * This is only meant for the renderer's profiling code; drawing from
+ * more than one thread while recording is not supported.
+ */
+void
+gsk_render_node_set_draw_times (gint64 *draw_times)
+{
+#ifdef G_ENABLE_DEBUG
+  node_draw_times = draw_times;
+  draw_children_time = 0;
+#endif
+}
+
 /**
  * gsk_render_node_draw:
  * @node: a #GskRenderNode
@@ -284,7 +378,24 @@ gsk_render_node_draw (GskRenderNode *node,
                             node->name ? node->name : node->node_class->type_name,
                             node));
 
-  node->node_class->draw (node, cr);
+#ifdef G_ENABLE_DEBUG
+  if (G_UNLIKELY (node_draw_times != NULL))
+    {
+      gint64 outer_children_time = draw_children_time;
+      gint64 start, total;
+
+      draw_children_time = 0;
+      start = g_get_monotonic_time ();
+
+      node->node_class->draw (node, cr);
+
+      total = (g_get_monotonic_time () - start) * 1000;
+      node_draw_times[node->node_class->node_type] += total - draw_children_time;
+      draw_children_time = outer_children_time + total;
+    }
+  else
+#endif
+    node->node_class->draw (node, cr);
 
   if (GSK_RENDER_MODE_CHECK (GEOMETRY))
     {
@@ -307,6 +418,79 @@ gsk_render_node_draw (GskRenderNode *node,
     }
 }
 
+/*< private >
+ * gsk_render_node_add_bounds_to_region:
+ * @node: a #GskRenderNode
+ * @region: the region to add to
+ *
+ * Adds the bounds of @node, rounded out to whole pixels, to @region.
+ */
+void
+gsk_render_node_add_bounds_to_region (GskRenderNode  *node,
+                                      cairo_region_t *region)
+{
+  cairo_rectangle_int_t rect;
+
+  rect.x = floorf (node->bounds.origin.x);
+  rect.y = floorf (node->bounds.origin.y);
+  rect.width = ceilf (node->bounds.origin.x + node->bounds.size.width) - rect.x;
+  rect.height = ceilf (node->bounds.origin.y + node->bounds.size.height) - rect.y;
+
+  cairo_region_union_rectangle (region, &rect);
+}
+
+/*< private >
+ * gsk_render_node_diff_impossible:
+ * @node1: a #GskRenderNode
+ * @node2: the #GskRenderNode to compare with
+ * @region: a #cairo_region_t to add the differences to
+ *
+ * Fallback for gsk_render_node_diff() when no detailed comparison is
+ * possible: everything covered by either node is considered changed.
+ */
+void
+gsk_render_node_diff_impossible (GskRenderNode  *node1,
+                                 GskRenderNode  *node2,
+                                 cairo_region_t *region)
+{
+  gsk_render_node_add_bounds_to_region (node1, region);
+  gsk_render_node_add_bounds_to_region (node2, region);
+}
+
+/*< private >
+ * gsk_render_node_diff:
+ * @node1: a #GskRenderNode
+ * @node2: the #GskRenderNode to compare with
+ * @region: a #cairo_region_t to add the differences to
+ *
+ * Compares @node1 and @node2 trying to compute the minimal region of changes.
+ *
+ * In the worst case, this is the union of the bounds of @node1 and @node2.
+ *
+ * Note that the difference may be larger than the actual changes, but it
+ * never misses an area that changed: drawing @node1 and then redrawing
+ * @region with @node2 gives the same result as drawing @node2.
+ *
+ * Identical nodes (as happens with nodes reused from caches) are skipped
+ * without looking at their contents.
+ */
+void
+gsk_render_node_diff (GskRenderNode  *node1,
+                      GskRenderNode  *node2,
+                      cairo_region_t *region)
+{
+  if (node1 == node2)
+    return;
+
+  if (node1->node_class->node_type != node2->node_class->node_type)
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
+
+  node1->node_class->diff (node1, node2, region);
+}
+
 #define GSK_RENDER_NODE_SERIALIZATION_VERSION 0
 #define GSK_RENDER_NODE_SERIALIZATION_ID "GskRenderNode"
 
@@ -329,21 +513,9 @@ gsk_render_node_draw (GskRenderNode *node,
 GBytes *
 gsk_render_node_serialize (GskRenderNode *node)
 {
-  GVariant *node_variant, *variant;
-  GBytes *result;
-
-  node_variant = gsk_render_node_serialize_node (node);
-
-  variant = g_variant_new ("(suuv)",
-                           GSK_RENDER_NODE_SERIALIZATION_ID,
-                           (guint32) GSK_RENDER_NODE_SERIALIZATION_VERSION,
-                           (guint32) gsk_render_node_get_node_type (node),
-                           node_variant);
-
-  result = g_variant_get_data_as_bytes (variant);
-  g_variant_unref (variant);
+  g_return_val_if_fail (GSK_IS_RENDER_NODE (node), NULL);
 
-  return result;
+  return gsk_render_node_binary_serialize (node);
 }
 
 /**
@@ -391,6 +563,10 @@ gsk_render_node_write_to_file (GskRenderNode *node,
  * Loads data previously created via gsk_render_node_serialize(). For a
  * discussion of the supported format, see that function.
  *
+ * The data does not need to be copied into memory first; @bytes can
+ * come from g_mapped_file_get_bytes(). Pixel data of textures and Cairo
+ * surfaces is used in place and keeps a reference on @bytes.
+ *
  * Returns: (nullable) (transfer full): a new #GskRenderNode or %NULL on
  *     error.
  **/
@@ -403,6 +579,10 @@ gsk_render_node_deserialize (GBytes  *bytes,
   GVariant *variant, *node_variant;
   GskRenderNode *node = NULL;
 
+  if (gsk_render_node_binary_detect (bytes))
+    return gsk_render_node_binary_deserialize (bytes, error);
+
+  /* Data written by older versions of GTK+ */
   variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("(suuv)"), bytes, FALSE);
 
   g_variant_get (variant, "(suuv)", &id_string, &version, &node_type, &node_variant);
@@ -0,0 +1,317 @@
+/* GSK - The GTK Scene Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*< private >
+ * SECTION: GskRenderNodeArena
+ *
+ * A #GskRenderNodeArena hands out the memory for the render nodes that
+ * are created while it is pushed, usually while taking the snapshot of
+ * a frame. Nodes are carved out of large chunks instead of being
+ * allocated one by one, and the chunks are reused once all nodes in
+ * them have been finalized.
+ *
+ * Render nodes are shared by pointer, so they can't be moved out of
+ * the arena. A node that is kept around keeps its whole chunk alive,
+ * even after the arena itself has been freed. Nodes that are known to
+ * outlive the frame, like the ones widgets cache, should therefore be
+ * created while the arena is suspended with
+ * gsk_render_node_arena_suspend().
+ */
+
+#include "config.h"
+
+#include "gskrendernodeprivate.h"
+
+#include <string.h>
+
+#define CHUNK_SIZE              (16 * 1024)
+
+/* Larger nodes, like containers with many children, use malloc */
+#define MAX_ARENA_NODE_SIZE     (CHUNK_SIZE / 8)
+
+/* graphene types need 16-byte alignment */
+#define ARENA_ALIGN(size)       (((size) + 15) & ~(gsize) 15)
+
+typedef struct _ArenaChunk ArenaChunk;
+
+struct _ArenaChunk
+{
+  /* The arena the chunk belongs to, or %NULL if it is gone */
+  GskRenderNodeArena *arena;
+
+  /* The next chunk in the arena's free list */
+  ArenaChunk *next_free;
+
+  /* The number of live nodes in the chunk, plus one while the chunk
+   * is the current chunk of its arena, changed atomically. Whoever drops
+   * it to 0 hands the chunk back to the arena, or frees it.
+   */
+  volatile int n_nodes;
+
+  gsize used;
+
+  gboolean is_free : 1;
+};
+
+#define CHUNK_HEADER_SIZE       ARENA_ALIGN (sizeof (ArenaChunk))
+
+struct _GskRenderNodeArena
+{
+  /* The chunk that nodes are allocated from */
+  ArenaChunk *current;
+
+  /* All chunks owned by the arena, current, full or free */
+  GPtrArray *chunks;
+  ArenaChunk *free_chunks;
+
+  /* The arena that was current before this one was pushed */
+  GskRenderNodeArena *previous;
+  gboolean pushed : 1;
+};
+
+/* Protects the ownership of the chunks, as nodes can be released
+ * from other threads
+ */
+G_LOCK_DEFINE_STATIC (arena);
+
+static GPrivate current_arena = G_PRIVATE_INIT (NULL);
+
+GskRenderNodeArena *
+gsk_render_node_arena_new (void)
+{
+  GskRenderNodeArena *arena;
+
+  arena = g_slice_new0 (GskRenderNodeArena);
+  arena->chunks = g_ptr_array_new ();
+
+  return arena;
+}
+
+/* Called with the lock held, once the last reference to @chunk is gone */
+static void
+arena_recycle_chunk (ArenaChunk *chunk)
+{
+  GskRenderNodeArena *arena = chunk->arena;
+
+  if (arena == NULL)
+    {
+      g_free (chunk);
+      return;
+    }
+
+  chunk->is_free = TRUE;
+  chunk->next_free = arena->free_chunks;
+  arena->free_chunks = chunk;
+}
+
+/*< private >
+ * gsk_render_node_arena_free:
+ * @arena: a #GskRenderNodeArena that is not pushed
+ *
+ * Frees @arena. Chunks that still contain live render nodes are freed
+ * together with the last of their nodes.
+ */
+void
+gsk_render_node_arena_free (GskRenderNodeArena *arena)
+{
+  ArenaChunk *current;
+  guint i;
+
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (!arena->pushed);
+
+  current = arena->current;
+  arena->current = NULL;
+
+  G_LOCK (arena);
+
+  /* Chunks with live nodes, or whose last node is being released right
+   * now, are freed by gsk_render_node_arena_release()
+   */
+  for (i = 0; i < arena->chunks->len; i++)
+    {
+      ArenaChunk *chunk = g_ptr_array_index (arena->chunks, i);
+
+      if (chunk->is_free)
+        g_free (chunk);
+      else
+        chunk->arena = NULL;
+    }
+
+  G_UNLOCK (arena);
+
+  if (current != NULL)
+    gsk_render_node_arena_release (current);
+
+  g_ptr_array_unref (arena->chunks);
+  g_slice_free (GskRenderNodeArena, arena);
+}
+
+/*< private >
+ * gsk_render_node_arena_push:
+ * @arena: a #GskRenderNodeArena
+ *
+ * Makes @arena the arena that render nodes created by the calling
+ * thread are allocated from, until gsk_render_node_arena_pop() is
+ * called.
+ */
+void
+gsk_render_node_arena_push (GskRenderNodeArena *arena)
+{
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (!arena->pushed);
+
+  arena->previous = g_private_get (&current_arena);
+  arena->pushed = TRUE;
+  g_private_set (&current_arena, arena);
+}
+
+void
+gsk_render_node_arena_pop (GskRenderNodeArena *arena)
+{
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (g_private_get (&current_arena) == arena);
+
+  g_private_set (&current_arena, arena->previous);
+  arena->previous = NULL;
+  arena->pushed = FALSE;
+}
+
+/*< private >
+ * gsk_render_node_arena_suspend:
+ *
+ * Makes render nodes created by the calling thread use malloc until
+ * gsk_render_node_arena_resume() is called. Calls can be nested.
+ *
+ * Returns: (nullable): the arena to pass to gsk_render_node_arena_resume()
+ */
+GskRenderNodeArena *
+gsk_render_node_arena_suspend (void)
+{
+  GskRenderNodeArena *arena = g_private_get (&current_arena);
+
+  g_private_set (&current_arena, NULL);
+
+  return arena;
+}
+
+void
+gsk_render_node_arena_resume (GskRenderNodeArena *arena)
+{
+  g_return_if_fail (g_private_get (&current_arena) == NULL);
+
+  g_private_set (&current_arena, arena);
+}
+
+static ArenaChunk *
+arena_next_chunk (GskRenderNodeArena *arena)
+{
+  ArenaChunk *old = arena->current;
+  ArenaChunk *chunk;
+
+  G_LOCK (arena);
+
+  if (arena->free_chunks != NULL)
+    {
+      chunk = arena->free_chunks;
+      arena->free_chunks = chunk->next_free;
+      chunk->next_free = NULL;
+      chunk->is_free = FALSE;
+    }
+  else
+    {
+      chunk = g_malloc (CHUNK_SIZE);
+      chunk->arena = arena;
+      chunk->next_free = NULL;
+      chunk->is_free = FALSE;
+      g_ptr_array_add (arena->chunks, chunk);
+    }
+
+  /* Nobody else can see a chunk without nodes */
+  g_atomic_int_set (&chunk->n_nodes, 1);
+  chunk->used = 0;
+  arena->current = chunk;
+
+  G_UNLOCK (arena);
+
+  /* Drop the reference the old chunk had for being current */
+  if (old != NULL)
+    gsk_render_node_arena_release (old);
+
+  return chunk;
+}
+
+/*< private >
+ * gsk_render_node_arena_alloc:
+ * @size: the size of the node
+ * @chunk_out: (out): return location for the chunk to pass to
+ *   gsk_render_node_arena_release(), or %NULL if the memory must
+ *   be freed with g_free()
+ *
+ * Allocates zeroed memory for a render node, from the current arena
+ * if there is one.
+ *
+ * Returns: the memory for the node
+ */
+gpointer
+gsk_render_node_arena_alloc (gsize     size,
+                             gpointer *chunk_out)
+{
+  GskRenderNodeArena *arena = g_private_get (&current_arena);
+  ArenaChunk *chunk;
+  gpointer mem;
+
+  size = ARENA_ALIGN (size);
+
+  if (arena == NULL || size > MAX_ARENA_NODE_SIZE)
+    {
+      *chunk_out = NULL;
+      return g_malloc0 (size);
+    }
+
+  chunk = arena->current;
+  if (chunk == NULL || CHUNK_HEADER_SIZE + chunk->used + size > CHUNK_SIZE)
+    chunk = arena_next_chunk (arena);
+
+  mem = (guchar *) chunk + CHUNK_HEADER_SIZE + chunk->used;
+  chunk->used += size;
+  g_atomic_int_inc (&chunk->n_nodes);
+
+  memset (mem, 0, size);
+
+  *chunk_out = chunk;
+
+  return mem;
+}
+
+/*< private >
+ * gsk_render_node_arena_release:
+ * @arena_chunk: the chunk returned by gsk_render_node_arena_alloc()
+ *
+ * Releases the memory of a node allocated from an arena.
+ */
+void
+gsk_render_node_arena_release (gpointer arena_chunk)
+{
+  ArenaChunk *chunk = arena_chunk;
+
+  if (!g_atomic_int_dec_and_test (&chunk->n_nodes))
+    return;
+
+  G_LOCK (arena);
+  arena_recycle_chunk (chunk);
+  G_UNLOCK (arena);
+}
@@ -0,0 +1,1431 @@
+/* GSK - The GTK Scene Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gskrendernodebinaryprivate.h"
+
+#include "gskrendernodeprivate.h"
+#include "gsktextureprivate.h"
+
+#include <string.h>
+
+/* The binary format is a flat file that can be mapped into memory and
+ * turned into a node tree without parsing nested containers and without
+ * copying any pixel data.
+ *
+ * It starts with a GskBinaryHeader, followed by:
+ *
+ *  - the node table: one guint32 per node, the offset of the node's
+ *    record in the record area, counted in 32-bit words.
+ *
+ *  - the record area: for each node, its GskRenderNodeType followed by
+ *    the values needed to recreate it. Children are referenced by their
+ *    index in the node table. Nodes are written children first, so child
+ *    indices are always smaller than the index of their parent, and the
+ *    root is the last node.
+ *
+ *  - the blob table: one GskBinaryBlob per blob, pointing to data aligned
+ *    to GSK_BINARY_BLOB_ALIGNMENT. Blobs hold pixel data and font
+ *    descriptions, and are shared by all nodes using the same texture,
+ *    surface or font.
+ *
+ * All values are stored in host byte order; data from machines with a
+ * different byte order is rejected.
+ */
+
+#define GSK_BINARY_MAGIC "GSKRNBIN"
+#define GSK_BINARY_VERSION 1
+#define GSK_BINARY_BYTE_ORDER 0x01020304
+#define GSK_BINARY_BLOB_ALIGNMENT 16
+#define GSK_BINARY_NO_BLOB G_MAXUINT32
+
+/* Pixel blobs start with the width and height of the image, followed by
+ * unpadded ARGB32 pixels at this offset, so that they stay aligned.
+ */
+#define GSK_BINARY_PIXELS_OFFSET 16
+
+#define ALIGN(n, align) (((n) + (align) - 1) & ~((guint64) (align) - 1))
+
+typedef struct {
+  char magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 n_nodes;
+  guint32 n_words;
+  guint32 n_blobs;
+  guint32 reserved;
+  guint64 nodes_offset;
+  guint64 words_offset;
+  guint64 blobs_offset;
+} GskBinaryHeader;
+
+typedef struct {
+  guint64 offset;
+  guint64 size;
+} GskBinaryBlob;
+
+gboolean
+gsk_render_node_binary_detect (GBytes *bytes)
+{
+  gsize size;
+  const char *data = g_bytes_get_data (bytes, &size);
+
+  return size >= sizeof (GskBinaryHeader) &&
+         memcmp (data, GSK_BINARY_MAGIC, strlen (GSK_BINARY_MAGIC)) == 0;
+}
+
+typedef struct {
+  GArray *nodes;
+  GArray *words;
+  GPtrArray *blobs;
+  /* GskRenderNode => index in nodes */
+  GHashTable *node_indices;
+  /* GskTexture, cairo_surface_t => index in blobs */
+  GHashTable *pixel_indices;
+  /* font description string => index in blobs */
+  GHashTable *font_indices;
+} GskBinaryWriter;
+
+static void
+writer_add_uint (GskBinaryWriter *writer,
+                 guint32          value)
+{
+  g_array_append_val (writer->words, value);
+}
+
+static void
+writer_add_float (GskBinaryWriter *writer,
+                  float            value)
+{
+  guint32 word;
+
+  memcpy (&word, &value, sizeof (guint32));
+  writer_add_uint (writer, word);
+}
+
+static void
+writer_add_double (GskBinaryWriter *writer,
+                   double           value)
+{
+  guint32 words[2];
+
+  memcpy (words, &value, sizeof (words));
+  g_array_append_vals (writer->words, words, 2);
+}
+
+static void
+writer_add_point (GskBinaryWriter        *writer,
+                  const graphene_point_t *point)
+{
+  writer_add_float (writer, point->x);
+  writer_add_float (writer, point->y);
+}
+
+static void
+writer_add_rect (GskBinaryWriter       *writer,
+                 const graphene_rect_t *rect)
+{
+  writer_add_float (writer, rect->origin.x);
+  writer_add_float (writer, rect->origin.y);
+  writer_add_float (writer, rect->size.width);
+  writer_add_float (writer, rect->size.height);
+}
+
+static void
+writer_add_rounded_rect (GskBinaryWriter      *writer,
+                         const GskRoundedRect *rect)
+{
+  guint i;
+
+  writer_add_rect (writer, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    {
+      writer_add_float (writer, rect->corner[i].width);
+      writer_add_float (writer, rect->corner[i].height);
+    }
+}
+
+static void
+writer_add_rgba (GskBinaryWriter *writer,
+                 const GdkRGBA   *rgba)
+{
+  writer_add_double (writer, rgba->red);
+  writer_add_double (writer, rgba->green);
+  writer_add_double (writer, rgba->blue);
+  writer_add_double (writer, rgba->alpha);
+}
+
+static void
+writer_add_matrix (GskBinaryWriter         *writer,
+                   const graphene_matrix_t *matrix)
+{
+  float values[16];
+  guint i;
+
+  graphene_matrix_to_float (matrix, values);
+  for (i = 0; i < 16; i++)
+    writer_add_float (writer, values[i]);
+}
+
+static guint32
+writer_add_blob (GskBinaryWriter *writer,
+                 GBytes          *bytes)
+{
+  g_ptr_array_add (writer->blobs, bytes);
+
+  return writer->blobs->len - 1;
+}
+
+static guchar *
+pixel_blob_new (int    width,
+                int    height,
+                gsize *size)
+{
+  guint32 header[2] = { width, height };
+  guchar *data;
+
+  *size = GSK_BINARY_PIXELS_OFFSET + (gsize) width * height * 4;
+  data = g_malloc0 (*size);
+  memcpy (data, header, sizeof (header));
+
+  return data;
+}
+
+static guint32
+writer_add_texture (GskBinaryWriter *writer,
+                    GskTexture      *texture)
+{
+  gpointer index;
+  guchar *data;
+  gsize size;
+  int width, height;
+
+  if (g_hash_table_lookup_extended (writer->pixel_indices, texture, NULL, &index))
+    return GPOINTER_TO_UINT (index);
+
+  width = gsk_texture_get_width (texture);
+  height = gsk_texture_get_height (texture);
+  data = pixel_blob_new (width, height, &size);
+  gsk_texture_download (texture, data + GSK_BINARY_PIXELS_OFFSET, width * 4);
+
+  index = GUINT_TO_POINTER (writer_add_blob (writer, g_bytes_new_take (data, size)));
+  g_hash_table_insert (writer->pixel_indices, texture, index);
+
+  return GPOINTER_TO_UINT (index);
+}
+
+static guint32
+writer_add_surface (GskBinaryWriter *writer,
+                    cairo_surface_t *surface)
+{
+  cairo_surface_t *image;
+  gpointer index;
+  guchar *data;
+  gsize size;
+  int width, height;
+
+  if (g_hash_table_lookup_extended (writer->pixel_indices, surface, NULL, &index))
+    return GPOINTER_TO_UINT (index);
+
+  image = cairo_surface_map_to_image (surface, NULL);
+  width = cairo_image_surface_get_width (image);
+  height = cairo_image_surface_get_height (image);
+  data = pixel_blob_new (width, height, &size);
+
+  if (cairo_image_surface_get_format (image) == CAIRO_FORMAT_ARGB32)
+    {
+      int y;
+
+      for (y = 0; y < height; y++)
+        memcpy (data + GSK_BINARY_PIXELS_OFFSET + y * width * 4,
+                cairo_image_surface_get_data (image) + y * cairo_image_surface_get_stride (image),
+                width * 4);
+    }
+  else
+    {
+      cairo_surface_t *copy;
+      cairo_t *cr;
+
+      copy = cairo_image_surface_create_for_data (data + GSK_BINARY_PIXELS_OFFSET,
+                                                  CAIRO_FORMAT_ARGB32,
+                                                  width, height, width * 4);
+      cr = cairo_create (copy);
+      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      cairo_set_source_surface (cr, image, 0, 0);
+      cairo_paint (cr);
+      cairo_destroy (cr);
+      cairo_surface_finish (copy);
+      cairo_surface_destroy (copy);
+    }
+
+  cairo_surface_unmap_image (surface, image);
+
+  index = GUINT_TO_POINTER (writer_add_blob (writer, g_bytes_new_take (data, size)));
+  g_hash_table_insert (writer->pixel_indices, surface, index);
+
+  return GPOINTER_TO_UINT (index);
+}
+
+static guint32
+writer_add_font (GskBinaryWriter *writer,
+                 PangoFont       *font)
+{
+  PangoFontDescription *desc;
+  gpointer index;
+  char *s;
+
+  desc = pango_font_describe (font);
+  s = pango_font_description_to_string (desc);
+  pango_font_description_free (desc);
+
+  if (g_hash_table_lookup_extended (writer->font_indices, s, NULL, &index))
+    {
+      g_free (s);
+      return GPOINTER_TO_UINT (index);
+    }
+
+  index = GUINT_TO_POINTER (writer_add_blob (writer, g_bytes_new (s, strlen (s) + 1)));
+  g_hash_table_insert (writer->font_indices, s, index);
+
+  return GPOINTER_TO_UINT (index);
+}
+
+static guint32 writer_add_node (GskBinaryWriter *writer,
+                                GskRenderNode   *node);
+
+static void
+writer_begin_node (GskBinaryWriter *writer,
+                   GskRenderNode   *node)
+{
+  guint32 offset = writer->words->len;
+
+  g_array_append_val (writer->nodes, offset);
+  writer_add_uint (writer, gsk_render_node_get_node_type (node));
+}
+
+static guint32
+writer_add_node (GskBinaryWriter *writer,
+                 GskRenderNode   *node)
+{
+  gpointer index;
+
+  if (g_hash_table_lookup_extended (writer->node_indices, node, NULL, &index))
+    return GPOINTER_TO_UINT (index);
+
+  switch (gsk_render_node_get_node_type (node))
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        guint i, n_children = gsk_container_node_get_n_children (node);
+        guint32 *children = g_new (guint32, n_children);
+
+        for (i = 0; i < n_children; i++)
+          children[i] = writer_add_node (writer, gsk_container_node_get_child (node, i));
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, n_children);
+        g_array_append_vals (writer->words, children, n_children);
+
+        g_free (children);
+      }
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        cairo_surface_t *surface = gsk_cairo_node_get_surface (node);
+        double x_scale = 1, y_scale = 1;
+        guint32 blob = GSK_BINARY_NO_BLOB;
+
+        if (surface)
+          {
+            blob = writer_add_surface (writer, surface);
+            cairo_surface_get_device_scale (surface, &x_scale, &y_scale);
+          }
+
+        writer_begin_node (writer, node);
+        writer_add_rect (writer, &node->bounds);
+        writer_add_uint (writer, blob);
+        writer_add_double (writer, x_scale);
+        writer_add_double (writer, y_scale);
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      writer_begin_node (writer, node);
+      writer_add_rect (writer, &node->bounds);
+      writer_add_rgba (writer, gsk_color_node_peek_color (node));
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        const GskColorStop *stops = gsk_linear_gradient_node_peek_color_stops (node);
+        gsize i, n_stops = gsk_linear_gradient_node_get_n_color_stops (node);
+
+        writer_begin_node (writer, node);
+        writer_add_rect (writer, &node->bounds);
+        writer_add_point (writer, gsk_linear_gradient_node_peek_start (node));
+        writer_add_point (writer, gsk_linear_gradient_node_peek_end (node));
+        writer_add_uint (writer, n_stops);
+        for (i = 0; i < n_stops; i++)
+          {
+            writer_add_double (writer, stops[i].offset);
+            writer_add_rgba (writer, &stops[i].color);
+          }
+      }
+      break;
+
+    case GSK_BORDER_NODE:
+      {
+        const float *widths = gsk_border_node_peek_widths (node);
+        const GdkRGBA *colors = gsk_border_node_peek_colors (node);
+        guint i;
+
+        writer_begin_node (writer, node);
+        writer_add_rounded_rect (writer, gsk_border_node_peek_outline (node));
+        for (i = 0; i < 4; i++)
+          writer_add_float (writer, widths[i]);
+        for (i = 0; i < 4; i++)
+          writer_add_rgba (writer, &colors[i]);
+      }
+      break;
+
+    case GSK_TEXTURE_NODE:
+      {
+        guint32 blob = writer_add_texture (writer, gsk_texture_node_get_texture (node));
+
+        writer_begin_node (writer, node);
+        writer_add_rect (writer, &node->bounds);
+        writer_add_uint (writer, blob);
+      }
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+      writer_begin_node (writer, node);
+      writer_add_rounded_rect (writer, gsk_inset_shadow_node_peek_outline (node));
+      writer_add_rgba (writer, gsk_inset_shadow_node_peek_color (node));
+      writer_add_float (writer, gsk_inset_shadow_node_get_dx (node));
+      writer_add_float (writer, gsk_inset_shadow_node_get_dy (node));
+      writer_add_float (writer, gsk_inset_shadow_node_get_spread (node));
+      writer_add_float (writer, gsk_inset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_OUTSET_SHADOW_NODE:
+      writer_begin_node (writer, node);
+      writer_add_rounded_rect (writer, gsk_outset_shadow_node_peek_outline (node));
+      writer_add_rgba (writer, gsk_outset_shadow_node_peek_color (node));
+      writer_add_float (writer, gsk_outset_shadow_node_get_dx (node));
+      writer_add_float (writer, gsk_outset_shadow_node_get_dy (node));
+      writer_add_float (writer, gsk_outset_shadow_node_get_spread (node));
+      writer_add_float (writer, gsk_outset_shadow_node_get_blur_radius (node));
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      {
+        guint32 child = writer_add_node (writer, gsk_transform_node_get_child (node));
+        graphene_matrix_t transform;
+
+        gsk_transform_node_get_transform (node, &transform);
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, child);
+        writer_add_matrix (writer, &transform);
+      }
+      break;
+
+    case GSK_OPACITY_NODE:
+      {
+        guint32 child = writer_add_node (writer, gsk_opacity_node_get_child (node));
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, child);
+        writer_add_double (writer, gsk_opacity_node_get_opacity (node));
+      }
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        guint32 child = writer_add_node (writer, gsk_color_matrix_node_get_child (node));
+        const graphene_vec4_t *offset = gsk_color_matrix_node_peek_color_offset (node);
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, child);
+        writer_add_matrix (writer, gsk_color_matrix_node_peek_color_matrix (node));
+        writer_add_float (writer, graphene_vec4_get_x (offset));
+        writer_add_float (writer, graphene_vec4_get_y (offset));
+        writer_add_float (writer, graphene_vec4_get_z (offset));
+        writer_add_float (writer, graphene_vec4_get_w (offset));
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      {
+        guint32 child = writer_add_node (writer, gsk_repeat_node_get_child (node));
+
+        writer_begin_node (writer, node);
+        writer_add_rect (writer, &node->bounds);
+        writer_add_uint (writer, child);
+        writer_add_rect (writer, gsk_repeat_node_peek_child_bounds (node));
+      }
+      break;
+
+    case GSK_CLIP_NODE:
+      {
+        guint32 child = writer_add_node (writer, gsk_clip_node_get_child (node));
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, child);
+        writer_add_rect (writer, gsk_clip_node_peek_clip (node));
+      }
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      {
+        guint32 child = writer_add_node (writer, gsk_rounded_clip_node_get_child (node));
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, child);
+        writer_add_rounded_rect (writer, gsk_rounded_clip_node_peek_clip (node));
+      }
+      break;
+
+    case GSK_SHADOW_NODE:
+      {
+        guint32 child = writer_add_node (writer, gsk_shadow_node_get_child (node));
+        gsize i, n_shadows = gsk_shadow_node_get_n_shadows (node);
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, child);
+        writer_add_uint (writer, n_shadows);
+        for (i = 0; i < n_shadows; i++)
+          {
+            const GskShadow *shadow = gsk_shadow_node_peek_shadow (node, i);
+
+            writer_add_rgba (writer, &shadow->color);
+            writer_add_float (writer, shadow->dx);
+            writer_add_float (writer, shadow->dy);
+            writer_add_float (writer, shadow->radius);
+          }
+      }
+      break;
+
+    case GSK_BLEND_NODE:
+      {
+        guint32 bottom = writer_add_node (writer, gsk_blend_node_get_bottom_child (node));
+        guint32 top = writer_add_node (writer, gsk_blend_node_get_top_child (node));
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, bottom);
+        writer_add_uint (writer, top);
+        writer_add_uint (writer, gsk_blend_node_get_blend_mode (node));
+      }
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        guint32 start = writer_add_node (writer, gsk_cross_fade_node_get_start_child (node));
+        guint32 end = writer_add_node (writer, gsk_cross_fade_node_get_end_child (node));
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, start);
+        writer_add_uint (writer, end);
+        writer_add_double (writer, gsk_cross_fade_node_get_progress (node));
+      }
+      break;
+
+    case GSK_TEXT_NODE:
+      {
+        guint32 font = writer_add_font (writer, gsk_text_node_get_font (node));
+        PangoGlyphString *glyphs = gsk_text_node_get_glyphs (node);
+        int i;
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, font);
+        writer_add_rgba (writer, gsk_text_node_get_color (node));
+        writer_add_double (writer, gsk_text_node_get_x (node));
+        writer_add_double (writer, gsk_text_node_get_y (node));
+        writer_add_uint (writer, glyphs->num_glyphs);
+        for (i = 0; i < glyphs->num_glyphs; i++)
+          {
+            const PangoGlyphInfo *glyph = &glyphs->glyphs[i];
+
+            writer_add_uint (writer, glyph->glyph);
+            writer_add_uint (writer, glyph->geometry.width);
+            writer_add_uint (writer, glyph->geometry.x_offset);
+            writer_add_uint (writer, glyph->geometry.y_offset);
+            writer_add_uint (writer, glyph->attr.is_cluster_start);
+          }
+      }
+      break;
+
+    case GSK_BLUR_NODE:
+      {
+        guint32 child = writer_add_node (writer, gsk_blur_node_get_child (node));
+
+        writer_begin_node (writer, node);
+        writer_add_uint (writer, child);
+        writer_add_double (writer, gsk_blur_node_get_radius (node));
+      }
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_assert_not_reached ();
+    }
+
+  index = GUINT_TO_POINTER (writer->nodes->len - 1);
+  g_hash_table_insert (writer->node_indices, node, index);
+
+  return GPOINTER_TO_UINT (index);
+}
+
+GBytes *
+gsk_render_node_binary_serialize (GskRenderNode *node)
+{
+  GskBinaryWriter writer;
+  GskBinaryHeader header = { { 0, }, };
+  GskBinaryBlob *blobs;
+  GByteArray *array;
+  guint64 offset;
+  guint i;
+
+  writer.nodes = g_array_new (FALSE, FALSE, sizeof (guint32));
+  writer.words = g_array_new (FALSE, FALSE, sizeof (guint32));
+  writer.blobs = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+  writer.node_indices = g_hash_table_new (NULL, NULL);
+  writer.pixel_indices = g_hash_table_new (NULL, NULL);
+  writer.font_indices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  writer_add_node (&writer, node);
+
+  memcpy (header.magic, GSK_BINARY_MAGIC, strlen (GSK_BINARY_MAGIC));
+  header.version = GSK_BINARY_VERSION;
+  header.byte_order = GSK_BINARY_BYTE_ORDER;
+  header.n_nodes = writer.nodes->len;
+  header.n_words = writer.words->len;
+  header.n_blobs = writer.blobs->len;
+  header.nodes_offset = sizeof (GskBinaryHeader);
+  header.words_offset = ALIGN (header.nodes_offset + header.n_nodes * sizeof (guint32), 8);
+  header.blobs_offset = ALIGN (header.words_offset + header.n_words * sizeof (guint32), GSK_BINARY_BLOB_ALIGNMENT);
+
+  blobs = g_new (GskBinaryBlob, header.n_blobs);
+  offset = ALIGN (header.blobs_offset + header.n_blobs * sizeof (GskBinaryBlob), GSK_BINARY_BLOB_ALIGNMENT);
+  for (i = 0; i < header.n_blobs; i++)
+    {
+      blobs[i].offset = offset;
+      blobs[i].size = g_bytes_get_size (g_ptr_array_index (writer.blobs, i));
+      offset = ALIGN (offset + blobs[i].size, GSK_BINARY_BLOB_ALIGNMENT);
+    }
+
+  array = g_byte_array_sized_new (offset);
+  g_byte_array_set_size (array, offset);
+  memset (array->data, 0, offset);
+
+  memcpy (array->data, &header, sizeof (GskBinaryHeader));
+  memcpy (array->data + header.nodes_offset, writer.nodes->data, header.n_nodes * sizeof (guint32));
+  memcpy (array->data + header.words_offset, writer.words->data, header.n_words * sizeof (guint32));
+  memcpy (array->data + header.blobs_offset, blobs, header.n_blobs * sizeof (GskBinaryBlob));
+  for (i = 0; i < header.n_blobs; i++)
+    memcpy (array->data + blobs[i].offset,
+            g_bytes_get_data (g_ptr_array_index (writer.blobs, i), NULL),
+            blobs[i].size);
+
+  g_free (blobs);
+  g_array_unref (writer.nodes);
+  g_array_unref (writer.words);
+  g_ptr_array_unref (writer.blobs);
+  g_hash_table_unref (writer.node_indices);
+  g_hash_table_unref (writer.pixel_indices);
+  g_hash_table_unref (writer.font_indices);
+
+  return g_byte_array_free_to_bytes (array);
+}
+
+typedef struct {
+  GBytes *bytes;
+  const guchar *data;
+  gsize size;
+  GskBinaryHeader header;
+
+  /* current position in the record area */
+  guint32 pos;
+  /* index of the node being read */
+  guint32 current;
+  gboolean invalid;
+
+  GskRenderNode **nodes;
+  /* Objects created from the blobs, so that nodes sharing a blob
+   * share them too */
+  cairo_surface_t **surfaces;
+  GskTexture **textures;
+  PangoFont **fonts;
+  PangoContext *context;
+} GskBinaryReader;
+
+static const cairo_user_data_key_t gsk_binary_bytes_key;
+
+static guint32
+reader_get_uint (GskBinaryReader *reader)
+{
+  guint32 value;
+
+  if (reader->pos >= reader->header.n_words)
+    {
+      reader->invalid = TRUE;
+      return 0;
+    }
+
+  memcpy (&value,
+          reader->data + reader->header.words_offset + reader->pos * sizeof (guint32),
+          sizeof (guint32));
+  reader->pos++;
+
+  return value;
+}
+
+static float
+reader_get_float (GskBinaryReader *reader)
+{
+  guint32 word = reader_get_uint (reader);
+  float value;
+
+  memcpy (&value, &word, sizeof (float));
+
+  return value;
+}
+
+static double
+reader_get_double (GskBinaryReader *reader)
+{
+  guint32 words[2];
+  double value;
+
+  words[0] = reader_get_uint (reader);
+  words[1] = reader_get_uint (reader);
+  memcpy (&value, words, sizeof (double));
+
+  return value;
+}
+
+static void
+reader_get_point (GskBinaryReader  *reader,
+                  graphene_point_t *point)
+{
+  point->x = reader_get_float (reader);
+  point->y = reader_get_float (reader);
+}
+
+static void
+reader_get_rect (GskBinaryReader *reader,
+                 graphene_rect_t *rect)
+{
+  rect->origin.x = reader_get_float (reader);
+  rect->origin.y = reader_get_float (reader);
+  rect->size.width = reader_get_float (reader);
+  rect->size.height = reader_get_float (reader);
+}
+
+static void
+reader_get_rounded_rect (GskBinaryReader *reader,
+                         GskRoundedRect  *rect)
+{
+  guint i;
+
+  reader_get_rect (reader, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    {
+      rect->corner[i].width = reader_get_float (reader);
+      rect->corner[i].height = reader_get_float (reader);
+    }
+}
+
+static void
+reader_get_rgba (GskBinaryReader *reader,
+                 GdkRGBA         *rgba)
+{
+  rgba->red = reader_get_double (reader);
+  rgba->green = reader_get_double (reader);
+  rgba->blue = reader_get_double (reader);
+  rgba->alpha = reader_get_double (reader);
+}
+
+static void
+reader_get_matrix (GskBinaryReader   *reader,
+                   graphene_matrix_t *matrix)
+{
+  float values[16];
+  guint i;
+
+  for (i = 0; i < 16; i++)
+    values[i] = reader_get_float (reader);
+
+  graphene_matrix_init_from_float (matrix, values);
+}
+
+/* Checks that @count elements of @words_per_element words each can
+ * still be read, before allocating memory for them.
+ */
+static gboolean
+reader_check_count (GskBinaryReader *reader,
+                    guint32          count,
+                    gsize            words_per_element)
+{
+  if (count > (reader->header.n_words - reader->pos) / words_per_element)
+    {
+      reader->invalid = TRUE;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static GskRenderNode *
+reader_get_node (GskBinaryReader *reader)
+{
+  guint32 index = reader_get_uint (reader);
+
+  /* Children are always written before their parents */
+  if (index >= reader->current)
+    {
+      reader->invalid = TRUE;
+      return NULL;
+    }
+
+  return reader->nodes[index];
+}
+
+static const guchar *
+reader_get_blob (GskBinaryReader *reader,
+                 guint32          index,
+                 gsize           *size)
+{
+  GskBinaryBlob blob;
+
+  if (index >= reader->header.n_blobs)
+    {
+      reader->invalid = TRUE;
+      return NULL;
+    }
+
+  memcpy (&blob,
+          reader->data + reader->header.blobs_offset + index * sizeof (GskBinaryBlob),
+          sizeof (GskBinaryBlob));
+
+  if (blob.offset > reader->size || blob.size > reader->size - blob.offset)
+    {
+      reader->invalid = TRUE;
+      return NULL;
+    }
+
+  *size = blob.size;
+
+  return reader->data + blob.offset;
+}
+
+static cairo_surface_t *
+reader_get_surface (GskBinaryReader *reader,
+                    guint32          index)
+{
+  cairo_surface_t *surface;
+  const guchar *data, *pixels;
+  guint32 header[2];
+  gsize size;
+
+  data = reader_get_blob (reader, index, &size);
+  if (data == NULL)
+    return NULL;
+
+  if (reader->surfaces[index])
+    return reader->surfaces[index];
+
+  if (size < GSK_BINARY_PIXELS_OFFSET)
+    {
+      reader->invalid = TRUE;
+      return NULL;
+    }
+
+  memcpy (header, data, sizeof (header));
+  if (header[0] == 0 || header[1] == 0 ||
+      header[0] > G_MAXINT / 4 ||
+      header[1] > (size - GSK_BINARY_PIXELS_OFFSET) / (header[0] * 4))
+    {
+      reader->invalid = TRUE;
+      return NULL;
+    }
+
+  pixels = data + GSK_BINARY_PIXELS_OFFSET;
+
+  if (GPOINTER_TO_SIZE (pixels) % sizeof (guint32) == 0)
+    {
+      /* Use the pixels in place. The data is usually read-only, but
+       * nodes never draw to the surfaces they were created with.
+       */
+      surface = cairo_image_surface_create_for_data ((guchar *) pixels,
+                                                     CAIRO_FORMAT_ARGB32,
+                                                     header[0], header[1],
+                                                     header[0] * 4);
+      cairo_surface_set_user_data (surface,
+                                   &gsk_binary_bytes_key,
+                                   g_bytes_ref (reader->bytes),
+                                   (cairo_destroy_func_t) g_bytes_unref);
+    }
+  else
+    {
+      guint32 y;
+
+      surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, header[0], header[1]);
+      for (y = 0; y < header[1]; y++)
+        memcpy (cairo_image_surface_get_data (surface) + y * cairo_image_surface_get_stride (surface),
+                pixels + y * header[0] * 4,
+                header[0] * 4);
+      cairo_surface_mark_dirty (surface);
+    }
+
+  reader->surfaces[index] = surface;
+
+  return surface;
+}
+
+static GskTexture *
+reader_get_texture (GskBinaryReader *reader,
+                    guint32          index)
+{
+  cairo_surface_t *surface;
+
+  surface = reader_get_surface (reader, index);
+  if (surface == NULL)
+    return NULL;
+
+  if (reader->textures[index] == NULL)
+    reader->textures[index] = gsk_texture_new_for_surface (surface);
+
+  return reader->textures[index];
+}
+
+static PangoFont *
+reader_get_font (GskBinaryReader *reader,
+                 guint32          index)
+{
+  PangoFontDescription *desc;
+  PangoFontMap *fontmap;
+  const guchar *data;
+  gsize size;
+
+  data = reader_get_blob (reader, index, &size);
+  if (data == NULL)
+    return NULL;
+
+  if (reader->fonts[index])
+    return reader->fonts[index];
+
+  if (size == 0 || data[size - 1] != '\0')
+    {
+      reader->invalid = TRUE;
+      return NULL;
+    }
+
+  fontmap = pango_cairo_font_map_get_default ();
+  if (reader->context == NULL)
+    reader->context = pango_font_map_create_context (fontmap);
+
+  desc = pango_font_description_from_string ((const char *) data);
+  reader->fonts[index] = pango_font_map_load_font (fontmap, reader->context, desc);
+  pango_font_description_free (desc);
+
+  if (reader->fonts[index] == NULL)
+    reader->invalid = TRUE;
+
+  return reader->fonts[index];
+}
+
+static GskRenderNode *
+reader_read_node (GskBinaryReader *reader)
+{
+  GskRenderNodeType type;
+  GskRenderNode *result = NULL;
+  guint32 offset;
+
+  memcpy (&offset,
+          reader->data + reader->header.nodes_offset + reader->current * sizeof (guint32),
+          sizeof (guint32));
+  reader->pos = offset;
+
+  type = reader_get_uint (reader);
+
+  switch (type)
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        GskRenderNode **children;
+        guint32 i, n_children;
+
+        n_children = reader_get_uint (reader);
+        if (!reader_check_count (reader, n_children, 1))
+          break;
+
+        children = g_new (GskRenderNode *, n_children);
+        for (i = 0; i < n_children; i++)
+          children[i] = reader_get_node (reader);
+
+        if (!reader->invalid)
+          result = gsk_container_node_new (children, n_children);
+
+        g_free (children);
+      }
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        cairo_surface_t *surface = NULL;
+        graphene_rect_t bounds;
+        double x_scale, y_scale;
+        guint32 blob;
+
+        reader_get_rect (reader, &bounds);
+        blob = reader_get_uint (reader);
+        x_scale = reader_get_double (reader);
+        y_scale = reader_get_double (reader);
+        if (!(x_scale > 0 && x_scale <= G_MAXINT16) ||
+            !(y_scale > 0 && y_scale <= G_MAXINT16))
+          reader->invalid = TRUE;
+
+        if (blob == GSK_BINARY_NO_BLOB)
+          {
+            if (!reader->invalid)
+              result = gsk_cairo_node_new (&bounds);
+            break;
+          }
+
+        surface = reader_get_surface (reader, blob);
+        if (!reader->invalid)
+          {
+            cairo_surface_t *copy;
+            cairo_t *cr;
+
+            /* The blob's surface is shared with the other nodes using
+             * it and may point into read-only memory, while the Cairo
+             * node gets its own device scale and can be drawn to with
+             * gsk_cairo_node_get_draw_context(), so give it a copy.
+             */
+            copy = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                               cairo_image_surface_get_width (surface),
+                                               cairo_image_surface_get_height (surface));
+            cr = cairo_create (copy);
+            cairo_set_source_surface (cr, surface, 0, 0);
+            cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+            cairo_paint (cr);
+            cairo_destroy (cr);
+
+            cairo_surface_set_device_scale (copy, x_scale, y_scale);
+            result = gsk_cairo_node_new_for_surface (&bounds, copy);
+            cairo_surface_destroy (copy);
+          }
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      {
+        graphene_rect_t bounds;
+        GdkRGBA color;
+
+        reader_get_rect (reader, &bounds);
+        reader_get_rgba (reader, &color);
+
+        if (!reader->invalid)
+          result = gsk_color_node_new (&color, &bounds);
+      }
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      {
+        graphene_rect_t bounds;
+        graphene_point_t start, end;
+        GskColorStop *stops;
+        guint32 i, n_stops;
+
+        reader_get_rect (reader, &bounds);
+        reader_get_point (reader, &start);
+        reader_get_point (reader, &end);
+        n_stops = reader_get_uint (reader);
+        if (!reader_check_count (reader, n_stops, 10))
+          break;
+
+        stops = g_new (GskColorStop, n_stops);
+        for (i = 0; i < n_stops; i++)
+          {
+            stops[i].offset = reader_get_double (reader);
+            reader_get_rgba (reader, &stops[i].color);
+          }
+
+        if (reader->invalid)
+          ;
+        else if (type == GSK_LINEAR_GRADIENT_NODE)
+          result = gsk_linear_gradient_node_new (&bounds, &start, &end, stops, n_stops);
+        else
+          result = gsk_repeating_linear_gradient_node_new (&bounds, &start, &end, stops, n_stops);
+
+        g_free (stops);
+      }
+      break;
+
+    case GSK_BORDER_NODE:
+      {
+        GskRoundedRect outline;
+        float widths[4];
+        GdkRGBA colors[4];
+        guint i;
+
+        reader_get_rounded_rect (reader, &outline);
+        for (i = 0; i < 4; i++)
+          widths[i] = reader_get_float (reader);
+        for (i = 0; i < 4; i++)
+          reader_get_rgba (reader, &colors[i]);
+
+        if (!reader->invalid)
+          result = gsk_border_node_new (&outline, widths, colors);
+      }
+      break;
+
+    case GSK_TEXTURE_NODE:
+      {
+        graphene_rect_t bounds;
+        GskTexture *texture;
+
+        reader_get_rect (reader, &bounds);
+        texture = reader_get_texture (reader, reader_get_uint (reader));
+
+        if (!reader->invalid)
+          result = gsk_texture_node_new (texture, &bounds);
+      }
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+      {
+        GskRoundedRect outline;
+        GdkRGBA color;
+        float dx, dy, spread, blur_radius;
+
+        reader_get_rounded_rect (reader, &outline);
+        reader_get_rgba (reader, &color);
+        dx = reader_get_float (reader);
+        dy = reader_get_float (reader);
+        spread = reader_get_float (reader);
+        blur_radius = reader_get_float (reader);
+
+        if (reader->invalid)
+          ;
+        else if (type == GSK_INSET_SHADOW_NODE)
+          result = gsk_inset_shadow_node_new (&outline, &color, dx, dy, spread, blur_radius);
+        else
+          result = gsk_outset_shadow_node_new (&outline, &color, dx, dy, spread, blur_radius);
+      }
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      {
+        GskRenderNode *child = reader_get_node (reader);
+        graphene_matrix_t transform;
+
+        reader_get_matrix (reader, &transform);
+
+        if (!reader->invalid)
+          result = gsk_transform_node_new (child, &transform);
+      }
+      break;
+
+    case GSK_OPACITY_NODE:
+      {
+        GskRenderNode *child = reader_get_node (reader);
+        double opacity = reader_get_double (reader);
+
+        if (!reader->invalid)
+          result = gsk_opacity_node_new (child, opacity);
+      }
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      {
+        GskRenderNode *child = reader_get_node (reader);
+        graphene_matrix_t matrix;
+        graphene_vec4_t offset;
+        float x, y, z, w;
+
+        reader_get_matrix (reader, &matrix);
+        x = reader_get_float (reader);
+        y = reader_get_float (reader);
+        z = reader_get_float (reader);
+        w = reader_get_float (reader);
+        graphene_vec4_init (&offset, x, y, z, w);
+
+        if (!reader->invalid)
+          result = gsk_color_matrix_node_new (child, &matrix, &offset);
+      }
+      break;
+
+    case GSK_REPEAT_NODE:
+      {
+        graphene_rect_t bounds, child_bounds;
+        GskRenderNode *child;
+
+        reader_get_rect (reader, &bounds);
+        child = reader_get_node (reader);
+        reader_get_rect (reader, &child_bounds);
+
+        if (!reader->invalid)
+          result = gsk_repeat_node_new (&bounds, child, &child_bounds);
+      }
+      break;
+
+    case GSK_CLIP_NODE:
+      {
+        GskRenderNode *child = reader_get_node (reader);
+        graphene_rect_t clip;
+
+        reader_get_rect (reader, &clip);
+
+        if (!reader->invalid)
+          result = gsk_clip_node_new (child, &clip);
+      }
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      {
+        GskRenderNode *child = reader_get_node (reader);
+        GskRoundedRect clip;
+
+        reader_get_rounded_rect (reader, &clip);
+
+        if (!reader->invalid)
+          result = gsk_rounded_clip_node_new (child, &clip);
+      }
+      break;
+
+    case GSK_SHADOW_NODE:
+      {
+        GskRenderNode *child = reader_get_node (reader);
+        GskShadow *shadows;
+        guint32 i, n_shadows;
+
+        n_shadows = reader_get_uint (reader);
+        if (n_shadows == 0 || !reader_check_count (reader, n_shadows, 11))
+          {
+            reader->invalid = TRUE;
+            break;
+          }
+
+        shadows = g_new (GskShadow, n_shadows);
+        for (i = 0; i < n_shadows; i++)
+          {
+            reader_get_rgba (reader, &shadows[i].color);
+            shadows[i].dx = reader_get_float (reader);
+            shadows[i].dy = reader_get_float (reader);
+            shadows[i].radius = reader_get_float (reader);
+          }
+
+        if (!reader->invalid)
+          result = gsk_shadow_node_new (child, shadows, n_shadows);
+
+        g_free (shadows);
+      }
+      break;
+
+    case GSK_BLEND_NODE:
+      {
+        GskRenderNode *bottom = reader_get_node (reader);
+        GskRenderNode *top = reader_get_node (reader);
+        guint32 mode = reader_get_uint (reader);
+
+        if (mode > GSK_BLEND_MODE_LUMINOSITY)
+          reader->invalid = TRUE;
+
+        if (!reader->invalid)
+          result = gsk_blend_node_new (bottom, top, mode);
+      }
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      {
+        GskRenderNode *start = reader_get_node (reader);
+        GskRenderNode *end = reader_get_node (reader);
+        double progress = reader_get_double (reader);
+
+        if (!reader->invalid)
+          result = gsk_cross_fade_node_new (start, end, progress);
+      }
+      break;
+
+    case GSK_TEXT_NODE:
+      {
+        PangoGlyphString *glyphs;
+        PangoFont *font;
+        GdkRGBA color;
+        double x, y;
+        guint32 i, n_glyphs;
+
+        font = reader_get_font (reader, reader_get_uint (reader));
+        reader_get_rgba (reader, &color);
+        x = reader_get_double (reader);
+        y = reader_get_double (reader);
+        n_glyphs = reader_get_uint (reader);
+        if (n_glyphs > G_MAXINT || !reader_check_count (reader, n_glyphs, 5))
+          {
+            reader->invalid = TRUE;
+            break;
+          }
+
+        glyphs = pango_glyph_string_new ();
+        pango_glyph_string_set_size (glyphs, n_glyphs);
+        for (i = 0; i < n_glyphs; i++)
+          {
+            PangoGlyphInfo *glyph = &glyphs->glyphs[i];
+
+            glyph->glyph = reader_get_uint (reader);
+            glyph->geometry.width = (gint32) reader_get_uint (reader);
+            glyph->geometry.x_offset = (gint32) reader_get_uint (reader);
+            glyph->geometry.y_offset = (gint32) reader_get_uint (reader);
+            glyph->attr.is_cluster_start = reader_get_uint (reader);
+          }
+
+        if (!reader->invalid)
+          result = gsk_text_node_new (font, glyphs, &color, x, y);
+
+        pango_glyph_string_free (glyphs);
+      }
+      break;
+
+    case GSK_BLUR_NODE:
+      {
+        GskRenderNode *child = reader_get_node (reader);
+        double radius = reader_get_double (reader);
+
+        if (!reader->invalid)
+          result = gsk_blur_node_new (child, radius);
+      }
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      reader->invalid = TRUE;
+      break;
+    }
+
+  if (result == NULL)
+    reader->invalid = TRUE;
+
+  return result;
+}
+
+static gboolean
+reader_check_header (GskBinaryReader  *reader,
+                     GError          **error)
+{
+  GskBinaryHeader *header = &reader->header;
+
+  if (reader->size < sizeof (GskBinaryHeader))
+    goto invalid;
+
+  memcpy (header, reader->data, sizeof (GskBinaryHeader));
+
+  if (memcmp (header->magic, GSK_BINARY_MAGIC, strlen (GSK_BINARY_MAGIC)) != 0)
+    {
+      g_set_error (error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_UNSUPPORTED_FORMAT,
+                   "Data not in GskRenderNode binary format.");
+      return FALSE;
+    }
+
+  if (header->version != GSK_BINARY_VERSION)
+    {
+      g_set_error (error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_UNSUPPORTED_VERSION,
+                   "Format version %u not supported.", header->version);
+      return FALSE;
+    }
+
+  if (header->byte_order != GSK_BINARY_BYTE_ORDER)
+    {
+      g_set_error (error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_UNSUPPORTED_FORMAT,
+                   "Data was written on a machine with a different byte order.");
+      return FALSE;
+    }
+
+  if (header->n_nodes == 0 ||
+      header->nodes_offset > reader->size ||
+      header->n_nodes > (reader->size - header->nodes_offset) / sizeof (guint32) ||
+      header->words_offset > reader->size ||
+      header->n_words > (reader->size - header->words_offset) / sizeof (guint32) ||
+      header->blobs_offset > reader->size ||
+      header->n_blobs > (reader->size - header->blobs_offset) / sizeof (GskBinaryBlob))
+    goto invalid;
+
+  return TRUE;
+
+invalid:
+  g_set_error (error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_INVALID_DATA,
+               "Truncated or corrupt render node data.");
+  return FALSE;
+}
+
+GskRenderNode *
+gsk_render_node_binary_deserialize (GBytes  *bytes,
+                                    GError **error)
+{
+  GskBinaryReader reader = { NULL, };
+  GskRenderNode *root = NULL;
+  guint32 i;
+
+  reader.bytes = bytes;
+  reader.data = g_bytes_get_data (bytes, &reader.size);
+
+  if (!reader_check_header (&reader, error))
+    return NULL;
+
+  reader.nodes = g_new0 (GskRenderNode *, reader.header.n_nodes);
+  reader.surfaces = g_new0 (cairo_surface_t *, reader.header.n_blobs);
+  reader.textures = g_new0 (GskTexture *, reader.header.n_blobs);
+  reader.fonts = g_new0 (PangoFont *, reader.header.n_blobs);
+
+  for (reader.current = 0; reader.current < reader.header.n_nodes; reader.current++)
+    {
+      reader.nodes[reader.current] = reader_read_node (&reader);
+      if (reader.invalid)
+        {
+          g_set_error (error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_INVALID_DATA,
+                       "Invalid data for node %u.", reader.current);
+          break;
+        }
+    }
+
+  if (!reader.invalid)
+    root = gsk_render_node_ref (reader.nodes[reader.header.n_nodes - 1]);
+
+  for (i = 0; i < reader.header.n_nodes; i++)
+    g_clear_pointer (&reader.nodes[i], gsk_render_node_unref);
+  for (i = 0; i < reader.header.n_blobs; i++)
+    {
+      g_clear_pointer (&reader.surfaces[i], cairo_surface_destroy);
+      g_clear_object (&reader.textures[i]);
+      g_clear_object (&reader.fonts[i]);
+    }
+  g_free (reader.nodes);
+  g_free (reader.surfaces);
+  g_free (reader.textures);
+  g_free (reader.fonts);
+  g_clear_object (&reader.context);
+
+  return root;
+}
@@ -26,6 +26,9 @@
 #include "gskroundedrectprivate.h"
 #include "gsktextureprivate.h"
 
+#include <math.h>
+#include <string.h>
+
 static gboolean
 check_variant_type (GVariant *variant,
                     const char *type_string,
@@ -42,6 +45,69 @@ check_variant_type (GVariant *variant,
   return TRUE;
 }
 
+static gboolean
+matrix_equal (const graphene_matrix_t *a,
+              const graphene_matrix_t *b)
+{
+  float fa[16], fb[16];
+
+  graphene_matrix_to_float (a, fa);
+  graphene_matrix_to_float (b, fb);
+
+  return memcmp (fa, fb, sizeof (fa)) == 0;
+}
+
+static void
+rectangle_init_from_graphene (cairo_rectangle_int_t *cairo,
+                              const graphene_rect_t *graphene)
+{
+  cairo->x = floorf (graphene->origin.x);
+  cairo->y = floorf (graphene->origin.y);
+  cairo->width = ceilf (graphene->origin.x + graphene->size.width) - cairo->x;
+  cairo->height = ceilf (graphene->origin.y + graphene->size.height) - cairo->y;
+}
+
+/* Diffs @child1 against @child2 and adds the changes to @region, restricted
+ * to @clip.
+ */
+static void
+diff_children_clipped (GskRenderNode         *child1,
+                       GskRenderNode         *child2,
+                       const graphene_rect_t *clip,
+                       cairo_region_t        *region)
+{
+  cairo_rectangle_int_t clip_rect;
+  cairo_region_t *sub;
+
+  sub = cairo_region_create ();
+  gsk_render_node_diff (child1, child2, sub);
+  rectangle_init_from_graphene (&clip_rect, clip);
+  cairo_region_intersect_rectangle (sub, &clip_rect);
+  cairo_region_union (region, sub);
+  cairo_region_destroy (sub);
+}
+
+/* For nodes whose effect spreads pixels around (blurs, shadows, repeats),
+ * we only detect whether the child changed at all.
+ */
+static gboolean
+children_equal (GskRenderNode *child1,
+                GskRenderNode *child2)
+{
+  cairo_region_t *sub;
+  gboolean result;
+
+  if (child1 == child2)
+    return TRUE;
+
+  sub = cairo_region_create ();
+  gsk_render_node_diff (child1, child2, sub);
+  result = cairo_region_is_empty (sub);
+  cairo_region_destroy (sub);
+
+  return result;
+}
+
 /*** GSK_COLOR_NODE ***/
 
 typedef struct _GskColorNode GskColorNode;
@@ -72,20 +138,23 @@ gsk_color_node_draw (GskRenderNode *node,
   cairo_fill (cr);
 }
 
-#define GSK_COLOR_NODE_VARIANT_TYPE "(dddddddd)"
-
-static GVariant *
-gsk_color_node_serialize (GskRenderNode *node)
+static void
+gsk_color_node_diff (GskRenderNode  *node1,
+                     GskRenderNode  *node2,
+                     cairo_region_t *region)
 {
-  GskColorNode *self = (GskColorNode *) node;
+  GskColorNode *self1 = (GskColorNode *) node1;
+  GskColorNode *self2 = (GskColorNode *) node2;
+
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      gdk_rgba_equal (&self1->color, &self2->color))
+    return;
 
-  return g_variant_new (GSK_COLOR_NODE_VARIANT_TYPE,
-                        self->color.red, self->color.green,
-                        self->color.blue, self->color.alpha,
-                        (double) node->bounds.origin.x, (double) node->bounds.origin.y,
-                        (double) node->bounds.size.width, (double) node->bounds.size.height);
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_COLOR_NODE_VARIANT_TYPE "(dddddddd)"
+
 static GskRenderNode *
 gsk_color_node_deserialize (GVariant  *variant,
                             GError   **error)
@@ -109,7 +178,7 @@ static const GskRenderNodeClass GSK_COLOR_NODE_CLASS = {
   "GskColorNode",
   gsk_color_node_finalize,
   gsk_color_node_draw,
-  gsk_color_node_serialize,
+  gsk_color_node_diff,
   gsk_color_node_deserialize,
 };
 
@@ -203,32 +272,26 @@ gsk_linear_gradient_node_draw (GskRenderNode *node,
   cairo_fill (cr);
 }
 
-#define GSK_LINEAR_GRADIENT_NODE_VARIANT_TYPE "(dddddddda(ddddd))"
-
-static GVariant *
-gsk_linear_gradient_node_serialize (GskRenderNode *node)
-{
-  GskLinearGradientNode *self = (GskLinearGradientNode *) node;
-  GVariantBuilder builder;
-  guint i;
-
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ddddd)"));
-  for (i = 0; i < self->n_stops; i++)
-    {
-      g_variant_builder_add  (&builder, "(ddddd)",
-                              (double) self->stops[i].offset,
-                              self->stops[i].color.red, self->stops[i].color.green,
-                              self->stops[i].color.blue, self->stops[i].color.alpha);
-    }
+static void
+gsk_linear_gradient_node_diff (GskRenderNode  *node1,
+                               GskRenderNode  *node2,
+                               cairo_region_t *region)
+{
+  GskLinearGradientNode *self1 = (GskLinearGradientNode *) node1;
+  GskLinearGradientNode *self2 = (GskLinearGradientNode *) node2;
+
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      graphene_point_equal (&self1->start, &self2->start) &&
+      graphene_point_equal (&self1->end, &self2->end) &&
+      self1->n_stops == self2->n_stops &&
+      memcmp (self1->stops, self2->stops, sizeof (GskColorStop) * self1->n_stops) == 0)
+    return;
 
-  return g_variant_new (GSK_LINEAR_GRADIENT_NODE_VARIANT_TYPE,
-                        (double) node->bounds.origin.x, (double) node->bounds.origin.y,
-                        (double) node->bounds.size.width, (double) node->bounds.size.height,
-                        (double) self->start.x, (double) self->start.y,
-                        (double) self->end.x, (double) self->end.y,
-                        &builder);
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_LINEAR_GRADIENT_NODE_VARIANT_TYPE "(dddddddda(ddddd))"
+
 static GskRenderNode *
 gsk_linear_gradient_node_real_deserialize (GVariant  *variant,
                                            gboolean   repeating,
@@ -287,7 +350,7 @@ static const GskRenderNodeClass GSK_LINEAR_GRADIENT_NODE_CLASS = {
   "GskLinearGradientNode",
   gsk_linear_gradient_node_finalize,
   gsk_linear_gradient_node_draw,
-  gsk_linear_gradient_node_serialize,
+  gsk_linear_gradient_node_diff,
   gsk_linear_gradient_node_deserialize,
 };
 
@@ -297,7 +360,7 @@ static const GskRenderNodeClass GSK_REPEATING_LINEAR_GRADIENT_NODE_CLASS = {
   "GskLinearGradientNode",
   gsk_linear_gradient_node_finalize,
   gsk_linear_gradient_node_draw,
-  gsk_linear_gradient_node_serialize,
+  gsk_linear_gradient_node_diff,
   gsk_repeating_linear_gradient_node_deserialize,
 };
 
@@ -525,32 +588,24 @@ gsk_border_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
-#define GSK_BORDER_NODE_VARIANT_TYPE "(dddddddddddddddddddddddddddddddd)"
-
-static GVariant *
-gsk_border_node_serialize (GskRenderNode *node)
+static void
+gsk_border_node_diff (GskRenderNode  *node1,
+                      GskRenderNode  *node2,
+                      cairo_region_t *region)
 {
-  GskBorderNode *self = (GskBorderNode *) node;
+  GskBorderNode *self1 = (GskBorderNode *) node1;
+  GskBorderNode *self2 = (GskBorderNode *) node2;
+
+  if (memcmp (&self1->outline, &self2->outline, sizeof (GskRoundedRect)) == 0 &&
+      memcmp (self1->border_width, self2->border_width, sizeof (self1->border_width)) == 0 &&
+      memcmp (self1->border_color, self2->border_color, sizeof (self1->border_color)) == 0)
+    return;
 
-  return g_variant_new (GSK_BORDER_NODE_VARIANT_TYPE,
-                        (double) self->outline.bounds.origin.x, (double) self->outline.bounds.origin.y,
-                        (double) self->outline.bounds.size.width, (double) self->outline.bounds.size.height,
-                        (double) self->outline.corner[0].width, (double) self->outline.corner[0].height,
-                        (double) self->outline.corner[1].width, (double) self->outline.corner[1].height,
-                        (double) self->outline.corner[2].width, (double) self->outline.corner[2].height,
-                        (double) self->outline.corner[3].width, (double) self->outline.corner[3].height,
-                        (double) self->border_width[0], (double) self->border_width[1],
-                        (double) self->border_width[2], (double) self->border_width[3],
-                        self->border_color[0].red, self->border_color[0].green,
-                        self->border_color[0].blue, self->border_color[0].alpha,
-                        self->border_color[1].red, self->border_color[1].green,
-                        self->border_color[1].blue, self->border_color[1].alpha,
-                        self->border_color[2].red, self->border_color[2].green,
-                        self->border_color[2].blue, self->border_color[2].alpha,
-                        self->border_color[3].red, self->border_color[3].green,
-                        self->border_color[3].blue, self->border_color[3].alpha);
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_BORDER_NODE_VARIANT_TYPE "(dddddddddddddddddddddddddddddddd)"
+
 static GskRenderNode *
 gsk_border_node_deserialize (GVariant  *variant,
                              GError   **error)
@@ -590,7 +645,7 @@ static const GskRenderNodeClass GSK_BORDER_NODE_CLASS = {
   "GskBorderNode",
   gsk_border_node_finalize,
   gsk_border_node_draw,
-  gsk_border_node_serialize,
+  gsk_border_node_diff,
   gsk_border_node_deserialize
 };
 
@@ -681,7 +736,11 @@ gsk_texture_node_draw (GskRenderNode *node,
   GskTextureNode *self = (GskTextureNode *) node;
   cairo_surface_t *surface;
 
-  surface = gsk_texture_download_surface (self->texture);
+  surface = gsk_render_node_get_thread_source (node);
+  if (surface)
+    cairo_surface_reference (surface);
+  else
+    surface = gsk_texture_download_surface (self->texture);
 
   cairo_save (cr);
 
@@ -698,35 +757,23 @@ gsk_texture_node_draw (GskRenderNode *node,
   cairo_surface_destroy (surface);
 }
 
-#define GSK_TEXTURE_NODE_VARIANT_TYPE "(dddduuau)"
-
-static GVariant *
-gsk_texture_node_serialize (GskRenderNode *node)
+static void
+gsk_texture_node_diff (GskRenderNode  *node1,
+                       GskRenderNode  *node2,
+                       cairo_region_t *region)
 {
-  GskTextureNode *self = (GskTextureNode *) node;
-  cairo_surface_t *surface;
-  GVariant *result;
+  GskTextureNode *self1 = (GskTextureNode *) node1;
+  GskTextureNode *self2 = (GskTextureNode *) node2;
 
-  surface = gsk_texture_download_surface (self->texture);
-
-  g_assert (cairo_image_surface_get_width (surface) * 4 == cairo_image_surface_get_stride (surface));
-
-  result = g_variant_new ("(dddduu@au)",
-                          (double) node->bounds.origin.x, (double) node->bounds.origin.y,
-                          (double) node->bounds.size.width, (double) node->bounds.size.height,
-                          (guint32) gsk_texture_get_width (self->texture),
-                          (guint32) gsk_texture_get_height (self->texture),
-                          g_variant_new_fixed_array (G_VARIANT_TYPE ("u"),
-                                                     cairo_image_surface_get_data (surface),
-                                                     gsk_texture_get_width (self->texture)
-                                                     * gsk_texture_get_height (self->texture),
-                                                     sizeof (guint32)));
-
-  cairo_surface_destroy (surface);
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      self1->texture == self2->texture)
+    return;
 
-  return result;
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_TEXTURE_NODE_VARIANT_TYPE "(dddduuau)"
+
 static GskRenderNode *
 gsk_texture_node_deserialize (GVariant  *variant,
                               GError   **error)
@@ -763,7 +810,7 @@ static const GskRenderNodeClass GSK_TEXTURE_NODE_CLASS = {
   "GskTextureNode",
   gsk_texture_node_finalize,
   gsk_texture_node_draw,
-  gsk_texture_node_serialize,
+  gsk_texture_node_diff,
   gsk_texture_node_deserialize
 };
 
@@ -1210,26 +1257,27 @@ gsk_inset_shadow_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
-#define GSK_INSET_SHADOW_NODE_VARIANT_TYPE "(dddddddddddddddddddd)"
-
-static GVariant *
-gsk_inset_shadow_node_serialize (GskRenderNode *node)
-{
-  GskInsetShadowNode *self = (GskInsetShadowNode *) node;
+static void
+gsk_inset_shadow_node_diff (GskRenderNode  *node1,
+                            GskRenderNode  *node2,
+                            cairo_region_t *region)
+{
+  GskInsetShadowNode *self1 = (GskInsetShadowNode *) node1;
+  GskInsetShadowNode *self2 = (GskInsetShadowNode *) node2;
+
+  if (memcmp (&self1->outline, &self2->outline, sizeof (GskRoundedRect)) == 0 &&
+      gdk_rgba_equal (&self1->color, &self2->color) &&
+      self1->dx == self2->dx &&
+      self1->dy == self2->dy &&
+      self1->spread == self2->spread &&
+      self1->blur_radius == self2->blur_radius)
+    return;
 
-  return g_variant_new (GSK_INSET_SHADOW_NODE_VARIANT_TYPE,
-                        (double) self->outline.bounds.origin.x, (double) self->outline.bounds.origin.y,
-                        (double) self->outline.bounds.size.width, (double) self->outline.bounds.size.height,
-                        (double) self->outline.corner[0].width, (double) self->outline.corner[0].height,
-                        (double) self->outline.corner[1].width, (double) self->outline.corner[1].height,
-                        (double) self->outline.corner[2].width, (double) self->outline.corner[2].height,
-                        (double) self->outline.corner[3].width, (double) self->outline.corner[3].height,
-                        self->color.red, self->color.green,
-                        self->color.blue, self->color.alpha,
-                        (double) self->dx, (double) self->dy,
-                        (double) self->spread, (double) self->blur_radius);
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_INSET_SHADOW_NODE_VARIANT_TYPE "(dddddddddddddddddddd)"
+
 static GskRenderNode *
 gsk_inset_shadow_node_deserialize (GVariant  *variant,
                                    GError   **error)
@@ -1265,7 +1313,7 @@ static const GskRenderNodeClass GSK_INSET_SHADOW_NODE_CLASS = {
   "GskInsetShadowNode",
   gsk_inset_shadow_node_finalize,
   gsk_inset_shadow_node_draw,
-  gsk_inset_shadow_node_serialize,
+  gsk_inset_shadow_node_diff,
   gsk_inset_shadow_node_deserialize
 };
 
@@ -1513,26 +1561,27 @@ gsk_outset_shadow_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
-#define GSK_OUTSET_SHADOW_NODE_VARIANT_TYPE "(dddddddddddddddddddd)"
-
-static GVariant *
-gsk_outset_shadow_node_serialize (GskRenderNode *node)
-{
-  GskOutsetShadowNode *self = (GskOutsetShadowNode *) node;
+static void
+gsk_outset_shadow_node_diff (GskRenderNode  *node1,
+                             GskRenderNode  *node2,
+                             cairo_region_t *region)
+{
+  GskOutsetShadowNode *self1 = (GskOutsetShadowNode *) node1;
+  GskOutsetShadowNode *self2 = (GskOutsetShadowNode *) node2;
+
+  if (memcmp (&self1->outline, &self2->outline, sizeof (GskRoundedRect)) == 0 &&
+      gdk_rgba_equal (&self1->color, &self2->color) &&
+      self1->dx == self2->dx &&
+      self1->dy == self2->dy &&
+      self1->spread == self2->spread &&
+      self1->blur_radius == self2->blur_radius)
+    return;
 
-  return g_variant_new (GSK_OUTSET_SHADOW_NODE_VARIANT_TYPE,
-                        (double) self->outline.bounds.origin.x, (double) self->outline.bounds.origin.y,
-                        (double) self->outline.bounds.size.width, (double) self->outline.bounds.size.height,
-                        (double) self->outline.corner[0].width, (double) self->outline.corner[0].height,
-                        (double) self->outline.corner[1].width, (double) self->outline.corner[1].height,
-                        (double) self->outline.corner[2].width, (double) self->outline.corner[2].height,
-                        (double) self->outline.corner[3].width, (double) self->outline.corner[3].height,
-                        self->color.red, self->color.green,
-                        self->color.blue, self->color.alpha,
-                        (double) self->dx, (double) self->dy,
-                        (double) self->spread, (double) self->blur_radius);
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_OUTSET_SHADOW_NODE_VARIANT_TYPE "(dddddddddddddddddddd)"
+
 static GskRenderNode *
 gsk_outset_shadow_node_deserialize (GVariant  *variant,
                                     GError   **error)
@@ -1568,7 +1617,7 @@ static const GskRenderNodeClass GSK_OUTSET_SHADOW_NODE_CLASS = {
   "GskOutsetShadowNode",
   gsk_outset_shadow_node_finalize,
   gsk_outset_shadow_node_draw,
-  gsk_outset_shadow_node_serialize,
+  gsk_outset_shadow_node_diff,
   gsk_outset_shadow_node_deserialize
 };
 
@@ -1708,50 +1757,36 @@ gsk_cairo_node_draw (GskRenderNode *node,
                      cairo_t       *cr)
 {
   GskCairoNode *self = (GskCairoNode *) node;
+  cairo_surface_t *surface;
 
   if (self->surface == NULL)
     return;
 
-  cairo_set_source_surface (cr, self->surface, node->bounds.origin.x, node->bounds.origin.y);
+  surface = gsk_render_node_get_thread_source (node);
+  if (surface == NULL)
+    surface = self->surface;
+
+  cairo_set_source_surface (cr, surface, node->bounds.origin.x, node->bounds.origin.y);
   cairo_paint (cr);
 }
 
-#define GSK_CAIRO_NODE_VARIANT_TYPE "(dddduuau)"
-
-static GVariant *
-gsk_cairo_node_serialize (GskRenderNode *node)
+static void
+gsk_cairo_node_diff (GskRenderNode  *node1,
+                     GskRenderNode  *node2,
+                     cairo_region_t *region)
 {
-  GskCairoNode *self = (GskCairoNode *) node;
+  GskCairoNode *self1 = (GskCairoNode *) node1;
+  GskCairoNode *self2 = (GskCairoNode *) node2;
 
-  if (self->surface == NULL)
-    {
-      return g_variant_new ("(dddduu@au)",
-                            (double) node->bounds.origin.x, (double) node->bounds.origin.y,
-                            (double) node->bounds.size.width, (double) node->bounds.size.height,
-                            (guint32) 0, (guint32) 0,
-                            g_variant_new_array (G_VARIANT_TYPE ("u"), NULL, 0));
-    }
-  else if (cairo_image_surface_get_width (self->surface) * 4 == cairo_image_surface_get_stride (self->surface))
-    {
-      return g_variant_new ("(dddduu@au)",
-                            (double) node->bounds.origin.x, (double) node->bounds.origin.y,
-                            (double) node->bounds.size.width, (double) node->bounds.size.height,
-                            (guint32) cairo_image_surface_get_width (self->surface),
-                            (guint32) cairo_image_surface_get_height (self->surface),
-                            g_variant_new_fixed_array (G_VARIANT_TYPE ("u"),
-                                                       cairo_image_surface_get_data (self->surface),
-                                                       cairo_image_surface_get_width (self->surface)
-                                                       * cairo_image_surface_get_height (self->surface),
-                                                       sizeof (guint32)));
-    }
-  else
-    {
-      /* FIXME: implement! */
-      g_assert_not_reached ();
-      return NULL;
-    }
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      self1->surface == self2->surface)
+    return;
+
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_CAIRO_NODE_VARIANT_TYPE "(dddduuau)"
+
 const cairo_user_data_key_t gsk_surface_variant_key;
 
 static GskRenderNode *
@@ -1801,7 +1836,7 @@ static const GskRenderNodeClass GSK_CAIRO_NODE_CLASS = {
   "GskCairoNode",
   gsk_cairo_node_finalize,
   gsk_cairo_node_draw,
-  gsk_cairo_node_serialize,
+  gsk_cairo_node_diff,
   gsk_cairo_node_deserialize
 };
 
@@ -1976,14 +2011,68 @@ gsk_container_node_draw (GskRenderNode *node,
                          cairo_t       *cr)
 {
   GskContainerNode *container = (GskContainerNode *) node;
+  graphene_rect_t clip;
+  double x1, y1, x2, y2;
   guint i;
 
+  /* Skip the children outside of the area being redrawn */
+  cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+  graphene_rect_init (&clip, x1, y1, x2 - x1, y2 - y1);
+
   for (i = 0; i < container->n_children; i++)
     {
+      graphene_rect_t unused;
+
+      if (!graphene_rect_intersection (&container->children[i]->bounds, &clip, &unused))
+        continue;
+
       gsk_render_node_draw (container->children[i], cr);
     }
 }
 
+static void
+gsk_container_node_diff (GskRenderNode  *node1,
+                         GskRenderNode  *node2,
+                         cairo_region_t *region)
+{
+  GskContainerNode *self1 = (GskContainerNode *) node1;
+  GskContainerNode *self2 = (GskContainerNode *) node2;
+  guint i, start, end1, end2;
+
+  /* Skip the children both containers share at the start and the end,
+   * these are usually nodes reused from a cache.
+   */
+  start = 0;
+  while (start < self1->n_children && start < self2->n_children &&
+         self1->children[start] == self2->children[start])
+    start++;
+
+  end1 = self1->n_children;
+  end2 = self2->n_children;
+  while (end1 > start && end2 > start &&
+         self1->children[end1 - 1] == self2->children[end2 - 1])
+    {
+      end1--;
+      end2--;
+    }
+
+  if (end1 == end2)
+    {
+      /* The common case: the same children in the same order, with some
+       * of them having changed.
+       */
+      for (i = start; i < end1; i++)
+        gsk_render_node_diff (self1->children[i], self2->children[i], region);
+    }
+  else
+    {
+      for (i = start; i < end1; i++)
+        gsk_render_node_add_bounds_to_region (self1->children[i], region);
+      for (i = start; i < end2; i++)
+        gsk_render_node_add_bounds_to_region (self2->children[i], region);
+    }
+}
+
 static void
 gsk_container_node_get_bounds (GskContainerNode *container,
                                graphene_rect_t *bounds)
@@ -2003,25 +2092,6 @@ gsk_container_node_get_bounds (GskContainerNode *container,
 
 #define GSK_CONTAINER_NODE_VARIANT_TYPE "a(uv)"
 
-static GVariant *
-gsk_container_node_serialize (GskRenderNode *node)
-{
-  GskContainerNode *self = (GskContainerNode *) node;
-  GVariantBuilder builder;
-  guint i;
-
-  g_variant_builder_init (&builder, G_VARIANT_TYPE (GSK_CONTAINER_NODE_VARIANT_TYPE));
-  
-  for (i = 0; i < self->n_children; i++)
-    {
-      g_variant_builder_add (&builder, "(uv)",
-                             (guint32) gsk_render_node_get_node_type (self->children[i]),
-                             gsk_render_node_serialize_node (self->children[i]));
-    }
-
-  return g_variant_builder_end (&builder);
-}
-
 static GskRenderNode *
 gsk_container_node_deserialize (GVariant  *variant,
                                 GError   **error)
@@ -2067,7 +2137,7 @@ static const GskRenderNodeClass GSK_CONTAINER_NODE_CLASS = {
   "GskContainerNode",
   gsk_container_node_finalize,
   gsk_container_node_draw,
-  gsk_container_node_serialize,
+  gsk_container_node_diff,
   gsk_container_node_deserialize
 };
 
@@ -2190,25 +2260,53 @@ gsk_transform_node_draw (GskRenderNode *node,
     }
 }
 
-#define GSK_TRANSFORM_NODE_VARIANT_TYPE "(dddddddddddddddduv)"
+static void
+gsk_transform_node_diff (GskRenderNode  *node1,
+                         GskRenderNode  *node2,
+                         cairo_region_t *region)
+{
+  GskTransformNode *self1 = (GskTransformNode *) node1;
+  GskTransformNode *self2 = (GskTransformNode *) node2;
+  cairo_region_t *sub;
+  float m[16];
+  guint i;
 
-static GVariant *
-gsk_transform_node_serialize (GskRenderNode *node)
-{
-  GskTransformNode *self = (GskTransformNode *) node;
-  float mat[16];
+  if (!matrix_equal (&self1->transform, &self2->transform))
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
 
-  graphene_matrix_to_float (&self->transform, mat);
+  if (self1->child == self2->child)
+    return;
 
-  return g_variant_new (GSK_TRANSFORM_NODE_VARIANT_TYPE,
-                        (double) mat[0], (double) mat[1], (double) mat[2], (double) mat[3],
-                        (double) mat[4], (double) mat[5], (double) mat[6], (double) mat[7],
-                        (double) mat[8], (double) mat[9], (double) mat[10], (double) mat[11],
-                        (double) mat[12], (double) mat[13], (double) mat[14], (double) mat[15],
-                        (guint32) gsk_render_node_get_node_type (self->child),
-                        gsk_render_node_serialize_node (self->child));
+  /* We can only map the difference of the children if the transform is
+   * a translation by whole pixels, which is what GtkSnapshot generates
+   * for cached widget nodes.
+   */
+  graphene_matrix_to_float (&self1->transform, m);
+  for (i = 0; i < 12; i++)
+    {
+      if (m[i] != (i % 5 == 0 ? 1.f : 0.f))
+        break;
+    }
+
+  if (i < 12 || m[14] != 0.f || m[15] != 1.f ||
+      m[12] != floorf (m[12]) || m[13] != floorf (m[13]))
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
+
+  sub = cairo_region_create ();
+  gsk_render_node_diff (self1->child, self2->child, sub);
+  cairo_region_translate (sub, m[12], m[13]);
+  cairo_region_union (region, sub);
+  cairo_region_destroy (sub);
 }
 
+#define GSK_TRANSFORM_NODE_VARIANT_TYPE "(dddddddddddddddduv)"
+
 static GskRenderNode *
 gsk_transform_node_deserialize (GVariant  *variant,
                                 GError   **error)
@@ -2256,7 +2354,7 @@ static const GskRenderNodeClass GSK_TRANSFORM_NODE_CLASS = {
   "GskTransformNode",
   gsk_transform_node_finalize,
   gsk_transform_node_draw,
-  gsk_transform_node_serialize,
+  gsk_transform_node_diff,
   gsk_transform_node_deserialize
 };
 
@@ -2364,19 +2462,22 @@ gsk_opacity_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
-#define GSK_OPACITY_NODE_VARIANT_TYPE "(duv)"
-
-static GVariant *
-gsk_opacity_node_serialize (GskRenderNode *node)
+static void
+gsk_opacity_node_diff (GskRenderNode  *node1,
+                       GskRenderNode  *node2,
+                       cairo_region_t *region)
 {
-  GskOpacityNode *self = (GskOpacityNode *) node;
+  GskOpacityNode *self1 = (GskOpacityNode *) node1;
+  GskOpacityNode *self2 = (GskOpacityNode *) node2;
 
-  return g_variant_new (GSK_OPACITY_NODE_VARIANT_TYPE,
-                        (double) self->opacity,
-                        (guint32) gsk_render_node_get_node_type (self->child),
-                        gsk_render_node_serialize_node (self->child));
+  if (self1->opacity == self2->opacity)
+    gsk_render_node_diff (self1->child, self2->child, region);
+  else
+    gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_OPACITY_NODE_VARIANT_TYPE "(duv)"
+
 static GskRenderNode *
 gsk_opacity_node_deserialize (GVariant  *variant,
                               GError   **error)
@@ -2412,7 +2513,7 @@ static const GskRenderNodeClass GSK_OPACITY_NODE_CLASS = {
   "GskOpacityNode",
   gsk_opacity_node_finalize,
   gsk_opacity_node_draw,
-  gsk_opacity_node_serialize,
+  gsk_opacity_node_diff,
   gsk_opacity_node_deserialize
 };
 
@@ -2578,27 +2679,23 @@ gsk_color_matrix_node_draw (GskRenderNode *node,
   cairo_pattern_destroy (pattern);
 }
 
-#define GSK_COLOR_MATRIX_NODE_VARIANT_TYPE "(dddddddddddddddddddduv)"
-
-static GVariant *
-gsk_color_matrix_node_serialize (GskRenderNode *node)
+static void
+gsk_color_matrix_node_diff (GskRenderNode  *node1,
+                            GskRenderNode  *node2,
+                            cairo_region_t *region)
 {
-  GskColorMatrixNode *self = (GskColorMatrixNode *) node;
-  float mat[16], vec[4];
-
-  graphene_matrix_to_float (&self->color_matrix, mat);
-  graphene_vec4_to_float (&self->color_offset, vec);
+  GskColorMatrixNode *self1 = (GskColorMatrixNode *) node1;
+  GskColorMatrixNode *self2 = (GskColorMatrixNode *) node2;
 
-  return g_variant_new (GSK_COLOR_MATRIX_NODE_VARIANT_TYPE,
-                        (double) mat[0], (double) mat[1], (double) mat[2], (double) mat[3],
-                        (double) mat[4], (double) mat[5], (double) mat[6], (double) mat[7],
-                        (double) mat[8], (double) mat[9], (double) mat[10], (double) mat[11],
-                        (double) mat[12], (double) mat[13], (double) mat[14], (double) mat[15],
-                        (double) vec[0], (double) vec[1], (double) vec[2], (double) vec[3],
-                        (guint32) gsk_render_node_get_node_type (self->child),
-                        gsk_render_node_serialize_node (self->child));
+  if (matrix_equal (&self1->color_matrix, &self2->color_matrix) &&
+      graphene_vec4_equal (&self1->color_offset, &self2->color_offset))
+    gsk_render_node_diff (self1->child, self2->child, region);
+  else
+    gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_COLOR_MATRIX_NODE_VARIANT_TYPE "(dddddddddddddddddddduv)"
+
 static GskRenderNode *
 gsk_color_matrix_node_deserialize (GVariant  *variant,
                                    GError   **error)
@@ -2649,7 +2746,7 @@ static const GskRenderNodeClass GSK_COLOR_MATRIX_NODE_CLASS = {
   "GskColorMatrixNode",
   gsk_color_matrix_node_finalize,
   gsk_color_matrix_node_draw,
-  gsk_color_matrix_node_serialize,
+  gsk_color_matrix_node_diff,
   gsk_color_matrix_node_deserialize
 };
 
@@ -2785,22 +2882,24 @@ gsk_repeat_node_draw (GskRenderNode *node,
   cairo_surface_destroy (surface);
 }
 
-#define GSK_REPEAT_NODE_VARIANT_TYPE "(dddddddduv)"
-
-static GVariant *
-gsk_repeat_node_serialize (GskRenderNode *node)
+static void
+gsk_repeat_node_diff (GskRenderNode  *node1,
+                      GskRenderNode  *node2,
+                      cairo_region_t *region)
 {
-  GskRepeatNode *self = (GskRepeatNode *) node;
+  GskRepeatNode *self1 = (GskRepeatNode *) node1;
+  GskRepeatNode *self2 = (GskRepeatNode *) node2;
+
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      graphene_rect_equal (&self1->child_bounds, &self2->child_bounds) &&
+      children_equal (self1->child, self2->child))
+    return;
 
-  return g_variant_new (GSK_REPEAT_NODE_VARIANT_TYPE,
-                        (double) node->bounds.origin.x, (double) node->bounds.origin.y,
-                        (double) node->bounds.size.width, (double) node->bounds.size.height,
-                        (double) self->child_bounds.origin.x, (double) self->child_bounds.origin.y,
-                        (double) self->child_bounds.size.width, (double) self->child_bounds.size.height,
-                        (guint32) gsk_render_node_get_node_type (self->child),
-                        gsk_render_node_serialize_node (self->child));
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_REPEAT_NODE_VARIANT_TYPE "(dddddddduv)"
+
 static GskRenderNode *
 gsk_repeat_node_deserialize (GVariant  *variant,
                              GError   **error)
@@ -2839,7 +2938,7 @@ static const GskRenderNodeClass GSK_REPEAT_NODE_CLASS = {
   "GskRepeatNode",
   gsk_repeat_node_finalize,
   gsk_repeat_node_draw,
-  gsk_repeat_node_serialize,
+  gsk_repeat_node_diff,
   gsk_repeat_node_deserialize
 };
 
@@ -2937,20 +3036,22 @@ gsk_clip_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
-#define GSK_CLIP_NODE_VARIANT_TYPE "(dddduv)"
-
-static GVariant *
-gsk_clip_node_serialize (GskRenderNode *node)
+static void
+gsk_clip_node_diff (GskRenderNode  *node1,
+                    GskRenderNode  *node2,
+                    cairo_region_t *region)
 {
-  GskClipNode *self = (GskClipNode *) node;
+  GskClipNode *self1 = (GskClipNode *) node1;
+  GskClipNode *self2 = (GskClipNode *) node2;
 
-  return g_variant_new (GSK_CLIP_NODE_VARIANT_TYPE,
-                        (double) node->bounds.origin.x, (double) node->bounds.origin.y,
-                        (double) node->bounds.size.width, (double) node->bounds.size.height,
-                        (guint32) gsk_render_node_get_node_type (self->child),
-                        gsk_render_node_serialize_node (self->child));
+  if (graphene_rect_equal (&self1->clip, &self2->clip))
+    diff_children_clipped (self1->child, self2->child, &self1->clip, region);
+  else
+    gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_CLIP_NODE_VARIANT_TYPE "(dddduv)"
+
 static GskRenderNode *
 gsk_clip_node_deserialize (GVariant  *variant,
                            GError   **error)
@@ -2986,7 +3087,7 @@ static const GskRenderNodeClass GSK_CLIP_NODE_CLASS = {
   "GskClipNode",
   gsk_clip_node_finalize,
   gsk_clip_node_draw,
-  gsk_clip_node_serialize,
+  gsk_clip_node_diff,
   gsk_clip_node_deserialize
 };
 
@@ -3085,24 +3186,22 @@ gsk_rounded_clip_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
-#define GSK_ROUNDED_CLIP_NODE_VARIANT_TYPE "(dddddddddddduv)"
-
-static GVariant *
-gsk_rounded_clip_node_serialize (GskRenderNode *node)
+static void
+gsk_rounded_clip_node_diff (GskRenderNode  *node1,
+                            GskRenderNode  *node2,
+                            cairo_region_t *region)
 {
-  GskRoundedClipNode *self = (GskRoundedClipNode *) node;
+  GskRoundedClipNode *self1 = (GskRoundedClipNode *) node1;
+  GskRoundedClipNode *self2 = (GskRoundedClipNode *) node2;
 
-  return g_variant_new (GSK_ROUNDED_CLIP_NODE_VARIANT_TYPE,
-                        (double) self->clip.bounds.origin.x, (double) self->clip.bounds.origin.y,
-                        (double) self->clip.bounds.size.width, (double) self->clip.bounds.size.height,
-                        (double) self->clip.corner[0].width, (double) self->clip.corner[0].height,
-                        (double) self->clip.corner[1].width, (double) self->clip.corner[1].height,
-                        (double) self->clip.corner[2].width, (double) self->clip.corner[2].height,
-                        (double) self->clip.corner[3].width, (double) self->clip.corner[3].height,
-                        (guint32) gsk_render_node_get_node_type (self->child),
-                        gsk_render_node_serialize_node (self->child));
+  if (memcmp (&self1->clip, &self2->clip, sizeof (GskRoundedRect)) == 0)
+    diff_children_clipped (self1->child, self2->child, &self1->clip.bounds, region);
+  else
+    gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_ROUNDED_CLIP_NODE_VARIANT_TYPE "(dddddddddddduv)"
+
 static GskRenderNode *
 gsk_rounded_clip_node_deserialize (GVariant  *variant,
                                    GError   **error)
@@ -3149,7 +3248,7 @@ static const GskRenderNodeClass GSK_ROUNDED_CLIP_NODE_CLASS = {
   "GskRoundedClipNode",
   gsk_rounded_clip_node_finalize,
   gsk_rounded_clip_node_draw,
-  gsk_rounded_clip_node_serialize,
+  gsk_rounded_clip_node_diff,
   gsk_rounded_clip_node_deserialize
 };
 
@@ -3271,6 +3370,22 @@ gsk_shadow_node_draw (GskRenderNode *node,
   cairo_pattern_destroy (pattern);
 }
 
+static void
+gsk_shadow_node_diff (GskRenderNode  *node1,
+                      GskRenderNode  *node2,
+                      cairo_region_t *region)
+{
+  GskShadowNode *self1 = (GskShadowNode *) node1;
+  GskShadowNode *self2 = (GskShadowNode *) node2;
+
+  if (self1->n_shadows == self2->n_shadows &&
+      memcmp (self1->shadows, self2->shadows, sizeof (GskShadow) * self1->n_shadows) == 0 &&
+      children_equal (self1->child, self2->child))
+    return;
+
+  gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 static void
 gsk_shadow_node_get_bounds (GskShadowNode *self,
                             graphene_rect_t *bounds)
@@ -3297,29 +3412,6 @@ gsk_shadow_node_get_bounds (GskShadowNode *self,
 
 #define GSK_SHADOW_NODE_VARIANT_TYPE "(uva(ddddddd))"
 
-static GVariant *
-gsk_shadow_node_serialize (GskRenderNode *node)
-{
-  GskShadowNode *self = (GskShadowNode *) node;
-  GVariantBuilder builder;
-  gsize i;
-
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ddddddd)"));
-  for (i = 0; i < self->n_shadows; i++)
-    {
-      g_variant_builder_add  (&builder, "(ddddddd)",
-                              self->shadows[i].color.red, self->shadows[i].color.green,
-                              self->shadows[i].color.blue, self->shadows[i].color.alpha,
-                              self->shadows[i].dx, self->shadows[i].dy,
-                              self->shadows[i].radius);
-    }
-
-  return g_variant_new (GSK_SHADOW_NODE_VARIANT_TYPE,
-                        (guint32) gsk_render_node_get_node_type (self->child),
-                        gsk_render_node_serialize_node (self->child),
-                        &builder);
-}
-
 static GskRenderNode *
 gsk_shadow_node_deserialize (GVariant  *variant,
                              GError   **error)
@@ -3374,7 +3466,7 @@ static const GskRenderNodeClass GSK_SHADOW_NODE_CLASS = {
   "GskShadowNode",
   gsk_shadow_node_finalize,
   gsk_shadow_node_draw,
-  gsk_shadow_node_serialize,
+  gsk_shadow_node_diff,
   gsk_shadow_node_deserialize
 };
 
@@ -3529,21 +3621,27 @@ gsk_blend_node_draw (GskRenderNode *node,
   cairo_paint (cr);
 }
 
-#define GSK_BLEND_NODE_VARIANT_TYPE "(uvuvu)"
-
-static GVariant *
-gsk_blend_node_serialize (GskRenderNode *node)
+static void
+gsk_blend_node_diff (GskRenderNode  *node1,
+                     GskRenderNode  *node2,
+                     cairo_region_t *region)
 {
-  GskBlendNode *self = (GskBlendNode *) node;
+  GskBlendNode *self1 = (GskBlendNode *) node1;
+  GskBlendNode *self2 = (GskBlendNode *) node2;
 
-  return g_variant_new (GSK_BLEND_NODE_VARIANT_TYPE,
-                        (guint32) gsk_render_node_get_node_type (self->bottom),
-                        gsk_render_node_serialize_node (self->bottom),
-                        (guint32) gsk_render_node_get_node_type (self->top),
-                        gsk_render_node_serialize_node (self->top),
-                        (guint32) self->blend_mode);
+  if (self1->blend_mode == self2->blend_mode)
+    {
+      gsk_render_node_diff (self1->bottom, self2->bottom, region);
+      gsk_render_node_diff (self1->top, self2->top, region);
+    }
+  else
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+    }
 }
 
+#define GSK_BLEND_NODE_VARIANT_TYPE "(uvuvu)"
+
 static GskRenderNode *
 gsk_blend_node_deserialize (GVariant  *variant,
                             GError   **error)
@@ -3590,7 +3688,7 @@ static const GskRenderNodeClass GSK_BLEND_NODE_CLASS = {
   "GskBlendNode",
   gsk_blend_node_finalize,
   gsk_blend_node_draw,
-  gsk_blend_node_serialize,
+  gsk_blend_node_diff,
   gsk_blend_node_deserialize
 };
 
@@ -3700,21 +3798,27 @@ gsk_cross_fade_node_draw (GskRenderNode *node,
   cairo_paint (cr);
 }
 
-#define GSK_CROSS_FADE_NODE_VARIANT_TYPE "(uvuvd)"
-
-static GVariant *
-gsk_cross_fade_node_serialize (GskRenderNode *node)
+static void
+gsk_cross_fade_node_diff (GskRenderNode  *node1,
+                          GskRenderNode  *node2,
+                          cairo_region_t *region)
 {
-  GskCrossFadeNode *self = (GskCrossFadeNode *) node;
+  GskCrossFadeNode *self1 = (GskCrossFadeNode *) node1;
+  GskCrossFadeNode *self2 = (GskCrossFadeNode *) node2;
 
-  return g_variant_new (GSK_CROSS_FADE_NODE_VARIANT_TYPE,
-                        (guint32) gsk_render_node_get_node_type (self->start),
-                        gsk_render_node_serialize_node (self->start),
-                        (guint32) gsk_render_node_get_node_type (self->end),
-                        gsk_render_node_serialize_node (self->end),
-                        (double) self->progress);
+  if (self1->progress == self2->progress)
+    {
+      gsk_render_node_diff (self1->start, self2->start, region);
+      gsk_render_node_diff (self1->end, self2->end, region);
+    }
+  else
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+    }
 }
 
+#define GSK_CROSS_FADE_NODE_VARIANT_TYPE "(uvuvd)"
+
 static GskRenderNode *
 gsk_cross_fade_node_deserialize (GVariant  *variant,
                                  GError   **error)
@@ -3762,7 +3866,7 @@ static const GskRenderNodeClass GSK_CROSS_FADE_NODE_CLASS = {
   "GskCrossFadeNode",
   gsk_cross_fade_node_finalize,
   gsk_cross_fade_node_draw,
-  gsk_cross_fade_node_serialize,
+  gsk_cross_fade_node_diff,
   gsk_cross_fade_node_deserialize
 };
 
@@ -3916,49 +4020,29 @@ gsk_text_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
-#define GSK_TEXT_NODE_VARIANT_TYPE "(sdddddda(uiiii))"
-
-static GVariant *
-gsk_text_node_serialize (GskRenderNode *node)
-{
-  GskTextNode *self = (GskTextNode *) node;
-  GVariant *v;
-  GVariantBuilder builder;
-  int i;
-  PangoFontDescription *desc;
-  char *s;
-
-  desc = pango_font_describe (self->font);
-  s = pango_font_description_to_string (desc);
-
-  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(uiiii)"));
-  for (i = 0; i < self->glyphs->num_glyphs; i++)
-    {
-      PangoGlyphInfo *glyph = &self->glyphs->glyphs[i];
-      g_variant_builder_add (&builder, "(uiiii)",
-                             glyph->glyph,
-                             glyph->geometry.width,
-                             glyph->geometry.x_offset,
-                             glyph->geometry.y_offset,
-                             glyph->attr.is_cluster_start);
-    }
-
-  v = g_variant_new (GSK_TEXT_NODE_VARIANT_TYPE,
-                     s,
-                     self->color.red,
-                     self->color.green,
-                     self->color.blue,
-                     self->color.alpha,
-                     self->x,
-                     self->y,
-                     &builder);
-
-  g_free (s);
-  pango_font_description_free (desc);
+static void
+gsk_text_node_diff (GskRenderNode  *node1,
+                    GskRenderNode  *node2,
+                    cairo_region_t *region)
+{
+  GskTextNode *self1 = (GskTextNode *) node1;
+  GskTextNode *self2 = (GskTextNode *) node2;
+
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      self1->font == self2->font &&
+      gdk_rgba_equal (&self1->color, &self2->color) &&
+      self1->x == self2->x &&
+      self1->y == self2->y &&
+      self1->glyphs->num_glyphs == self2->glyphs->num_glyphs &&
+      memcmp (self1->glyphs->glyphs, self2->glyphs->glyphs,
+              sizeof (PangoGlyphInfo) * self1->glyphs->num_glyphs) == 0)
+    return;
 
-  return v;
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_TEXT_NODE_VARIANT_TYPE "(sdddddda(uiiii))"
+
 static GskRenderNode *
 gsk_text_node_deserialize (GVariant  *variant,
                            GError   **error)
@@ -4019,7 +4103,7 @@ static const GskRenderNodeClass GSK_TEXT_NODE_CLASS = {
   "GskTextNode",
   gsk_text_node_finalize,
   gsk_text_node_draw,
-  gsk_text_node_serialize,
+  gsk_text_node_diff,
   gsk_text_node_deserialize
 };
 
@@ -4317,19 +4401,23 @@ gsk_blur_node_draw (GskRenderNode *node,
   cairo_pattern_destroy (pattern);
 }
 
-#define GSK_BLUR_NODE_VARIANT_TYPE "(duv)"
-
-static GVariant *
-gsk_blur_node_serialize (GskRenderNode *node)
+static void
+gsk_blur_node_diff (GskRenderNode  *node1,
+                    GskRenderNode  *node2,
+                    cairo_region_t *region)
 {
-  GskBlurNode *self = (GskBlurNode *) node;
+  GskBlurNode *self1 = (GskBlurNode *) node1;
+  GskBlurNode *self2 = (GskBlurNode *) node2;
+
+  if (self1->radius == self2->radius &&
+      children_equal (self1->child, self2->child))
+    return;
 
-  return g_variant_new (GSK_BLUR_NODE_VARIANT_TYPE,
-                        (double) self->radius,
-                        (guint32) gsk_render_node_get_node_type (self->child),
-                        gsk_render_node_serialize (self->child));
+  gsk_render_node_diff_impossible (node1, node2, region);
 }
 
+#define GSK_BLUR_NODE_VARIANT_TYPE "(duv)"
+
 static GskRenderNode *
 gsk_blur_node_deserialize (GVariant  *variant,
                            GError   **error)
@@ -4361,7 +4449,7 @@ static const GskRenderNodeClass GSK_BLUR_NODE_CLASS = {
   "GskBlurNode",
   gsk_blur_node_finalize,
   gsk_blur_node_draw,
-  gsk_blur_node_serialize,
+  gsk_blur_node_diff,
   gsk_blur_node_deserialize
 };
 
@@ -4460,9 +4548,3 @@ gsk_render_node_deserialize_node (GskRenderNodeType   type,
   return result;
 }
 
-GVariant *
-gsk_render_node_serialize_node (GskRenderNode *node)
-{
-  return node->node_class->serialize (node);
-}
-
@@ -10,12 +10,17 @@ typedef struct _GskRenderNodeClass GskRenderNodeClass;
 
 #define GSK_IS_RENDER_NODE_TYPE(node,type) (GSK_IS_RENDER_NODE (node) && (node)->node_class->node_type == (type))
 
+#define GSK_N_RENDER_NODE_TYPES (GSK_BLUR_NODE + 1)
+
 struct _GskRenderNode
 {
   const GskRenderNodeClass *node_class;
 
   volatile int ref_count;
 
+  /* The arena chunk the node was allocated from, if any */
+  gpointer arena_chunk;
+
   /* Use for debugging */
   char *name;
 
@@ -34,14 +39,47 @@ struct _GskRenderNodeClass
   void (* finalize) (GskRenderNode *node);
   void (* draw) (GskRenderNode *node,
                  cairo_t       *cr);
-  GVariant * (* serialize) (GskRenderNode *node);
+  void (* diff) (GskRenderNode  *node1,
+                 GskRenderNode  *node2,
+                 cairo_region_t *region);
   GskRenderNode * (* deserialize) (GVariant  *variant,
                                    GError   **error);
 };
 
 GskRenderNode *gsk_render_node_new (const GskRenderNodeClass *node_class, gsize extra_size);
 
-GVariant * gsk_render_node_serialize_node (GskRenderNode *node);
+typedef struct _GskRenderNodeArena GskRenderNodeArena;
+
+GskRenderNodeArena * gsk_render_node_arena_new (void);
+void gsk_render_node_arena_free (GskRenderNodeArena *arena);
+void gsk_render_node_arena_push (GskRenderNodeArena *arena);
+void gsk_render_node_arena_pop (GskRenderNodeArena *arena);
+GskRenderNodeArena * gsk_render_node_arena_suspend (void);
+void gsk_render_node_arena_resume (GskRenderNodeArena *arena);
+gpointer gsk_render_node_arena_alloc (gsize size, gpointer *chunk_out);
+void gsk_render_node_arena_release (gpointer arena_chunk);
+
+void gsk_render_node_diff (GskRenderNode *node1, GskRenderNode *node2, cairo_region_t *region);
+void gsk_render_node_diff_impossible (GskRenderNode *node1, GskRenderNode *node2, cairo_region_t *region);
+void gsk_render_node_add_bounds_to_region (GskRenderNode *node, cairo_region_t *region);
+
+void gsk_render_node_set_draw_times (gint64 *draw_times);
+
+typedef struct _GskRenderNodeSources GskRenderNodeSources;
+
+struct _GskRenderNodeSources
+{
+  /* Image surfaces with the contents of Cairo and texture nodes, shared
+   * by all threads drawing a tree and never drawn to
+   */
+  GHashTable *snapshots;
+  /* The surfaces wrapping them that one thread draws with */
+  GHashTable *surfaces;
+};
+
+void gsk_render_node_set_thread_sources (GskRenderNodeSources *sources);
+cairo_surface_t * gsk_render_node_get_thread_source (GskRenderNode *node);
+
 GskRenderNode * gsk_render_node_deserialize_node (GskRenderNodeType type, GVariant *variant, GError **error);
 
 double gsk_opacity_node_get_opacity (GskRenderNode *node);
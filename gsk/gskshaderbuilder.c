@@ -4,9 +4,24 @@
 
 #include "gskdebugprivate.h"
 
-#include <gdk/gdk.h>
+#include "gdk/gdk-private.h"
 #include <epoxy/gl.h>
 
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* Linked programs are stored in $XDG_CACHE_HOME/gtk-4.0/gl-programs,
+ * named after a checksum of the GL implementation followed by one of
+ * the shader sources. A cache file is a ProgramBinaryHeader followed
+ * by the data returned by glGetProgramBinary().
+ */
+#define PROGRAM_BINARY_MAGIC    0x42505347 /* "GSPB" */
+
+typedef struct {
+  guint32 magic;
+  guint32 format;
+} ProgramBinaryHeader;
+
 typedef struct {
   int program_id;
 
@@ -24,6 +39,12 @@ struct _GskShaderBuilder
 
   int version;
 
+  /* Whether glGetProgramBinary() is usable, or -1 if unknown */
+  int has_program_binary;
+  /* The start of the names of the program binaries of this driver */
+  char *cache_prefix;
+  gboolean cache_pruned;
+
   GPtrArray *defines;
   GPtrArray *uniforms;
   GPtrArray *attributes;
@@ -67,6 +88,7 @@ gsk_shader_builder_finalize (GObject *gobject)
   g_free (self->resource_base_path);
   g_free (self->vertex_preamble);
   g_free (self->fragment_preamble);
+  g_free (self->cache_prefix);
 
   g_clear_pointer (&self->defines, g_ptr_array_unref);
   g_clear_pointer (&self->uniforms, g_ptr_array_unref);
@@ -86,6 +108,8 @@ gsk_shader_builder_class_init (GskShaderBuilderClass *klass)
 static void
 gsk_shader_builder_init (GskShaderBuilder *self)
 {
+  self->has_program_binary = -1;
+
   self->defines = g_ptr_array_new_with_free_func (g_free);
   self->uniforms = g_ptr_array_new_with_free_func (g_free);
   self->attributes = g_ptr_array_new_with_free_func (g_free);
@@ -204,17 +228,13 @@ lookup_shader_code (GString *code,
   return TRUE;
 }
 
-static int
-gsk_shader_builder_compile_shader (GskShaderBuilder *builder,
-                                   int               shader_type,
-                                   const char       *shader_preamble,
-                                   const char       *shader_source,
-                                   GError          **error)
+static char *
+gsk_shader_builder_build_source (GskShaderBuilder *builder,
+                                 const char       *shader_preamble,
+                                 const char       *shader_source,
+                                 GError          **error)
 {
   GString *code;
-  char *source;
-  int shader_id;
-  int status;
   int i;
 
   code = g_string_new (NULL);
@@ -244,7 +264,7 @@ gsk_shader_builder_compile_shader (GskShaderBuilder *builder,
   if (!lookup_shader_code (code, builder->resource_base_path, shader_preamble, error))
     {
       g_string_free (code, TRUE);
-      return -1;
+      return NULL;
     }
 
   g_string_append_c (code, '\n');
@@ -252,10 +272,22 @@ gsk_shader_builder_compile_shader (GskShaderBuilder *builder,
   if (!lookup_shader_code (code, builder->resource_base_path, shader_source, error))
     {
       g_string_free (code, TRUE);
-      return -1;
+      return NULL;
     }
 
-  source = g_string_free (code, FALSE);
+  return g_string_free (code, FALSE);
+}
+
+static int
+gsk_shader_builder_compile_shader (GskShaderBuilder *builder,
+                                   int               shader_type,
+                                   const char       *shader_preamble,
+                                   const char       *shader_name,
+                                   const char       *source,
+                                   GError          **error)
+{
+  int shader_id;
+  int status;
 
   shader_id = glCreateShader (shader_type);
   glShaderSource (shader_id, 1, (const GLchar **) &source, NULL);
@@ -267,13 +299,11 @@ gsk_shader_builder_compile_shader (GskShaderBuilder *builder,
       g_print ("*** Compiling %s shader from '%s' + '%s' ***\n"
                "%s\n",
                shader_type == GL_VERTEX_SHADER ? "vertex" : "fragment",
-               shader_preamble, shader_source,
+               shader_preamble, shader_name,
                source);
     }
 #endif
 
-  g_free (source);
-
   glGetShaderiv (shader_id, GL_COMPILE_STATUS, &status);
   if (status == GL_FALSE)
     {
@@ -333,6 +363,186 @@ gsk_shader_builder_cache_attributes (GskShaderBuilder *builder,
     }
 }
 
+static gboolean
+gsk_shader_builder_has_program_binary (GskShaderBuilder *builder)
+{
+  if (builder->has_program_binary < 0)
+    {
+      int n_formats = 0;
+
+      if (epoxy_is_desktop_gl ())
+        builder->has_program_binary = epoxy_gl_version () >= 41 ||
+                                      epoxy_has_gl_extension ("GL_ARB_get_program_binary");
+      else
+        builder->has_program_binary = epoxy_gl_version () >= 30;
+
+      /* Some drivers support the API, but no formats */
+      if (builder->has_program_binary)
+        glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+
+      builder->has_program_binary = n_formats > 0;
+    }
+
+  return builder->has_program_binary;
+}
+
+static void
+checksum_add_string (GChecksum  *checksum,
+                     const char *string)
+{
+  if (string == NULL)
+    string = "";
+
+  /* Include the terminator, so that concatenations don't collide */
+  g_checksum_update (checksum, (const guchar *) string, strlen (string) + 1);
+}
+
+/* Program binaries are only valid for the driver that created them,
+ * so their names start with a checksum of the driver. That also tells
+ * which files were written for other drivers, see
+ * gsk_shader_builder_save_program_binary().
+ */
+static const char *
+gsk_shader_builder_get_cache_prefix (GskShaderBuilder *builder)
+{
+  GChecksum *checksum;
+  char *version;
+
+  if (builder->cache_prefix != NULL)
+    return builder->cache_prefix;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+  checksum_add_string (checksum, (const char *) glGetString (GL_VENDOR));
+  checksum_add_string (checksum, (const char *) glGetString (GL_RENDERER));
+  checksum_add_string (checksum, (const char *) glGetString (GL_VERSION));
+
+  version = g_strdup_printf ("%d.%d.%d", GTK_MAJOR_VERSION, GTK_MINOR_VERSION, GTK_MICRO_VERSION);
+  checksum_add_string (checksum, version);
+  g_free (version);
+
+  builder->cache_prefix = g_strconcat (g_checksum_get_string (checksum), "-", NULL);
+
+  g_checksum_free (checksum);
+
+  return builder->cache_prefix;
+}
+
+static char *
+gsk_shader_builder_get_cache_path (GskShaderBuilder *builder,
+                                   const char       *vertex_source,
+                                   const char       *fragment_source)
+{
+  GChecksum *checksum;
+  char *name;
+  char *path;
+  int i;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+  checksum_add_string (checksum, vertex_source);
+  checksum_add_string (checksum, fragment_source);
+
+  /* and the attribute locations get linked in */
+  for (i = 0; i < builder->attributes->len; i++)
+    checksum_add_string (checksum, g_ptr_array_index (builder->attributes, i));
+
+  name = g_strconcat (gsk_shader_builder_get_cache_prefix (builder),
+                      g_checksum_get_string (checksum),
+                      NULL);
+  path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "gl-programs", name, NULL);
+
+  g_checksum_free (checksum);
+  g_free (name);
+
+  return path;
+}
+
+static int
+gsk_shader_builder_load_program_binary (GskShaderBuilder *builder,
+                                        const char       *path)
+{
+  ProgramBinaryHeader header;
+  char *data;
+  gsize length;
+  int program_id;
+  int status;
+
+  if (!g_file_get_contents (path, &data, &length, NULL))
+    return -1;
+
+  if (length <= sizeof (header))
+    goto invalid;
+
+  memcpy (&header, data, sizeof (header));
+  if (header.magic != PROGRAM_BINARY_MAGIC)
+    goto invalid;
+
+  program_id = glCreateProgram ();
+  glProgramBinary (program_id, header.format, data + sizeof (header), length - sizeof (header));
+
+  /* The driver rejects binaries from other versions of itself */
+  glGetProgramiv (program_id, GL_LINK_STATUS, &status);
+  if (status == GL_FALSE)
+    {
+      glDeleteProgram (program_id);
+      goto invalid;
+    }
+
+  g_free (data);
+
+  return program_id;
+
+invalid:
+  GSK_NOTE (SHADERS, g_print ("Discarding invalid program binary '%s'\n", path));
+
+  g_unlink (path);
+  g_free (data);
+
+  return -1;
+}
+
+static void
+gsk_shader_builder_save_program_binary (GskShaderBuilder *builder,
+                                        int               program_id,
+                                        const char       *path)
+{
+  ProgramBinaryHeader header;
+  GLenum format;
+  guchar *data;
+  char *dir;
+  int length = 0;
+
+  glGetProgramiv (program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  data = g_malloc (sizeof (header) + length);
+  glGetProgramBinary (program_id, length, &length, &format, data + sizeof (header));
+
+  header.magic = PROGRAM_BINARY_MAGIC;
+  header.format = format;
+  memcpy (data, &header, sizeof (header));
+
+  /* g_file_set_contents() renames the file into place, so other
+   * processes never see a partial binary
+   */
+  dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0755) == 0 &&
+      g_file_set_contents (path, (const char *) data, sizeof (header) + length, NULL) &&
+      !builder->cache_pruned)
+    {
+      /* Programs are mostly compiled after the driver or GTK+ changed,
+       * which leaves the binaries for the previous ones behind
+       */
+      gdk_disk_cache_prune (dir, gsk_shader_builder_get_cache_prefix (builder));
+      builder->cache_pruned = TRUE;
+    }
+
+  g_free (dir);
+  g_free (data);
+}
+
 int
 gsk_shader_builder_create_program (GskShaderBuilder *builder,
                                    const char       *vertex_shader,
@@ -340,34 +550,77 @@ gsk_shader_builder_create_program (GskShaderBuilder *builder,
                                    GError          **error)
 {
   ShaderProgram *program;
-  int vertex_id, fragment_id;
-  int program_id;
+  char *vertex_source, *fragment_source;
+  char *cache_path = NULL;
+  int vertex_id = -1, fragment_id = -1;
+  int program_id = -1;
   int status;
+  int i;
 
   g_return_val_if_fail (GSK_IS_SHADER_BUILDER (builder), -1);
   g_return_val_if_fail (vertex_shader != NULL, -1);
   g_return_val_if_fail (fragment_shader != NULL, -1);
 
+  vertex_source = gsk_shader_builder_build_source (builder,
+                                                   builder->vertex_preamble,
+                                                   vertex_shader,
+                                                   error);
+  if (vertex_source == NULL)
+    return -1;
+
+  fragment_source = gsk_shader_builder_build_source (builder,
+                                                     builder->fragment_preamble,
+                                                     fragment_shader,
+                                                     error);
+  if (fragment_source == NULL)
+    {
+      g_free (vertex_source);
+      return -1;
+    }
+
+  if (gdk_disk_cache_enabled (GDK_DISK_CACHE_SHADERS) &&
+      gsk_shader_builder_has_program_binary (builder))
+    {
+      cache_path = gsk_shader_builder_get_cache_path (builder, vertex_source, fragment_source);
+
+      program_id = gsk_shader_builder_load_program_binary (builder, cache_path);
+      if (program_id > 0)
+        {
+          GSK_NOTE (SHADERS, g_print ("*** Loaded program '%s' + '%s' from '%s' ***\n",
+                                      vertex_shader, fragment_shader, cache_path));
+          goto linked;
+        }
+    }
+
   vertex_id = gsk_shader_builder_compile_shader (builder, GL_VERTEX_SHADER,
                                                  builder->vertex_preamble,
                                                  vertex_shader,
+                                                 vertex_source,
                                                  error);
   if (vertex_id < 0)
-    return -1;
+    goto out;
 
   fragment_id = gsk_shader_builder_compile_shader (builder, GL_FRAGMENT_SHADER,
                                                    builder->fragment_preamble,
                                                    fragment_shader,
+                                                   fragment_source,
                                                    error);
   if (fragment_id < 0)
-    {
-      glDeleteShader (vertex_id);
-      return -1;
-    }
+    goto out;
 
   program_id = glCreateProgram ();
   glAttachShader (program_id, vertex_id);
   glAttachShader (program_id, fragment_id);
+
+  /* Give every attribute the same location in all programs, in the order
+   * they were added, so that programs can share vertex arrays.
+   */
+  for (i = 0; i < builder->attributes->len; i++)
+    glBindAttribLocation (program_id, i, g_ptr_array_index (builder->attributes, i));
+
+  if (cache_path != NULL)
+    glProgramParameteri (program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
   glLinkProgram (program_id);
 
   glGetProgramiv (program_id, GL_LINK_STATUS, &status);
@@ -385,12 +638,21 @@ gsk_shader_builder_create_program (GskShaderBuilder *builder,
                    "Linking failure in shader:\n%s", buffer);
       g_free (buffer);
 
+      glDetachShader (program_id, vertex_id);
+      glDetachShader (program_id, fragment_id);
       glDeleteProgram (program_id);
       program_id = -1;
 
       goto out;
     }
 
+  glDetachShader (program_id, vertex_id);
+  glDetachShader (program_id, fragment_id);
+
+  if (cache_path != NULL)
+    gsk_shader_builder_save_program_binary (builder, program_id, cache_path);
+
+linked:
   program = shader_program_new (program_id);
   gsk_shader_builder_cache_uniforms (builder, program);
   gsk_shader_builder_cache_attributes (builder, program);
@@ -423,16 +685,14 @@ gsk_shader_builder_create_program (GskShaderBuilder *builder,
 
 out:
   if (vertex_id > 0)
-    {
-      glDetachShader (program_id, vertex_id);
-      glDeleteShader (vertex_id);
-    }
+    glDeleteShader (vertex_id);
 
   if (fragment_id > 0)
-    {
-      glDetachShader (program_id, fragment_id);
-      glDeleteShader (fragment_id);
-    }
+    glDeleteShader (fragment_id);
+
+  g_free (cache_path);
+  g_free (fragment_source);
+  g_free (vertex_source);
 
   return program_id;
 }
@@ -43,15 +43,16 @@ gsk_vulkan_buffer_new_internal (GdkVulkanContext  *context,
                                  self->vk_buffer,
                                  &requirements);
 
+  /* Vertex, staging and download buffers only live for a frame */
   self->memory = gsk_vulkan_memory_new (context,
-                                        requirements.memoryTypeBits,
+                                        &requirements,
                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                        size);
+                                        GSK_VULKAN_MEMORY_TRANSIENT);
 
   GSK_VK_CHECK (vkBindBufferMemory, gdk_vulkan_context_get_device (context),
                                     self->vk_buffer,
                                     gsk_vulkan_memory_get_device_memory (self->memory),
-                                    0);
+                                    gsk_vulkan_memory_get_offset (self->memory));
   return self;
 }
 
@@ -80,12 +81,12 @@ gsk_vulkan_buffer_new_download (GdkVulkanContext  *context,
 void
 gsk_vulkan_buffer_free (GskVulkanBuffer *self)
 {
-  gsk_vulkan_memory_free (self->memory);
-
   vkDestroyBuffer (gdk_vulkan_context_get_device (self->vulkan),
                    self->vk_buffer,
                    NULL);
 
+  gsk_vulkan_memory_free (self->memory);
+
   g_object_unref (self->vulkan);
 
   g_slice_free (GskVulkanBuffer, self);
@@ -20,6 +20,112 @@ gsk_vulkan_clip_init_copy (GskVulkanClip *self,
   gsk_rounded_rect_init_copy (&self->rect, &src->rect);
 }
 
+static void
+gsk_vulkan_clip_init_rounded (GskVulkanClip        *self,
+                              const GskRoundedRect *rounded)
+{
+  if (gsk_rounded_rect_is_rectilinear (rounded))
+    self->type = GSK_VULKAN_CLIP_RECT;
+  else if (gsk_rounded_rect_is_circular (rounded))
+    self->type = GSK_VULKAN_CLIP_ROUNDED_CIRCULAR;
+  else
+    self->type = GSK_VULKAN_CLIP_ROUNDED;
+
+  gsk_rounded_rect_init_copy (&self->rect, rounded);
+}
+
+static void
+rect_get_corner (const graphene_rect_t *rect,
+                 GskCorner              corner,
+                 graphene_point_t      *point)
+{
+  point->x = rect->origin.x;
+  point->y = rect->origin.y;
+
+  if (corner == GSK_CORNER_TOP_RIGHT || corner == GSK_CORNER_BOTTOM_RIGHT)
+    point->x += rect->size.width;
+  if (corner == GSK_CORNER_BOTTOM_RIGHT || corner == GSK_CORNER_BOTTOM_LEFT)
+    point->y += rect->size.height;
+}
+
+/* Computes the intersection of two rounded rectangles, if it is a
+ * rounded rectangle itself. That is the case if no corner of one
+ * of them cuts into the straight edges of the other, which covers
+ * the common case of nested widgets with rounded borders.
+ */
+static gboolean
+rounded_rect_intersection (const GskRoundedRect *a,
+                           const GskRoundedRect *b,
+                           GskRoundedRect       *result)
+{
+  graphene_rect_t bounds;
+  graphene_size_t corners[4];
+  guint i;
+
+  if (!graphene_rect_intersection (&a->bounds, &b->bounds, &bounds))
+    return FALSE;
+
+  for (i = 0; i < 4; i++)
+    {
+      graphene_point_t p, pa, pb;
+      gboolean at_a, at_b;
+
+      rect_get_corner (&bounds, i, &p);
+      rect_get_corner (&a->bounds, i, &pa);
+      rect_get_corner (&b->bounds, i, &pb);
+      at_a = graphene_point_equal (&p, &pa);
+      at_b = graphene_point_equal (&p, &pb);
+
+      if (at_a && at_b)
+        {
+          /* The larger corner cuts away everything the smaller one does */
+          if (a->corner[i].width >= b->corner[i].width &&
+              a->corner[i].height >= b->corner[i].height)
+            corners[i] = a->corner[i];
+          else if (b->corner[i].width >= a->corner[i].width &&
+                   b->corner[i].height >= a->corner[i].height)
+            corners[i] = b->corner[i];
+          else
+            return FALSE;
+        }
+      else if (at_a)
+        {
+          if (!gsk_rounded_rect_contains_point (b, &p))
+            return FALSE;
+          corners[i] = a->corner[i];
+        }
+      else if (at_b)
+        {
+          if (!gsk_rounded_rect_contains_point (a, &p))
+            return FALSE;
+          corners[i] = b->corner[i];
+        }
+      else
+        {
+          if (!gsk_rounded_rect_contains_point (a, &p) ||
+              !gsk_rounded_rect_contains_point (b, &p))
+            return FALSE;
+          graphene_size_init (&corners[i], 0, 0);
+        }
+    }
+
+  /* Corners that overlap each other don't make a rounded rectangle */
+  if (corners[GSK_CORNER_TOP_LEFT].width + corners[GSK_CORNER_TOP_RIGHT].width > bounds.size.width ||
+      corners[GSK_CORNER_BOTTOM_LEFT].width + corners[GSK_CORNER_BOTTOM_RIGHT].width > bounds.size.width ||
+      corners[GSK_CORNER_TOP_LEFT].height + corners[GSK_CORNER_BOTTOM_LEFT].height > bounds.size.height ||
+      corners[GSK_CORNER_TOP_RIGHT].height + corners[GSK_CORNER_BOTTOM_RIGHT].height > bounds.size.height)
+    return FALSE;
+
+  gsk_rounded_rect_init (result,
+                         &bounds,
+                         &corners[GSK_CORNER_TOP_LEFT],
+                         &corners[GSK_CORNER_TOP_RIGHT],
+                         &corners[GSK_CORNER_BOTTOM_RIGHT],
+                         &corners[GSK_CORNER_BOTTOM_LEFT]);
+
+  return TRUE;
+}
+
 gboolean
 gsk_vulkan_clip_intersect_rect (GskVulkanClip         *dest,
                                 const GskVulkanClip   *src,
@@ -65,12 +171,15 @@ gsk_vulkan_clip_intersect_rect (GskVulkanClip         *dest,
         }
       else
         {
+          GskRoundedRect rounded, result;
+
           /* some points of rect are inside src's rounded rect,
            * some are outside. */
-          /* XXX: If the 2 rects don't intersect on rounded corners,
-           * we could actually compute a new clip here.
-           */
-          return FALSE;
+          gsk_rounded_rect_init_from_rect (&rounded, rect, 0);
+          if (!rounded_rect_intersection (&src->rect, &rounded, &result))
+            return FALSE;
+
+          gsk_vulkan_clip_init_rounded (dest, &result);
         }
     }
 
@@ -100,28 +209,29 @@ gsk_vulkan_clip_intersect_rounded_rect (GskVulkanClip        *dest,
       break;
 
     case GSK_VULKAN_CLIP_NONE:
-      dest->type = gsk_rounded_rect_is_circular (&dest->rect) ? GSK_VULKAN_CLIP_ROUNDED_CIRCULAR : GSK_VULKAN_CLIP_ROUNDED;
-      gsk_rounded_rect_init_copy (&dest->rect, rounded);
+      gsk_vulkan_clip_init_rounded (dest, rounded);
       break;
 
     case GSK_VULKAN_CLIP_RECT:
-      if (graphene_rect_contains_rect (&src->rect.bounds, &rounded->bounds))
+    case GSK_VULKAN_CLIP_ROUNDED_CIRCULAR:
+    case GSK_VULKAN_CLIP_ROUNDED:
+      if (gsk_rounded_rect_contains_rect (&src->rect, &rounded->bounds))
         {
-          dest->type = gsk_rounded_rect_is_circular (&dest->rect) ? GSK_VULKAN_CLIP_ROUNDED_CIRCULAR : GSK_VULKAN_CLIP_ROUNDED;
-          gsk_rounded_rect_init_copy (&dest->rect, rounded);
-          return TRUE;
+          gsk_vulkan_clip_init_rounded (dest, rounded);
         }
-      /* some points of rect are inside src's rounded rect,
-       * some are outside. */
-      /* XXX: If the 2 rects don't intersect on rounded corners,
-       * we could actually compute a new clip here.
-       */
-      return FALSE;
+      else
+        {
+          GskRoundedRect result;
 
-    case GSK_VULKAN_CLIP_ROUNDED_CIRCULAR:
-    case GSK_VULKAN_CLIP_ROUNDED:
-      /* XXX: improve */
-      return FALSE;
+          /* Clips that can't be expressed as a single rounded rect,
+           * like overlapping rounded corners, still need a fallback
+           */
+          if (!rounded_rect_intersection (&src->rect, rounded, &result))
+            return FALSE;
+
+          gsk_vulkan_clip_init_rounded (dest, &result);
+        }
+      break;
     }
 
   return TRUE;
@@ -150,8 +260,35 @@ gsk_vulkan_clip_transform (GskVulkanClip           *dest,
     case GSK_VULKAN_CLIP_RECT:
     case GSK_VULKAN_CLIP_ROUNDED_CIRCULAR:
     case GSK_VULKAN_CLIP_ROUNDED:
-      /* FIXME: Handle 2D operations, in particular transform and scale */
-      return FALSE;
+      {
+        double xx, yx, xy, yy, dx, dy;
+        GskRoundedRect rounded;
+        guint i;
+
+        /* FIXME: Handle rotations, which need a mask */
+        if (!graphene_matrix_is_2d (transform))
+          return FALSE;
+
+        graphene_matrix_to_2d (transform, &xx, &yx, &xy, &yy, &dx, &dy);
+        if (yx != 0 || xy != 0 || xx <= 0 || yy <= 0)
+          return FALSE;
+
+        /* The clip is in the coordinates of the parent, so it gets
+         * the inverse transform
+         */
+        graphene_rect_init (&rounded.bounds,
+                            (src->rect.bounds.origin.x - dx) / xx,
+                            (src->rect.bounds.origin.y - dy) / yy,
+                            src->rect.bounds.size.width / xx,
+                            src->rect.bounds.size.height / yy);
+        for (i = 0; i < 4; i++)
+          graphene_size_init (&rounded.corner[i],
+                              src->rect.corner[i].width / xx,
+                              src->rect.corner[i].height / yy);
+
+        gsk_vulkan_clip_init_rounded (dest, &rounded);
+      }
+      return TRUE;
     }
 }
 
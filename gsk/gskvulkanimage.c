@@ -247,14 +247,15 @@ gsk_vulkan_image_new (GdkVulkanContext      *context,
                                 &requirements);
 
   self->memory = gsk_vulkan_memory_new (context,
-                                        requirements.memoryTypeBits,
+                                        &requirements,
                                         memory,
-                                        requirements.size);
+                                        tiling == VK_IMAGE_TILING_OPTIMAL ? GSK_VULKAN_MEMORY_OPTIMAL
+                                                                          : GSK_VULKAN_MEMORY_LINEAR);
 
   GSK_VK_CHECK (vkBindImageMemory, gdk_vulkan_context_get_device (context),
                                    self->vk_image,
                                    gsk_vulkan_memory_get_device_memory (self->memory),
-                                   0);
+                                   gsk_vulkan_memory_get_offset (self->memory));
   return self;
 }
 
@@ -757,11 +758,11 @@ gsk_vulkan_image_finalize (GObject *object)
    * the VkImage */
   if (self->memory)
     {
-      gsk_vulkan_memory_free (self->memory);
-
       vkDestroyImage (gdk_vulkan_context_get_device (self->vulkan),
                       self->vk_image,
                       NULL);
+
+      gsk_vulkan_memory_free (self->memory);
     }
 
   g_object_unref (self->vulkan);
@@ -3,52 +3,405 @@
 #include "gskvulkanpipelineprivate.h"
 #include "gskvulkanmemoryprivate.h"
 
-struct _GskVulkanMemory
-{
-  GdkVulkanContext *vulkan;
+#include <string.h>
+
+/* Buffers and images are sub-allocated from large blocks of device
+ * memory, as drivers limit the number of allocations and allocating
+ * is slow. There is a pool of blocks for every memory type and usage.
+ *
+ * Blocks for long-lived resources keep a list of free ranges and
+ * allocate first fit. Transient blocks just bump an offset, which is
+ * reset once everything allocated from them has been freed, usually
+ * at the end of a frame.
+ *
+ * Host-visible blocks stay mapped for as long as they exist, as a
+ * VkDeviceMemory can only be mapped once.
+ */
+
+#define BLOCK_SIZE              (16 * 1024 * 1024)
+
+/* Larger allocations get device memory of their own */
+#define MAX_SUBALLOCATION_SIZE  (BLOCK_SIZE / 4)
 
-  gsize size;
+#define ALIGN(value, alignment) (((value) + (alignment) - 1) / (alignment) * (alignment))
+
+typedef struct _GskVulkanAllocator GskVulkanAllocator;
+typedef struct _GskVulkanMemoryPool GskVulkanMemoryPool;
+typedef struct _GskVulkanMemoryBlock GskVulkanMemoryBlock;
+
+typedef struct {
+  VkDeviceSize offset;
+  VkDeviceSize size;
+} FreeRange;
+
+struct _GskVulkanMemoryBlock
+{
+  GskVulkanMemoryPool *pool;
 
   VkDeviceMemory vk_memory;
+  VkDeviceSize size;
+
+  /* The mapping of host-visible blocks */
+  guchar *data;
+
+  /* Sorted by offset, for blocks that are not transient */
+  GArray *free_ranges;
+  /* The end of the last allocation, for transient blocks */
+  VkDeviceSize used;
+
+  guint n_allocations;
+
+  /* Whether the block holds a single large allocation */
+  gboolean dedicated : 1;
 };
 
-GskVulkanMemory *
-gsk_vulkan_memory_new (GdkVulkanContext      *context,
-                       uint32_t               allowed_types,
-                       VkMemoryPropertyFlags  flags,
-                       gsize                  size)
+struct _GskVulkanMemoryPool
+{
+  GskVulkanAllocator *allocator;
+
+  uint32_t memory_type;
+  GskVulkanMemoryUsage usage;
+
+  GPtrArray *blocks;
+};
+
+struct _GskVulkanAllocator
 {
+  /* Not a reference, the allocator is owned by the context */
+  GdkVulkanContext *vulkan;
+
   VkPhysicalDeviceMemoryProperties properties;
-  GskVulkanMemory *self;
-  uint32_t i;
+  VkDeviceSize non_coherent_atom_size;
 
-  self = g_slice_new0 (GskVulkanMemory);
+  GskVulkanMemoryPool pools[VK_MAX_MEMORY_TYPES][GSK_VULKAN_N_MEMORY_USAGES];
 
-  self->vulkan = g_object_ref (context);
-  self->size = size;
+  guint n_allocations;
+  gsize bytes_allocated;
+  gsize bytes_live;
+};
+
+struct _GskVulkanMemory
+{
+  GdkVulkanContext *vulkan;
+
+  GskVulkanMemoryBlock *block;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+};
+
+static void
+gsk_vulkan_memory_block_free (GskVulkanMemoryBlock *block)
+{
+  GskVulkanAllocator *allocator = block->pool->allocator;
+  VkDevice device = gdk_vulkan_context_get_device (allocator->vulkan);
+
+  if (block->data != NULL)
+    vkUnmapMemory (device, block->vk_memory);
+
+  vkFreeMemory (device, block->vk_memory, NULL);
+
+  allocator->bytes_allocated -= block->size;
+
+  g_clear_pointer (&block->free_ranges, g_array_unref);
+  g_slice_free (GskVulkanMemoryBlock, block);
+}
+
+static void
+gsk_vulkan_allocator_free (gpointer data)
+{
+  GskVulkanAllocator *allocator = data;
+  guint i, j;
+
+  /* All memory holds a reference on the context */
+  g_warn_if_fail (allocator->n_allocations == 0);
+
+  for (i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+    {
+      for (j = 0; j < GSK_VULKAN_N_MEMORY_USAGES; j++)
+        g_clear_pointer (&allocator->pools[i][j].blocks, g_ptr_array_unref);
+    }
+
+  g_slice_free (GskVulkanAllocator, allocator);
+}
+
+static GskVulkanAllocator *
+gsk_vulkan_allocator_get (GdkVulkanContext *context)
+{
+  GskVulkanAllocator *allocator;
+  VkPhysicalDeviceProperties device_properties;
+  guint i, j;
+
+  allocator = g_object_get_data (G_OBJECT (context), "gsk-vulkan-allocator");
+  if (allocator != NULL)
+    return allocator;
+
+  allocator = g_slice_new0 (GskVulkanAllocator);
+  allocator->vulkan = context;
 
   vkGetPhysicalDeviceMemoryProperties (gdk_vulkan_context_get_physical_device (context),
-                                       &properties);
+                                       &allocator->properties);
+  vkGetPhysicalDeviceProperties (gdk_vulkan_context_get_physical_device (context),
+                                 &device_properties);
+  allocator->non_coherent_atom_size = MAX (device_properties.limits.nonCoherentAtomSize, 1);
 
-  for (i = 0; i < properties.memoryTypeCount; i++)
+  for (i = 0; i < VK_MAX_MEMORY_TYPES; i++)
     {
-      if (!(allowed_types & (1 << i)))
-        continue;
+      for (j = 0; j < GSK_VULKAN_N_MEMORY_USAGES; j++)
+        {
+          allocator->pools[i][j].allocator = allocator;
+          allocator->pools[i][j].memory_type = i;
+          allocator->pools[i][j].usage = j;
+        }
+    }
 
-      if ((properties.memoryTypes[i].propertyFlags & flags) == flags)
-        break;
-  }
+  g_object_set_data_full (G_OBJECT (context), "gsk-vulkan-allocator",
+                          allocator, gsk_vulkan_allocator_free);
+
+  return allocator;
+}
+
+static gboolean
+gsk_vulkan_memory_pool_is_coherent (GskVulkanMemoryPool *pool)
+{
+  VkMemoryPropertyFlags flags = pool->allocator->properties.memoryTypes[pool->memory_type].propertyFlags;
+
+  return (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+static GskVulkanMemoryBlock *
+gsk_vulkan_memory_pool_add_block (GskVulkanMemoryPool *pool,
+                                  VkDeviceSize         size,
+                                  gboolean             dedicated)
+{
+  GskVulkanAllocator *allocator = pool->allocator;
+  VkDevice device = gdk_vulkan_context_get_device (allocator->vulkan);
+  GskVulkanMemoryBlock *block;
 
-  g_assert (i < properties.memoryTypeCount);
+  block = g_slice_new0 (GskVulkanMemoryBlock);
+  block->pool = pool;
+  block->size = size;
+  block->dedicated = dedicated;
 
-  GSK_VK_CHECK (vkAllocateMemory, gdk_vulkan_context_get_device (context),
+  GSK_VK_CHECK (vkAllocateMemory, device,
                                   &(VkMemoryAllocateInfo) {
                                       .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
                                       .allocationSize = size,
-                                      .memoryTypeIndex = i
+                                      .memoryTypeIndex = pool->memory_type
                                   },
                                   NULL,
-                                  &self->vk_memory);
+                                  &block->vk_memory);
+
+  if (allocator->properties.memoryTypes[pool->memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+      void *data;
+
+      GSK_VK_CHECK (vkMapMemory, device,
+                                 block->vk_memory,
+                                 0,
+                                 VK_WHOLE_SIZE,
+                                 0,
+                                 &data);
+      block->data = data;
+    }
+
+  if (!dedicated && pool->usage != GSK_VULKAN_MEMORY_TRANSIENT)
+    {
+      FreeRange range = { 0, size };
+
+      block->free_ranges = g_array_new (FALSE, FALSE, sizeof (FreeRange));
+      g_array_append_val (block->free_ranges, range);
+    }
+
+  if (pool->blocks == NULL)
+    pool->blocks = g_ptr_array_new_with_free_func ((GDestroyNotify) gsk_vulkan_memory_block_free);
+  g_ptr_array_add (pool->blocks, block);
+
+  allocator->bytes_allocated += size;
+
+  return block;
+}
+
+static gboolean
+gsk_vulkan_memory_block_alloc (GskVulkanMemoryBlock *block,
+                               VkDeviceSize          size,
+                               VkDeviceSize          alignment,
+                               VkDeviceSize         *offset_out)
+{
+  guint i;
+
+  if (block->dedicated)
+    return FALSE;
+
+  if (block->free_ranges == NULL)
+    {
+      VkDeviceSize offset = ALIGN (block->used, alignment);
+
+      if (offset + size > block->size)
+        return FALSE;
+
+      block->used = offset + size;
+      *offset_out = offset;
+      return TRUE;
+    }
+
+  for (i = 0; i < block->free_ranges->len; i++)
+    {
+      FreeRange *range = &g_array_index (block->free_ranges, FreeRange, i);
+      VkDeviceSize offset = ALIGN (range->offset, alignment);
+      VkDeviceSize end = range->offset + range->size;
+
+      if (offset + size > end)
+        continue;
+
+      if (offset > range->offset)
+        {
+          /* Keep the padding in front free */
+          range->size = offset - range->offset;
+          if (offset + size < end)
+            {
+              FreeRange rest = { offset + size, end - offset - size };
+
+              g_array_insert_val (block->free_ranges, i + 1, rest);
+            }
+        }
+      else if (offset + size < end)
+        {
+          range->offset = offset + size;
+          range->size = end - range->offset;
+        }
+      else
+        {
+          g_array_remove_index (block->free_ranges, i);
+        }
+
+      *offset_out = offset;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+gsk_vulkan_memory_block_release (GskVulkanMemoryBlock *block,
+                                 VkDeviceSize          offset,
+                                 VkDeviceSize          size)
+{
+  FreeRange range = { offset, size };
+  FreeRange *ranges;
+  guint i;
+
+  if (block->free_ranges == NULL)
+    {
+      if (block->n_allocations == 0)
+        block->used = 0;
+      return;
+    }
+
+  for (i = 0; i < block->free_ranges->len; i++)
+    {
+      if (g_array_index (block->free_ranges, FreeRange, i).offset > offset)
+        break;
+    }
+
+  g_array_insert_val (block->free_ranges, i, range);
+  ranges = (FreeRange *) block->free_ranges->data;
+
+  /* Merge with the following range */
+  if (i + 1 < block->free_ranges->len &&
+      ranges[i].offset + ranges[i].size == ranges[i + 1].offset)
+    {
+      ranges[i].size += ranges[i + 1].size;
+      g_array_remove_index (block->free_ranges, i + 1);
+    }
+
+  /* and with the preceding one */
+  if (i > 0 &&
+      ranges[i - 1].offset + ranges[i - 1].size == ranges[i].offset)
+    {
+      ranges[i - 1].size += ranges[i].size;
+      g_array_remove_index (block->free_ranges, i);
+    }
+}
+
+GskVulkanMemory *
+gsk_vulkan_memory_new (GdkVulkanContext           *context,
+                       const VkMemoryRequirements *requirements,
+                       VkMemoryPropertyFlags       flags,
+                       GskVulkanMemoryUsage        usage)
+{
+  GskVulkanAllocator *allocator;
+  GskVulkanMemoryPool *pool;
+  GskVulkanMemoryBlock *block;
+  GskVulkanMemory *self;
+  VkDeviceSize size, alignment, offset;
+  uint32_t i;
+
+  allocator = gsk_vulkan_allocator_get (context);
+
+  for (i = 0; i < allocator->properties.memoryTypeCount; i++)
+    {
+      if (!(requirements->memoryTypeBits & (1 << i)))
+        continue;
+
+      if ((allocator->properties.memoryTypes[i].propertyFlags & flags) == flags)
+        break;
+    }
+
+  g_assert (i < allocator->properties.memoryTypeCount);
+
+  pool = &allocator->pools[i][usage];
+
+  size = requirements->size;
+  alignment = MAX (requirements->alignment, 1);
+
+  /* Flushes of non-coherent memory need to be aligned */
+  if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+      !gsk_vulkan_memory_pool_is_coherent (pool))
+    {
+      alignment = ALIGN (alignment, allocator->non_coherent_atom_size);
+      size = ALIGN (size, allocator->non_coherent_atom_size);
+    }
+
+  self = g_slice_new0 (GskVulkanMemory);
+  self->vulkan = g_object_ref (context);
+  self->size = size;
+
+  block = NULL;
+  offset = 0;
+
+  if (size <= MAX_SUBALLOCATION_SIZE)
+    {
+      guint j;
+
+      for (j = 0; pool->blocks != NULL && j < pool->blocks->len; j++)
+        {
+          GskVulkanMemoryBlock *b = g_ptr_array_index (pool->blocks, j);
+
+          if (gsk_vulkan_memory_block_alloc (b, size, alignment, &offset))
+            {
+              block = b;
+              break;
+            }
+        }
+
+      if (block == NULL)
+        {
+          block = gsk_vulkan_memory_pool_add_block (pool, BLOCK_SIZE, FALSE);
+          if (!gsk_vulkan_memory_block_alloc (block, size, alignment, &offset))
+            g_assert_not_reached ();
+        }
+    }
+  else
+    {
+      block = gsk_vulkan_memory_pool_add_block (pool, size, TRUE);
+    }
+
+  block->n_allocations++;
+  self->block = block;
+  self->offset = offset;
+
+  allocator->n_allocations++;
+  allocator->bytes_live += size;
 
   return self;
 }
@@ -56,9 +409,22 @@ gsk_vulkan_memory_new (GdkVulkanContext      *context,
 void
 gsk_vulkan_memory_free (GskVulkanMemory *self)
 {
-  vkFreeMemory (gdk_vulkan_context_get_device (self->vulkan),
-                self->vk_memory,
-                NULL);
+  GskVulkanMemoryBlock *block = self->block;
+  GskVulkanMemoryPool *pool = block->pool;
+  GskVulkanAllocator *allocator = pool->allocator;
+
+  block->n_allocations--;
+  gsk_vulkan_memory_block_release (block, self->offset, self->size);
+
+  allocator->n_allocations--;
+  allocator->bytes_live -= self->size;
+
+  /* Give empty blocks back to the driver, but keep one around for
+   * each pool, so we don't churn every frame
+   */
+  if (block->n_allocations == 0 &&
+      (block->dedicated || pool->blocks->len > 1))
+    g_ptr_array_remove_fast (pool->blocks, block);
 
   g_object_unref (self->vulkan);
 
@@ -68,28 +434,138 @@ gsk_vulkan_memory_free (GskVulkanMemory *self)
 VkDeviceMemory
 gsk_vulkan_memory_get_device_memory (GskVulkanMemory *self)
 {
-  return self->vk_memory;
+  return self->block->vk_memory;
+}
+
+VkDeviceSize
+gsk_vulkan_memory_get_offset (GskVulkanMemory *self)
+{
+  return self->offset;
 }
 
 guchar *
 gsk_vulkan_memory_map (GskVulkanMemory *self)
 {
-  void *data;
+  g_return_val_if_fail (self->block->data != NULL, NULL);
 
-  GSK_VK_CHECK (vkMapMemory, gdk_vulkan_context_get_device (self->vulkan),
-                             self->vk_memory,
-                             0,
-                             self->size,
-                             0,
-                             &data);
-
-  return data;
+  return self->block->data + self->offset;
 }
 
 void
 gsk_vulkan_memory_unmap (GskVulkanMemory *self)
 {
-  vkUnmapMemory (gdk_vulkan_context_get_device (self->vulkan),
-                 self->vk_memory);
+  GskVulkanMemoryBlock *block = self->block;
+
+  /* The block stays mapped, but writes to non-coherent memory need
+   * to be made visible to the device
+   */
+  if (gsk_vulkan_memory_pool_is_coherent (block->pool))
+    return;
+
+  GSK_VK_CHECK (vkFlushMappedMemoryRanges, gdk_vulkan_context_get_device (self->vulkan),
+                                           1,
+                                           &(VkMappedMemoryRange) {
+                                               .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+                                               .memory = block->vk_memory,
+                                               .offset = self->offset,
+                                               .size = block->dedicated ? VK_WHOLE_SIZE : self->size
+                                           });
+}
+
+/*< private >
+ * gsk_vulkan_memory_trim:
+ * @context: a #GdkVulkanContext
+ *
+ * Frees all blocks of device memory for @context that have no
+ * allocations left in them, including the ones that are normally
+ * kept around for reuse.
+ *
+ * This must be called before the last reference on @context goes
+ * away, as the device is gone by the time the allocator is freed.
+ */
+void
+gsk_vulkan_memory_trim (GdkVulkanContext *context)
+{
+  GskVulkanAllocator *allocator;
+  guint i, j, k;
+
+  allocator = g_object_get_data (G_OBJECT (context), "gsk-vulkan-allocator");
+  if (allocator == NULL)
+    return;
+
+  for (i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+    {
+      for (j = 0; j < GSK_VULKAN_N_MEMORY_USAGES; j++)
+        {
+          GskVulkanMemoryPool *pool = &allocator->pools[i][j];
+
+          if (pool->blocks == NULL)
+            continue;
+
+          for (k = pool->blocks->len; k > 0; k--)
+            {
+              GskVulkanMemoryBlock *block = g_ptr_array_index (pool->blocks, k - 1);
+
+              if (block->n_allocations == 0)
+                g_ptr_array_remove_index_fast (pool->blocks, k - 1);
+            }
+        }
+    }
 }
 
+/*< private >
+ * gsk_vulkan_memory_get_stats:
+ * @context: a #GdkVulkanContext
+ * @stats: (out): return location for the statistics
+ *
+ * Collects statistics about the device memory that buffers and images
+ * for @context have been allocated from.
+ */
+void
+gsk_vulkan_memory_get_stats (GdkVulkanContext     *context,
+                             GskVulkanMemoryStats *stats)
+{
+  GskVulkanAllocator *allocator = gsk_vulkan_allocator_get (context);
+  gsize free_bytes = 0, fragmented_bytes = 0;
+  guint i, j, k, l;
+
+  memset (stats, 0, sizeof (GskVulkanMemoryStats));
+
+  for (i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+    {
+      for (j = 0; j < GSK_VULKAN_N_MEMORY_USAGES; j++)
+        {
+          GskVulkanMemoryPool *pool = &allocator->pools[i][j];
+
+          if (pool->blocks == NULL)
+            continue;
+
+          stats->n_blocks += pool->blocks->len;
+
+          for (k = 0; k < pool->blocks->len; k++)
+            {
+              GskVulkanMemoryBlock *block = g_ptr_array_index (pool->blocks, k);
+              VkDeviceSize largest = 0, total = 0;
+
+              if (block->free_ranges == NULL)
+                continue;
+
+              for (l = 0; l < block->free_ranges->len; l++)
+                {
+                  FreeRange *range = &g_array_index (block->free_ranges, FreeRange, l);
+
+                  total += range->size;
+                  largest = MAX (largest, range->size);
+                }
+
+              free_bytes += total;
+              fragmented_bytes += total - largest;
+            }
+        }
+    }
+
+  stats->n_allocations = allocator->n_allocations;
+  stats->bytes_allocated = allocator->bytes_allocated;
+  stats->bytes_live = allocator->bytes_live;
+  stats->fragmentation = free_bytes > 0 ? fragmented_bytes * 100 / free_bytes : 0;
+}
@@ -7,17 +7,49 @@ G_BEGIN_DECLS
 
 typedef struct _GskVulkanMemory GskVulkanMemory;
 
-GskVulkanMemory *       gsk_vulkan_memory_new                           (GdkVulkanContext       *context,
-                                                                         uint32_t                allowed_types,
-                                                                         VkMemoryPropertyFlags   properties,
-                                                                         gsize                   size);
+typedef enum {
+  /* Buffers and linearly tiled images */
+  GSK_VULKAN_MEMORY_LINEAR,
+  /* Optimally tiled images, which must not share pages with linear
+   * resources, see bufferImageGranularity
+   */
+  GSK_VULKAN_MEMORY_OPTIMAL,
+  /* Linear resources that are freed again by the end of the frame,
+   * like vertex and staging buffers
+   */
+  GSK_VULKAN_MEMORY_TRANSIENT,
+  GSK_VULKAN_N_MEMORY_USAGES
+} GskVulkanMemoryUsage;
+
+typedef struct {
+  guint n_allocations;
+  guint n_blocks;
+  /* Device memory held by the blocks */
+  gsize bytes_allocated;
+  /* Memory handed out to buffers and images */
+  gsize bytes_live;
+  /* The percentage of free memory that is not in the largest free
+   * range of its block
+   */
+  guint fragmentation;
+} GskVulkanMemoryStats;
+
+GskVulkanMemory *       gsk_vulkan_memory_new                           (GdkVulkanContext           *context,
+                                                                         const VkMemoryRequirements *requirements,
+                                                                         VkMemoryPropertyFlags       properties,
+                                                                         GskVulkanMemoryUsage        usage);
 void                    gsk_vulkan_memory_free                          (GskVulkanMemory        *memory);
 
 VkDeviceMemory          gsk_vulkan_memory_get_device_memory             (GskVulkanMemory        *self);
+VkDeviceSize            gsk_vulkan_memory_get_offset                    (GskVulkanMemory        *self);
 
 guchar *                gsk_vulkan_memory_map                           (GskVulkanMemory        *self);
 void                    gsk_vulkan_memory_unmap                         (GskVulkanMemory        *self);
 
+void                    gsk_vulkan_memory_trim                          (GdkVulkanContext       *context);
+void                    gsk_vulkan_memory_get_stats                     (GdkVulkanContext       *context,
+                                                                         GskVulkanMemoryStats   *stats);
+
 G_END_DECLS
 
 #endif /* __GSK_VULKAN_MEMORY_PRIVATE_H__ */
@@ -5,7 +5,11 @@
 #include "gskvulkanpushconstantsprivate.h"
 #include "gskvulkanshaderprivate.h"
 
+#include "gdk/gdk-private.h"
+
 #include <graphene.h>
+#include <glib/gstdio.h>
+#include <string.h>
 
 typedef struct _GskVulkanPipelinePrivate GskVulkanPipelinePrivate;
 
@@ -24,6 +28,190 @@ struct _GskVulkanPipelinePrivate
 
 G_DEFINE_TYPE_WITH_PRIVATE (GskVulkanPipeline, gsk_vulkan_pipeline, G_TYPE_OBJECT)
 
+/* Pipelines are created with a VkPipelineCache per context, which is
+ * loaded from and written back to $XDG_CACHE_HOME/gtk-4.0/vulkan-pipelines
+ * so that drivers don't need to compile the shaders again on the next
+ * start. The file is named after a checksum of the device and driver.
+ */
+typedef struct {
+  VkPipelineCache vk_cache;
+
+  char *path;
+  /* The size of the data the cache was created from */
+  gsize initial_size;
+} PipelineCache;
+
+static void
+pipeline_cache_free (gpointer data)
+{
+  PipelineCache *cache = data;
+
+  g_free (cache->path);
+  g_slice_free (PipelineCache, cache);
+}
+
+static char *
+pipeline_cache_get_path (const VkPhysicalDeviceProperties *properties)
+{
+  GChecksum *checksum;
+  char *key;
+  char *path;
+
+  key = g_strdup_printf ("%08x:%08x:%08x:%d.%d.%d:",
+                         properties->vendorID,
+                         properties->deviceID,
+                         properties->driverVersion,
+                         GTK_MAJOR_VERSION, GTK_MINOR_VERSION, GTK_MICRO_VERSION);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) key, strlen (key));
+  g_checksum_update (checksum, properties->pipelineCacheUUID, VK_UUID_SIZE);
+
+  path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "vulkan-pipelines",
+                           g_checksum_get_string (checksum),
+                           NULL);
+
+  g_checksum_free (checksum);
+  g_free (key);
+
+  return path;
+}
+
+/* The header is always little-endian */
+static gboolean
+pipeline_cache_data_is_valid (const guchar                     *data,
+                              gsize                             length,
+                              const VkPhysicalDeviceProperties *properties)
+{
+  guint32 header[4];
+
+  if (length < sizeof (header) + VK_UUID_SIZE)
+    return FALSE;
+
+  memcpy (header, data, sizeof (header));
+
+  return GUINT32_FROM_LE (header[0]) >= sizeof (header) + VK_UUID_SIZE &&
+         GUINT32_FROM_LE (header[0]) <= length &&
+         GUINT32_FROM_LE (header[1]) == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         GUINT32_FROM_LE (header[2]) == properties->vendorID &&
+         GUINT32_FROM_LE (header[3]) == properties->deviceID &&
+         memcmp (data + sizeof (header), properties->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+static VkPipelineCache
+gsk_vulkan_pipeline_get_cache (GdkVulkanContext *context)
+{
+  VkPhysicalDeviceProperties properties;
+  VkDevice device = gdk_vulkan_context_get_device (context);
+  PipelineCache *cache;
+  char *data = NULL;
+  gsize length = 0;
+
+  cache = g_object_get_data (G_OBJECT (context), "gsk-vulkan-pipeline-cache");
+  if (cache != NULL)
+    return cache->vk_cache;
+
+  cache = g_slice_new0 (PipelineCache);
+
+  if (gdk_disk_cache_enabled (GDK_DISK_CACHE_SHADERS))
+    {
+      vkGetPhysicalDeviceProperties (gdk_vulkan_context_get_physical_device (context), &properties);
+
+      cache->path = pipeline_cache_get_path (&properties);
+
+      if (g_file_get_contents (cache->path, &data, &length, NULL) &&
+          !pipeline_cache_data_is_valid ((const guchar *) data, length, &properties))
+        {
+          GSK_NOTE (VULKAN, g_print ("Discarding invalid pipeline cache '%s'\n", cache->path));
+          g_unlink (cache->path);
+          g_clear_pointer (&data, g_free);
+          length = 0;
+        }
+    }
+
+  if (data != NULL &&
+      vkCreatePipelineCache (device,
+                             &(VkPipelineCacheCreateInfo) {
+                                 .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                                 .initialDataSize = length,
+                                 .pInitialData = data
+                             },
+                             NULL,
+                             &cache->vk_cache) == VK_SUCCESS)
+    {
+      cache->initial_size = length;
+    }
+  else
+    {
+      GSK_VK_CHECK (vkCreatePipelineCache, device,
+                                           &(VkPipelineCacheCreateInfo) {
+                                               .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                                           },
+                                           NULL,
+                                           &cache->vk_cache);
+    }
+
+  g_free (data);
+
+  g_object_set_data_full (G_OBJECT (context), "gsk-vulkan-pipeline-cache",
+                          cache, pipeline_cache_free);
+
+  return cache->vk_cache;
+}
+
+/*< private >
+ * gsk_vulkan_pipeline_free_cache:
+ * @context: a #GdkVulkanContext
+ *
+ * Writes the pipeline cache of @context to disk if new pipelines were
+ * added to it, and frees it. This must be called while the device of
+ * @context is still around.
+ */
+void
+gsk_vulkan_pipeline_free_cache (GdkVulkanContext *context)
+{
+  VkDevice device = gdk_vulkan_context_get_device (context);
+  PipelineCache *cache;
+
+  cache = g_object_get_data (G_OBJECT (context), "gsk-vulkan-pipeline-cache");
+  if (cache == NULL)
+    return;
+
+  if (cache->path != NULL)
+    {
+      size_t size = 0;
+
+      /* The data only grows when the driver compiled something */
+      if (vkGetPipelineCacheData (device, cache->vk_cache, &size, NULL) == VK_SUCCESS &&
+          size > 0 && size != cache->initial_size)
+        {
+          char *data = g_malloc (size);
+          char *dir;
+
+          if (vkGetPipelineCacheData (device, cache->vk_cache, &size, data) == VK_SUCCESS)
+            {
+              dir = g_path_get_dirname (cache->path);
+              if (g_mkdir_with_parents (dir, 0755) == 0 &&
+                  g_file_set_contents (cache->path, data, size, NULL))
+                {
+                  char *name = g_path_get_basename (cache->path);
+
+                  /* Remove the caches of previous drivers */
+                  gdk_disk_cache_prune (dir, name);
+                  g_free (name);
+                }
+              g_free (dir);
+            }
+
+          g_free (data);
+        }
+    }
+
+  vkDestroyPipelineCache (device, cache->vk_cache, NULL);
+
+  g_object_set_data (G_OBJECT (context), "gsk-vulkan-pipeline-cache", NULL);
+}
+
 static void
 gsk_vulkan_pipeline_finalize (GObject *gobject)
 {
@@ -96,7 +284,7 @@ gsk_vulkan_pipeline_new_full (GType                    pipeline_type,
   priv->fragment_shader = gsk_vulkan_shader_new_from_resource (context, GSK_VULKAN_SHADER_FRAGMENT, shader_name, NULL);
 
   GSK_VK_CHECK (vkCreateGraphicsPipelines, device,
-                                           VK_NULL_HANDLE,
+                                           gsk_vulkan_pipeline_get_cache (context),
                                            1,
                                            &(VkGraphicsPipelineCreateInfo) {
                                                .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
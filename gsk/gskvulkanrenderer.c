@@ -9,6 +9,7 @@
 #include "gsktextureprivate.h"
 #include "gskvulkanbufferprivate.h"
 #include "gskvulkanimageprivate.h"
+#include "gskvulkanmemoryprivate.h"
 #include "gskvulkanpipelineprivate.h"
 #include "gskvulkanrenderprivate.h"
 #include "gskvulkanglyphcacheprivate.h"
@@ -28,6 +29,15 @@ typedef struct {
   GQuark cpu_time;
   GQuark gpu_time;
 } ProfileTimers;
+
+typedef struct {
+  GQuark memory_blocks;
+  GQuark memory_allocations;
+  GQuark memory_allocated;
+  GQuark memory_live;
+  GQuark memory_fragmentation;
+  GQuark fallbacks;
+} ProfileCounters;
 #endif
 
 struct _GskVulkanRenderer
@@ -49,6 +59,7 @@ struct _GskVulkanRenderer
 
 #ifdef G_ENABLE_DEBUG
   ProfileTimers profile_timers;
+  ProfileCounters profile_counters;
 #endif
 };
 
@@ -59,6 +70,23 @@ struct _GskVulkanRendererClass
 
 G_DEFINE_TYPE (GskVulkanRenderer, gsk_vulkan_renderer, GSK_TYPE_RENDERER)
 
+#ifdef G_ENABLE_DEBUG
+static void
+gsk_vulkan_renderer_update_memory_counters (GskVulkanRenderer *self,
+                                            GskProfiler       *profiler)
+{
+  GskVulkanMemoryStats stats;
+
+  gsk_vulkan_memory_get_stats (self->vulkan, &stats);
+
+  gsk_profiler_counter_set (profiler, self->profile_counters.memory_blocks, stats.n_blocks);
+  gsk_profiler_counter_set (profiler, self->profile_counters.memory_allocations, stats.n_allocations);
+  gsk_profiler_counter_set (profiler, self->profile_counters.memory_allocated, stats.bytes_allocated);
+  gsk_profiler_counter_set (profiler, self->profile_counters.memory_live, stats.bytes_live);
+  gsk_profiler_counter_set (profiler, self->profile_counters.memory_fragmentation, stats.fragmentation);
+}
+#endif
+
 static void
 gsk_vulkan_renderer_free_targets (GskVulkanRenderer *self)
 {
@@ -166,6 +194,8 @@ gsk_vulkan_renderer_unrealize (GskRenderer *renderer)
   device = gdk_vulkan_context_get_device (self->vulkan);
 
   gsk_vulkan_renderer_free_targets (self);
+  gsk_vulkan_memory_trim (self->vulkan);
+  gsk_vulkan_pipeline_free_cache (self->vulkan);
   g_signal_handlers_disconnect_by_func(self->vulkan,
                                        gsk_vulkan_renderer_update_images_cb,
                                        self);
@@ -220,6 +250,8 @@ gsk_vulkan_renderer_render_texture (GskRenderer           *renderer,
   cpu_time = gsk_profiler_timer_end (profiler, self->profile_timers.cpu_time);
   gsk_profiler_timer_set (profiler, self->profile_timers.cpu_time, cpu_time);
 
+  gsk_vulkan_renderer_update_memory_counters (self, profiler);
+
   gsk_profiler_push_samples (profiler);
 #endif
 
@@ -256,6 +288,8 @@ gsk_vulkan_renderer_render (GskRenderer   *renderer,
   cpu_time = gsk_profiler_timer_end (profiler, self->profile_timers.cpu_time);
   gsk_profiler_timer_set (profiler, self->profile_timers.cpu_time, cpu_time);
 
+  gsk_vulkan_renderer_update_memory_counters (self, profiler);
+
   gsk_profiler_push_samples (profiler);
 #endif
 }
@@ -297,6 +331,13 @@ gsk_vulkan_renderer_init (GskVulkanRenderer *self)
 
 #ifdef G_ENABLE_DEBUG
   self->profile_timers.cpu_time = gsk_profiler_add_timer (profiler, "cpu-time", "CPU time", FALSE, TRUE);
+
+  self->profile_counters.memory_blocks = gsk_profiler_add_counter (profiler, "vulkan-memory-blocks", "Device memory blocks", FALSE);
+  self->profile_counters.memory_allocations = gsk_profiler_add_counter (profiler, "vulkan-memory-allocations", "Device memory allocations", FALSE);
+  self->profile_counters.memory_allocated = gsk_profiler_add_counter (profiler, "vulkan-memory-allocated", "Device memory allocated (bytes)", FALSE);
+  self->profile_counters.memory_live = gsk_profiler_add_counter (profiler, "vulkan-memory-live", "Device memory in use (bytes)", FALSE);
+  self->profile_counters.memory_fragmentation = gsk_profiler_add_counter (profiler, "vulkan-memory-fragmentation", "Device memory fragmentation (%)", FALSE);
+  self->profile_counters.fallbacks = gsk_profiler_add_counter (profiler, "fallbacks", "Fallback nodes", TRUE);
 #endif
 }
 
@@ -375,3 +416,12 @@ gsk_vulkan_renderer_get_cached_glyph (GskVulkanRenderer *self,
 {
   return gsk_vulkan_glyph_cache_lookup (self->glyph_cache, FALSE, font, glyph);
 }
+
+void
+gsk_vulkan_renderer_count_fallback (GskVulkanRenderer *self)
+{
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_inc (gsk_renderer_get_profiler (GSK_RENDERER (self)),
+                            self->profile_counters.fallbacks);
+#endif
+}
@@ -54,6 +54,8 @@ GskVulkanCachedGlyph * gsk_vulkan_renderer_get_cached_glyph (GskVulkanRenderer *
                                                              PangoFont         *font,
                                                              PangoGlyph         glyph);
 
+void                   gsk_vulkan_renderer_count_fallback   (GskVulkanRenderer *self);
+
 
 G_END_DECLS
 
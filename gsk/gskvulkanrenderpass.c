@@ -176,10 +176,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_BLEND_MODE;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_BLEND_MODE_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_BLEND_MODE_CLIP_ROUNDED;
       else
-        FALLBACK ("Blend nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_BLEND_MODE_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_BLEND_MODE;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -190,10 +188,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_CROSS_FADE;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_CROSS_FADE_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_CROSS_FADE_CLIP_ROUNDED;
       else
-        FALLBACK ("Cross fade nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_CROSS_FADE_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_CROSS_FADE;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -206,10 +202,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_INSET_SHADOW;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_INSET_SHADOW_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_INSET_SHADOW_CLIP_ROUNDED;
       else
-        FALLBACK ("Inset shadow nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_INSET_SHADOW_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_INSET_SHADOW;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -222,10 +216,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_OUTSET_SHADOW;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_OUTSET_SHADOW_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_OUTSET_SHADOW_CLIP_ROUNDED;
       else
-        FALLBACK ("Outset shadow nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_OUTSET_SHADOW_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_OUTSET_SHADOW;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -238,10 +230,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_BLEND;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_BLEND_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_BLEND_CLIP_ROUNDED;
       else
-        FALLBACK ("Cairo nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_BLEND_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_SURFACE;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -262,10 +252,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
               pipeline_type = GSK_VULKAN_PIPELINE_COLOR_TEXT;
             else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
               pipeline_type = GSK_VULKAN_PIPELINE_COLOR_TEXT_CLIP;
-            else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-              pipeline_type = GSK_VULKAN_PIPELINE_COLOR_TEXT_CLIP_ROUNDED;
             else
-              FALLBACK ("Text nodes can't deal with clip type %u\n", constants->clip.type);
+              pipeline_type = GSK_VULKAN_PIPELINE_COLOR_TEXT_CLIP_ROUNDED;
             op.type = GSK_VULKAN_OP_COLOR_TEXT;
           }
         else
@@ -274,10 +262,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
               pipeline_type = GSK_VULKAN_PIPELINE_TEXT;
             else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
               pipeline_type = GSK_VULKAN_PIPELINE_TEXT_CLIP;
-            else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-              pipeline_type = GSK_VULKAN_PIPELINE_TEXT_CLIP_ROUNDED;
             else
-              FALLBACK ("Text nodes can't deal with clip type %u\n", constants->clip.type);
+              pipeline_type = GSK_VULKAN_PIPELINE_TEXT_CLIP_ROUNDED;
             op.type = GSK_VULKAN_OP_TEXT;
           }
         op.text.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
@@ -323,10 +309,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_BLEND;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_BLEND_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_BLEND_CLIP_ROUNDED;
       else
-        FALLBACK ("Texture nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_BLEND_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_TEXTURE;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -337,10 +321,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_COLOR;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_COLOR_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_COLOR_CLIP_ROUNDED;
       else
-        FALLBACK ("Color nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_COLOR_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_COLOR;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -356,10 +338,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_LINEAR_GRADIENT;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_LINEAR_GRADIENT_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_LINEAR_GRADIENT_CLIP_ROUNDED;
       else
-        FALLBACK ("Linear gradient nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_LINEAR_GRADIENT_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_LINEAR_GRADIENT;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -370,10 +350,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_COLOR_MATRIX;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_COLOR_MATRIX_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_COLOR_MATRIX_CLIP_ROUNDED;
       else
-        FALLBACK ("Opacity nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_COLOR_MATRIX_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_OPACITY;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -384,10 +362,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_BLUR;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_BLUR_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_BLUR_CLIP_ROUNDED;
       else
-        FALLBACK ("Blur nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_BLUR_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_BLUR;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -398,10 +374,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_COLOR_MATRIX;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_COLOR_MATRIX_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_COLOR_MATRIX_CLIP_ROUNDED;
       else
-        FALLBACK ("Color matrix nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_COLOR_MATRIX_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_COLOR_MATRIX;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -412,10 +386,8 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         pipeline_type = GSK_VULKAN_PIPELINE_BORDER;
       else if (constants->clip.type == GSK_VULKAN_CLIP_RECT)
         pipeline_type = GSK_VULKAN_PIPELINE_BORDER_CLIP;
-      else if (constants->clip.type == GSK_VULKAN_CLIP_ROUNDED_CIRCULAR)
-        pipeline_type = GSK_VULKAN_PIPELINE_BORDER_CLIP_ROUNDED;
       else
-        FALLBACK ("Border nodes can't deal with clip type %u\n", constants->clip.type);
+        pipeline_type = GSK_VULKAN_PIPELINE_BORDER_CLIP_ROUNDED;
       op.type = GSK_VULKAN_OP_BORDER;
       op.render.pipeline = gsk_vulkan_render_get_pipeline (render, pipeline_type);
       g_array_append_val (self->render_ops, op);
@@ -567,6 +539,7 @@ gsk_vulkan_render_pass_get_node_as_texture (GskVulkanRenderPass   *self,
   GSK_NOTE (FALLBACK, g_print ("Node as texture not implemented. Using %gx%g fallback surface\n",
                                ceil (bounds->size.width),
                                ceil (bounds->size.height)));
+  gsk_vulkan_renderer_count_fallback (GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render)));
 
   /* XXX: We could intersect bounds with clip bounds here */
   surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
@@ -612,6 +585,7 @@ gsk_vulkan_render_pass_upload_fallback (GskVulkanRenderPass  *self,
                      node->name ? node->name : node->node_class->type_name, node,
                      ceil (node->bounds.size.width),
                      ceil (node->bounds.size.height)));
+  gsk_vulkan_renderer_count_fallback (GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render)));
 
   /* XXX: We could intersect bounds with clip bounds here */
   surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
@@ -0,0 +1,35 @@
+uniform vec4 uOutline[3];
+uniform vec4 uWidths;
+uniform vec4 uColors[4];
+
+void main() {
+  RoundedRect outside = create_rounded_rect(uOutline[0], uOutline[1], uOutline[2]);
+  RoundedRect inside = rounded_rect_shrink(outside, uWidths);
+  vec2 p = vPosition;
+
+  float alpha = clamp(rounded_rect_coverage(outside, p) -
+                      rounded_rect_coverage(inside, p),
+                      0.0, 1.0);
+
+  // Use the color of the side that is closest relative to its width,
+  // which splits the corners along their diagonals
+  vec4 d = vec4(p.y - outside.bounds.y, outside.bounds.z - p.x,
+                outside.bounds.w - p.y, p.x - outside.bounds.x) / max(uWidths, 0.0001);
+  vec4 color = uColors[0];
+  float m = d.x;
+
+  if (d.y < m) {
+    m = d.y;
+    color = uColors[1];
+  }
+  if (d.z < m) {
+    m = d.z;
+    color = uColors[2];
+  }
+  if (d.w < m) {
+    color = uColors[3];
+  }
+
+  // The colors are premultiplied
+  setOutputColor(color * alpha * uAlpha);
+}
@@ -0,0 +1,6 @@
+void main() {
+  gl_Position = uMVP * vec4(aPosition, 0.0, 1.0);
+  vPosition = aPosition;
+
+  vColor = aColor;
+}
@@ -0,0 +1,80 @@
+uniform vec4 uOutline[3];
+uniform vec2 uOffset;
+uniform float uSpread;
+uniform float uBlurRadius;
+uniform bool uInset;
+
+// Approximations of the Gaussian and its integral, see
+// http://madebyevan.com/shaders/fast-rounded-rectangle-shadows/
+float gaussian(float x, float sigma) {
+  return exp(-(x * x) / (2.0 * sigma * sigma)) / (2.50662827 * sigma);
+}
+
+vec2 erf(vec2 x) {
+  vec2 s = sign(x);
+  vec2 a = abs(x);
+
+  x = 1.0 + (0.278393 + (0.230389 + 0.078108 * (a * a)) * a) * a;
+  x *= x;
+
+  return s - s / (x * x);
+}
+
+float blurred_box_x(float x, float y, float sigma, float corner, vec2 half_size) {
+  float delta = min(half_size.y - corner - abs(y), 0.0);
+  float curved = half_size.x - corner + sqrt(max(0.0, corner * corner - delta * delta));
+  vec2 integral = 0.5 + 0.5 * erf((x + vec2(-curved, curved)) * (sqrt(0.5) / sigma));
+
+  return integral.y - integral.x;
+}
+
+// The coverage of a rounded rectangle with circular corners of the same
+// size, blurred with @sigma, sampled along y
+float blurred_rounded_rect_coverage(RoundedRect r, vec2 p, float sigma) {
+  vec2 half_size = max((r.bounds.zw - r.bounds.xy) * 0.5, 0.0);
+  float corner = min(r.corner_widths.x, min(half_size.x, half_size.y));
+
+  p -= (r.bounds.xy + r.bounds.zw) * 0.5;
+
+  float low = p.y - half_size.y;
+  float high = p.y + half_size.y;
+  float start = clamp(-3.0 * sigma, low, high);
+  float end = clamp(3.0 * sigma, low, high);
+  float dy = (end - start) / 4.0;
+  float y = start + dy * 0.5;
+  float value = 0.0;
+
+  for (int i = 0; i < 4; i++) {
+    value += blurred_box_x(p.x, p.y - y, sigma, corner, half_size) * gaussian(y, sigma) * dy;
+    y += dy;
+  }
+
+  return value;
+}
+
+float shadow_coverage(RoundedRect r, vec2 p) {
+  if (uBlurRadius > 0.0)
+    return blurred_rounded_rect_coverage(r, p, uBlurRadius);
+
+  return rounded_rect_coverage(r, p);
+}
+
+void main() {
+  RoundedRect outline = create_rounded_rect(uOutline[0], uOutline[1], uOutline[2]);
+  vec2 p = vPosition;
+  float alpha;
+
+  if (uInset) {
+    RoundedRect inside = rounded_rect_shrink(outline, vec4(uSpread));
+
+    alpha = rounded_rect_coverage(outline, p) * (1.0 - shadow_coverage(inside, p - uOffset));
+  }
+  else {
+    RoundedRect outside = rounded_rect_shrink(outline, vec4(-uSpread));
+
+    alpha = shadow_coverage(outside, p - uOffset) * (1.0 - rounded_rect_coverage(outline, p));
+  }
+
+  // vColor is premultiplied
+  setOutputColor(vColor * alpha * uAlpha);
+}
@@ -1,5 +1,4 @@
-uniform vec4 uColor;
-
 void main() {
-  setOutputColor(uColor);
+  // vColor is premultiplied
+  setOutputColor(vColor * uAlpha);
 }
@@ -2,5 +2,8 @@ uniform mat4 uMVP;
 
 in vec2 aPosition;
 in vec2 aUv;
+in vec4 aColor;
 
 out vec2 vUv;
+out vec4 vColor;
+out vec2 vPosition;
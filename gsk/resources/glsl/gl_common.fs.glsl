@@ -3,13 +3,76 @@ uniform sampler2D uSource;
 uniform sampler2D uMask;
 uniform float uAlpha;
 uniform int uBlendMode;
+uniform vec4 uClip[3];
+uniform bool uHasClip;
 
 varying vec2 vUv;
+varying vec4 vColor;
+varying vec2 vPosition;
 
 vec4 Texture(sampler2D sampler, vec2 texCoords) {
   return texture2D(sampler, texCoords);
 }
 
+/* A rounded rectangle, as (x0, y0, x1, y1) bounds and the widths and
+ * heights of the top left, top right, bottom right and bottom left
+ * corners
+ */
+struct RoundedRect
+{
+  vec4 bounds;
+  vec4 corner_widths;
+  vec4 corner_heights;
+};
+
+/* Takes the layout of gsk_rounded_rect_to_float() */
+RoundedRect create_rounded_rect(vec4 rect, vec4 corner_widths, vec4 corner_heights) {
+  return RoundedRect(vec4(rect.xy, rect.xy + rect.zw), corner_widths, corner_heights);
+}
+
+float ellipsis_coverage(vec2 point, vec2 center, vec2 radius) {
+  vec2 p0 = (point - center) / radius;
+  vec2 p1 = 2.0 * p0 / radius;
+  float d = (dot(p0, p0) - 1.0) / length(p1);
+
+  return clamp(0.5 - d, 0.0, 1.0);
+}
+
+float rounded_rect_coverage(RoundedRect r, vec2 p) {
+  if (p.x < r.bounds.x || p.y < r.bounds.y ||
+      p.x >= r.bounds.z || p.y >= r.bounds.w)
+    return 0.0;
+
+  vec2 ref_tl = r.bounds.xy + vec2( r.corner_widths.x,  r.corner_heights.x);
+  vec2 ref_tr = r.bounds.zy + vec2(-r.corner_widths.y,  r.corner_heights.y);
+  vec2 ref_br = r.bounds.zw + vec2(-r.corner_widths.z, -r.corner_heights.z);
+  vec2 ref_bl = r.bounds.xw + vec2( r.corner_widths.w, -r.corner_heights.w);
+
+  if (p.x < ref_tl.x && p.y < ref_tl.y)
+    return ellipsis_coverage(p, ref_tl, vec2(r.corner_widths.x, r.corner_heights.x));
+  if (p.x > ref_tr.x && p.y < ref_tr.y)
+    return ellipsis_coverage(p, ref_tr, vec2(r.corner_widths.y, r.corner_heights.y));
+  if (p.x > ref_br.x && p.y > ref_br.y)
+    return ellipsis_coverage(p, ref_br, vec2(r.corner_widths.z, r.corner_heights.z));
+  if (p.x < ref_bl.x && p.y > ref_bl.y)
+    return ellipsis_coverage(p, ref_bl, vec2(r.corner_widths.w, r.corner_heights.w));
+
+  return 1.0;
+}
+
+/* @amount is the top, right, bottom and left distance to shrink by */
+RoundedRect rounded_rect_shrink(RoundedRect r, vec4 amount) {
+  vec4 new_bounds = r.bounds + vec4(1.0, 1.0, -1.0, -1.0) * amount.wxyz;
+  vec4 new_widths = max(r.corner_widths - amount.wyyw, 0.0);
+  vec4 new_heights = max(r.corner_heights - amount.xxzz, 0.0);
+
+  return RoundedRect(new_bounds, new_widths, new_heights);
+}
+
 void setOutputColor(vec4 color) {
+  // The clip is in the coordinates of the item
+  if (uHasClip)
+    color *= rounded_rect_coverage(create_rounded_rect(uClip[0], uClip[1], uClip[2]), vPosition);
+
   gl_FragColor = color;
 }
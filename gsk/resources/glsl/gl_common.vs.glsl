@@ -2,5 +2,8 @@ uniform mat4 uMVP;
 
 attribute vec2 aPosition;
 attribute vec2 aUv;
+attribute vec4 aColor;
 
 varying vec2 vUv;
+varying vec4 vColor;
+varying vec2 vPosition;
@@ -0,0 +1,40 @@
+#define MAX_COLOR_STOPS 8
+
+uniform vec2 uGradientStart;
+uniform vec2 uGradientEnd;
+uniform float uColorStopOffsets[MAX_COLOR_STOPS];
+uniform vec4 uColorStops[MAX_COLOR_STOPS];
+uniform int uNumColorStops;
+uniform bool uRepeating;
+
+void main() {
+  vec2 direction = uGradientEnd - uGradientStart;
+  float offset = dot(vPosition - uGradientStart, direction) / dot(direction, direction);
+
+  if (uRepeating)
+    offset = fract(offset);
+  else
+    offset = clamp(offset, 0.0, 1.0);
+
+  vec4 color = uColorStops[0];
+
+  for (int i = 1; i < MAX_COLOR_STOPS; i++) {
+    if (i >= uNumColorStops)
+      break;
+
+    float start = uColorStopOffsets[i - 1];
+    float end = uColorStopOffsets[i];
+    float t;
+
+    // Stops at the same offset give a hard edge
+    if (end > start)
+      t = clamp((offset - start) / (end - start), 0.0, 1.0);
+    else
+      t = step(end, offset);
+
+    color = mix(color, uColorStops[i], t);
+  }
+
+  // The color stops are not premultiplied, to interpolate like Cairo
+  setOutputColor(vec4(color.rgb * color.a, color.a) * uAlpha);
+}
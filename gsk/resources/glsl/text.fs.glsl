@@ -0,0 +1,7 @@
+void main() {
+  // The glyph atlas only holds coverage, drawn in white
+  float coverage = Texture(uSource, vUv).a;
+
+  // vColor is premultiplied
+  setOutputColor(vColor * coverage * uAlpha);
+}
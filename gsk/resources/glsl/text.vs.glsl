@@ -0,0 +1,7 @@
+void main() {
+  gl_Position = uMVP * vec4(aPosition, 0.0, 1.0);
+  vPosition = aPosition;
+
+  vUv = vec2(aUv.x, aUv.y);
+  vColor = aColor;
+}
@@ -0,0 +1,476 @@
+/*  Copyright 2017 The GTK+ Team
+ *
+ * GTK+ is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * GLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GTK+; see the file COPYING.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gdk/gdk.h>
+#include <gsk/gsk.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Per-node profiling is private API, so the tool links the GDK and
+ * GSK libraries directly instead of libgtk
+ */
+#include "gdk/gdk-private.h"
+#include "gsk/gskrendererprivate.h"
+
+static char *renderer_name = NULL;
+static int runs = 100;
+static int warmup = 3;
+static gboolean per_node = FALSE;
+static gboolean no_download = FALSE;
+static char **paths = NULL;
+
+static GOptionEntry options[] = {
+  { "renderer", 'r', 0, G_OPTION_ARG_STRING, &renderer_name, "Renderer to use (cairo, opengl, vulkan)", "NAME" },
+  { "runs", 'n', 0, G_OPTION_ARG_INT, &runs, "Render each node file N times", "N" },
+  { "warmup", 'w', 0, G_OPTION_ARG_INT, &warmup, "Render each node file N times before measuring", "N" },
+  { "per-node", 'p', 0, G_OPTION_ARG_NONE, &per_node, "Report statistics per render node type", NULL },
+  { "no-download", '\0', 0, G_OPTION_ARG_NONE, &no_download, "Do not download the rendered texture", NULL },
+  { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &paths, NULL, "PATH…" },
+  { NULL }
+};
+
+typedef struct {
+  gint64 n_nodes;
+  gint64 draw_time;
+} NodeStats;
+
+typedef struct {
+  char *name;
+  GArray *frame_times;
+  NodeStats node_stats[GSK_BLUR_NODE + 1];
+} Result;
+
+static void
+result_free (gpointer data)
+{
+  Result *result = data;
+
+  g_free (result->name);
+  g_array_unref (result->frame_times);
+  g_free (result);
+}
+
+static int
+compare_times (gconstpointer a,
+               gconstpointer b)
+{
+  gint64 ta = *(const gint64 *) a;
+  gint64 tb = *(const gint64 *) b;
+
+  return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+/* Returns the nearest-rank percentile of the sorted @times */
+static gint64
+percentile (GArray *times,
+            double  p)
+{
+  guint rank;
+
+  rank = (guint) ceil (p / 100.0 * times->len);
+  rank = CLAMP (rank, 1, times->len);
+
+  return g_array_index (times, gint64, rank - 1);
+}
+
+static int
+compare_filenames (gconstpointer a,
+                   gconstpointer b)
+{
+  return strcmp (*(const char **) a, *(const char **) b);
+}
+
+static void
+add_file (GPtrArray  *files,
+          const char *path)
+{
+  GError *error = NULL;
+  GPtrArray *entries;
+  const char *name;
+  GDir *dir;
+  guint i;
+
+  if (!g_file_test (path, G_FILE_TEST_IS_DIR))
+    {
+      g_ptr_array_add (files, g_strdup (path));
+      return;
+    }
+
+  dir = g_dir_open (path, 0, &error);
+  if (dir == NULL)
+    {
+      g_printerr ("Could not open directory: %s\n", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  /* Sort, so that the output does not depend on the file system */
+  entries = g_ptr_array_new ();
+  while ((name = g_dir_read_name (dir)))
+    {
+      char *filename = g_build_filename (path, name, NULL);
+
+      if (g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+        g_ptr_array_add (entries, filename);
+      else
+        g_free (filename);
+    }
+  g_dir_close (dir);
+
+  g_ptr_array_sort (entries, compare_filenames);
+  for (i = 0; i < entries->len; i++)
+    g_ptr_array_add (files, g_ptr_array_index (entries, i));
+  g_ptr_array_free (entries, TRUE);
+}
+
+static GskRenderNode *
+load_node_file (const char *filename)
+{
+  GError *error = NULL;
+  GMappedFile *mapped_file;
+  GskRenderNode *node;
+  GBytes *bytes;
+
+  mapped_file = g_mapped_file_new (filename, FALSE, &error);
+  if (mapped_file == NULL)
+    {
+      g_printerr ("Could not open node file: %s\n", error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  bytes = g_mapped_file_get_bytes (mapped_file);
+  g_mapped_file_unref (mapped_file);
+
+  node = gsk_render_node_deserialize (bytes, &error);
+  g_bytes_unref (bytes);
+  if (node == NULL)
+    {
+      g_printerr ("Invalid node file %s: %s\n", filename, error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  return node;
+}
+
+static gint64
+render_frame (GskRenderer   *renderer,
+              GskRenderNode *node,
+              GByteArray    *data)
+{
+  GskTexture *texture;
+  gint64 start, end;
+
+  start = g_get_monotonic_time ();
+
+  texture = gsk_renderer_render_texture (renderer, node, NULL);
+
+  /* Downloading forces renderers that work asynchronously to finish the frame.
+   * The texture size may differ from the node bounds, so size the buffer from
+   * the texture; it only grows during the warmup.
+   */
+  if (!no_download)
+    {
+      gsize stride = (gsize) gsk_texture_get_width (texture) * 4;
+
+      g_byte_array_set_size (data, stride * gsk_texture_get_height (texture));
+      gsk_texture_download (texture, data->data, stride);
+    }
+
+  end = g_get_monotonic_time ();
+
+  g_object_unref (texture);
+
+  return end - start;
+}
+
+static Result *
+benchmark_file (GskRenderer *renderer,
+                const char  *filename)
+{
+  GskRenderNode *node;
+  graphene_rect_t bounds;
+  Result *result;
+  GByteArray *data;
+  int run, i;
+
+  node = load_node_file (filename);
+  if (node == NULL)
+    return NULL;
+
+  gsk_render_node_get_bounds (node, &bounds);
+  if (ceil (bounds.size.width) < 1 || ceil (bounds.size.height) < 1)
+    {
+      g_printerr ("Skipping %s: node has no area\n", filename);
+      gsk_render_node_unref (node);
+      return NULL;
+    }
+
+  data = g_byte_array_new ();
+
+  result = g_new0 (Result, 1);
+  result->name = g_path_get_basename (filename);
+  result->frame_times = g_array_sized_new (FALSE, FALSE, sizeof (gint64), runs);
+
+  for (run = 0; run < warmup; run++)
+    render_frame (renderer, node, data);
+
+  for (run = 0; run < runs; run++)
+    {
+      gint64 frame_time = render_frame (renderer, node, data);
+
+      g_array_append_val (result->frame_times, frame_time);
+
+      if (!per_node)
+        continue;
+
+      for (i = 1; i <= GSK_BLUR_NODE; i++)
+        {
+          gint64 n_nodes, draw_time;
+
+          if (!gsk_renderer_get_node_profile (renderer, i, &n_nodes, &draw_time))
+            continue;
+
+          /* The node counts are the same for every frame */
+          result->node_stats[i].n_nodes = n_nodes;
+          result->node_stats[i].draw_time += draw_time;
+        }
+    }
+
+  g_array_sort (result->frame_times, compare_times);
+
+  g_byte_array_unref (data);
+  gsk_render_node_unref (node);
+
+  return result;
+}
+
+static void
+print_results (GPtrArray *results)
+{
+  GArray *all_times;
+  int name_width = strlen ("File");
+  guint i, j;
+
+  for (i = 0; i < results->len; i++)
+    {
+      Result *result = g_ptr_array_index (results, i);
+      name_width = MAX (name_width, (int) strlen (result->name));
+    }
+
+  g_print ("%-*s %10s %10s %10s %10s\n", name_width, "File", "min", "median", "p99", "mean");
+
+  all_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+  for (i = 0; i < results->len; i++)
+    {
+      Result *result = g_ptr_array_index (results, i);
+      gint64 total = 0;
+
+      for (j = 0; j < result->frame_times->len; j++)
+        total += g_array_index (result->frame_times, gint64, j);
+
+      g_print ("%-*s %8.3fms %8.3fms %8.3fms %8.3fms\n",
+               name_width, result->name,
+               (double) percentile (result->frame_times, 0) / 1000.,
+               (double) percentile (result->frame_times, 50) / 1000.,
+               (double) percentile (result->frame_times, 99) / 1000.,
+               (double) total / result->frame_times->len / 1000.);
+
+      g_array_append_vals (all_times, result->frame_times->data, result->frame_times->len);
+    }
+
+  if (results->len > 1)
+    {
+      gint64 total = 0;
+
+      g_array_sort (all_times, compare_times);
+      for (j = 0; j < all_times->len; j++)
+        total += g_array_index (all_times, gint64, j);
+
+      g_print ("%-*s %8.3fms %8.3fms %8.3fms %8.3fms\n",
+               name_width, "All",
+               (double) percentile (all_times, 0) / 1000.,
+               (double) percentile (all_times, 50) / 1000.,
+               (double) percentile (all_times, 99) / 1000.,
+               (double) total / all_times->len / 1000.);
+    }
+
+  g_array_unref (all_times);
+}
+
+static void
+print_node_results (GskRenderer *renderer,
+                    GPtrArray   *results)
+{
+  NodeStats totals[GSK_BLUR_NODE + 1] = { { 0, }, };
+  GEnumClass *enum_class;
+  gint64 total_time = 0;
+  gint64 total_frames = 0;
+  guint i;
+  int t;
+
+  if (!gsk_renderer_get_node_profile (renderer, GSK_CONTAINER_NODE, NULL, NULL))
+    {
+      g_print ("\nPer-node statistics are not available, GTK+ was built without debugging support.\n");
+      return;
+    }
+
+  for (i = 0; i < results->len; i++)
+    {
+      Result *result = g_ptr_array_index (results, i);
+
+      for (t = 1; t <= GSK_BLUR_NODE; t++)
+        {
+          totals[t].n_nodes += result->node_stats[t].n_nodes;
+          totals[t].draw_time += result->node_stats[t].draw_time;
+          total_time += result->node_stats[t].draw_time;
+        }
+
+      total_frames += result->frame_times->len;
+    }
+
+  enum_class = g_type_class_ref (GSK_TYPE_RENDER_NODE_TYPE);
+
+  g_print ("\n%-32s %10s %12s %12s %7s\n", "Node type", "nodes", "time/frame", "time/node", "share");
+  for (t = 1; t <= GSK_BLUR_NODE; t++)
+    {
+      GEnumValue *value = g_enum_get_value (enum_class, t);
+      double per_frame, per_node_time;
+
+      if (totals[t].n_nodes == 0)
+        continue;
+
+      /* Draw times are summed over all runs, node counts over all files */
+      per_frame = (double) totals[t].draw_time / runs / 1000.;
+      per_node_time = (double) totals[t].draw_time / runs / totals[t].n_nodes;
+
+      g_print ("%-32s %10" G_GINT64_FORMAT " %10.3fms %10.0fns %6.1f%%\n",
+               value->value_nick,
+               totals[t].n_nodes,
+               per_frame,
+               per_node_time,
+               total_time > 0 ? 100. * totals[t].draw_time / total_time : 0.);
+    }
+
+  g_type_class_unref (enum_class);
+
+  g_print ("\nTimes are spent in Cairo drawing, excluding child nodes, over %" G_GINT64_FORMAT " frames.\n",
+           total_frames);
+  g_print ("Nodes that %s draws natively are counted, but not timed.\n",
+           G_OBJECT_TYPE_NAME (renderer));
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  GskRenderer *renderer;
+  GdkWindow *window;
+  GPtrArray *files;
+  GPtrArray *results;
+  guint i;
+
+  g_set_prgname ("gtk4-rendernode-benchmark");
+
+  context = g_option_context_new (NULL);
+  g_option_context_set_summary (context, "Render serialized render nodes and report frame times.");
+  g_option_context_add_main_entries (context, options, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  if (paths == NULL)
+    {
+      g_printerr ("No node files given\n");
+      return 1;
+    }
+
+  if (runs < 1)
+    {
+      g_printerr ("Number of runs given with -n/--runs must be at least 1 and not %d.\n", runs);
+      return 1;
+    }
+
+  gdk_pre_parse ();
+  if (gdk_display_open_default () == NULL)
+    {
+      g_printerr ("Could not open a display\n");
+      return 1;
+    }
+
+  if (renderer_name)
+    g_object_set_data_full (G_OBJECT (gdk_display_get_default ()), "gsk-renderer",
+                            g_strdup (renderer_name), g_free);
+
+  window = gdk_window_new_toplevel (gdk_display_get_default (), 0, 10, 10);
+  renderer = gsk_renderer_new_for_window (window);
+  if (renderer == NULL)
+    {
+      g_printerr ("Could not create a renderer\n");
+      return 1;
+    }
+
+  if (per_node)
+    gsk_renderer_set_profile_nodes (renderer, TRUE);
+
+  files = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0; paths[i]; i++)
+    add_file (files, paths[i]);
+
+  results = g_ptr_array_new_with_free_func (result_free);
+  for (i = 0; i < files->len; i++)
+    {
+      Result *result = benchmark_file (renderer, g_ptr_array_index (files, i));
+
+      if (result)
+        g_ptr_array_add (results, result);
+    }
+
+  if (results->len == 0)
+    {
+      g_printerr ("No node files could be rendered\n");
+      return 1;
+    }
+
+  g_print ("%s, %d runs per file after %d warmup runs\n\n",
+           G_OBJECT_TYPE_NAME (renderer), runs, warmup);
+
+  print_results (results);
+
+  if (per_node)
+    print_node_results (renderer, results);
+
+  g_ptr_array_unref (results);
+  g_ptr_array_unref (files);
+  g_strfreev (paths);
+  g_free (renderer_name);
+
+  gsk_renderer_unrealize (renderer);
+  g_object_unref (renderer);
+  g_object_unref (window);
+
+  return 0;
+}
@@ -23,6 +23,8 @@
 #include "gtkcssnodeprivate.h"
 #include "gtkwidgetpath.h"
 
+#include <string.h>
+
 /* GTK_CSS_MATCHER_WIDGET_PATH */
 
 static gboolean
@@ -325,6 +327,142 @@ _gtk_css_matcher_node_init (GtkCssMatcher *matcher,
 {
   matcher->node.klass = &GTK_CSS_MATCHER_NODE;
   matcher->node.node = node;
+  matcher->node.filter = NULL;
+}
+
+/* Only node matchers use the filter, other matchers ignore it */
+void
+_gtk_css_matcher_set_ancestor_filter (GtkCssMatcher              *matcher,
+                                      const GtkCssAncestorFilter *filter)
+{
+  if (matcher->klass == &GTK_CSS_MATCHER_NODE)
+    matcher->node.filter = filter;
+}
+
+const GtkCssAncestorFilter *
+_gtk_css_matcher_get_ancestor_filter (const GtkCssMatcher *matcher)
+{
+  if (matcher->klass == &GTK_CSS_MATCHER_NODE)
+    return matcher->node.filter;
+
+  return NULL;
+}
+
+/* GTK_CSS_ANCESTOR_FILTER */
+
+typedef enum {
+  ANCESTOR_NAME,
+  ANCESTOR_CLASS,
+  ANCESTOR_ID
+} AncestorKey;
+
+static guint32
+gtk_css_ancestor_filter_hash (AncestorKey key,
+                              guint64     value)
+{
+  guint32 hash;
+
+  hash = (guint32) (value ^ (value >> 32)) ^ (key * 0x9e3779b9u);
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+
+  return hash;
+}
+
+/* Each key sets two bits, taken from the low and high half of the hash */
+#define FILTER_BIT1(hash) ((hash) % GTK_CSS_ANCESTOR_FILTER_BITS)
+#define FILTER_BIT2(hash) (((hash) >> 16) % GTK_CSS_ANCESTOR_FILTER_BITS)
+
+static void
+gtk_css_ancestor_filter_set (GtkCssAncestorFilter *filter,
+                             guint32               hash)
+{
+  filter->bits[FILTER_BIT1 (hash) / 32] |= 1u << (FILTER_BIT1 (hash) % 32);
+  filter->bits[FILTER_BIT2 (hash) / 32] |= 1u << (FILTER_BIT2 (hash) % 32);
+}
+
+static gboolean
+gtk_css_ancestor_filter_get (const GtkCssAncestorFilter *filter,
+                             guint32                     hash)
+{
+  return (filter->bits[FILTER_BIT1 (hash) / 32] & (1u << (FILTER_BIT1 (hash) % 32))) &&
+         (filter->bits[FILTER_BIT2 (hash) / 32] & (1u << (FILTER_BIT2 (hash) % 32)));
+}
+
+void
+_gtk_css_ancestor_filter_init (GtkCssAncestorFilter *filter)
+{
+  memset (filter, 0, sizeof (GtkCssAncestorFilter));
+}
+
+/*
+ * _gtk_css_ancestor_filter_add:
+ * @filter: the filter
+ * @matcher: the matcher for a node
+ *
+ * Adds the name, id and classes of the node @matcher matches
+ * to @filter.
+ *
+ * Returns: %FALSE if that isn't possible because @matcher is not
+ *   a node matcher. The filter must not be used for descendants
+ *   of @matcher then.
+ */
+gboolean
+_gtk_css_ancestor_filter_add (GtkCssAncestorFilter *filter,
+                              const GtkCssMatcher  *matcher)
+{
+  const GtkCssNodeDeclaration *decl;
+  const GQuark *classes;
+  const char *id;
+  guint i, n_classes;
+
+  if (matcher->klass != &GTK_CSS_MATCHER_NODE)
+    return FALSE;
+
+  decl = gtk_css_node_get_declaration (matcher->node.node);
+
+  gtk_css_ancestor_filter_set (filter,
+                               gtk_css_ancestor_filter_hash (ANCESTOR_NAME,
+                                                             GPOINTER_TO_SIZE (gtk_css_node_declaration_get_name (decl))));
+
+  id = gtk_css_node_declaration_get_id (decl);
+  if (id)
+    gtk_css_ancestor_filter_set (filter,
+                                 gtk_css_ancestor_filter_hash (ANCESTOR_ID, GPOINTER_TO_SIZE (id)));
+
+  classes = gtk_css_node_declaration_get_classes (decl, &n_classes);
+  for (i = 0; i < n_classes; i++)
+    gtk_css_ancestor_filter_set (filter,
+                                 gtk_css_ancestor_filter_hash (ANCESTOR_CLASS, classes[i]));
+
+  return TRUE;
+}
+
+gboolean
+_gtk_css_ancestor_filter_may_have_name (const GtkCssAncestorFilter *filter,
+                                        /*interned*/ const char    *name)
+{
+  return gtk_css_ancestor_filter_get (filter,
+                                      gtk_css_ancestor_filter_hash (ANCESTOR_NAME, GPOINTER_TO_SIZE (name)));
+}
+
+gboolean
+_gtk_css_ancestor_filter_may_have_class (const GtkCssAncestorFilter *filter,
+                                         GQuark                      class_name)
+{
+  return gtk_css_ancestor_filter_get (filter,
+                                      gtk_css_ancestor_filter_hash (ANCESTOR_CLASS, class_name));
+}
+
+gboolean
+_gtk_css_ancestor_filter_may_have_id (const GtkCssAncestorFilter *filter,
+                                      /*interned*/ const char    *id)
+{
+  return gtk_css_ancestor_filter_get (filter,
+                                      gtk_css_ancestor_filter_hash (ANCESTOR_ID, GPOINTER_TO_SIZE (id)));
 }
 
 /* GTK_CSS_MATCHER_WIDGET_ANY */
@@ -28,6 +28,7 @@ typedef struct _GtkCssMatcherNode GtkCssMatcherNode;
 typedef struct _GtkCssMatcherSuperset GtkCssMatcherSuperset;
 typedef struct _GtkCssMatcherWidgetPath GtkCssMatcherWidgetPath;
 typedef struct _GtkCssMatcherClass GtkCssMatcherClass;
+typedef struct _GtkCssAncestorFilter GtkCssAncestorFilter;
 
 struct _GtkCssMatcherClass {
   gboolean        (* get_parent)                  (GtkCssMatcher          *matcher,
@@ -60,6 +61,8 @@ struct _GtkCssMatcherWidgetPath {
 struct _GtkCssMatcherNode {
   const GtkCssMatcherClass *klass;
   GtkCssNode               *node;
+  /* NULL or a filter containing all ancestors of node */
+  const GtkCssAncestorFilter *filter;
 };
 
 struct _GtkCssMatcherSuperset {
@@ -68,6 +71,17 @@ struct _GtkCssMatcherSuperset {
   GtkCssChange              relevant;
 };
 
+/* A Bloom filter of the names, ids and classes of a node's ancestors.
+ * If it says a name, id or class is not present, no ancestor has it
+ * and descendant selectors needing it can be skipped without walking
+ * up the tree.
+ */
+#define GTK_CSS_ANCESTOR_FILTER_BITS 512
+
+struct _GtkCssAncestorFilter {
+  guint32 bits[GTK_CSS_ANCESTOR_FILTER_BITS / 32];
+};
+
 union _GtkCssMatcher {
   const GtkCssMatcherClass *klass;
   GtkCssMatcherWidgetPath   path;
@@ -85,6 +99,21 @@ void              _gtk_css_matcher_superset_init  (GtkCssMatcher          *match
                                                    const GtkCssMatcher    *subset,
                                                    GtkCssChange            relevant);
 
+void              _gtk_css_matcher_set_ancestor_filter (GtkCssMatcher     *matcher,
+                                                   const GtkCssAncestorFilter *filter);
+const GtkCssAncestorFilter *
+                  _gtk_css_matcher_get_ancestor_filter (const GtkCssMatcher *matcher);
+
+void              _gtk_css_ancestor_filter_init   (GtkCssAncestorFilter   *filter);
+gboolean          _gtk_css_ancestor_filter_add    (GtkCssAncestorFilter   *filter,
+                                                   const GtkCssMatcher    *matcher);
+gboolean          _gtk_css_ancestor_filter_may_have_name  (const GtkCssAncestorFilter *filter,
+                                                   /*interned*/const char *name);
+gboolean          _gtk_css_ancestor_filter_may_have_class (const GtkCssAncestorFilter *filter,
+                                                   GQuark                  class_name);
+gboolean          _gtk_css_ancestor_filter_may_have_id    (const GtkCssAncestorFilter *filter,
+                                                   /*interned*/const char *id);
+
 
 static inline gboolean
 _gtk_css_matcher_get_parent (GtkCssMatcher       *matcher,
@@ -20,6 +20,7 @@
 #include "gtkcssnodeprivate.h"
 
 #include "gtkcssanimatedstyleprivate.h"
+#include "gtkcssmatcherprivate.h"
 #include "gtkcsssectionprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkintl.h"
@@ -115,6 +116,48 @@ struct _GtkCssNodeStyleChange {
 static guint cssnode_signals[LAST_SIGNAL] = { 0 };
 static GParamSpec *cssnode_properties[NUM_PROPERTIES];
 
+/* Used to compute the styles of many children in parallel */
+#define MIN_PARALLEL_MATCHES 32
+#define MATCHES_PER_THREAD 16
+
+typedef struct {
+  GtkCssNode              *node;
+  GtkStyleProviderPrivate *provider;
+  GtkCssMatcher            matcher;
+  GtkCssLookup            *lookup;
+  GtkCssChange             change;
+} StyleMatch;
+
+/* The state while validating the children of a node. Anything that
+ * changes how nodes match, like names, ids, classes, states or the
+ * tree structure, bumps node_tree_serial, which makes the state
+ * unusable for the rest of the children.
+ */
+typedef struct {
+  GtkCssNode                 *parent;
+  guint                       serial;
+
+  /* NULL or a filter containing all ancestors of the children */
+  const GtkCssAncestorFilter *filter;
+
+  /* The children that were matched in advance, in order, and
+   * the index of each child's match in them
+   */
+  StyleMatch                 *matches;
+  guint                       n_matches;
+  GHashTable                 *match_index;
+
+  /* Used while matching in threads */
+  volatile gint               next_thread_match;
+  guint                       n_threads;
+  GMutex                      mutex;
+  GCond                       cond;
+} ChildValidation;
+
+static ChildValidation *child_validation;
+static guint node_tree_serial;
+static GThreadPool *style_match_pool;
+
 static GtkStyleProviderPrivate *
 gtk_css_node_get_style_provider_or_null (GtkCssNode *cssnode)
 {
@@ -352,13 +395,51 @@ store_in_global_parent_cache (GtkCssNode                  *node,
                                                  style);
 }
 
+/* Takes the result of matching @cssnode in advance, if there is one */
+static gboolean
+take_style_match (GtkCssNode               *cssnode,
+                  GtkStyleProviderPrivate  *provider,
+                  GtkCssLookup            **lookup,
+                  GtkCssChange             *change)
+{
+  ChildValidation *cv = child_validation;
+  StyleMatch *match;
+  gpointer index;
+
+  if (cv == NULL ||
+      cv->n_matches == 0 ||
+      cssnode->parent != cv->parent ||
+      cv->serial != node_tree_serial)
+    return FALSE;
+
+  /* Only one child of each declaration is matched in advance, the
+   * others usually find its style in the style cache
+   */
+  if (!g_hash_table_lookup_extended (cv->match_index, cssnode, NULL, &index))
+    return FALSE;
+
+  match = &cv->matches[GPOINTER_TO_UINT (index)];
+  if (match->lookup == NULL || match->provider != provider)
+    return FALSE;
+
+  *lookup = match->lookup;
+  *change = match->change;
+  match->lookup = NULL;
+
+  return TRUE;
+}
+
 static GtkCssStyle *
 gtk_css_node_create_style (GtkCssNode *cssnode)
 {
   const GtkCssNodeDeclaration *decl;
+  GtkStyleProviderPrivate *provider;
+  GtkCssLookup *lookup;
+  GtkCssChange change;
   GtkCssMatcher matcher;
   GtkCssStyle *parent;
   GtkCssStyle *style;
+  gboolean is_first, is_last;
 
   decl = gtk_css_node_get_declaration (cssnode);
   parent = cssnode->parent ? cssnode->parent->style : NULL;
@@ -367,15 +448,49 @@ gtk_css_node_create_style (GtkCssNode *cssnode)
   if (style)
     return g_object_ref (style);
 
-  if (gtk_css_node_init_matcher (cssnode, &matcher))
-    style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
-                                              &matcher,
-                                              parent);
+  provider = gtk_css_node_get_style_provider (cssnode);
+  is_first = gtk_css_node_is_first_child (cssnode);
+  is_last = gtk_css_node_is_last_child (cssnode);
+
+  style = gtk_css_node_style_cache_lookup_shared (provider, parent, decl, is_first, is_last);
+  if (style)
+    {
+      g_object_ref (style);
+      store_in_global_parent_cache (cssnode, decl, style);
+      return style;
+    }
+
+  if (take_style_match (cssnode, provider, &lookup, &change))
+    {
+      style = gtk_css_static_style_new_resolve (provider,
+                                                lookup,
+                                                change,
+                                                parent);
+      _gtk_css_lookup_free (lookup);
+    }
+  else if (gtk_css_node_init_matcher (cssnode, &matcher))
+    {
+      if (cssnode->parent != NULL &&
+          child_validation != NULL &&
+          child_validation->parent == cssnode->parent &&
+          child_validation->serial == node_tree_serial)
+        _gtk_css_matcher_set_ancestor_filter (&matcher, child_validation->filter);
+
+      style = gtk_css_static_style_new_compute (provider,
+                                                &matcher,
+                                                parent);
+    }
   else
-    style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
+    style = gtk_css_static_style_new_compute (provider,
                                               NULL,
                                               parent);
 
+  gtk_css_node_style_cache_insert_shared (provider,
+                                          parent,
+                                          (GtkCssNodeDeclaration *) decl,
+                                          is_first,
+                                          is_last,
+                                          style);
   store_in_global_parent_cache (cssnode, decl, style);
 
   return style;
@@ -742,6 +857,8 @@ gtk_css_node_reposition (GtkCssNode *node,
   /* Take a reference here so the whole function has a reference */
   g_object_ref (node);
 
+  node_tree_serial++;
+
   if (node->visible)
     {
       if (node->next_sibling)
@@ -1275,6 +1392,59 @@ gtk_css_node_invalidate_style_provider (GtkCssNode *cssnode)
     }
 }
 
+static void
+gtk_css_node_invalidate_provider_change_recurse (GtkCssNode              *cssnode,
+                                                 GtkStyleProviderPrivate *provider)
+{
+  GtkCssMatcher matcher;
+  GtkCssNode *child;
+
+  /* Style caches are shared between nodes with the same declaration,
+   * so any cache in the subtree may contain old styles, even for nodes
+   * that aren't affected themselves.
+   */
+  g_clear_pointer (&cssnode->cache, gtk_css_node_style_cache_unref);
+
+  /* Nodes that are invalid already don't need to be matched */
+  if ((cssnode->pending_changes & GTK_CSS_CHANGE_SOURCE) == 0 &&
+      (!gtk_css_node_init_matcher (cssnode, &matcher) ||
+       _gtk_style_provider_private_may_affect (provider, &matcher)))
+    gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
+
+  for (child = cssnode->first_child;
+       child;
+       child = child->next_sibling)
+    {
+      if (gtk_css_node_get_style_provider_or_null (child) == NULL)
+        gtk_css_node_invalidate_provider_change_recurse (child, provider);
+    }
+}
+
+/*
+ * gtk_css_node_invalidate_style_provider_change:
+ * @cssnode: the node
+ * @provider: the style provider of @cssnode, while it emits
+ *   ::-gtk-private-changed
+ *
+ * Like gtk_css_node_invalidate_style_provider(), but only invalidates
+ * the nodes that @provider says may be affected by the change.
+ */
+void
+gtk_css_node_invalidate_style_provider_change (GtkCssNode              *cssnode,
+                                               GtkStyleProviderPrivate *provider)
+{
+  guint serial;
+
+  /* Every style context sharing the root gets the signal, only walk
+   * the tree for the first one */
+  serial = _gtk_style_provider_private_get_change_serial (provider);
+  if (serial != 0 && cssnode->provider_change == serial)
+    return;
+  cssnode->provider_change = serial;
+
+  gtk_css_node_invalidate_provider_change_recurse (cssnode, provider);
+}
+
 static void
 gtk_css_node_invalidate_timestamp (GtkCssNode *cssnode)
 {
@@ -1316,6 +1486,9 @@ gtk_css_node_invalidate (GtkCssNode   *cssnode,
   if (change == 0)
     return;
 
+  if (change & GTK_CSS_CHANGE_ANY_SELF)
+    node_tree_serial++;
+
   cssnode->pending_changes |= change;
 
   GTK_CSS_NODE_GET_CLASS (cssnode)->invalidate (cssnode);
@@ -1326,9 +1499,185 @@ gtk_css_node_invalidate (GtkCssNode   *cssnode,
 }
 
 static void
-gtk_css_node_validate_internal (GtkCssNode *cssnode,
-                                gint64      timestamp)
+style_match_run (ChildValidation *cv)
+{
+  StyleMatch *match;
+  guint i;
+
+  while (TRUE)
+    {
+      i = g_atomic_int_add (&cv->next_thread_match, 1);
+      if (i >= cv->n_matches)
+        break;
+
+      match = &cv->matches[i];
+      match->lookup = gtk_css_static_style_lookup (match->provider,
+                                                   &match->matcher,
+                                                   &match->change);
+    }
+}
+
+static void
+style_match_thread_func (gpointer data,
+                         gpointer user_data)
+{
+  ChildValidation *cv = data;
+
+  style_match_run (cv);
+
+  g_mutex_lock (&cv->mutex);
+  cv->n_threads--;
+  g_cond_signal (&cv->cond);
+  g_mutex_unlock (&cv->mutex);
+}
+
+static gboolean
+gtk_css_node_needs_new_static_style (GtkCssNode *cssnode)
+{
+  GtkCssStyle *static_style;
+
+  if (!cssnode->style_is_invalid)
+    return FALSE;
+
+  static_style = cssnode->style;
+  if (GTK_IS_CSS_ANIMATED_STYLE (static_style))
+    static_style = GTK_CSS_ANIMATED_STYLE (static_style)->style;
+
+  return gtk_css_style_needs_recreation (static_style, cssnode->pending_changes);
+}
+
+/*
+ * Matching selectors only reads the node tree and the style providers,
+ * so when many children of @cssnode need a new style, it is done for
+ * all of them at once using all CPUs. The styles are still computed
+ * and set one by one on the main thread, in order.
+ */
+static void
+match_children_in_parallel (GtkCssNode      *cssnode,
+                            ChildValidation *cv)
+{
+  GtkCssNode *child;
+  GHashTable *seen;
+  GArray *matches;
+  guint i, n_threads;
+
+  i = 0;
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    {
+      if (child->visible && child->invalid && child->style_is_invalid)
+        i++;
+    }
+
+  if (i < MIN_PARALLEL_MATCHES)
+    return;
+
+  if (style_match_pool == NULL)
+    {
+      if (g_get_num_processors () < 2)
+        return;
+
+      style_match_pool = g_thread_pool_new (style_match_thread_func,
+                                            NULL,
+                                            g_get_num_processors () - 1,
+                                            FALSE,
+                                            NULL);
+    }
+
+  matches = g_array_sized_new (FALSE, FALSE, sizeof (StyleMatch), i);
+  /* Children with the same declaration likely share their style */
+  seen = g_hash_table_new (gtk_css_node_declaration_hash, gtk_css_node_declaration_equal);
+
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    {
+      StyleMatch match;
+
+      if (!child->visible || !child->invalid ||
+          !gtk_css_node_needs_new_static_style (child))
+        continue;
+
+      if (g_hash_table_contains (seen, child->decl))
+        continue;
+      g_hash_table_add (seen, child->decl);
+
+      if (!gtk_css_node_init_matcher (child, &match.matcher))
+        continue;
+      _gtk_css_matcher_set_ancestor_filter (&match.matcher, cv->filter);
+
+      match.node = child;
+      match.provider = gtk_css_node_get_style_provider (child);
+      match.lookup = NULL;
+      match.change = 0;
+
+      g_array_append_val (matches, match);
+    }
+
+  g_hash_table_unref (seen);
+
+  if (matches->len < MIN_PARALLEL_MATCHES)
+    {
+      g_array_free (matches, TRUE);
+      return;
+    }
+
+  cv->n_matches = matches->len;
+  cv->matches = (StyleMatch *) g_array_free (matches, FALSE);
+  cv->next_thread_match = 0;
+
+  cv->match_index = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < cv->n_matches; i++)
+    g_hash_table_insert (cv->match_index, cv->matches[i].node, GUINT_TO_POINTER (i));
+
+  n_threads = MIN (cv->n_matches / MATCHES_PER_THREAD,
+                   (guint) g_thread_pool_get_max_threads (style_match_pool));
+
+  g_mutex_init (&cv->mutex);
+  g_cond_init (&cv->cond);
+  cv->n_threads = n_threads;
+
+  for (i = 0; i < n_threads; i++)
+    g_thread_pool_push (style_match_pool, cv, NULL);
+
+  /* Help out instead of just waiting */
+  style_match_run (cv);
+
+  g_mutex_lock (&cv->mutex);
+  while (cv->n_threads > 0)
+    g_cond_wait (&cv->cond, &cv->mutex);
+  g_mutex_unlock (&cv->mutex);
+
+  g_mutex_clear (&cv->mutex);
+  g_cond_clear (&cv->cond);
+}
+
+static void
+child_validation_finish (ChildValidation *cv)
 {
+  guint i;
+
+  for (i = 0; i < cv->n_matches; i++)
+    {
+      if (cv->matches[i].lookup)
+        _gtk_css_lookup_free (cv->matches[i].lookup);
+    }
+
+  g_free (cv->matches);
+  g_clear_pointer (&cv->match_index, g_hash_table_unref);
+}
+
+/* @filter contains the ancestors of @cssnode or is %NULL if they are unknown */
+static void
+gtk_css_node_validate_internal (GtkCssNode                 *cssnode,
+                                gint64                      timestamp,
+                                const GtkCssAncestorFilter *filter)
+{
+  GtkCssAncestorFilter child_filter;
+  ChildValidation cv = { NULL, };
+  ChildValidation *old_cv;
+  GtkCssMatcher matcher;
   GtkCssNode *child;
 
   if (!cssnode->invalid)
@@ -1343,23 +1692,58 @@ gtk_css_node_validate_internal (GtkCssNode *cssnode,
 
   GTK_CSS_NODE_GET_CLASS (cssnode)->validate (cssnode);
 
+  if (cssnode->first_child == NULL)
+    return;
+
+  if (filter)
+    {
+      child_filter = *filter;
+      /* If there is no matcher, matching stops here and we don't need to add anything */
+      if (gtk_css_node_init_matcher (cssnode, &matcher) &&
+          !_gtk_css_ancestor_filter_add (&child_filter, &matcher))
+        filter = NULL;
+      else
+        filter = &child_filter;
+    }
+
+  cv.parent = cssnode;
+  cv.serial = node_tree_serial;
+  cv.filter = filter;
+
+  match_children_in_parallel (cssnode, &cv);
+
+  old_cv = child_validation;
+  child_validation = &cv;
+
   for (child = gtk_css_node_get_first_child (cssnode);
        child;
        child = gtk_css_node_get_next_sibling (child))
     {
       if (child->visible)
-        gtk_css_node_validate_internal (child, timestamp);
+        gtk_css_node_validate_internal (child,
+                                        timestamp,
+                                        cv.serial == node_tree_serial ? filter : NULL);
     }
+
+  child_validation = old_cv;
+
+  child_validation_finish (&cv);
 }
 
 void
 gtk_css_node_validate (GtkCssNode *cssnode)
 {
+  GtkCssAncestorFilter filter;
   gint64 timestamp;
 
   timestamp = gtk_css_node_get_timestamp (cssnode);
 
-  gtk_css_node_validate_internal (cssnode, timestamp);
+  /* Only a root node knows all its ancestors */
+  _gtk_css_ancestor_filter_init (&filter);
+
+  gtk_css_node_validate_internal (cssnode,
+                                  timestamp,
+                                  cssnode->parent ? NULL : &filter);
 }
 
 gboolean
@@ -21,6 +21,7 @@
 
 #include "gtkdebug.h"
 #include "gtkcssstaticstyleprivate.h"
+#include "gtkstyleproviderprivate.h"
 
 struct _GtkCssNodeStyleCache {
   guint        ref_count;
@@ -180,3 +181,299 @@ gtk_css_node_style_cache_lookup (GtkCssNodeStyleCache        *parent,
   return gtk_css_node_style_cache_ref (result);
 }
 
+
+/* STYLE SHARING
+ *
+ * The caches above hang off the parent node, so identical subtrees in
+ * different places of the node tree compute their styles separately.
+ * In addition, every style provider has a table that shares styles
+ * between all nodes it styles, keyed by the parent's style and the
+ * node's declaration.
+ *
+ * As nodes in different places share styles this way, a style only
+ * goes into the table if it doesn't depend on any siblings and not
+ * on the position of its ancestors. Whether a node is the first or
+ * last child is only compared when the style depends on it.
+ */
+
+/* Once the table grows beyond this, it is cleared */
+#define MAX_SHARED_STYLES 4096
+
+#define SHARING_POSITION (GTK_CSS_CHANGE_FIRST_CHILD | GTK_CSS_CHANGE_LAST_CHILD)
+
+#define SHARING_FORBIDDEN (GTK_CSS_CHANGE_ANY_SIBLING | \
+                           GTK_CSS_CHANGE_NTH_CHILD | GTK_CSS_CHANGE_NTH_LAST_CHILD | \
+                           GTK_CSS_CHANGE_PARENT_POSITION | \
+                           GTK_CSS_CHANGE_PARENT_SIBLING_CLASS | GTK_CSS_CHANGE_PARENT_SIBLING_ID | \
+                           GTK_CSS_CHANGE_PARENT_SIBLING_NAME | GTK_CSS_CHANGE_PARENT_SIBLING_POSITION | \
+                           GTK_CSS_CHANGE_PARENT_SIBLING_STATE)
+
+typedef struct _StyleSharing StyleSharing;
+typedef struct _SharedKey SharedKey;
+typedef struct _SharedStyle SharedStyle;
+
+struct _StyleSharing {
+  GtkStyleProviderPrivate *provider;
+  /* SharedKey => GSList of SharedStyle */
+  GHashTable *styles;
+  guint n_styles;
+  guint hits;
+  guint misses;
+};
+
+struct _SharedKey {
+  GtkCssStyle *parent;
+  GtkCssNodeDeclaration *decl;
+};
+
+struct _SharedStyle {
+  GtkCssStyle *style;
+  /* The position the style was computed for, masked
+   * by the position changes it depends on */
+  GtkCssChange position;
+};
+
+static GQuark style_sharing_quark;
+
+static guint
+shared_key_hash (gconstpointer item)
+{
+  const SharedKey *key = item;
+
+  return g_direct_hash (key->parent) ^ gtk_css_node_declaration_hash (key->decl);
+}
+
+static gboolean
+shared_key_equal (gconstpointer item1,
+                  gconstpointer item2)
+{
+  const SharedKey *key1 = item1;
+  const SharedKey *key2 = item2;
+
+  return key1->parent == key2->parent &&
+         gtk_css_node_declaration_equal (key1->decl, key2->decl);
+}
+
+static void
+shared_key_free (gpointer item)
+{
+  SharedKey *key = item;
+
+  g_clear_object (&key->parent);
+  gtk_css_node_declaration_unref (key->decl);
+
+  g_slice_free (SharedKey, key);
+}
+
+static void
+shared_style_free (gpointer item)
+{
+  SharedStyle *shared = item;
+
+  g_object_unref (shared->style);
+
+  g_slice_free (SharedStyle, shared);
+}
+
+static void
+shared_style_list_free (gpointer list)
+{
+  g_slist_free_full (list, shared_style_free);
+}
+
+static void
+style_sharing_clear (StyleSharing *sharing)
+{
+  g_hash_table_remove_all (sharing->styles);
+  sharing->n_styles = 0;
+}
+
+static void
+style_sharing_free (gpointer data)
+{
+  StyleSharing *sharing = data;
+
+  g_signal_handlers_disconnect_by_func (sharing->provider, style_sharing_clear, sharing);
+  g_hash_table_unref (sharing->styles);
+
+  g_slice_free (StyleSharing, sharing);
+}
+
+static StyleSharing *
+style_sharing_get (GtkStyleProviderPrivate *provider,
+                   gboolean                 create)
+{
+  StyleSharing *sharing;
+
+  if (G_UNLIKELY (style_sharing_quark == 0))
+    style_sharing_quark = g_quark_from_static_string ("gtk-css-style-sharing");
+
+  sharing = g_object_get_qdata (G_OBJECT (provider), style_sharing_quark);
+  if (sharing != NULL || !create)
+    return sharing;
+
+  sharing = g_slice_new0 (StyleSharing);
+  sharing->provider = provider;
+  sharing->styles = g_hash_table_new_full (shared_key_hash,
+                                           shared_key_equal,
+                                           shared_key_free,
+                                           shared_style_list_free);
+
+  /* All styles are computed from the provider's rules */
+  g_signal_connect_swapped (provider, "-gtk-private-changed",
+                            G_CALLBACK (style_sharing_clear), sharing);
+
+  g_object_set_qdata_full (G_OBJECT (provider), style_sharing_quark,
+                           sharing, style_sharing_free);
+
+  return sharing;
+}
+
+static GtkCssChange
+get_position (gboolean is_first,
+              gboolean is_last)
+{
+  return (is_first ? GTK_CSS_CHANGE_FIRST_CHILD : 0) |
+         (is_last ? GTK_CSS_CHANGE_LAST_CHILD : 0);
+}
+
+/**
+ * gtk_css_node_style_cache_lookup_shared:
+ * @provider: the style provider used for the node
+ * @parent: (allow-none): the style of the node's parent
+ * @decl: the node's declaration
+ * @is_first: if the node is the first visible child
+ * @is_last: if the node is the last visible child
+ *
+ * Looks for a style for the node in the styles shared by all nodes
+ * that are styled by @provider.
+ *
+ * Returns: (transfer none) (nullable): the style or %NULL
+ */
+GtkCssStyle *
+gtk_css_node_style_cache_lookup_shared (GtkStyleProviderPrivate     *provider,
+                                        GtkCssStyle                 *parent,
+                                        const GtkCssNodeDeclaration *decl,
+                                        gboolean                     is_first,
+                                        gboolean                     is_last)
+{
+  StyleSharing *sharing;
+  SharedKey key = { parent, (GtkCssNodeDeclaration *) decl };
+  GtkCssChange position;
+  GSList *l;
+
+  sharing = style_sharing_get (provider, TRUE);
+
+  position = get_position (is_first, is_last);
+
+  for (l = g_hash_table_lookup (sharing->styles, &key); l; l = l->next)
+    {
+      SharedStyle *shared = l->data;
+      GtkCssChange change;
+
+      change = gtk_css_static_style_get_change (GTK_CSS_STATIC_STYLE (shared->style));
+      if ((position & change & SHARING_POSITION) == shared->position)
+        {
+          sharing->hits++;
+          return shared->style;
+        }
+    }
+
+  sharing->misses++;
+
+  return NULL;
+}
+
+/**
+ * gtk_css_node_style_cache_insert_shared:
+ * @provider: the style provider used for the node
+ * @parent: (allow-none): the style of the node's parent
+ * @decl: the node's declaration
+ * @is_first: if the node is the first visible child
+ * @is_last: if the node is the last visible child
+ * @style: the style computed for the node
+ *
+ * Shares @style with all nodes styled by @provider that have the same
+ * parent style and declaration, if it doesn't depend on anything else.
+ */
+void
+gtk_css_node_style_cache_insert_shared (GtkStyleProviderPrivate *provider,
+                                        GtkCssStyle             *parent,
+                                        GtkCssNodeDeclaration   *decl,
+                                        gboolean                 is_first,
+                                        gboolean                 is_last,
+                                        GtkCssStyle             *style)
+{
+  StyleSharing *sharing;
+  SharedKey lookup = { parent, decl };
+  SharedKey *key;
+  SharedStyle *shared;
+  GtkCssChange change;
+  GSList *list;
+
+#ifdef G_ENABLE_DEBUG
+  if (GTK_DEBUG_CHECK (NO_CSS_CACHE))
+    return;
+#endif
+
+  if (!GTK_IS_CSS_STATIC_STYLE (style))
+    return;
+
+  change = gtk_css_static_style_get_change (GTK_CSS_STATIC_STYLE (style));
+  if (change & SHARING_FORBIDDEN)
+    return;
+
+  sharing = style_sharing_get (provider, TRUE);
+
+  if (sharing->n_styles >= MAX_SHARED_STYLES)
+    style_sharing_clear (sharing);
+
+  shared = g_slice_new (SharedStyle);
+  shared->style = g_object_ref (style);
+  shared->position = get_position (is_first, is_last) & change & SHARING_POSITION;
+
+  if (g_hash_table_lookup_extended (sharing->styles, &lookup, (gpointer *) &key, (gpointer *) &list))
+    {
+      g_hash_table_steal (sharing->styles, key);
+    }
+  else
+    {
+      key = g_slice_new (SharedKey);
+      key->parent = parent ? g_object_ref (parent) : NULL;
+      key->decl = gtk_css_node_declaration_ref (decl);
+      list = NULL;
+    }
+
+  g_hash_table_insert (sharing->styles, key, g_slist_prepend (list, shared));
+  sharing->n_styles++;
+}
+
+/**
+ * gtk_css_node_style_cache_get_shared_stats:
+ * @provider: a style provider
+ * @n_styles: (out): the number of shared styles
+ * @hits: (out): the number of lookups that found a style
+ * @misses: (out): the number of lookups that didn't
+ *
+ * Queries statistics about the styles shared for @provider, for
+ * the inspector.
+ */
+void
+gtk_css_node_style_cache_get_shared_stats (GtkStyleProviderPrivate *provider,
+                                           guint                   *n_styles,
+                                           guint                   *hits,
+                                           guint                   *misses)
+{
+  StyleSharing *sharing;
+
+  sharing = style_sharing_get (provider, FALSE);
+  if (sharing == NULL)
+    {
+      *n_styles = *hits = *misses = 0;
+      return;
+    }
+
+  *n_styles = sharing->n_styles;
+  *hits = sharing->hits;
+  *misses = sharing->misses;
+}
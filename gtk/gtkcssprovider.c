@@ -41,11 +41,14 @@
 #include "gtkstyleproviderprivate.h"
 #include "gtkwidgetpath.h"
 #include "gtkbindings.h"
+#include "gtkdebug.h"
 #include "gtkmarshalers.h"
 #include "gtkprivate.h"
 #include "gtkintl.h"
 #include "gtkversion.h"
 
+#include "gdk/gdk-private.h"
+
 /**
  * SECTION:gtkcssprovider
  * @Short_description: CSS-like styling for widgets
@@ -83,6 +86,7 @@ typedef struct _GtkCssScanner GtkCssScanner;
 typedef struct _PropertyValue PropertyValue;
 typedef enum ParserScope ParserScope;
 typedef enum ParserSymbol ParserSymbol;
+typedef struct _GtkCssProviderSnapshot GtkCssProviderSnapshot;
 
 struct _PropertyValue {
   GtkCssStyleProperty *property;
@@ -120,6 +124,16 @@ struct _GtkCssProviderPrivate
   GtkCssSelectorTree *tree;
   GResource *resource;
   gchar *path;
+
+  /* uri => checksum of every file read by a load that can be cached */
+  GHashTable *cache_sources;
+  guint use_theme_cache : 1;
+  guint cacheable : 1;
+
+  /* While emitting a change after a reload: if only the rulesets
+   * matched by changed_tree (which may be NULL) changed */
+  guint partial_change : 1;
+  GtkCssSelectorTree *changed_tree;
 };
 
 enum {
@@ -137,6 +151,9 @@ static void gtk_css_style_provider_private_iface_init (GtkStyleProviderPrivateIn
 static void gtk_css_style_provider_emit_error (GtkStyleProviderPrivate *provider,
                                                GtkCssSection           *section,
                                                const GError            *error);
+static GtkCssProviderSnapshot *gtk_css_provider_snapshot_new (GtkCssProvider *css_provider);
+static void gtk_css_provider_changed (GtkCssProvider         *css_provider,
+                                      GtkCssProviderSnapshot *old);
 
 static void
 gtk_css_provider_load_internal (GtkCssProvider *css_provider,
@@ -340,6 +357,9 @@ gtk_css_provider_emit_error (GtkCssProvider *provider,
                              GtkCssScanner  *scanner,
                              const GError   *error)
 {
+  /* Loading from the cache would not report the error again */
+  provider->priv->cacheable = FALSE;
+
   gtk_css_style_provider_emit_error (GTK_STYLE_PROVIDER_PRIVATE (provider),
                                      scanner ? scanner->section : NULL,
                                      error);
@@ -625,12 +645,42 @@ gtk_css_style_provider_lookup (GtkStyleProviderPrivate *provider,
     }
 }
 
+static gboolean
+gtk_css_style_provider_may_affect (GtkStyleProviderPrivate *provider,
+                                   const GtkCssMatcher     *matcher)
+{
+  GtkCssProvider *css_provider = GTK_CSS_PROVIDER (provider);
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GtkCssMatcher change_matcher;
+  GPtrArray *matches;
+
+  if (!priv->partial_change)
+    return TRUE;
+
+  if (priv->changed_tree == NULL)
+    return FALSE;
+
+  /* Changes to names and classes restyle the node anyway, so only the
+   * rules that could match with the node's current ones matter. This is
+   * the same assumption the change computed in lookup makes. */
+  _gtk_css_matcher_superset_init (&change_matcher, matcher, GTK_CSS_CHANGE_NAME | GTK_CSS_CHANGE_CLASS);
+
+  matches = _gtk_css_selector_tree_match_all (priv->changed_tree, &change_matcher);
+  if (matches == NULL)
+    return FALSE;
+
+  g_ptr_array_free (matches, TRUE);
+
+  return TRUE;
+}
+
 static void
 gtk_css_style_provider_private_iface_init (GtkStyleProviderPrivateInterface *iface)
 {
   iface->get_color = gtk_css_style_provider_get_color;
   iface->get_keyframes = gtk_css_style_provider_get_keyframes;
   iface->lookup = gtk_css_style_provider_lookup;
+  iface->may_affect = gtk_css_style_provider_may_affect;
   iface->emit_error = gtk_css_style_provider_emit_error;
 }
 
@@ -941,6 +991,9 @@ parse_binding_set (GtkCssScanner *scanner)
       goto skip_semicolon;
     }
 
+  /* Binding sets are global, they can't be restored from the cache */
+  scanner->provider->priv->cacheable = FALSE;
+
   binding_set = gtk_binding_set_find (name);
   if (!binding_set)
     {
@@ -1388,6 +1441,589 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
 #endif
 }
 
+/* THEME CACHE
+ *
+ * Parsing a large theme takes a noticeable part of the startup time,
+ * so the result of loading a theme is kept in the user's cache
+ * directory. The cache stores the sorted rulesets together with the
+ * ready-built selector tree. Values are kept in their printed form,
+ * which is what gtk_css_provider_to_string() produces and is known to
+ * parse back to the same value. Every distinct value is only stored
+ * and parsed once and then shared by all rulesets using it.
+ *
+ * The cache is only used when the checksums of the theme and of all
+ * the files it imports match the ones it was created from.
+ */
+
+#define THEME_CACHE_MAGIC   "GTK-CSS-THEME-CACHE"
+#define THEME_CACHE_VERSION 1
+
+/* (header, sources, colors, keyframes, values, rulesets, selector tree) */
+#define THEME_CACHE_TYPE    "(sa(ss)a(ss)a(ss)a(ss)aauv)"
+
+typedef struct {
+  GtkCssStyleProperty *property;
+  GtkCssValue         *value;
+} CachedValue;
+
+static gboolean
+gtk_css_provider_use_theme_cache (GtkCssProvider *css_provider)
+{
+#ifdef VERIFY_TREE
+  /* verifying needs the selectors, which the cache doesn't have */
+  return FALSE;
+#else
+  return css_provider->priv->use_theme_cache &&
+         !gtk_keep_css_sections &&
+         gdk_disk_cache_enabled (GDK_DISK_CACHE_THEMES);
+#endif
+}
+
+/* Besides the version, the header identifies the build: development
+ * versions can change the properties or the selector tree layout
+ * without a version bump.
+ */
+static char *
+gtk_css_provider_get_cache_header (void)
+{
+  return g_strdup_printf ("%s %d %d.%d.%d %d %d %u %x",
+                          THEME_CACHE_MAGIC, THEME_CACHE_VERSION,
+                          GTK_MAJOR_VERSION, GTK_MINOR_VERSION, GTK_MICRO_VERSION,
+                          GLIB_SIZEOF_VOID_P, G_BYTE_ORDER,
+                          _gtk_css_style_property_get_n_properties (),
+                          _gtk_css_selector_tree_get_format_id ());
+}
+
+static char *
+gtk_css_provider_get_cache_path (GFile *file)
+{
+  char *uri, *checksum, *path;
+
+  uri = g_file_get_uri (file);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+  path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "css", checksum, NULL);
+
+  g_free (checksum);
+  g_free (uri);
+
+  return path;
+}
+
+static void
+gtk_css_provider_cache_parser_error (GtkCssParser *parser,
+                                     const GError *error,
+                                     gpointer      user_data)
+{
+  gboolean *failed = user_data;
+
+  *failed = TRUE;
+}
+
+static GtkCssValue *
+gtk_css_provider_parse_cached_value (GtkStyleProperty *property,
+                                     GFile            *file,
+                                     const char       *text)
+{
+  GtkCssParser *parser;
+  GtkCssValue *value;
+  gboolean failed = FALSE;
+
+  parser = _gtk_css_parser_new (text, file, gtk_css_provider_cache_parser_error, &failed);
+  if (property)
+    value = _gtk_style_property_parse_value (property, parser);
+  else
+    value = _gtk_css_color_value_parse (parser);
+
+  if (value != NULL && (failed || !_gtk_css_parser_is_eof (parser)))
+    g_clear_pointer (&value, _gtk_css_value_unref);
+
+  _gtk_css_parser_free (parser);
+
+  return value;
+}
+
+static GtkCssKeyframes *
+gtk_css_provider_parse_cached_keyframes (GFile      *file,
+                                         const char *text)
+{
+  GtkCssParser *parser;
+  GtkCssKeyframes *keyframes;
+  gboolean failed = FALSE;
+  char *block;
+
+  /* The parser expects the block to be closed */
+  block = g_strconcat (text, "}", NULL);
+  parser = _gtk_css_parser_new (block, file, gtk_css_provider_cache_parser_error, &failed);
+
+  keyframes = _gtk_css_keyframes_parse (parser);
+  if (keyframes != NULL &&
+      (failed ||
+       !_gtk_css_parser_try (parser, "}", TRUE) ||
+       !_gtk_css_parser_is_eof (parser)))
+    g_clear_pointer (&keyframes, _gtk_css_keyframes_unref);
+
+  _gtk_css_parser_free (parser);
+  g_free (block);
+
+  return keyframes;
+}
+
+static gboolean
+gtk_css_provider_check_cache_sources (GVariant   *sources,
+                                      GFile      *file,
+                                      const char *text)
+{
+  GVariantIter iter;
+  const char *uri, *checksum;
+  char *main_uri;
+  gboolean result = TRUE;
+
+  main_uri = g_file_get_uri (file);
+
+  g_variant_iter_init (&iter, sources);
+  while (result && g_variant_iter_next (&iter, "(&s&s)", &uri, &checksum))
+    {
+      char *contents, *actual;
+
+      if (g_str_equal (uri, main_uri))
+        {
+          actual = g_compute_checksum_for_string (G_CHECKSUM_SHA256, text, -1);
+        }
+      else
+        {
+          GFile *import = g_file_new_for_uri (uri);
+
+          if (g_file_load_contents (import, NULL, &contents, NULL, NULL, NULL))
+            {
+              actual = g_compute_checksum_for_string (G_CHECKSUM_SHA256, contents, -1);
+              g_free (contents);
+            }
+          else
+            actual = NULL;
+
+          g_object_unref (import);
+        }
+
+      result = g_strcmp0 (actual, checksum) == 0;
+      g_free (actual);
+    }
+
+  g_free (main_uri);
+
+  return result;
+}
+
+static gboolean
+gtk_css_provider_load_cache_contents (GtkCssProvider *css_provider,
+                                      GVariant       *cache,
+                                      GFile          *file,
+                                      const char     *text)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GVariant *sources, *colors, *keyframes, *values, *rulesets, *tree;
+  GPtrArray *parsed_colors, *parsed_keyframes;
+  CachedValue *parsed_values;
+  const char *header;
+  char *expected_header;
+  gsize n_values, i, j;
+  gboolean result = FALSE;
+
+  g_variant_get (cache, "(&s@a(ss)@a(ss)@a(ss)@a(ss)@aauv)",
+                 &header, &sources, &colors, &keyframes, &values, &rulesets, &tree);
+
+  n_values = g_variant_n_children (values);
+  parsed_values = g_new0 (CachedValue, n_values);
+  parsed_colors = g_ptr_array_new_with_free_func ((GDestroyNotify) _gtk_css_value_unref);
+  parsed_keyframes = g_ptr_array_new_with_free_func ((GDestroyNotify) _gtk_css_keyframes_unref);
+
+  expected_header = gtk_css_provider_get_cache_header ();
+  if (!g_str_equal (header, expected_header))
+    goto out;
+
+  if (!gtk_css_provider_check_cache_sources (sources, file, text))
+    goto out;
+
+  for (i = 0; i < g_variant_n_children (colors); i++)
+    {
+      const char *value;
+      GtkCssValue *color;
+
+      g_variant_get_child (colors, i, "(&s&s)", NULL, &value);
+      color = gtk_css_provider_parse_cached_value (NULL, file, value);
+      if (color == NULL)
+        goto out;
+
+      g_ptr_array_add (parsed_colors, color);
+    }
+
+  for (i = 0; i < g_variant_n_children (keyframes); i++)
+    {
+      const char *value;
+      GtkCssKeyframes *parsed;
+
+      g_variant_get_child (keyframes, i, "(&s&s)", NULL, &value);
+      parsed = gtk_css_provider_parse_cached_keyframes (file, value);
+      if (parsed == NULL)
+        goto out;
+
+      g_ptr_array_add (parsed_keyframes, parsed);
+    }
+
+  for (i = 0; i < n_values; i++)
+    {
+      GtkStyleProperty *property;
+      const char *name, *value;
+
+      g_variant_get_child (values, i, "(&s&s)", &name, &value);
+
+      /* Shorthands are split up when parsing, only longhands end up here */
+      property = _gtk_style_property_lookup (name);
+      if (!GTK_IS_CSS_STYLE_PROPERTY (property))
+        goto out;
+
+      parsed_values[i].property = GTK_CSS_STYLE_PROPERTY (property);
+      parsed_values[i].value = gtk_css_provider_parse_cached_value (property, file, value);
+      if (parsed_values[i].value == NULL)
+        goto out;
+    }
+
+  g_array_set_size (priv->rulesets, g_variant_n_children (rulesets));
+  memset (priv->rulesets->data, 0, priv->rulesets->len * sizeof (GtkCssRuleset));
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      GVariant *indexes;
+      const guint32 *idx;
+      gsize n;
+
+      indexes = g_variant_get_child_value (rulesets, i);
+      idx = g_variant_get_fixed_array (indexes, &n, sizeof (guint32));
+
+      for (j = 0; j < n; j++)
+        {
+          if (idx[j] >= n_values)
+            break;
+
+          gtk_css_ruleset_add (ruleset,
+                               parsed_values[idx[j]].property,
+                               _gtk_css_value_ref (parsed_values[idx[j]].value),
+                               NULL);
+        }
+
+      g_variant_unref (indexes);
+
+      if (j < n)
+        goto out;
+    }
+
+  if (!_gtk_css_selector_tree_deserialize (tree,
+                                           priv->rulesets->data,
+                                           sizeof (GtkCssRuleset),
+                                           priv->rulesets->len,
+                                           G_STRUCT_OFFSET (GtkCssRuleset, selector_match),
+                                           &priv->tree))
+    goto out;
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      if (g_array_index (priv->rulesets, GtkCssRuleset, i).selector_match == NULL)
+        goto out;
+    }
+
+  for (i = 0; i < parsed_colors->len; i++)
+    {
+      const char *name;
+
+      g_variant_get_child (colors, i, "(&s&s)", &name, NULL);
+      g_hash_table_insert (priv->symbolic_colors,
+                           g_strdup (name),
+                           _gtk_css_value_ref (g_ptr_array_index (parsed_colors, i)));
+    }
+
+  for (i = 0; i < parsed_keyframes->len; i++)
+    {
+      const char *name;
+
+      g_variant_get_child (keyframes, i, "(&s&s)", &name, NULL);
+      g_hash_table_insert (priv->keyframes,
+                           g_strdup (name),
+                           _gtk_css_keyframes_ref (g_ptr_array_index (parsed_keyframes, i)));
+    }
+
+  result = TRUE;
+
+out:
+  if (!result)
+    {
+      for (i = 0; i < priv->rulesets->len; i++)
+        gtk_css_ruleset_clear (&g_array_index (priv->rulesets, GtkCssRuleset, i));
+      g_array_set_size (priv->rulesets, 0);
+      _gtk_css_selector_tree_free (priv->tree);
+      priv->tree = NULL;
+    }
+
+  for (i = 0; i < n_values; i++)
+    {
+      if (parsed_values[i].value)
+        _gtk_css_value_unref (parsed_values[i].value);
+    }
+  g_free (parsed_values);
+  g_ptr_array_unref (parsed_colors);
+  g_ptr_array_unref (parsed_keyframes);
+  g_free (expected_header);
+
+  g_variant_unref (sources);
+  g_variant_unref (colors);
+  g_variant_unref (keyframes);
+  g_variant_unref (values);
+  g_variant_unref (rulesets);
+  g_variant_unref (tree);
+
+  return result;
+}
+
+static gboolean
+gtk_css_provider_load_cache (GtkCssProvider *css_provider,
+                             GFile          *file,
+                             const char     *text)
+{
+  GMappedFile *mapped;
+  GBytes *bytes;
+  GVariant *cache;
+  char *path;
+  gboolean result;
+
+  path = gtk_css_provider_get_cache_path (file);
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  g_free (path);
+
+  if (mapped == NULL)
+    return FALSE;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  g_mapped_file_unref (mapped);
+
+  cache = g_variant_new_from_bytes (G_VARIANT_TYPE (THEME_CACHE_TYPE), bytes, FALSE);
+  g_variant_ref_sink (cache);
+  g_bytes_unref (bytes);
+
+  result = gtk_css_provider_load_cache_contents (css_provider, cache, file, text);
+
+  g_variant_unref (cache);
+
+  return result;
+}
+
+/* Checks that @value survives printing and parsing it again, and
+ * returns the printed form.
+ */
+static char *
+gtk_css_provider_print_cached_value (GtkStyleProperty *property,
+                                     GFile            *file,
+                                     GtkCssValue      *value)
+{
+  GtkCssValue *parsed;
+  char *printed, *reprinted;
+
+  printed = _gtk_css_value_to_string (value);
+  parsed = gtk_css_provider_parse_cached_value (property, file, printed);
+  if (parsed == NULL)
+    {
+      g_free (printed);
+      return NULL;
+    }
+
+  reprinted = _gtk_css_value_to_string (parsed);
+  _gtk_css_value_unref (parsed);
+
+  if (!g_str_equal (printed, reprinted))
+    g_clear_pointer (&printed, g_free);
+
+  g_free (reprinted);
+
+  return printed;
+}
+
+static char *
+gtk_css_provider_print_cached_keyframes (GFile           *file,
+                                         GtkCssKeyframes *keyframes)
+{
+  GtkCssKeyframes *parsed;
+  GString *printed, *reprinted;
+
+  printed = g_string_new (NULL);
+  _gtk_css_keyframes_print (keyframes, printed);
+
+  parsed = gtk_css_provider_parse_cached_keyframes (file, printed->str);
+  if (parsed == NULL)
+    {
+      g_string_free (printed, TRUE);
+      return NULL;
+    }
+
+  reprinted = g_string_new (NULL);
+  _gtk_css_keyframes_print (parsed, reprinted);
+  _gtk_css_keyframes_unref (parsed);
+
+  if (!g_string_equal (printed, reprinted))
+    {
+      g_string_free (printed, TRUE);
+      printed = NULL;
+    }
+
+  g_string_free (reprinted, TRUE);
+
+  return printed ? g_string_free (printed, FALSE) : NULL;
+}
+
+static GVariant *
+gtk_css_provider_serialize_cache (GtkCssProvider *css_provider,
+                                  GFile          *file)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GVariantBuilder sources, colors, keyframes, values, rulesets;
+  GHashTable *value_indexes;
+  GHashTableIter iter;
+  gpointer key, value;
+  char *header;
+  guint i, j;
+
+  g_variant_builder_init (&sources, G_VARIANT_TYPE ("a(ss)"));
+  g_variant_builder_init (&colors, G_VARIANT_TYPE ("a(ss)"));
+  g_variant_builder_init (&keyframes, G_VARIANT_TYPE ("a(ss)"));
+  g_variant_builder_init (&values, G_VARIANT_TYPE ("a(ss)"));
+  g_variant_builder_init (&rulesets, G_VARIANT_TYPE ("aau"));
+
+  g_hash_table_iter_init (&iter, priv->cache_sources);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_variant_builder_add (&sources, "(ss)", key, value);
+
+  g_hash_table_iter_init (&iter, priv->symbolic_colors);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      char *printed = gtk_css_provider_print_cached_value (NULL, file, value);
+
+      if (printed == NULL)
+        goto fail;
+
+      g_variant_builder_add (&colors, "(ss)", key, printed);
+      g_free (printed);
+    }
+
+  g_hash_table_iter_init (&iter, priv->keyframes);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      char *printed = gtk_css_provider_print_cached_keyframes (file, value);
+
+      if (printed == NULL)
+        goto fail;
+
+      g_variant_builder_add (&keyframes, "(ss)", key, printed);
+      g_free (printed);
+    }
+
+  /* "property: value" => index */
+  value_indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      GVariantBuilder indexes;
+
+      g_variant_builder_init (&indexes, G_VARIANT_TYPE ("au"));
+
+      for (j = 0; j < ruleset->n_styles; j++)
+        {
+          GtkStyleProperty *property = GTK_STYLE_PROPERTY (ruleset->styles[j].property);
+          const char *name = _gtk_style_property_get_name (property);
+          char *printed, *declaration;
+          gpointer index;
+
+          printed = _gtk_css_value_to_string (ruleset->styles[j].value);
+          declaration = g_strconcat (name, ": ", printed, NULL);
+          g_free (printed);
+
+          if (!g_hash_table_lookup_extended (value_indexes, declaration, NULL, &index))
+            {
+              printed = gtk_css_provider_print_cached_value (property, file, ruleset->styles[j].value);
+              if (printed == NULL)
+                {
+                  g_free (declaration);
+                  g_variant_builder_clear (&indexes);
+                  g_hash_table_unref (value_indexes);
+                  goto fail;
+                }
+
+              index = GUINT_TO_POINTER (g_hash_table_size (value_indexes));
+              g_variant_builder_add (&values, "(ss)", name, printed);
+              g_hash_table_insert (value_indexes, declaration, index);
+              g_free (printed);
+            }
+          else
+            g_free (declaration);
+
+          g_variant_builder_add (&indexes, "u", GPOINTER_TO_UINT (index));
+        }
+
+      g_variant_builder_add_value (&rulesets, g_variant_builder_end (&indexes));
+    }
+
+  g_hash_table_unref (value_indexes);
+
+  header = gtk_css_provider_get_cache_header ();
+  value = g_variant_new ("(s@a(ss)@a(ss)@a(ss)@a(ss)@aauv)",
+                         header,
+                         g_variant_builder_end (&sources),
+                         g_variant_builder_end (&colors),
+                         g_variant_builder_end (&keyframes),
+                         g_variant_builder_end (&values),
+                         g_variant_builder_end (&rulesets),
+                         _gtk_css_selector_tree_serialize (priv->tree,
+                                                           priv->rulesets->data,
+                                                           sizeof (GtkCssRuleset)));
+  g_free (header);
+
+  return value;
+
+fail:
+  g_variant_builder_clear (&sources);
+  g_variant_builder_clear (&colors);
+  g_variant_builder_clear (&keyframes);
+  g_variant_builder_clear (&values);
+  g_variant_builder_clear (&rulesets);
+
+  return NULL;
+}
+
+static void
+gtk_css_provider_save_cache (GtkCssProvider *css_provider,
+                             GFile          *file)
+{
+  GVariant *cache;
+  char *path, *dir;
+
+  cache = gtk_css_provider_serialize_cache (css_provider, file);
+  if (cache == NULL)
+    return;
+
+  g_variant_ref_sink (cache);
+
+  path = gtk_css_provider_get_cache_path (file);
+  dir = g_path_get_dirname (path);
+
+  /* The cache is an optimization, failing to write it is fine */
+  if (g_mkdir_with_parents (dir, 0755) == 0)
+    g_file_set_contents (path,
+                         g_variant_get_data (cache),
+                         g_variant_get_size (cache),
+                         NULL);
+
+  g_free (dir);
+  g_free (path);
+  g_variant_unref (cache);
+}
+
 static void
 gtk_css_provider_load_internal (GtkCssProvider *css_provider,
                                 GtkCssScanner  *parent,
@@ -1440,6 +2076,26 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
 
   if (text)
     {
+      GtkCssProviderPrivate *priv = css_provider->priv;
+
+      if (parent == NULL && file != NULL &&
+          gtk_css_provider_use_theme_cache (css_provider))
+        {
+          if (gtk_css_provider_load_cache (css_provider, file, text))
+            {
+              g_free (free_data);
+              return;
+            }
+
+          priv->cache_sources = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+          priv->cacheable = TRUE;
+        }
+
+      if (priv->cache_sources && file)
+        g_hash_table_insert (priv->cache_sources,
+                             g_file_get_uri (file),
+                             g_compute_checksum_for_string (G_CHECKSUM_SHA256, text, -1));
+
       scanner = gtk_css_scanner_new (css_provider,
                                      parent,
                                      parent ? parent->section : NULL,
@@ -1451,7 +2107,17 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
       gtk_css_scanner_destroy (scanner);
 
       if (parent == NULL)
-        gtk_css_provider_postprocess (css_provider);
+        {
+          gtk_css_provider_postprocess (css_provider);
+
+          if (priv->cache_sources)
+            {
+              if (priv->cacheable)
+                gtk_css_provider_save_cache (css_provider, file);
+
+              g_clear_pointer (&priv->cache_sources, g_hash_table_unref);
+            }
+        }
     }
 
   g_free (free_data);
@@ -1474,6 +2140,7 @@ gtk_css_provider_load_from_data (GtkCssProvider  *css_provider,
                                  gssize           length)
 {
   char *free_data;
+  GtkCssProviderSnapshot *snapshot;
 
   g_return_if_fail (GTK_IS_CSS_PROVIDER (css_provider));
   g_return_if_fail (data != NULL);
@@ -1489,13 +2156,15 @@ gtk_css_provider_load_from_data (GtkCssProvider  *css_provider,
       data = free_data;
     }
 
+  snapshot = gtk_css_provider_snapshot_new (css_provider);
+
   gtk_css_provider_reset (css_provider);
 
   gtk_css_provider_load_internal (css_provider, NULL, NULL, data);
 
   g_free (free_data);
 
-  _gtk_style_provider_private_changed (GTK_STYLE_PROVIDER_PRIVATE (css_provider));
+  gtk_css_provider_changed (css_provider, snapshot);
 }
 
 /**
@@ -1510,14 +2179,18 @@ void
 gtk_css_provider_load_from_file (GtkCssProvider  *css_provider,
                                  GFile           *file)
 {
+  GtkCssProviderSnapshot *snapshot;
+
   g_return_if_fail (GTK_IS_CSS_PROVIDER (css_provider));
   g_return_if_fail (G_IS_FILE (file));
 
+  snapshot = gtk_css_provider_snapshot_new (css_provider);
+
   gtk_css_provider_reset (css_provider);
 
   gtk_css_provider_load_internal (css_provider, NULL, file, NULL);
 
-  _gtk_style_provider_private_changed (GTK_STYLE_PROVIDER_PRIVATE (css_provider));
+  gtk_css_provider_changed (css_provider, snapshot);
 }
 
 /**
@@ -1753,7 +2426,9 @@ _gtk_css_provider_load_named (GtkCssProvider *provider,
 
   if (g_resources_get_info (resource_path, 0, NULL, NULL, NULL))
     {
+      provider->priv->use_theme_cache = TRUE;
       gtk_css_provider_load_from_resource (provider, resource_path);
+      provider->priv->use_theme_cache = FALSE;
       g_free (resource_path);
       return;
     }
@@ -1774,7 +2449,9 @@ _gtk_css_provider_load_named (GtkCssProvider *provider,
       if (resource != NULL)
         g_resources_register (resource);
 
+      provider->priv->use_theme_cache = TRUE;
       gtk_css_provider_load_from_path (provider, path);
+      provider->priv->use_theme_cache = FALSE;
 
       /* Only set this after load, as load_from_path will clear it */
       provider->priv->resource = resource;
@@ -1981,3 +2658,232 @@ gtk_css_provider_to_string (GtkCssProvider *provider)
   return g_string_free (str, FALSE);
 }
 
+/* INCREMENTAL RELOADS
+ *
+ * Reloading a provider used to restyle every node using it. Instead,
+ * the rulesets from before the reload are kept and compared with the
+ * new ones, and only nodes that may match a ruleset that was added,
+ * removed or modified get restyled. Rulesets are sorted, so a few
+ * changed rules show up between a common start and a common end.
+ */
+
+/* Compare larger providers, like themes, as a whole */
+#define MAX_SNAPSHOT_RULESETS 2048
+#define MAX_CHANGED_RULESETS 64
+
+struct _GtkCssProviderSnapshot
+{
+  GHashTable *symbolic_colors;
+  char *keyframes;              /* printed, as they are rarely used */
+  GArray *rulesets;
+  GtkCssSelectorTree *tree;     /* the selectors of the rulesets */
+};
+
+static void
+gtk_css_provider_snapshot_free (GtkCssProviderSnapshot *snapshot)
+{
+  guint i;
+
+  for (i = 0; i < snapshot->rulesets->len; i++)
+    gtk_css_ruleset_clear (&g_array_index (snapshot->rulesets, GtkCssRuleset, i));
+  g_array_free (snapshot->rulesets, TRUE);
+  _gtk_css_selector_tree_free (snapshot->tree);
+
+  g_hash_table_destroy (snapshot->symbolic_colors);
+  g_free (snapshot->keyframes);
+  g_slice_free (GtkCssProviderSnapshot, snapshot);
+}
+
+static char *
+gtk_css_provider_print_all_keyframes (GtkCssProvider *css_provider)
+{
+  GString *str;
+
+  str = g_string_new (NULL);
+  gtk_css_provider_print_keyframes (css_provider->priv->keyframes, str);
+
+  return g_string_free (str, FALSE);
+}
+
+/* Takes the current rulesets and colors of @css_provider, which is about
+ * to be reset, so they can be compared with the ones after the reload
+ */
+static GtkCssProviderSnapshot *
+gtk_css_provider_snapshot_new (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GtkCssProviderSnapshot *snapshot;
+
+  /* Nothing is styled with a provider that isn't used yet */
+  if (priv->rulesets->len == 0 ||
+      priv->rulesets->len > MAX_SNAPSHOT_RULESETS ||
+      !_gtk_style_provider_private_has_users (GTK_STYLE_PROVIDER_PRIVATE (css_provider)))
+    return NULL;
+
+  snapshot = g_slice_new (GtkCssProviderSnapshot);
+
+  snapshot->symbolic_colors = priv->symbolic_colors;
+  priv->symbolic_colors = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                 (GDestroyNotify) g_free,
+                                                 (GDestroyNotify) _gtk_css_value_unref);
+  snapshot->keyframes = gtk_css_provider_print_all_keyframes (css_provider);
+
+  snapshot->rulesets = priv->rulesets;
+  priv->rulesets = g_array_new (FALSE, FALSE, sizeof (GtkCssRuleset));
+  snapshot->tree = priv->tree;
+  priv->tree = NULL;
+
+  return snapshot;
+}
+
+static gboolean
+gtk_css_provider_colors_equal (GHashTable *colors1,
+                               GHashTable *colors2)
+{
+  GHashTableIter iter;
+  gpointer name, value;
+
+  if (g_hash_table_size (colors1) != g_hash_table_size (colors2))
+    return FALSE;
+
+  g_hash_table_iter_init (&iter, colors1);
+  while (g_hash_table_iter_next (&iter, &name, &value))
+    {
+      GtkCssValue *other = g_hash_table_lookup (colors2, name);
+
+      if (other == NULL || !_gtk_css_value_equal (value, other))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gtk_css_ruleset_equal (const GtkCssRuleset *ruleset1,
+                       const GtkCssRuleset *ruleset2)
+{
+  guint i;
+
+  if (ruleset1->n_styles != ruleset2->n_styles)
+    return FALSE;
+
+  for (i = 0; i < ruleset1->n_styles; i++)
+    {
+      if (ruleset1->styles[i].property != ruleset2->styles[i].property ||
+          !_gtk_css_value_equal (ruleset1->styles[i].value, ruleset2->styles[i].value))
+        return FALSE;
+    }
+
+  return _gtk_css_selector_tree_match_equal (ruleset1->selector_match,
+                                             ruleset2->selector_match);
+}
+
+static void
+gtk_css_provider_add_changed_selector (GtkCssSelectorTreeBuilder *builder,
+                                       GPtrArray                 *selectors,
+                                       const GtkCssRuleset       *ruleset)
+{
+  GtkCssSelector *selector;
+
+  selector = _gtk_css_selector_tree_match_copy_selector (ruleset->selector_match);
+  _gtk_css_selector_tree_builder_add (builder, selector, NULL, selector);
+  g_ptr_array_add (selectors, selector);
+}
+
+#define RULESET(array, i) (&g_array_index ((array), GtkCssRuleset, (i)))
+
+/* Returns %FALSE if everything needs to be considered changed */
+static gboolean
+gtk_css_provider_diff (GtkCssProvider          *css_provider,
+                       GtkCssProviderSnapshot  *old,
+                       GtkCssSelectorTree     **changed_tree)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GArray *new_rulesets = priv->rulesets;
+  GtkCssSelectorTreeBuilder *builder;
+  GPtrArray *selectors;
+  guint i, start, old_end, new_end;
+  gboolean keyframes_equal;
+  char *keyframes;
+
+  if (new_rulesets->len > MAX_SNAPSHOT_RULESETS ||
+      !gtk_css_provider_colors_equal (old->symbolic_colors, priv->symbolic_colors))
+    return FALSE;
+
+  keyframes = gtk_css_provider_print_all_keyframes (css_provider);
+  keyframes_equal = g_str_equal (old->keyframes, keyframes);
+  g_free (keyframes);
+  if (!keyframes_equal)
+    return FALSE;
+
+  for (start = 0;
+       start < old->rulesets->len && start < new_rulesets->len;
+       start++)
+    {
+      if (!gtk_css_ruleset_equal (RULESET (old->rulesets, start),
+                                  RULESET (new_rulesets, start)))
+        break;
+    }
+
+  for (old_end = old->rulesets->len, new_end = new_rulesets->len;
+       old_end > start && new_end > start;
+       old_end--, new_end--)
+    {
+      if (!gtk_css_ruleset_equal (RULESET (old->rulesets, old_end - 1),
+                                  RULESET (new_rulesets, new_end - 1)))
+        break;
+    }
+
+  if ((old_end - start) + (new_end - start) > MAX_CHANGED_RULESETS)
+    return FALSE;
+
+  if (old_end == start && new_end == start)
+    {
+      *changed_tree = NULL;
+      return TRUE;
+    }
+
+  builder = _gtk_css_selector_tree_builder_new ();
+  selectors = g_ptr_array_new_with_free_func ((GDestroyNotify) _gtk_css_selector_free);
+
+  for (i = start; i < old_end; i++)
+    gtk_css_provider_add_changed_selector (builder, selectors, RULESET (old->rulesets, i));
+  for (i = start; i < new_end; i++)
+    gtk_css_provider_add_changed_selector (builder, selectors, RULESET (new_rulesets, i));
+
+  *changed_tree = _gtk_css_selector_tree_builder_build (builder);
+
+  _gtk_css_selector_tree_builder_free (builder);
+  g_ptr_array_unref (selectors);
+
+  return TRUE;
+}
+
+#undef RULESET
+
+/* Emits the changed signal after a reload, telling nodes that
+ * did not match any of the changed rulesets that they are unaffected
+ */
+static void
+gtk_css_provider_changed (GtkCssProvider         *css_provider,
+                          GtkCssProviderSnapshot *old)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GtkCssSelectorTree *changed_tree = NULL;
+  gboolean partial = FALSE;
+
+  if (old != NULL)
+    {
+      partial = gtk_css_provider_diff (css_provider, old, &changed_tree);
+      gtk_css_provider_snapshot_free (old);
+    }
+
+  priv->partial_change = partial;
+  priv->changed_tree = changed_tree;
+
+  _gtk_style_provider_private_changed (GTK_STYLE_PROVIDER_PRIVATE (css_provider));
+
+  priv->partial_change = FALSE;
+  priv->changed_tree = NULL;
+  _gtk_css_selector_tree_free (changed_tree);
+}
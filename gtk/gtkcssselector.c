@@ -1474,6 +1474,56 @@ gtk_css_selectors_skip_initial_selector (GtkCssSelector *selector, const GtkCssS
   return (GtkCssSelector *)gtk_css_selector_previous (selector);
 }
 
+typedef struct {
+  GPtrArray *array;
+  /* NULL or a filter of the ancestors of the matched node */
+  const GtkCssAncestorFilter *filter;
+} TreeMatchData;
+
+static gboolean gtk_css_selector_tree_previous_may_match (const GtkCssSelectorTree   *tree,
+                                                          const GtkCssAncestorFilter *filter);
+
+/* Checks if the compound selector starting at @tree can match any ancestor
+ * in @filter. Only names, classes and ids are checked, everything
+ * else is assumed to match.
+ */
+static gboolean
+gtk_css_selector_tree_ancestor_may_match (const GtkCssSelectorTree   *tree,
+                                          const GtkCssAncestorFilter *filter)
+{
+  const GtkCssSelectorClass *class = tree->selector.class;
+
+  if (class == &GTK_CSS_SELECTOR_NAME)
+    return _gtk_css_ancestor_filter_may_have_name (filter, tree->selector.name.name);
+  else if (class == &GTK_CSS_SELECTOR_CLASS)
+    return _gtk_css_ancestor_filter_may_have_class (filter, tree->selector.style_class.style_class);
+  else if (class == &GTK_CSS_SELECTOR_ID)
+    return _gtk_css_ancestor_filter_may_have_id (filter, tree->selector.id.name);
+
+  if (!class->is_simple || gtk_css_selector_tree_get_matches (tree))
+    return TRUE;
+
+  /* The compound selector continues, check the rest of it */
+  return gtk_css_selector_tree_previous_may_match (tree, filter);
+}
+
+static gboolean
+gtk_css_selector_tree_previous_may_match (const GtkCssSelectorTree   *tree,
+                                          const GtkCssAncestorFilter *filter)
+{
+  const GtkCssSelectorTree *prev;
+
+  for (prev = gtk_css_selector_tree_get_previous (tree);
+       prev != NULL;
+       prev = gtk_css_selector_tree_get_sibling (prev))
+    {
+      if (gtk_css_selector_tree_ancestor_may_match (prev, filter))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 static gboolean
 gtk_css_selector_tree_match_foreach (const GtkCssSelector *selector,
                                      const GtkCssMatcher  *matcher,
@@ -1481,16 +1531,28 @@ gtk_css_selector_tree_match_foreach (const GtkCssSelector *selector,
 {
   const GtkCssSelectorTree *tree = (const GtkCssSelectorTree *) selector;
   const GtkCssSelectorTree *prev;
+  TreeMatchData *data = res;
 
   if (!gtk_css_selector_match (selector, matcher))
     return FALSE;
 
-  gtk_css_selector_tree_found_match (tree, res);
+  gtk_css_selector_tree_found_match (tree, &data->array);
 
   for (prev = gtk_css_selector_tree_get_previous (tree);
        prev != NULL;
        prev = gtk_css_selector_tree_get_sibling (prev))
-    gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+    {
+      /* All ancestors of any node we get to here are also ancestors
+       * of the node we started with, so the filter is still valid.
+       * Skip walking up the tree if no ancestor can match.
+       */
+      if (data->filter &&
+          prev->selector.class == &GTK_CSS_SELECTOR_DESCENDANT &&
+          !gtk_css_selector_tree_previous_may_match (prev, data->filter))
+        continue;
+
+      gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+    }
 
   return FALSE;
 }
@@ -1499,13 +1561,16 @@ GPtrArray *
 _gtk_css_selector_tree_match_all (const GtkCssSelectorTree *tree,
 				  const GtkCssMatcher *matcher)
 {
-  GPtrArray *array = NULL;
+  TreeMatchData data;
+
+  data.array = NULL;
+  data.filter = _gtk_css_matcher_get_ancestor_filter (matcher);
 
   for (; tree != NULL;
        tree = gtk_css_selector_tree_get_sibling (tree))
-    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &array);
+    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &data);
 
-  return array;
+  return data.array;
 }
 
 /* When checking for changes via the tree we need to know if a rule further
@@ -1668,6 +1733,104 @@ _gtk_css_selector_tree_match_print (const GtkCssSelectorTree *tree,
     }
 }
 
+/* Checks that every simple selector of the compound selector from @a up
+ * to @a_end is also in the one from @b up to @b_end
+ */
+static gboolean
+gtk_css_selector_tree_compound_contains (const GtkCssSelectorTree *a,
+                                         const GtkCssSelectorTree *a_end,
+                                         const GtkCssSelectorTree *b,
+                                         const GtkCssSelectorTree *b_end)
+{
+  const GtkCssSelectorTree *iter, *other;
+
+  for (iter = a; iter != a_end; iter = gtk_css_selector_tree_get_parent (iter))
+    {
+      for (other = b; other != b_end; other = gtk_css_selector_tree_get_parent (other))
+        {
+          if (gtk_css_selector_equal (&iter->selector, &other->selector))
+            break;
+        }
+
+      if (other == b_end)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*< private >
+ * _gtk_css_selector_tree_match_equal:
+ * @a: the node of a ruleset in a tree
+ * @b: the node of a ruleset in a possibly different tree
+ *
+ * Checks if the selectors leading to @a and @b are the same. The simple
+ * selectors of a compound selector can be in a different order in each
+ * tree, so compound selectors are compared as sets.
+ *
+ * Returns: %TRUE if both rulesets have the same selector
+ */
+gboolean
+_gtk_css_selector_tree_match_equal (const GtkCssSelectorTree *a,
+                                    const GtkCssSelectorTree *b)
+{
+  const GtkCssSelectorTree *a_start, *b_start;
+
+  while (a != NULL && b != NULL)
+    {
+      a_start = a;
+      while (a && a->selector.class->is_simple)
+        a = gtk_css_selector_tree_get_parent (a);
+
+      b_start = b;
+      while (b && b->selector.class->is_simple)
+        b = gtk_css_selector_tree_get_parent (b);
+
+      if (!gtk_css_selector_tree_compound_contains (a_start, a, b_start, b) ||
+          !gtk_css_selector_tree_compound_contains (b_start, b, a_start, a))
+        return FALSE;
+
+      /* The combinators */
+      if (a == NULL || b == NULL)
+        break;
+
+      if (!gtk_css_selector_equal (&a->selector, &b->selector))
+        return FALSE;
+
+      a = gtk_css_selector_tree_get_parent (a);
+      b = gtk_css_selector_tree_get_parent (b);
+    }
+
+  return a == NULL && b == NULL;
+}
+
+/*< private >
+ * _gtk_css_selector_tree_match_copy_selector:
+ * @tree: the node of a ruleset in a tree
+ *
+ * Recreates the selector of a ruleset from its tree.
+ *
+ * Returns: a new selector, free with _gtk_css_selector_free()
+ */
+GtkCssSelector *
+_gtk_css_selector_tree_match_copy_selector (const GtkCssSelectorTree *tree)
+{
+  const GtkCssSelectorTree *iter;
+  GtkCssSelector *selector;
+  guint n;
+
+  n = 0;
+  for (iter = tree; iter; iter = gtk_css_selector_tree_get_parent (iter))
+    n++;
+
+  /* The root of the tree holds the first selector */
+  selector = g_new0 (GtkCssSelector, n + 1);
+  for (iter = tree; iter; iter = gtk_css_selector_tree_get_parent (iter))
+    selector[--n] = iter->selector;
+
+  return selector;
+}
+
 void
 _gtk_css_selector_tree_free (GtkCssSelectorTree *tree)
 {
@@ -1901,3 +2064,392 @@ _gtk_css_selector_tree_builder_build (GtkCssSelectorTreeBuilder *builder)
 
   return tree;
 }
+
+/* SERIALIZATION */
+
+/* The selector tree is stored as its raw bytes, with all pointers
+ * cleared. Nodes and match arrays are listed separately so their
+ * pointers can be restored and their offsets checked when loading.
+ */
+#define SERIALIZED_TREE_TYPE "(aya(uys)a(uau))"
+
+static const GtkCssSelectorClass *serialized_classes[] = {
+  &GTK_CSS_SELECTOR_DESCENDANT,
+  &GTK_CSS_SELECTOR_CHILD,
+  &GTK_CSS_SELECTOR_SIBLING,
+  &GTK_CSS_SELECTOR_ADJACENT,
+  &GTK_CSS_SELECTOR_ANY,
+  &GTK_CSS_SELECTOR_NOT_ANY,
+  &GTK_CSS_SELECTOR_NAME,
+  &GTK_CSS_SELECTOR_NOT_NAME,
+  &GTK_CSS_SELECTOR_CLASS,
+  &GTK_CSS_SELECTOR_NOT_CLASS,
+  &GTK_CSS_SELECTOR_ID,
+  &GTK_CSS_SELECTOR_NOT_ID,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION
+};
+
+/*< private >
+ * _gtk_css_selector_tree_get_format_id:
+ *
+ * Returns a number that changes with the layout of serialized trees,
+ * to tell apart trees written by a different build of GTK+.
+ *
+ * Returns: the format id
+ */
+guint
+_gtk_css_selector_tree_get_format_id (void)
+{
+  return (sizeof (GtkCssSelectorTree) << 16) |
+         (sizeof (GtkCssSelector) << 8) |
+         G_N_ELEMENTS (serialized_classes);
+}
+
+static void
+serialize_tree (const GtkCssSelectorTree *tree,
+                const guint8             *data,
+                const guint8             *matches_base,
+                gsize                     match_size,
+                GVariantBuilder          *nodes,
+                GVariantBuilder          *matches,
+                gsize                    *len)
+{
+  while (tree != NULL)
+    {
+      const GtkCssSelectorClass *class = tree->selector.class;
+      guint32 offset = (const guint8 *) tree - data;
+      const char *payload = "";
+      gpointer *tree_matches;
+      guint i;
+
+      for (i = 0; i < G_N_ELEMENTS (serialized_classes); i++)
+        {
+          if (serialized_classes[i] == class)
+            break;
+        }
+      g_assert (i < G_N_ELEMENTS (serialized_classes));
+
+      if (class == &GTK_CSS_SELECTOR_NAME || class == &GTK_CSS_SELECTOR_NOT_NAME)
+        payload = tree->selector.name.name;
+      else if (class == &GTK_CSS_SELECTOR_ID || class == &GTK_CSS_SELECTOR_NOT_ID)
+        payload = tree->selector.id.name;
+      else if (class == &GTK_CSS_SELECTOR_CLASS || class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        payload = g_quark_to_string (tree->selector.style_class.style_class);
+
+      g_variant_builder_add (nodes, "(uys)", offset, (guchar) i, payload);
+      *len = MAX (*len, offset + sizeof (GtkCssSelectorTree));
+
+      tree_matches = gtk_css_selector_tree_get_matches (tree);
+      if (tree_matches)
+        {
+          GVariantBuilder indexes;
+
+          g_variant_builder_init (&indexes, G_VARIANT_TYPE ("au"));
+          for (i = 0; tree_matches[i] != NULL; i++)
+            g_variant_builder_add (&indexes, "u",
+                                   (guint32) (((guint8 *) tree_matches[i] - matches_base) / match_size));
+
+          g_variant_builder_add (matches, "(u@au)",
+                                 (guint32) (offset + tree->matches_offset),
+                                 g_variant_builder_end (&indexes));
+          *len = MAX (*len, offset + tree->matches_offset + (i + 1) * sizeof (gpointer));
+        }
+
+      serialize_tree (gtk_css_selector_tree_get_previous (tree),
+                      data, matches_base, match_size,
+                      nodes, matches, len);
+
+      tree = gtk_css_selector_tree_get_sibling (tree);
+    }
+}
+
+static void
+clear_tree_pointers (GtkCssSelectorTree *tree)
+{
+  while (tree != NULL)
+    {
+      gpointer *tree_matches = gtk_css_selector_tree_get_matches (tree);
+
+      if (tree_matches)
+        {
+          guint i;
+
+          for (i = 0; tree_matches[i] != NULL; i++)
+            tree_matches[i] = NULL;
+        }
+
+      /* State and position selectors keep their payload, it is
+       * plain data
+       */
+      if (tree->selector.class == &GTK_CSS_SELECTOR_NAME ||
+          tree->selector.class == &GTK_CSS_SELECTOR_NOT_NAME ||
+          tree->selector.class == &GTK_CSS_SELECTOR_ID ||
+          tree->selector.class == &GTK_CSS_SELECTOR_NOT_ID ||
+          tree->selector.class == &GTK_CSS_SELECTOR_CLASS ||
+          tree->selector.class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        memset (&tree->selector, 0, sizeof (GtkCssSelector));
+      else
+        tree->selector.class = NULL;
+
+      clear_tree_pointers ((GtkCssSelectorTree *) gtk_css_selector_tree_get_previous (tree));
+
+      tree = (GtkCssSelectorTree *) gtk_css_selector_tree_get_sibling (tree);
+    }
+}
+
+/*< private >
+ * _gtk_css_selector_tree_serialize:
+ * @tree: (allow-none): a tree built by _gtk_css_selector_tree_builder_build()
+ * @matches_base: the start of the array holding all matches of @tree
+ * @match_size: the size of an element of that array
+ *
+ * Serializes @tree so it can be recreated with
+ * _gtk_css_selector_tree_deserialize(). The matches of @tree must all
+ * be elements of the same array, they are stored as indexes into it.
+ *
+ * Returns: (transfer floating): a #GVariant describing @tree
+ */
+GVariant *
+_gtk_css_selector_tree_serialize (const GtkCssSelectorTree *tree,
+                                  gconstpointer             matches_base,
+                                  gsize                     match_size)
+{
+  GVariantBuilder nodes, matches;
+  GVariant *blob;
+  guint8 *data;
+  gsize len = 0;
+
+  g_variant_builder_init (&nodes, G_VARIANT_TYPE ("a(uys)"));
+  g_variant_builder_init (&matches, G_VARIANT_TYPE ("a(uau)"));
+
+  serialize_tree (tree, (const guint8 *) tree, matches_base, match_size,
+                  &nodes, &matches, &len);
+
+  if (len > 0)
+    {
+      data = g_memdup (tree, len);
+      clear_tree_pointers ((GtkCssSelectorTree *) data);
+      blob = g_variant_new_from_data (G_VARIANT_TYPE ("ay"), data, len, TRUE, g_free, data);
+    }
+  else
+    blob = g_variant_new_array (G_VARIANT_TYPE_BYTE, NULL, 0);
+
+  return g_variant_new ("(@ay@a(uys)@a(uau))",
+                        blob,
+                        g_variant_builder_end (&nodes),
+                        g_variant_builder_end (&matches));
+}
+
+/* The builder places every node before its matches, its children and its
+ * next sibling, and after its parent. Requiring that makes sure that a
+ * corrupt file can't make walking the tree loop.
+ */
+static gboolean
+check_tree_offset (GHashTable *offsets,
+                   guint32     offset,
+                   gint32      relative,
+                   gboolean    forward)
+{
+  if (relative == GTK_CSS_SELECTOR_TREE_EMPTY_OFFSET)
+    return TRUE;
+
+  if (forward ? relative <= 0 : relative >= 0)
+    return FALSE;
+
+  return g_hash_table_contains (offsets, GUINT_TO_POINTER (offset + relative + 1));
+}
+
+/* Marks the words of @data covered by a node or a match array as used.
+ * Nothing in the builder's layout overlaps, and writing a node must not
+ * be able to change the match pointers written before it.
+ */
+static gboolean
+claim_tree_range (guint8  *used,
+                  guint32  offset,
+                  gsize    size)
+{
+  gsize i, end;
+
+  end = (offset + size + sizeof (gpointer) - 1) / sizeof (gpointer);
+  for (i = offset / sizeof (gpointer); i < end; i++)
+    {
+      if (used[i])
+        return FALSE;
+      used[i] = TRUE;
+    }
+
+  return TRUE;
+}
+
+/*< private >
+ * _gtk_css_selector_tree_deserialize:
+ * @variant: a #GVariant created by _gtk_css_selector_tree_serialize()
+ * @matches_base: the start of the array holding the matches
+ * @match_size: the size of an element of that array
+ * @n_matches: the number of elements in the array
+ * @selector_match_offset: the offset of the selector_match field
+ *   of an element, as passed to _gtk_css_selector_tree_builder_add()
+ * @tree_out: (out): return location for the tree
+ *
+ * Recreates a tree serialized with _gtk_css_selector_tree_serialize(),
+ * using the elements of the given array as matches. The selector_match
+ * field of every element is set to its node in the tree.
+ *
+ * @variant may come from an untrusted source, all offsets and indexes
+ * in it are checked, and no two nodes or match arrays may overlap.
+ *
+ * Returns: %TRUE if @variant described a valid tree
+ */
+gboolean
+_gtk_css_selector_tree_deserialize (GVariant            *variant,
+                                    gpointer             matches_base,
+                                    gsize                match_size,
+                                    guint                n_matches,
+                                    gsize                selector_match_offset,
+                                    GtkCssSelectorTree **tree_out)
+{
+  GVariant *blob, *nodes, *matches;
+  GHashTable *node_offsets, *match_offsets;
+  const guint8 *blob_data;
+  guint8 *data = NULL;
+  guint8 *used = NULL;
+  gsize len, i, j;
+  gboolean result = FALSE;
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE (SERIALIZED_TREE_TYPE)))
+    return FALSE;
+
+  g_variant_get (variant, "(@ay@a(uys)@a(uau))", &blob, &nodes, &matches);
+
+  node_offsets = g_hash_table_new (NULL, NULL);
+  match_offsets = g_hash_table_new (NULL, NULL);
+
+  blob_data = g_variant_get_fixed_array (blob, &len, 1);
+  if (len == 0)
+    {
+      /* An empty stylesheet */
+      result = g_variant_n_children (nodes) == 0 && g_variant_n_children (matches) == 0;
+      goto out;
+    }
+
+  if (len < sizeof (GtkCssSelectorTree) ||
+      g_variant_n_children (nodes) == 0)
+    goto out;
+
+  data = g_malloc (len);
+  memcpy (data, blob_data, len);
+  used = g_malloc0 (len / sizeof (gpointer) + 1);
+
+  for (i = 0; i < g_variant_n_children (matches); i++)
+    {
+      GVariant *indexes;
+      gpointer *tree_matches;
+      const guint32 *idx;
+      guint32 offset;
+      gsize n;
+
+      g_variant_get_child (matches, i, "(u@au)", &offset, &indexes);
+      idx = g_variant_get_fixed_array (indexes, &n, sizeof (guint32));
+
+      if (offset % sizeof (gpointer) != 0 ||
+          n >= len / sizeof (gpointer) ||
+          offset > len - (n + 1) * sizeof (gpointer) ||
+          !claim_tree_range (used, offset, (n + 1) * sizeof (gpointer)))
+        {
+          g_variant_unref (indexes);
+          goto out;
+        }
+
+      tree_matches = (gpointer *) (data + offset);
+      for (j = 0; j < n; j++)
+        {
+          if (idx[j] >= n_matches)
+            break;
+          tree_matches[j] = (guint8 *) matches_base + idx[j] * match_size;
+        }
+      tree_matches[j] = NULL;
+
+      g_variant_unref (indexes);
+
+      if (j < n)
+        goto out;
+
+      g_hash_table_add (match_offsets, GUINT_TO_POINTER (offset + 1));
+    }
+
+  for (i = 0; i < g_variant_n_children (nodes); i++)
+    {
+      GtkCssSelectorTree *tree;
+      const GtkCssSelectorClass *class;
+      const char *payload;
+      guint32 offset;
+      guchar class_index;
+
+      g_variant_get_child (nodes, i, "(uy&s)", &offset, &class_index, &payload);
+
+      if (offset % sizeof (gpointer) != 0 ||
+          offset > len - sizeof (GtkCssSelectorTree) ||
+          class_index >= G_N_ELEMENTS (serialized_classes) ||
+          !claim_tree_range (used, offset, sizeof (GtkCssSelectorTree)))
+        goto out;
+
+      tree = (GtkCssSelectorTree *) (data + offset);
+      class = serialized_classes[class_index];
+
+      tree->selector.class = class;
+      if (class == &GTK_CSS_SELECTOR_NAME || class == &GTK_CSS_SELECTOR_NOT_NAME)
+        tree->selector.name.name = g_intern_string (payload);
+      else if (class == &GTK_CSS_SELECTOR_ID || class == &GTK_CSS_SELECTOR_NOT_ID)
+        tree->selector.id.name = g_intern_string (payload);
+      else if (class == &GTK_CSS_SELECTOR_CLASS || class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        tree->selector.style_class.style_class = g_quark_from_string (payload);
+
+      g_hash_table_add (node_offsets, GUINT_TO_POINTER (offset + 1));
+    }
+
+  if (!g_hash_table_contains (node_offsets, GUINT_TO_POINTER (1)))
+    goto out;
+
+  for (i = 0; i < g_variant_n_children (nodes); i++)
+    {
+      GtkCssSelectorTree *tree;
+      gpointer *tree_matches;
+      guint32 offset;
+
+      g_variant_get_child (nodes, i, "(uy&s)", &offset, NULL, NULL);
+      tree = (GtkCssSelectorTree *) (data + offset);
+
+      if (!check_tree_offset (node_offsets, offset, tree->parent_offset, FALSE) ||
+          !check_tree_offset (node_offsets, offset, tree->previous_offset, TRUE) ||
+          !check_tree_offset (node_offsets, offset, tree->sibling_offset, TRUE) ||
+          !check_tree_offset (match_offsets, offset, tree->matches_offset, TRUE))
+        goto out;
+
+      tree_matches = gtk_css_selector_tree_get_matches (tree);
+      if (tree_matches)
+        {
+          for (j = 0; tree_matches[j] != NULL; j++)
+            *(GtkCssSelectorTree **) ((guint8 *) tree_matches[j] + selector_match_offset) = tree;
+        }
+    }
+
+  result = TRUE;
+
+out:
+  g_free (used);
+  g_hash_table_unref (node_offsets);
+  g_hash_table_unref (match_offsets);
+  g_variant_unref (blob);
+  g_variant_unref (nodes);
+  g_variant_unref (matches);
+
+  if (result)
+    *tree_out = (GtkCssSelectorTree *) data;
+  else
+    g_free (data);
+
+  return result;
+}
@@ -47,6 +47,20 @@ GtkCssChange _gtk_css_selector_tree_get_change_all   (const GtkCssSelectorTree *
 						      const GtkCssMatcher *matcher);
 void         _gtk_css_selector_tree_match_print      (const GtkCssSelectorTree *tree,
 						      GString                  *str);
+gboolean     _gtk_css_selector_tree_match_equal      (const GtkCssSelectorTree *a,
+                                                      const GtkCssSelectorTree *b);
+GtkCssSelector *
+             _gtk_css_selector_tree_match_copy_selector (const GtkCssSelectorTree *tree);
+guint        _gtk_css_selector_tree_get_format_id    (void);
+GVariant *   _gtk_css_selector_tree_serialize        (const GtkCssSelectorTree *tree,
+                                                      gconstpointer             matches_base,
+                                                      gsize                     match_size);
+gboolean     _gtk_css_selector_tree_deserialize      (GVariant                 *variant,
+                                                      gpointer                  matches_base,
+                                                      gsize                     match_size,
+                                                      guint                     n_matches,
+                                                      gsize                     selector_match_offset,
+                                                      GtkCssSelectorTree      **tree_out);
 
 
 GtkCssSelectorTreeBuilder *_gtk_css_selector_tree_builder_new   (void);
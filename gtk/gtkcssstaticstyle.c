@@ -21,11 +21,14 @@
 
 #include "gtkcssstaticstyleprivate.h"
 
+#include <string.h>
+
 #include "gtkcssanimationprivate.h"
 #include "gtkcssarrayvalueprivate.h"
 #include "gtkcssenumvalueprivate.h"
 #include "gtkcssinheritvalueprivate.h"
 #include "gtkcssinitialvalueprivate.h"
+#include "gtkcsslookupprivate.h"
 #include "gtkcssnumbervalueprivate.h"
 #include "gtkcsssectionprivate.h"
 #include "gtkcssshorthandpropertyprivate.h"
@@ -40,14 +43,280 @@
 
 G_DEFINE_TYPE (GtkCssStaticStyle, gtk_css_static_style, GTK_TYPE_CSS_STYLE)
 
+struct _GtkCssValues {
+  int                    ref_count;
+  GtkCssValueGroup       group;
+  GtkCssValue           *values[1];
+};
+
+typedef struct {
+  const guint           *properties;
+  guint                  n_properties;
+  /* If all properties are inherited, so the group can be taken over
+   * from the parent when none of them is set */
+  gboolean               inherited;
+} GtkCssValueGroupInfo;
+
+typedef struct {
+  guint8                 group;
+  guint8                 index;
+} GtkCssValueSlot;
+
+static const guint core_properties[] = {
+  GTK_CSS_PROPERTY_COLOR,
+  GTK_CSS_PROPERTY_DPI,
+  GTK_CSS_PROPERTY_FONT_SIZE,
+  GTK_CSS_PROPERTY_ICON_THEME,
+  GTK_CSS_PROPERTY_ICON_PALETTE
+};
+
+static const guint font_properties[] = {
+  GTK_CSS_PROPERTY_FONT_FAMILY,
+  GTK_CSS_PROPERTY_FONT_STYLE,
+  GTK_CSS_PROPERTY_FONT_WEIGHT,
+  GTK_CSS_PROPERTY_FONT_STRETCH,
+  GTK_CSS_PROPERTY_LETTER_SPACING,
+  GTK_CSS_PROPERTY_TEXT_SHADOW,
+  GTK_CSS_PROPERTY_CARET_COLOR,
+  GTK_CSS_PROPERTY_SECONDARY_CARET_COLOR
+};
+
+static const guint font_variant_properties[] = {
+  GTK_CSS_PROPERTY_FONT_KERNING,
+  GTK_CSS_PROPERTY_FONT_VARIANT_LIGATURES,
+  GTK_CSS_PROPERTY_FONT_VARIANT_POSITION,
+  GTK_CSS_PROPERTY_FONT_VARIANT_CAPS,
+  GTK_CSS_PROPERTY_FONT_VARIANT_NUMERIC,
+  GTK_CSS_PROPERTY_FONT_VARIANT_ALTERNATES,
+  GTK_CSS_PROPERTY_FONT_VARIANT_EAST_ASIAN
+};
+
+static const guint text_decoration_properties[] = {
+  GTK_CSS_PROPERTY_TEXT_DECORATION_LINE,
+  GTK_CSS_PROPERTY_TEXT_DECORATION_COLOR,
+  GTK_CSS_PROPERTY_TEXT_DECORATION_STYLE
+};
+
+static const guint icon_properties[] = {
+  GTK_CSS_PROPERTY_ICON_SHADOW,
+  GTK_CSS_PROPERTY_ICON_STYLE
+};
+
+static const guint icon_effect_properties[] = {
+  GTK_CSS_PROPERTY_ICON_SOURCE,
+  GTK_CSS_PROPERTY_ICON_TRANSFORM,
+  GTK_CSS_PROPERTY_ICON_FILTER
+};
+
+static const guint background_properties[] = {
+  GTK_CSS_PROPERTY_BACKGROUND_COLOR,
+  GTK_CSS_PROPERTY_BOX_SHADOW,
+  GTK_CSS_PROPERTY_BACKGROUND_CLIP,
+  GTK_CSS_PROPERTY_BACKGROUND_ORIGIN,
+  GTK_CSS_PROPERTY_BACKGROUND_SIZE,
+  GTK_CSS_PROPERTY_BACKGROUND_POSITION,
+  GTK_CSS_PROPERTY_BACKGROUND_REPEAT,
+  GTK_CSS_PROPERTY_BACKGROUND_IMAGE,
+  GTK_CSS_PROPERTY_BACKGROUND_BLEND_MODE
+};
+
+static const guint border_properties[] = {
+  GTK_CSS_PROPERTY_BORDER_TOP_STYLE,
+  GTK_CSS_PROPERTY_BORDER_TOP_WIDTH,
+  GTK_CSS_PROPERTY_BORDER_LEFT_STYLE,
+  GTK_CSS_PROPERTY_BORDER_LEFT_WIDTH,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_STYLE,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_WIDTH,
+  GTK_CSS_PROPERTY_BORDER_RIGHT_STYLE,
+  GTK_CSS_PROPERTY_BORDER_RIGHT_WIDTH,
+  GTK_CSS_PROPERTY_BORDER_TOP_COLOR,
+  GTK_CSS_PROPERTY_BORDER_RIGHT_COLOR,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_COLOR,
+  GTK_CSS_PROPERTY_BORDER_LEFT_COLOR,
+  GTK_CSS_PROPERTY_BORDER_IMAGE_SOURCE,
+  GTK_CSS_PROPERTY_BORDER_IMAGE_REPEAT,
+  GTK_CSS_PROPERTY_BORDER_IMAGE_SLICE,
+  GTK_CSS_PROPERTY_BORDER_IMAGE_WIDTH
+};
+
+static const guint border_radius_properties[] = {
+  GTK_CSS_PROPERTY_BORDER_TOP_LEFT_RADIUS,
+  GTK_CSS_PROPERTY_BORDER_TOP_RIGHT_RADIUS,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_RIGHT_RADIUS,
+  GTK_CSS_PROPERTY_BORDER_BOTTOM_LEFT_RADIUS
+};
+
+static const guint outline_properties[] = {
+  GTK_CSS_PROPERTY_OUTLINE_STYLE,
+  GTK_CSS_PROPERTY_OUTLINE_WIDTH,
+  GTK_CSS_PROPERTY_OUTLINE_OFFSET,
+  GTK_CSS_PROPERTY_OUTLINE_TOP_LEFT_RADIUS,
+  GTK_CSS_PROPERTY_OUTLINE_TOP_RIGHT_RADIUS,
+  GTK_CSS_PROPERTY_OUTLINE_BOTTOM_RIGHT_RADIUS,
+  GTK_CSS_PROPERTY_OUTLINE_BOTTOM_LEFT_RADIUS,
+  GTK_CSS_PROPERTY_OUTLINE_COLOR
+};
+
+static const guint size_properties[] = {
+  GTK_CSS_PROPERTY_MARGIN_TOP,
+  GTK_CSS_PROPERTY_MARGIN_LEFT,
+  GTK_CSS_PROPERTY_MARGIN_BOTTOM,
+  GTK_CSS_PROPERTY_MARGIN_RIGHT,
+  GTK_CSS_PROPERTY_PADDING_TOP,
+  GTK_CSS_PROPERTY_PADDING_LEFT,
+  GTK_CSS_PROPERTY_PADDING_BOTTOM,
+  GTK_CSS_PROPERTY_PADDING_RIGHT,
+  GTK_CSS_PROPERTY_BORDER_SPACING,
+  GTK_CSS_PROPERTY_MIN_WIDTH,
+  GTK_CSS_PROPERTY_MIN_HEIGHT
+};
+
+static const guint transition_properties[] = {
+  GTK_CSS_PROPERTY_TRANSITION_PROPERTY,
+  GTK_CSS_PROPERTY_TRANSITION_DURATION,
+  GTK_CSS_PROPERTY_TRANSITION_TIMING_FUNCTION,
+  GTK_CSS_PROPERTY_TRANSITION_DELAY
+};
+
+static const guint animation_properties[] = {
+  GTK_CSS_PROPERTY_ANIMATION_NAME,
+  GTK_CSS_PROPERTY_ANIMATION_DURATION,
+  GTK_CSS_PROPERTY_ANIMATION_TIMING_FUNCTION,
+  GTK_CSS_PROPERTY_ANIMATION_ITERATION_COUNT,
+  GTK_CSS_PROPERTY_ANIMATION_DIRECTION,
+  GTK_CSS_PROPERTY_ANIMATION_PLAY_STATE,
+  GTK_CSS_PROPERTY_ANIMATION_DELAY,
+  GTK_CSS_PROPERTY_ANIMATION_FILL_MODE
+};
+
+static const guint other_properties[] = {
+  GTK_CSS_PROPERTY_OPACITY,
+  GTK_CSS_PROPERTY_FILTER,
+  GTK_CSS_PROPERTY_GTK_KEY_BINDINGS
+};
+
+#define GROUP(props, inherited) { props, G_N_ELEMENTS (props), inherited }
+
+static const GtkCssValueGroupInfo value_groups[GTK_CSS_N_VALUE_GROUPS] = {
+  [GTK_CSS_CORE_VALUES] = GROUP (core_properties, TRUE),
+  [GTK_CSS_FONT_VALUES] = GROUP (font_properties, TRUE),
+  [GTK_CSS_FONT_VARIANT_VALUES] = GROUP (font_variant_properties, FALSE),
+  [GTK_CSS_TEXT_DECORATION_VALUES] = GROUP (text_decoration_properties, FALSE),
+  [GTK_CSS_ICON_VALUES] = GROUP (icon_properties, TRUE),
+  [GTK_CSS_ICON_EFFECT_VALUES] = GROUP (icon_effect_properties, FALSE),
+  [GTK_CSS_BACKGROUND_VALUES] = GROUP (background_properties, FALSE),
+  [GTK_CSS_BORDER_VALUES] = GROUP (border_properties, FALSE),
+  [GTK_CSS_BORDER_RADIUS_VALUES] = GROUP (border_radius_properties, FALSE),
+  [GTK_CSS_OUTLINE_VALUES] = GROUP (outline_properties, FALSE),
+  [GTK_CSS_SIZE_VALUES] = GROUP (size_properties, FALSE),
+  [GTK_CSS_TRANSITION_VALUES] = GROUP (transition_properties, FALSE),
+  [GTK_CSS_ANIMATION_VALUES] = GROUP (animation_properties, FALSE),
+  [GTK_CSS_OTHER_VALUES] = GROUP (other_properties, FALSE)
+};
+
+#undef GROUP
+
+/* Filled in class_init from value_groups */
+static GtkCssValueSlot value_slots[GTK_CSS_PROPERTY_N_PROPERTIES];
+
+/* The groups created last, to share them between styles that are
+ * not related to each other */
+#define N_RECENT_VALUES 4
+static GtkCssValues *recent_values[GTK_CSS_N_VALUE_GROUPS][N_RECENT_VALUES];
+
+static GtkCssValues *
+gtk_css_values_new (GtkCssValueGroup group)
+{
+  GtkCssValues *values;
+
+  values = g_malloc0 (sizeof (GtkCssValues) +
+                      (value_groups[group].n_properties - 1) * sizeof (GtkCssValue *));
+  values->ref_count = 1;
+  values->group = group;
+
+  return values;
+}
+
+static GtkCssValues *
+gtk_css_values_ref (GtkCssValues *values)
+{
+  values->ref_count++;
+
+  return values;
+}
+
+static void
+gtk_css_values_unref (GtkCssValues *values)
+{
+  guint i;
+
+  values->ref_count--;
+  if (values->ref_count > 0)
+    return;
+
+  for (i = 0; i < value_groups[values->group].n_properties; i++)
+    {
+      if (values->values[i])
+        _gtk_css_value_unref (values->values[i]);
+    }
+
+  g_free (values);
+}
+
+static GtkCssValues *
+gtk_css_values_copy (GtkCssValues *values)
+{
+  GtkCssValues *copy;
+  guint i;
+
+  copy = gtk_css_values_new (values->group);
+  for (i = 0; i < value_groups[values->group].n_properties; i++)
+    {
+      if (values->values[i])
+        copy->values[i] = _gtk_css_value_ref (values->values[i]);
+    }
+
+  return copy;
+}
+
+static gboolean
+gtk_css_values_equal (const GtkCssValues *values1,
+                      const GtkCssValues *values2)
+{
+  guint i;
+
+  if (values1 == values2)
+    return TRUE;
+
+  for (i = 0; i < value_groups[values1->group].n_properties; i++)
+    {
+      GtkCssValue *value1 = values1->values[i];
+      GtkCssValue *value2 = values2->values[i];
+
+      if (value1 == value2)
+        continue;
+
+      if (value1 == NULL || value2 == NULL ||
+          !_gtk_css_value_equal (value1, value2))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static GtkCssValue *
 gtk_css_static_style_get_value (GtkCssStyle *style,
                                 guint        id)
 {
   /* This is called a lot, so we avoid a dynamic type check here */
   GtkCssStaticStyle *sstyle = (GtkCssStaticStyle *) style;
+  const GtkCssValueSlot *slot = &value_slots[id];
+  GtkCssValues *values = sstyle->groups[slot->group];
 
-  return sstyle->values[id];
+  if (values == NULL)
+    return NULL;
+
+  return values->values[slot->index];
 }
 
 static GtkCssSection *
@@ -69,11 +338,8 @@ gtk_css_static_style_dispose (GObject *object)
   GtkCssStaticStyle *style = GTK_CSS_STATIC_STYLE (object);
   guint i;
 
-  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
-    {
-      if (style->values[i])
-        _gtk_css_value_unref (style->values[i]);
-    }
+  for (i = 0; i < GTK_CSS_N_VALUE_GROUPS; i++)
+    g_clear_pointer (&style->groups[i], gtk_css_values_unref);
   if (style->sections)
     {
       g_ptr_array_unref (style->sections);
@@ -88,6 +354,16 @@ gtk_css_static_style_class_init (GtkCssStaticStyleClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GtkCssStyleClass *style_class = GTK_CSS_STYLE_CLASS (klass);
+  guint group, i;
+
+  for (group = 0; group < GTK_CSS_N_VALUE_GROUPS; group++)
+    {
+      for (i = 0; i < value_groups[group].n_properties; i++)
+        {
+          value_slots[value_groups[group].properties[i]].group = group;
+          value_slots[value_groups[group].properties[i]].index = i;
+        }
+    }
 
   object_class->dispose = gtk_css_static_style_dispose;
 
@@ -113,9 +389,24 @@ gtk_css_static_style_set_value (GtkCssStaticStyle *style,
                                 GtkCssValue       *value,
                                 GtkCssSection     *section)
 {
-  if (style->values[id])
-    _gtk_css_value_unref (style->values[id]);
-  style->values[id] = _gtk_css_value_ref (value);
+  const GtkCssValueSlot *slot = &value_slots[id];
+  GtkCssValues *values = style->groups[slot->group];
+
+  /* Groups are shared, so copy them before writing */
+  if (values == NULL)
+    {
+      values = style->groups[slot->group] = gtk_css_values_new (slot->group);
+    }
+  else if (values->ref_count > 1)
+    {
+      style->groups[slot->group] = gtk_css_values_copy (values);
+      gtk_css_values_unref (values);
+      values = style->groups[slot->group];
+    }
+
+  if (values->values[slot->index])
+    _gtk_css_value_unref (values->values[slot->index]);
+  values->values[slot->index] = _gtk_css_value_ref (value);
 
   if (style->sections && style->sections->len > id && g_ptr_array_index (style->sections, id))
     {
@@ -165,14 +456,165 @@ gtk_css_static_style_get_default (void)
   return default_style;
 }
 
-GtkCssStyle *
-gtk_css_static_style_new_compute (GtkStyleProviderPrivate *provider,
-                                  const GtkCssMatcher     *matcher,
-                                  GtkCssStyle             *parent)
+static gboolean
+gtk_css_static_style_can_inherit_group (GtkCssLookup      *lookup,
+                                        GtkCssValueGroup   group,
+                                        GtkCssStyle       *parent_style)
+{
+  const GtkCssValueGroupInfo *info = &value_groups[group];
+  guint i;
+
+  if (!info->inherited ||
+      parent_style == NULL ||
+      !GTK_IS_CSS_STATIC_STYLE (parent_style) ||
+      GTK_CSS_STATIC_STYLE (parent_style)->groups[group] == NULL)
+    return FALSE;
+
+  for (i = 0; i < info->n_properties; i++)
+    {
+      GtkCssValue *specified = lookup->values[info->properties[i]].value;
+
+      if (specified != NULL && specified != _gtk_css_inherit_value_get ())
+        return FALSE;
+
+      /* The section would be lost */
+      if (lookup->values[info->properties[i]].section != NULL)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Replaces the groups of @style with equal ones from its parent or
+ * from other recently computed styles, so they are only kept once.
+ */
+static void
+gtk_css_static_style_share_groups (GtkCssStaticStyle *style,
+                                   GtkCssStyle       *parent_style)
+{
+  GtkCssStaticStyle *parent = NULL;
+  guint group, i;
+
+  if (parent_style && GTK_IS_CSS_STATIC_STYLE (parent_style))
+    parent = GTK_CSS_STATIC_STYLE (parent_style);
+
+  for (group = 0; group < GTK_CSS_N_VALUE_GROUPS; group++)
+    {
+      GtkCssValues *values = style->groups[group];
+      GtkCssValues *shared = NULL;
+
+      if (values == NULL || values->ref_count > 1)
+        continue;
+
+      if (parent && parent->groups[group] &&
+          gtk_css_values_equal (values, parent->groups[group]))
+        {
+          shared = parent->groups[group];
+        }
+      else
+        {
+          for (i = 0; i < N_RECENT_VALUES; i++)
+            {
+              if (recent_values[group][i] &&
+                  gtk_css_values_equal (values, recent_values[group][i]))
+                {
+                  shared = recent_values[group][i];
+                  break;
+                }
+            }
+        }
+
+      if (shared)
+        {
+          style->groups[group] = gtk_css_values_ref (shared);
+          gtk_css_values_unref (values);
+        }
+      else
+        {
+          if (recent_values[group][N_RECENT_VALUES - 1])
+            gtk_css_values_unref (recent_values[group][N_RECENT_VALUES - 1]);
+          memmove (&recent_values[group][1], &recent_values[group][0],
+                   (N_RECENT_VALUES - 1) * sizeof (GtkCssValues *));
+          recent_values[group][0] = gtk_css_values_ref (values);
+        }
+    }
+}
+
+/*
+ * gtk_css_static_style_resolve:
+ * @style: a new #GtkCssStaticStyle to be filled with the new properties
+ * @provider: the provider the values are resolved for
+ * @lookup: the lookup
+ * @parent_style: (allow-none): the parent style
+ *
+ * Resolves @lookup into @style. This is done by converting from the
+ * “winning declaration” to the “computed value”.
+ *
+ * Groups of inherited properties that are not set are shared with
+ * the parent without computing them.
+ *
+ * XXX: This bypasses the notion of “specified value”. If this ever becomes
+ * an issue, go fix it.
+ */
+static void
+gtk_css_static_style_resolve (GtkCssStaticStyle       *style,
+                              GtkStyleProviderPrivate *provider,
+                              GtkCssLookup            *lookup,
+                              GtkCssStyle             *parent_style)
+{
+  gboolean inherited[GTK_CSS_N_VALUE_GROUPS];
+  guint i;
+
+  for (i = 0; i < GTK_CSS_N_VALUE_GROUPS; i++)
+    {
+      inherited[i] = gtk_css_static_style_can_inherit_group (lookup, i, parent_style);
+      if (inherited[i])
+        style->groups[i] = gtk_css_values_ref (GTK_CSS_STATIC_STYLE (parent_style)->groups[i]);
+    }
+
+  /* Properties are computed in order, as they depend on the ones
+   * before them, like font-size on -gtk-dpi */
+  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+    {
+      if (inherited[value_slots[i].group])
+        continue;
+
+      if (lookup->values[i].value ||
+          _gtk_bitmask_get (lookup->missing, i))
+        gtk_css_static_style_compute_value (style,
+                                            provider,
+                                            parent_style,
+                                            i,
+                                            lookup->values[i].value,
+                                            lookup->values[i].section);
+      /* else not a relevant property */
+    }
+
+  gtk_css_static_style_share_groups (style, parent_style);
+}
+
+/*
+ * gtk_css_static_style_lookup:
+ * @provider: the provider to look up the values in
+ * @matcher: (allow-none): the matcher for the node or %NULL
+ * @change: (out): the change flags of the matched rules
+ *
+ * Finds the winning declarations for a node, which can then be
+ * turned into a style with gtk_css_static_style_new_resolve().
+ *
+ * This only reads the provider and the node tree, so it may run
+ * in a thread while the main thread waits for the result.
+ *
+ * Returns: (transfer full): the lookup, free it with _gtk_css_lookup_free()
+ */
+GtkCssLookup *
+gtk_css_static_style_lookup (GtkStyleProviderPrivate *provider,
+                             const GtkCssMatcher     *matcher,
+                             GtkCssChange            *change)
 {
-  GtkCssStaticStyle *result;
   GtkCssLookup *lookup;
-  GtkCssChange change = GTK_CSS_CHANGE_ANY_SELF | GTK_CSS_CHANGE_ANY_SIBLING | GTK_CSS_CHANGE_ANY_PARENT;
+
+  *change = GTK_CSS_CHANGE_ANY_SELF | GTK_CSS_CHANGE_ANY_SIBLING | GTK_CSS_CHANGE_ANY_PARENT;
 
   lookup = _gtk_css_lookup_new (NULL);
 
@@ -180,20 +622,45 @@ gtk_css_static_style_new_compute (GtkStyleProviderPrivate *provider,
     _gtk_style_provider_private_lookup (provider,
                                         matcher,
                                         lookup,
-                                        &change);
+                                        change);
+
+  return lookup;
+}
+
+GtkCssStyle *
+gtk_css_static_style_new_resolve (GtkStyleProviderPrivate *provider,
+                                  GtkCssLookup            *lookup,
+                                  GtkCssChange             change,
+                                  GtkCssStyle             *parent)
+{
+  GtkCssStaticStyle *result;
 
   result = g_object_new (GTK_TYPE_CSS_STATIC_STYLE, NULL);
 
   result->change = change;
 
-  _gtk_css_lookup_resolve (lookup,
-                           provider,
-                           result,
-                           parent);
+  gtk_css_static_style_resolve (result,
+                                provider,
+                                lookup,
+                                parent);
 
+  return GTK_CSS_STYLE (result);
+}
+
+GtkCssStyle *
+gtk_css_static_style_new_compute (GtkStyleProviderPrivate *provider,
+                                  const GtkCssMatcher     *matcher,
+                                  GtkCssStyle             *parent)
+{
+  GtkCssStyle *result;
+  GtkCssLookup *lookup;
+  GtkCssChange change;
+
+  lookup = gtk_css_static_style_lookup (provider, matcher, &change);
+  result = gtk_css_static_style_new_resolve (provider, lookup, change, parent);
   _gtk_css_lookup_free (lookup);
 
-  return GTK_CSS_STYLE (result);
+  return result;
 }
 
 void
@@ -34,13 +34,37 @@ G_BEGIN_DECLS
 
 typedef struct _GtkCssStaticStyle           GtkCssStaticStyle;
 typedef struct _GtkCssStaticStyleClass      GtkCssStaticStyleClass;
+typedef struct _GtkCssValues                GtkCssValues;
+
+/* Properties are stored in groups of related properties. Groups are
+ * immutable once the style is computed and shared between all styles
+ * where all the values in the group are equal.
+ */
+typedef enum {
+  GTK_CSS_CORE_VALUES,
+  GTK_CSS_FONT_VALUES,
+  GTK_CSS_FONT_VARIANT_VALUES,
+  GTK_CSS_TEXT_DECORATION_VALUES,
+  GTK_CSS_ICON_VALUES,
+  GTK_CSS_ICON_EFFECT_VALUES,
+  GTK_CSS_BACKGROUND_VALUES,
+  GTK_CSS_BORDER_VALUES,
+  GTK_CSS_BORDER_RADIUS_VALUES,
+  GTK_CSS_OUTLINE_VALUES,
+  GTK_CSS_SIZE_VALUES,
+  GTK_CSS_TRANSITION_VALUES,
+  GTK_CSS_ANIMATION_VALUES,
+  GTK_CSS_OTHER_VALUES,
+  GTK_CSS_N_VALUE_GROUPS
+} GtkCssValueGroup;
 
 struct _GtkCssStaticStyle
 {
   GtkCssStyle parent;
 
-  GtkCssValue           *values[GTK_CSS_PROPERTY_N_PROPERTIES]; /* the values */
-  GPtrArray             *sections;             /* sections the values are defined in */
+  GtkCssValues          *groups[GTK_CSS_N_VALUE_GROUPS]; /* the values */
+  GPtrArray             *sections;             /* sections the values are defined in, only
+                                                  kept while the inspector is in use */
 
   GtkCssChange           change;               /* change as returned by value lookup */
 };
@@ -56,6 +80,13 @@ GtkCssStyle *           gtk_css_static_style_get_default        (void);
 GtkCssStyle *           gtk_css_static_style_new_compute        (GtkStyleProviderPrivate *provider,
                                                                  const GtkCssMatcher    *matcher,
                                                                  GtkCssStyle            *parent);
+GtkCssLookup *          gtk_css_static_style_lookup             (GtkStyleProviderPrivate *provider,
+                                                                 const GtkCssMatcher    *matcher,
+                                                                 GtkCssChange           *change);
+GtkCssStyle *           gtk_css_static_style_new_resolve        (GtkStyleProviderPrivate *provider,
+                                                                 GtkCssLookup           *lookup,
+                                                                 GtkCssChange            change,
+                                                                 GtkCssStyle            *parent);
 
 void                    gtk_css_static_style_compute_value      (GtkCssStaticStyle      *style,
                                                                  GtkStyleProviderPrivate*provider,
@@ -34,6 +34,8 @@
 #include "gtksnapshot.h"
 #include "gtkwidgetprivate.h"
 
+typedef struct _IconLoad IconLoad;
+
 struct _GtkIconHelperPrivate {
   GtkImageDefinition *def;
 
@@ -43,18 +45,265 @@ struct _GtkIconHelperPrivate {
   guint use_fallback : 1;
   guint force_scale_pixbuf : 1;
   guint rendered_surface_is_symbolic : 1;
+  guint load_done : 1;
 
   GtkWidget *owner;
   GtkCssNode *node;
   cairo_surface_t *rendered_surface;
   GskTexture *texture;
+
+  /* The themed icon load this helper waits for, its result, and
+   * the size reported while it is running
+   */
+  IconLoad *load;
+  GdkPixbuf *loaded_pixbuf;
+  gint load_width;
+  gint load_height;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GtkIconHelper, gtk_icon_helper, G_TYPE_OBJECT)
 
+/* Themed icons that aren't loaded yet are decoded in a thread,
+ * and the helper draws nothing until they are done. Helpers that
+ * want the same icon in the same colors share a load.
+ *
+ * Only a few loads run at the same time. The others wait in a
+ * stack, so when scrolling through many icons the ones that just
+ * became visible are loaded first, and the ones that were
+ * scrolled away before their turn are dropped without ever
+ * being loaded.
+ */
+#define MAX_RUNNING_ICON_LOADS 4
+
+struct _IconLoad
+{
+  GtkIconInfo *info;
+  gboolean symbolic;
+  GdkRGBA fg;
+  GdkRGBA success_color;
+  GdkRGBA warning_color;
+  GdkRGBA error_color;
+
+  /* The helpers waiting for this load */
+  GSList *helpers;
+  gboolean running;
+};
+
+static GHashTable *icon_loads;
+static GQueue queued_icon_loads = G_QUEUE_INIT;
+static guint n_running_icon_loads;
+
+static guint
+icon_load_hash (gconstpointer data)
+{
+  const IconLoad *load = data;
+  guint hash;
+
+  hash = g_direct_hash (load->info);
+  if (load->symbolic)
+    hash ^= gdk_rgba_hash (&load->fg) ^
+            gdk_rgba_hash (&load->success_color) << 1 ^
+            gdk_rgba_hash (&load->warning_color) << 2 ^
+            gdk_rgba_hash (&load->error_color) << 3;
+
+  return hash;
+}
+
+static gboolean
+icon_load_equal (gconstpointer data1,
+                 gconstpointer data2)
+{
+  const IconLoad *load1 = data1;
+  const IconLoad *load2 = data2;
+
+  if (load1->info != load2->info ||
+      load1->symbolic != load2->symbolic)
+    return FALSE;
+
+  if (!load1->symbolic)
+    return TRUE;
+
+  return gdk_rgba_equal (&load1->fg, &load2->fg) &&
+         gdk_rgba_equal (&load1->success_color, &load2->success_color) &&
+         gdk_rgba_equal (&load1->warning_color, &load2->warning_color) &&
+         gdk_rgba_equal (&load1->error_color, &load2->error_color);
+}
+
+static void
+icon_load_free (IconLoad *load)
+{
+  g_object_unref (load->info);
+  g_slist_free (load->helpers);
+  g_slice_free (IconLoad, load);
+}
+
+static void icon_load_start_queued (void);
+
+/* Whether @pixbuf has the size that was reported while loading it,
+ * so showing it doesn't change the size request of the owner.
+ */
+static gboolean
+gtk_icon_helper_load_size_matches (GtkIconHelper *self,
+                                   GdkPixbuf     *pixbuf)
+{
+  GtkIconHelperPrivate *priv = self->priv;
+  int scale;
+
+  scale = gtk_widget_get_scale_factor (priv->owner);
+
+  return (gdk_pixbuf_get_width (pixbuf) + scale - 1) / scale == priv->load_width &&
+         (gdk_pixbuf_get_height (pixbuf) + scale - 1) / scale == priv->load_height;
+}
+
+static void
+icon_load_done (GObject      *source,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  IconLoad *load = user_data;
+  GdkPixbuf *pixbuf;
+  GSList *l;
+
+  /* Finishing also stores the result in the icon info, so even
+   * if nobody waits for it anymore, the work wasn't wasted.
+   */
+  if (load->symbolic)
+    pixbuf = gtk_icon_info_load_symbolic_finish (load->info, result, NULL, NULL);
+  else
+    pixbuf = gtk_icon_info_load_icon_finish (load->info, result, NULL);
+
+  g_hash_table_remove (icon_loads, load);
+  n_running_icon_loads--;
+
+  for (l = load->helpers; l; l = l->next)
+    {
+      GtkIconHelper *self = l->data;
+      GtkIconHelperPrivate *priv = self->priv;
+
+      priv->load = NULL;
+      priv->load_done = TRUE;
+      if (pixbuf)
+        priv->loaded_pixbuf = g_object_ref (pixbuf);
+
+      /* Most icons come in the size that was asked for, and then
+       * only the contents changed
+       */
+      if (pixbuf && gtk_icon_helper_load_size_matches (self, pixbuf))
+        gtk_widget_queue_draw (priv->owner);
+      else
+        gtk_widget_queue_resize (priv->owner);
+    }
+
+  g_clear_object (&pixbuf);
+  icon_load_free (load);
+
+  icon_load_start_queued ();
+}
+
+static void
+icon_load_start_queued (void)
+{
+  IconLoad *load;
+
+  while (n_running_icon_loads < MAX_RUNNING_ICON_LOADS &&
+         (load = g_queue_pop_head (&queued_icon_loads)) != NULL)
+    {
+      load->running = TRUE;
+      n_running_icon_loads++;
+
+      if (load->symbolic)
+        gtk_icon_info_load_symbolic_async (load->info,
+                                           &load->fg,
+                                           &load->success_color,
+                                           &load->warning_color,
+                                           &load->error_color,
+                                           NULL,
+                                           icon_load_done,
+                                           load);
+      else
+        gtk_icon_info_load_icon_async (load->info,
+                                       NULL,
+                                       icon_load_done,
+                                       load);
+    }
+}
+
+static void
+gtk_icon_helper_queue_load (GtkIconHelper *self,
+                            GtkIconInfo   *info,
+                            const GdkRGBA *fg,
+                            const GdkRGBA *success_color,
+                            const GdkRGBA *warning_color,
+                            const GdkRGBA *error_color)
+{
+  IconLoad key = { NULL, }, *load;
+
+  if (icon_loads == NULL)
+    icon_loads = g_hash_table_new (icon_load_hash, icon_load_equal);
+
+  key.info = info;
+  key.symbolic = fg != NULL;
+  if (key.symbolic)
+    {
+      key.fg = *fg;
+      key.success_color = *success_color;
+      key.warning_color = *warning_color;
+      key.error_color = *error_color;
+    }
+
+  load = g_hash_table_lookup (icon_loads, &key);
+  if (load == NULL)
+    {
+      load = g_slice_dup (IconLoad, &key);
+      g_object_ref (load->info);
+      load->helpers = NULL;
+      load->running = FALSE;
+
+      g_hash_table_add (icon_loads, load);
+      g_queue_push_head (&queued_icon_loads, load);
+    }
+  else if (!load->running)
+    {
+      /* Wanted again, so move it to the front */
+      g_queue_remove (&queued_icon_loads, load);
+      g_queue_push_head (&queued_icon_loads, load);
+    }
+
+  load->helpers = g_slist_prepend (load->helpers, self);
+  self->priv->load = load;
+
+  icon_load_start_queued ();
+}
+
+static void
+gtk_icon_helper_cancel_load (GtkIconHelper *self)
+{
+  GtkIconHelperPrivate *priv = self->priv;
+  IconLoad *load = priv->load;
+
+  g_clear_object (&priv->loaded_pixbuf);
+  priv->load_done = FALSE;
+
+  if (load == NULL)
+    return;
+
+  priv->load = NULL;
+  priv->rendered_surface_is_symbolic = FALSE;
+  load->helpers = g_slist_remove (load->helpers, self);
+
+  /* Running loads are left to finish, see icon_load_done() */
+  if (load->helpers == NULL && !load->running)
+    {
+      g_queue_remove (&queued_icon_loads, load);
+      g_hash_table_remove (icon_loads, load);
+      icon_load_free (load);
+    }
+}
+
 void
 gtk_icon_helper_invalidate (GtkIconHelper *self)
 {
+  gtk_icon_helper_cancel_load (self);
   g_clear_object (&self->priv->texture);
 
   if (self->priv->rendered_surface != NULL)
@@ -349,20 +598,53 @@ ensure_surface_for_gicon (GtkIconHelper    *self,
 
   ensure_icon_size (self, &width, &height);
 
-  info = gtk_icon_theme_lookup_by_gicon_for_scale (icon_theme,
-                                                   gicon,
-                                                   MIN (width, height),
-                                                   scale, flags);
+  if (priv->load_done)
+    {
+      /* The result of gtk_icon_helper_queue_load() */
+      destination = g_steal_pointer (&priv->loaded_pixbuf);
+      symbolic = priv->rendered_surface_is_symbolic;
+      priv->load_done = FALSE;
+      info = NULL;
+    }
+  else
+    {
+      destination = NULL;
+      symbolic = FALSE;
+      info = gtk_icon_theme_lookup_by_gicon_for_scale (icon_theme,
+                                                       gicon,
+                                                       MIN (width, height),
+                                                       scale, flags);
+    }
+
   if (info)
     {
+      GdkRGBA fg, success_color, warning_color, error_color;
+
       symbolic = gtk_icon_info_is_symbolic (info);
 
       if (symbolic)
+        gtk_icon_theme_lookup_symbolic_colors (style, &fg, &success_color, &warning_color, &error_color);
+
+      /* Helpers of transient nodes, like the ones used by cell
+       * renderers, don't live long enough to wait for a load
+       */
+      if (!GTK_IS_CSS_TRANSIENT_NODE (priv->node) &&
+          !gtk_icon_info_is_loaded (info,
+                                    symbolic ? &fg : NULL,
+                                    &success_color, &warning_color, &error_color))
         {
-          GdkRGBA fg, success_color, warning_color, error_color;
-
-          gtk_icon_theme_lookup_symbolic_colors (style, &fg, &success_color, &warning_color, &error_color);
+          priv->rendered_surface_is_symbolic = symbolic;
+          priv->load_width = width;
+          priv->load_height = height;
+          gtk_icon_helper_queue_load (self, info,
+                                      symbolic ? &fg : NULL,
+                                      &success_color, &warning_color, &error_color);
+          g_object_unref (info);
+          return NULL;
+        }
 
+      if (symbolic)
+        {
           destination = gtk_icon_info_load_symbolic (info,
                                                      &fg, &success_color,
                                                      &warning_color, &error_color,
@@ -376,10 +658,6 @@ ensure_surface_for_gicon (GtkIconHelper    *self,
 
       g_object_unref (info);
     }
-  else
-    {
-      destination = NULL;
-    }
 
   if (destination == NULL)
     {
@@ -467,7 +745,7 @@ gtk_icon_helper_ensure_surface (GtkIconHelper *self)
 {
   int scale;
 
-  if (self->priv->rendered_surface)
+  if (self->priv->rendered_surface || self->priv->load)
     return;
 
   scale = gtk_widget_get_scale_factor (self->priv->owner);
@@ -578,6 +856,14 @@ _gtk_icon_helper_get_size (GtkIconHelper *self,
         {
           get_surface_size (self, self->priv->rendered_surface, &width, &height);
         }
+      else if (self->priv->load != NULL)
+        {
+          /* Report the size that was asked for until the icon is
+           * loaded, so that it usually doesn't need a resize then
+           */
+          width = self->priv->load_width;
+          height = self->priv->load_height;
+        }
       else if (self->priv->icon_size != GTK_ICON_SIZE_INVALID)
         {
           ensure_icon_size (self, &width, &height);
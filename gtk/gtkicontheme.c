@@ -48,6 +48,7 @@
 #include "gtkstylecontextprivate.h"
 #include "gtkprivate.h"
 #include "gdkpixbufutilsprivate.h"
+#include "gdk/gdk-private.h"
 
 /* this is in case round() is not provided by the compiler, 
  * such as in the case of C89 compilers, like MSVC
@@ -231,6 +232,11 @@ struct _GtkIconInfo
 
   SymbolicPixbufCache *symbolic_pixbuf_cache;
 
+  /* The symbolic SVG, rendered once at the size of pixbuf with
+   * the colors encoded in separate channels
+   */
+  GdkPixbuf *symbolic_mask;
+
   gint symbolic_width;
   gint symbolic_height;
 };
@@ -3459,6 +3465,8 @@ icon_info_dup (GtkIconInfo *icon_info)
   dup->max_size = icon_info->max_size;
   dup->symbolic_width = icon_info->symbolic_width;
   dup->symbolic_height = icon_info->symbolic_height;
+  if (icon_info->symbolic_mask)
+    dup->symbolic_mask = g_object_ref (icon_info->symbolic_mask);
 
   return dup;
 }
@@ -3494,6 +3502,7 @@ gtk_icon_info_finalize (GObject *object)
   g_clear_error (&icon_info->load_error);
 
   symbolic_pixbuf_cache_free (icon_info->symbolic_pixbuf_cache);
+  g_clear_object (&icon_info->symbolic_mask);
 
   G_OBJECT_CLASS (gtk_icon_info_parent_class)->finalize (object);
 }
@@ -3720,6 +3729,312 @@ icon_info_get_pixbuf_ready (GtkIconInfo *icon_info)
   return FALSE;
 }
 
+/* The raster cache keeps icons that were loaded from files in
+ * $XDG_CACHE_HOME/gtk-4.0/icons, in the size they were loaded at,
+ * so other processes can map them instead of decoding and scaling
+ * the file again. Unlike the icon-theme.cache index, it is written
+ * by GTK+ itself. Entries are named after a checksum of everything
+ * that influences the result, except for the mtime and size of the
+ * source file. Those are kept in the header instead, so an entry for
+ * a file that changed is found, and removed, on the next lookup.
+ */
+#define ICON_RASTER_CACHE_MAGIC "GTKICON2"
+
+/* When the cache grows beyond this, the entries that were used least
+ * recently are removed until it is back to 3/4 of the size.
+ */
+#define ICON_RASTER_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+/* Number of entries written between checks of the cache size */
+#define ICON_RASTER_CACHE_PRUNE_INTERVAL 64
+
+typedef struct
+{
+  char magic[8];
+  guint32 width;
+  guint32 height;
+  guint32 rowstride;
+  guint32 has_alpha;
+  gdouble scale;
+  guint64 source_mtime;
+  guint64 source_size;
+} IconRasterCacheHeader;
+
+G_STATIC_ASSERT (sizeof (IconRasterCacheHeader) == 48);
+
+typedef struct
+{
+  guint64 mtime;
+  guint64 size;
+} IconRasterCacheSource;
+
+typedef struct
+{
+  char *path;
+  gint64 atime;
+  guint64 size;
+} IconRasterCacheEntry;
+
+static char *
+icon_raster_cache_get_path (GtkIconInfo           *icon_info,
+                            const char            *variant,
+                            IconRasterCacheSource *source)
+{
+  GStatBuf buf;
+  char *path, *key, *checksum, *cache_path;
+  char scale[G_ASCII_DTOSTR_BUF_SIZE];
+
+  if (!gdk_disk_cache_enabled (GDK_DISK_CACHE_ICONS))
+    return NULL;
+
+  if (icon_info->is_resource ||
+      icon_info->cache_pixbuf != NULL ||
+      icon_info->icon_file == NULL)
+    return NULL;
+
+  path = g_file_get_path (icon_info->icon_file);
+  if (path == NULL)
+    return NULL;
+
+  if (g_stat (path, &buf) != 0)
+    {
+      g_free (path);
+      return NULL;
+    }
+
+  source->mtime = buf.st_mtime;
+  source->size = buf.st_size;
+
+  g_ascii_dtostr (scale, G_ASCII_DTOSTR_BUF_SIZE, icon_info->unscaled_scale);
+
+  key = g_strdup_printf ("%d.%d.%d %d %s %d %d %d %d %d %d %d %d %s %s",
+                         GTK_MAJOR_VERSION, GTK_MINOR_VERSION, GTK_MICRO_VERSION,
+                         G_BYTE_ORDER,
+                         path,
+                         icon_info->dir_type, icon_info->dir_size, icon_info->dir_scale,
+                         icon_info->min_size, icon_info->max_size,
+                         icon_info->desired_size, icon_info->desired_scale,
+                         icon_info->forced_size, scale,
+                         variant);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+  cache_path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "icons", checksum, NULL);
+
+  g_free (checksum);
+  g_free (key);
+  g_free (path);
+
+  return cache_path;
+}
+
+static void
+icon_raster_cache_pixels_destroy (guchar   *pixels,
+                                  gpointer  data)
+{
+  g_mapped_file_unref (data);
+}
+
+/* The returned pixbuf uses the mapped file as its pixels. The
+ * mapping is private, so the file is never changed through it.
+ */
+static GdkPixbuf *
+icon_raster_cache_load (const char                  *cache_path,
+                        const IconRasterCacheSource *source,
+                        gdouble                     *scale)
+{
+  const IconRasterCacheHeader *header;
+  GMappedFile *file;
+  GdkPixbuf *pixbuf;
+  guint64 needed;
+  gsize size;
+  guint n_channels;
+
+  file = g_mapped_file_new (cache_path, TRUE, NULL);
+  if (file == NULL)
+    return NULL;
+
+  size = g_mapped_file_get_length (file);
+  header = (const IconRasterCacheHeader *) g_mapped_file_get_contents (file);
+
+  if (size < sizeof (IconRasterCacheHeader) ||
+      memcmp (header->magic, ICON_RASTER_CACHE_MAGIC, sizeof (header->magic)) != 0)
+    goto fail;
+
+  /* The source file changed since the entry was written. The new
+   * contents will be saved under the same name, but remove the entry
+   * now in case the icon is not loaded again.
+   */
+  if (header->source_mtime != source->mtime ||
+      header->source_size != source->size)
+    {
+      g_unlink (cache_path);
+      goto fail;
+    }
+
+  if (header->width == 0 || header->width > G_MAXINT / 4 ||
+      header->height == 0 || header->height > G_MAXINT ||
+      header->rowstride > G_MAXINT)
+    goto fail;
+
+  n_channels = header->has_alpha ? 4 : 3;
+  if (header->rowstride < header->width * n_channels)
+    goto fail;
+
+  needed = sizeof (IconRasterCacheHeader) +
+           (guint64) header->rowstride * (header->height - 1) +
+           header->width * n_channels;
+  if (size < needed)
+    goto fail;
+
+  pixbuf = gdk_pixbuf_new_from_data ((guchar *) g_mapped_file_get_contents (file) + sizeof (IconRasterCacheHeader),
+                                     GDK_COLORSPACE_RGB,
+                                     header->has_alpha != 0,
+                                     8,
+                                     header->width,
+                                     header->height,
+                                     header->rowstride,
+                                     icon_raster_cache_pixels_destroy,
+                                     file);
+  if (scale)
+    *scale = header->scale;
+
+  return pixbuf;
+
+fail:
+  g_mapped_file_unref (file);
+  return NULL;
+}
+
+static int
+icon_raster_cache_entry_compare (gconstpointer a,
+                                 gconstpointer b)
+{
+  const IconRasterCacheEntry *entry1 = a;
+  const IconRasterCacheEntry *entry2 = b;
+
+  if (entry1->atime < entry2->atime)
+    return -1;
+  else if (entry1->atime > entry2->atime)
+    return 1;
+  else
+    return 0;
+}
+
+/* Removes the least recently used entries while the cache is larger
+ * than ICON_RASTER_CACHE_MAX_SIZE. Mapping an entry updates its
+ * atime, though with relatime mounts only about once per day, which
+ * is precise enough here. Other processes may be pruning at the same
+ * time, so files disappearing underneath us are expected.
+ */
+static void
+icon_raster_cache_prune (const char *dir)
+{
+  GArray *entries;
+  GDir *cache_dir;
+  const char *name;
+  guint64 total_size;
+  gsize name_length;
+  guint i;
+
+  cache_dir = g_dir_open (dir, 0, NULL);
+  if (cache_dir == NULL)
+    return;
+
+  name_length = 2 * g_checksum_type_get_length (G_CHECKSUM_SHA256);
+  entries = g_array_new (FALSE, FALSE, sizeof (IconRasterCacheEntry));
+  total_size = 0;
+
+  while ((name = g_dir_read_name (cache_dir)) != NULL)
+    {
+      IconRasterCacheEntry entry;
+      GStatBuf buf;
+
+      /* Skip the temporary files of entries that are being written */
+      if (strlen (name) != name_length)
+        continue;
+
+      entry.path = g_build_filename (dir, name, NULL);
+      if (g_stat (entry.path, &buf) != 0)
+        {
+          g_free (entry.path);
+          continue;
+        }
+
+      entry.atime = buf.st_atime;
+      entry.size = buf.st_size;
+      total_size += entry.size;
+      g_array_append_val (entries, entry);
+    }
+
+  g_dir_close (cache_dir);
+
+  if (total_size > ICON_RASTER_CACHE_MAX_SIZE)
+    {
+      g_array_sort (entries, icon_raster_cache_entry_compare);
+
+      for (i = 0; i < entries->len && total_size > ICON_RASTER_CACHE_MAX_SIZE / 4 * 3; i++)
+        {
+          IconRasterCacheEntry *entry = &g_array_index (entries, IconRasterCacheEntry, i);
+
+          if (g_unlink (entry->path) == 0)
+            total_size -= entry->size;
+        }
+
+      GTK_NOTE (ICONTHEME,
+                g_message ("Pruned the raster cache to %" G_GUINT64_FORMAT " bytes", total_size));
+    }
+
+  for (i = 0; i < entries->len; i++)
+    g_free (g_array_index (entries, IconRasterCacheEntry, i).path);
+  g_array_free (entries, TRUE);
+}
+
+static void
+icon_raster_cache_save (const char                  *cache_path,
+                        const IconRasterCacheSource *source,
+                        GdkPixbuf                   *pixbuf,
+                        gdouble                      scale)
+{
+  static gint n_saved = 0;
+  IconRasterCacheHeader header = { ICON_RASTER_CACHE_MAGIC, };
+  gsize byte_length;
+  char *data, *dir;
+
+  if (gdk_pixbuf_get_colorspace (pixbuf) != GDK_COLORSPACE_RGB ||
+      gdk_pixbuf_get_bits_per_sample (pixbuf) != 8 ||
+      gdk_pixbuf_get_n_channels (pixbuf) != (gdk_pixbuf_get_has_alpha (pixbuf) ? 4 : 3))
+    return;
+
+  header.width = gdk_pixbuf_get_width (pixbuf);
+  header.height = gdk_pixbuf_get_height (pixbuf);
+  header.rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  header.has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+  header.scale = scale;
+  header.source_mtime = source->mtime;
+  header.source_size = source->size;
+
+  byte_length = gdk_pixbuf_get_byte_length (pixbuf);
+  data = g_malloc (sizeof (header) + byte_length);
+  memcpy (data, &header, sizeof (header));
+  memcpy (data + sizeof (header), gdk_pixbuf_get_pixels (pixbuf), byte_length);
+
+  dir = g_path_get_dirname (cache_path);
+
+  /* The cache is an optimization, failing to write it is fine.
+   * g_file_set_contents() renames a temporary file into place, so
+   * other processes never see a partially written entry.
+   */
+  if (g_mkdir_with_parents (dir, 0755) == 0 &&
+      g_file_set_contents (cache_path, data, sizeof (header) + byte_length, NULL))
+    {
+      /* Icons may be loaded in threads */
+      if (g_atomic_int_add (&n_saved, 1) % ICON_RASTER_CACHE_PRUNE_INTERVAL == 0)
+        icon_raster_cache_prune (dir);
+    }
+
+  g_free (dir);
+  g_free (data);
+}
+
 /* This function contains the complicated logic for deciding
  * on the size at which to load the icon and loading it at
  * that size.
@@ -3731,6 +4046,8 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo *icon_info)
   gint scaled_desired_size;
   GdkPixbuf *source_pixbuf;
   gdouble dir_scale;
+  char *cache_path;
+  IconRasterCacheSource cache_source;
 
   if (icon_info->pixbuf)
     {
@@ -3777,6 +4094,20 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo *icon_info)
         icon_info->scale = (gdouble) scaled_desired_size / (icon_info->dir_size * dir_scale);
     }
 
+  cache_path = icon_raster_cache_get_path (icon_info, "icon", &cache_source);
+  if (cache_path)
+    {
+      icon_info->pixbuf = icon_raster_cache_load (cache_path, &cache_source, &icon_info->scale);
+      if (icon_info->pixbuf)
+        {
+          GTK_NOTE (ICONTHEME,
+                    g_message ("Loaded icon %s from the raster cache", icon_info->filename));
+          g_free (cache_path);
+          apply_emblems (icon_info);
+          return TRUE;
+        }
+    }
+
   /* At this point, we need to actually get the icon; either from the
    * builtin image or by loading the file
    */
@@ -3871,6 +4202,7 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo *icon_info)
           warn_about_load_failure = FALSE;
         }
 
+      g_free (cache_path);
       return FALSE;
     }
 
@@ -3907,6 +4239,12 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo *icon_info)
       g_object_unref (source_pixbuf);
     }
 
+  if (cache_path)
+    {
+      icon_raster_cache_save (cache_path, &cache_source, icon_info->pixbuf, icon_info->scale);
+      g_free (cache_path);
+    }
+
   apply_emblems (icon_info);
 
   return TRUE;
@@ -4352,62 +4690,68 @@ gtk_icon_info_load_symbolic_png (GtkIconInfo    *icon_info,
                                                error_color ? error_color : &error_default);
 }
 
+/* Renders the symbolic SVG once, with each of the four colors
+ * replaced by a channel of its own: the foreground is black and
+ * success, warning and error are pure red, green and blue. This is
+ * the same encoding that .symbolic.png icons use, so the result can
+ * be recolored with gtk_icon_theme_color_symbolic_pixbuf() for any
+ * set of colors without going through the SVG loader again.
+ */
 static GdkPixbuf *
-gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
-                                 const GdkRGBA  *fg,
-                                 const GdkRGBA  *success_color,
-                                 const GdkRGBA  *warning_color,
-                                 const GdkRGBA  *error_color,
-                                 GError        **error)
+gtk_icon_info_load_symbolic_svg_mask (GtkIconInfo  *icon_info,
+                                      GError      **error)
 {
   GInputStream *stream;
   GdkPixbuf *pixbuf;
-  gchar *css_fg;
-  gchar *css_success;
-  gchar *css_warning;
-  gchar *css_error;
   gchar *data;
   gchar *width;
   gchar *height;
   gchar *file_data, *escaped_file_data;
   gsize file_len;
   gint symbolic_size;
-  double alpha;
-  gchar alphastr[G_ASCII_DTOSTR_BUF_SIZE];
-
-  alpha = fg->alpha;
+  char *cache_path;
+  IconRasterCacheSource cache_source;
 
-  css_fg = rgba_to_string_noalpha (fg);
+  if (icon_info->symbolic_mask)
+    return g_object_ref (icon_info->symbolic_mask);
 
-  css_success = css_warning = css_error = NULL;
+  if (!icon_info_ensure_scale_and_pixbuf (icon_info))
+    {
+      g_propagate_error (error, icon_info->load_error);
+      icon_info->load_error = NULL;
+      return NULL;
+    }
 
-  if (warning_color)
-    css_warning = rgba_to_string_noalpha (warning_color);
-  else
-    css_warning = g_strdup ("rgb(245,121,62)");
+  width = g_strdup_printf ("symbolic-mask %dx%d",
+                           gdk_pixbuf_get_width (icon_info->pixbuf),
+                           gdk_pixbuf_get_height (icon_info->pixbuf));
+  cache_path = icon_raster_cache_get_path (icon_info, width, &cache_source);
+  g_free (width);
 
-  if (error_color)
-    css_error = rgba_to_string_noalpha (error_color);
-  else
-    css_error = g_strdup ("rgb(204,0,0)");
+  if (cache_path)
+    {
+      icon_info->symbolic_mask = icon_raster_cache_load (cache_path, &cache_source, NULL);
 
-  if (success_color)
-    css_success = rgba_to_string_noalpha (success_color);
-  else
-    css_success = g_strdup ("rgb(78,154,6)");
+      /* The colorizing code relies on masks having alpha, and on the
+       * size we asked for; a bad entry gets rendered again and replaced
+       */
+      if (icon_info->symbolic_mask &&
+          (!gdk_pixbuf_get_has_alpha (icon_info->symbolic_mask) ||
+           gdk_pixbuf_get_n_channels (icon_info->symbolic_mask) != 4 ||
+           gdk_pixbuf_get_width (icon_info->symbolic_mask) != gdk_pixbuf_get_width (icon_info->pixbuf) ||
+           gdk_pixbuf_get_height (icon_info->symbolic_mask) != gdk_pixbuf_get_height (icon_info->pixbuf)))
+        g_clear_object (&icon_info->symbolic_mask);
+
+      if (icon_info->symbolic_mask)
+        {
+          g_free (cache_path);
+          return g_object_ref (icon_info->symbolic_mask);
+        }
+    }
 
   if (!g_file_load_contents (icon_info->icon_file, NULL, &file_data, &file_len, NULL, error))
-    return NULL;
-
-  if (!icon_info_ensure_scale_and_pixbuf (icon_info))
     {
-      g_propagate_error (error, icon_info->load_error);
-      icon_info->load_error = NULL;
-      g_free (css_fg);
-      g_free (css_warning);
-      g_free (css_error);
-      g_free (css_success);
-      g_free (file_data);
+      g_free (cache_path);
       return NULL;
     }
 
@@ -4421,11 +4765,8 @@ gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
 
       if (!pixbuf)
         {
-          g_free (css_fg);
-          g_free (css_warning);
-          g_free (css_error);
-          g_free (css_success);
           g_free (file_data);
+          g_free (cache_path);
           return NULL;
         }
 
@@ -4453,8 +4794,6 @@ gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
   escaped_file_data = g_markup_escape_text (file_data, file_len);
   g_free (file_data);
 
-  g_ascii_dtostr (alphastr, G_ASCII_DTOSTR_BUF_SIZE, CLAMP (alpha, 0, 1));
-
   data = g_strconcat ("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
                       "<svg version=\"1.1\"\n"
                       "     xmlns=\"http://www.w3.org/2000/svg\"\n"
@@ -4463,26 +4802,22 @@ gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
                       "     height=\"", height, "\">\n"
                       "  <style type=\"text/css\">\n"
                       "    rect,path {\n"
-                      "      fill: ", css_fg," !important;\n"
+                      "      fill: rgb(0,0,0) !important;\n"
                       "    }\n"
                       "    .warning {\n"
-                      "      fill: ", css_warning, " !important;\n"
+                      "      fill: rgb(0,255,0) !important;\n"
                       "    }\n"
                       "    .error {\n"
-                      "      fill: ", css_error ," !important;\n"
+                      "      fill: rgb(0,0,255) !important;\n"
                       "    }\n"
                       "    .success {\n"
-                      "      fill: ", css_success, " !important;\n"
+                      "      fill: rgb(255,0,0) !important;\n"
                       "    }\n"
                       "  </style>\n"
-                      "  <g opacity=\"", alphastr, "\" ><xi:include href=\"data:text/xml,", escaped_file_data, "\"/></g>\n"
+                      "  <xi:include href=\"data:text/xml,", escaped_file_data, "\"/>\n"
                       "</svg>",
                       NULL);
   g_free (escaped_file_data);
-  g_free (css_fg);
-  g_free (css_warning);
-  g_free (css_error);
-  g_free (css_success);
   g_free (width);
   g_free (height);
 
@@ -4495,9 +4830,63 @@ gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
                                                 error);
   g_object_unref (stream);
 
+  if (pixbuf == NULL)
+    {
+      g_free (cache_path);
+      return NULL;
+    }
+
+  /* The colorizing code below relies on this */
+  if (!gdk_pixbuf_get_has_alpha (pixbuf))
+    {
+      GdkPixbuf *with_alpha;
+
+      with_alpha = gdk_pixbuf_add_alpha (pixbuf, FALSE, 0, 0, 0);
+      g_object_unref (pixbuf);
+      pixbuf = with_alpha;
+    }
+
+  if (cache_path)
+    {
+      icon_raster_cache_save (cache_path, &cache_source, pixbuf, 1.0);
+      g_free (cache_path);
+    }
+
+  icon_info->symbolic_mask = g_object_ref (pixbuf);
+
   return pixbuf;
 }
 
+static GdkPixbuf *
+gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
+                                 const GdkRGBA  *fg,
+                                 const GdkRGBA  *success_color,
+                                 const GdkRGBA  *warning_color,
+                                 const GdkRGBA  *error_color,
+                                 GError        **error)
+{
+  GdkRGBA success_default = { 78 / 255., 154 / 255., 6 / 255., 1.0 };
+  GdkRGBA warning_default = { 245 / 255., 121 / 255., 62 / 255., 1.0 };
+  GdkRGBA error_default = { 204 / 255., 0, 0, 1.0 };
+  GdkRGBA fg_clamped;
+  GdkPixbuf *mask, *pixbuf;
+
+  mask = gtk_icon_info_load_symbolic_svg_mask (icon_info, error);
+  if (mask == NULL)
+    return NULL;
+
+  fg_clamped = *fg;
+  fg_clamped.alpha = CLAMP (fg->alpha, 0, 1);
+
+  pixbuf = gtk_icon_theme_color_symbolic_pixbuf (mask,
+                                                 &fg_clamped,
+                                                 success_color ? success_color : &success_default,
+                                                 warning_color ? warning_color : &warning_default,
+                                                 error_color ? error_color : &error_default);
+  g_object_unref (mask);
+
+  return pixbuf;
+}
 
 static GdkPixbuf *
 gtk_icon_info_load_symbolic_internal (GtkIconInfo    *icon_info,
@@ -4842,6 +5231,22 @@ gtk_icon_info_load_symbolic_async (GtkIconInfo          *icon_info,
           pixbuf = symbolic_cache_get_proxy (symbolic_cache, icon_info);
           g_task_return_pointer (task, pixbuf, g_object_unref);
         }
+      else if (icon_info->symbolic_mask)
+        {
+          GError *error = NULL;
+
+          /* Only the colors changed, recoloring is cheap enough
+           * to not need a thread
+           */
+          pixbuf = gtk_icon_info_load_symbolic_internal (icon_info,
+                                                         fg, success_color, warning_color, error_color,
+                                                         TRUE,
+                                                         &error);
+          if (pixbuf == NULL)
+            g_task_return_error (task, error);
+          else
+            g_task_return_pointer (task, pixbuf, g_object_unref);
+        }
       else
         {
           if (fg)
@@ -4914,6 +5319,9 @@ gtk_icon_info_load_symbolic_finish (GtkIconInfo   *icon_info,
 
       g_assert (pixbuf != NULL); /* we checked for !had_error above */
 
+      if (icon_info->symbolic_mask == NULL && data->dup->symbolic_mask != NULL)
+        icon_info->symbolic_mask = g_object_ref (data->dup->symbolic_mask);
+
       symbolic_cache = symbolic_pixbuf_cache_matches (icon_info->symbolic_pixbuf_cache,
                                                       data->fg_set ? &data->fg : NULL,
                                                       data->success_color_set ? &data->success_color : NULL,
@@ -4939,6 +5347,37 @@ gtk_icon_info_load_symbolic_finish (GtkIconInfo   *icon_info,
   return g_task_propagate_pointer (task, error);
 }
 
+/*< private >
+ * gtk_icon_info_is_loaded:
+ * @icon_info: a #GtkIconInfo
+ * @fg: (allow-none): the foreground color for symbolic icons
+ * @success_color: (allow-none): the success color
+ * @warning_color: (allow-none): the warning color
+ * @error_color: (allow-none): the error color
+ *
+ * Checks whether loading @icon_info, or loading it as symbolic icon
+ * with the given colors if @fg is not %NULL, can be done without
+ * reading and decoding the icon file.
+ *
+ * Returns: %TRUE if the icon can be loaded without blocking
+ */
+gboolean
+gtk_icon_info_is_loaded (GtkIconInfo   *icon_info,
+                         const GdkRGBA *fg,
+                         const GdkRGBA *success_color,
+                         const GdkRGBA *warning_color,
+                         const GdkRGBA *error_color)
+{
+  g_return_val_if_fail (GTK_IS_ICON_INFO (icon_info), FALSE);
+
+  if (fg == NULL || !gtk_icon_info_is_symbolic (icon_info))
+    return icon_info_get_pixbuf_ready (icon_info);
+
+  return icon_info->symbolic_mask != NULL ||
+         symbolic_pixbuf_cache_matches (icon_info->symbolic_pixbuf_cache,
+                                        fg, success_color, warning_color, error_color) != NULL;
+}
+
 /**
  * gtk_icon_info_load_symbolic_for_context_async:
  * @icon_info: a #GtkIconInfo from gtk_icon_theme_lookup_icon()
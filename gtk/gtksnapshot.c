@@ -76,6 +76,17 @@ gtk_snapshot_collect_default (GtkSnapshotState *state,
   return node;
 }
 
+/* Finished snapshots keep their root state, together with its chain of
+ * cached states, for the next snapshot, so that taking a snapshot usually
+ * doesn't allocate any states.
+ */
+#define MAX_CACHED_ROOT_STATES 4
+
+/* Snapshots can be taken in any thread */
+G_LOCK_DEFINE_STATIC (cached_root_states);
+static GtkSnapshotState *cached_root_states[MAX_CACHED_ROOT_STATES];
+static guint n_cached_root_states = 0;
+
 static GtkSnapshotState *
 gtk_snapshot_state_new (GtkSnapshotState       *parent,
                         char                   *name,
@@ -84,14 +95,22 @@ gtk_snapshot_state_new (GtkSnapshotState       *parent,
                         int                     translate_y,
                         GtkSnapshotCollectFunc  collect_func)
 {
-  GtkSnapshotState *state;
+  GtkSnapshotState *state = NULL;
 
   if (parent != NULL && parent->cached_state != NULL)
     {
       state = parent->cached_state;
       parent->cached_state = NULL;
     }
-  else
+  else if (parent == NULL)
+    {
+      G_LOCK (cached_root_states);
+      if (n_cached_root_states > 0)
+        state = cached_root_states[--n_cached_root_states];
+      G_UNLOCK (cached_root_states);
+    }
+
+  if (state == NULL)
     {
       state = g_slice_new0 (GtkSnapshotState);
       state->nodes = g_ptr_array_new_with_free_func ((GDestroyNotify) gsk_render_node_unref);
@@ -946,7 +965,20 @@ gtk_snapshot_pop_internal (GtkSnapshot *snapshot)
                               state->name);
 
   if (snapshot->state == NULL)
-    gtk_snapshot_state_free (state);
+    {
+      gtk_snapshot_state_clear (state);
+
+      G_LOCK (cached_root_states);
+      if (n_cached_root_states < MAX_CACHED_ROOT_STATES)
+        {
+          cached_root_states[n_cached_root_states++] = state;
+          state = NULL;
+        }
+      G_UNLOCK (cached_root_states);
+
+      if (state != NULL)
+        gtk_snapshot_state_free (state);
+    }
   else
     {
       gtk_snapshot_state_clear (state);
@@ -993,6 +1025,21 @@ gtk_snapshot_pop (GtkSnapshot *snapshot)
     }
 }
 
+/*
+ * gtk_snapshot_pop_collect:
+ * @snapshot: a #GtkSnapshot
+ *
+ * Like gtk_snapshot_pop(), but instead of appending the collected
+ * node to the node underneath it, returns it to the caller.
+ *
+ * Returns: (transfer full) (nullable): the collected node
+ */
+GskRenderNode *
+gtk_snapshot_pop_collect (GtkSnapshot *snapshot)
+{
+  return gtk_snapshot_pop_internal (snapshot);
+}
+
 /**
  * gtk_snapshot_get_renderer:
  * @snapshot: a #GtkSnapshot
@@ -1085,6 +1132,42 @@ gtk_snapshot_append_node (GtkSnapshot   *snapshot,
     }
 }
 
+/*
+ * gtk_snapshot_append_node_at_offset:
+ * @snapshot: a #GtkSnapshot
+ * @node: a #GskRenderNode created with an offset of (0, 0)
+ *
+ * Appends @node to the current render node of @snapshot, translated
+ * by the current offset. This is used to reuse nodes that have been
+ * recorded in their own coordinate system, like the render nodes
+ * cached by widgets.
+ */
+void
+gtk_snapshot_append_node_at_offset (GtkSnapshot   *snapshot,
+                                    GskRenderNode *node)
+{
+  GskRenderNode *transform_node;
+  graphene_matrix_t offset;
+
+  if (snapshot->state->translate_x == 0 &&
+      snapshot->state->translate_y == 0)
+    {
+      gtk_snapshot_append_node (snapshot, node);
+      return;
+    }
+
+  graphene_matrix_init_translate (&offset,
+                                  &GRAPHENE_POINT3D_INIT(
+                                      snapshot->state->translate_x,
+                                      snapshot->state->translate_y,
+                                      0
+                                  ));
+
+  transform_node = gsk_transform_node_new (node, &offset);
+  gtk_snapshot_append_node (snapshot, transform_node);
+  gsk_render_node_unref (transform_node);
+}
+
 /**
  * gtk_snapshot_append_cairo:
  * @snapshot: a #GtkSnapshot
@@ -1262,6 +1345,33 @@ gtk_snapshot_clips_rect (GtkSnapshot                 *snapshot,
   return cairo_region_contains_rectangle (snapshot->state->clip_region, &offset_rect) == CAIRO_REGION_OVERLAP_OUT;
 }
 
+/*
+ * gtk_snapshot_contains_rect:
+ * @snapshot: a #GtkSnapshot
+ * @rect: a rectangle
+ *
+ * Tests whether the rectangle is entirely inside the clip region of
+ * @snapshot, so that nothing drawn inside it will be clipped away.
+ *
+ * Returns: %TRUE if @rect is entirely inside the clip region
+ */
+gboolean
+gtk_snapshot_contains_rect (GtkSnapshot                 *snapshot,
+                            const cairo_rectangle_int_t *rect)
+{
+  cairo_rectangle_int_t offset_rect;
+
+  if (snapshot->state->clip_region == NULL)
+    return TRUE;
+
+  offset_rect.x = rect->x + snapshot->state->translate_x;
+  offset_rect.y = rect->y + snapshot->state->translate_y;
+  offset_rect.width = rect->width;
+  offset_rect.height = rect->height;
+
+  return cairo_region_contains_rectangle (snapshot->state->clip_region, &offset_rect) == CAIRO_REGION_OVERLAP_IN;
+}
+
 /**
  * gtk_snapshot_render_background:
  * @snapshot: a #GtkSnapshot
@@ -228,6 +228,19 @@ gtk_style_cascade_lookup (GtkStyleProviderPrivate *provider,
   gtk_style_cascade_iter_clear (&iter);
 }
 
+static gboolean
+gtk_style_cascade_may_affect (GtkStyleProviderPrivate *provider,
+                              const GtkCssMatcher     *matcher)
+{
+  GtkStyleCascade *cascade = GTK_STYLE_CASCADE (provider);
+
+  /* Adding or removing providers or changing the scale affects everything */
+  if (cascade->changed_provider == NULL)
+    return TRUE;
+
+  return _gtk_style_provider_private_may_affect (cascade->changed_provider, matcher);
+}
+
 static void
 gtk_style_cascade_provider_private_iface_init (GtkStyleProviderPrivateInterface *iface)
 {
@@ -236,6 +249,18 @@ gtk_style_cascade_provider_private_iface_init (GtkStyleProviderPrivateInterface
   iface->get_scale = gtk_style_cascade_get_scale;
   iface->get_keyframes = gtk_style_cascade_get_keyframes;
   iface->lookup = gtk_style_cascade_lookup;
+  iface->may_affect = gtk_style_cascade_may_affect;
+}
+
+static void
+gtk_style_cascade_provider_changed (GtkStyleProviderPrivate *provider,
+                                    GtkStyleCascade         *cascade)
+{
+  GtkStyleProviderPrivate *old_provider = cascade->changed_provider;
+
+  cascade->changed_provider = provider;
+  _gtk_style_provider_private_changed (GTK_STYLE_PROVIDER_PRIVATE (cascade));
+  cascade->changed_provider = old_provider;
 }
 
 G_DEFINE_TYPE_EXTENDED (GtkStyleCascade, _gtk_style_cascade, G_TYPE_OBJECT, 0,
@@ -300,16 +325,16 @@ _gtk_style_cascade_set_parent (GtkStyleCascade *cascade,
   if (parent)
     {
       g_object_ref (parent);
-      g_signal_connect_swapped (parent,
-                                "-gtk-private-changed",
-                                G_CALLBACK (_gtk_style_provider_private_changed),
-                                cascade);
+      g_signal_connect (parent,
+                        "-gtk-private-changed",
+                        G_CALLBACK (gtk_style_cascade_provider_changed),
+                        cascade);
     }
 
   if (cascade->parent)
     {
       g_signal_handlers_disconnect_by_func (cascade->parent, 
-                                            _gtk_style_provider_private_changed,
+                                            gtk_style_cascade_provider_changed,
                                             cascade);
       g_object_unref (cascade->parent);
     }
@@ -331,10 +356,10 @@ _gtk_style_cascade_add_provider (GtkStyleCascade  *cascade,
 
   data.provider = g_object_ref (provider);
   data.priority = priority;
-  data.changed_signal_id = g_signal_connect_swapped (provider,
-                                                     "-gtk-private-changed",
-                                                     G_CALLBACK (_gtk_style_provider_private_changed),
-                                                     cascade);
+  data.changed_signal_id = g_signal_connect (provider,
+                                             "-gtk-private-changed",
+                                             G_CALLBACK (gtk_style_cascade_provider_changed),
+                                             cascade);
 
   /* ensure it gets removed first */
   _gtk_style_cascade_remove_provider (cascade, provider);
@@ -40,6 +40,9 @@ struct _GtkStyleCascade
   GtkStyleCascade *parent;
   GArray *providers;
   int scale;
+
+  /* the provider whose change is being emitted, if any */
+  GtkStyleProviderPrivate *changed_provider;
 };
 
 struct _GtkStyleCascadeClass
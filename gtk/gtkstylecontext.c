@@ -255,7 +255,8 @@ static void
 gtk_style_context_cascade_changed (GtkStyleCascade *cascade,
                                    GtkStyleContext *context)
 {
-  gtk_css_node_invalidate_style_provider (gtk_style_context_get_root (context));
+  gtk_css_node_invalidate_style_provider_change (gtk_style_context_get_root (context),
+                                                 GTK_STYLE_PROVIDER_PRIVATE (cascade));
 }
 
 static void
@@ -287,8 +288,9 @@ gtk_style_context_set_cascade (GtkStyleContext *context,
 
   priv->cascade = cascade;
 
+  /* Not a change of the cascade, so it can't tell what it affects */
   if (cascade && priv->cssnode != NULL)
-    gtk_style_context_cascade_changed (cascade, context);
+    gtk_css_node_invalidate_style_provider (gtk_style_context_get_root (context));
 }
 
 static void
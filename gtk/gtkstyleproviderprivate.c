@@ -31,6 +31,7 @@ enum {
 G_DEFINE_INTERFACE (GtkStyleProviderPrivate, _gtk_style_provider_private, GTK_TYPE_STYLE_PROVIDER)
 
 static guint signals[LAST_SIGNAL];
+static GQuark change_serial_quark;
 
 static void
 _gtk_style_provider_private_default_init (GtkStyleProviderPrivateInterface *iface)
@@ -108,11 +109,89 @@ _gtk_style_provider_private_lookup (GtkStyleProviderPrivate *provider,
 void
 _gtk_style_provider_private_changed (GtkStyleProviderPrivate *provider)
 {
+  static guint change_serial = 0;
+
   gtk_internal_return_if_fail (GTK_IS_STYLE_PROVIDER_PRIVATE (provider));
 
+  if (G_UNLIKELY (change_serial_quark == 0))
+    change_serial_quark = g_quark_from_static_string ("gtk-style-provider-change-serial");
+
+  /* Serials are unique among all providers and never 0 */
+  change_serial++;
+  if (change_serial == 0)
+    change_serial++;
+  g_object_set_qdata (G_OBJECT (provider), change_serial_quark, GUINT_TO_POINTER (change_serial));
+
   g_signal_emit (provider, signals[CHANGED], 0);
 }
 
+/*
+ * _gtk_style_provider_private_get_change_serial:
+ * @provider: a provider that is emitting ::-gtk-private-changed
+ *
+ * Gets a number identifying the change @provider is emitting, so
+ * handlers that would otherwise repeat the same work for the same
+ * change can tell whether it was done already.
+ *
+ * Returns: the serial of the change, different for every emission
+ *   of ::-gtk-private-changed by any provider
+ */
+guint
+_gtk_style_provider_private_get_change_serial (GtkStyleProviderPrivate *provider)
+{
+  gtk_internal_return_val_if_fail (GTK_IS_STYLE_PROVIDER_PRIVATE (provider), 0);
+
+  if (change_serial_quark == 0)
+    return 0;
+
+  return GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (provider), change_serial_quark));
+}
+
+/*
+ * _gtk_style_provider_private_has_users:
+ * @provider: a provider
+ *
+ * Checks if anything, like a style cascade, reacts to changes of
+ * @provider. Providers don't need to track what changed otherwise.
+ *
+ * Returns: %TRUE if @provider is in use
+ */
+gboolean
+_gtk_style_provider_private_has_users (GtkStyleProviderPrivate *provider)
+{
+  gtk_internal_return_val_if_fail (GTK_IS_STYLE_PROVIDER_PRIVATE (provider), FALSE);
+
+  return g_signal_has_handler_pending (provider, signals[CHANGED], 0, FALSE);
+}
+
+/*
+ * _gtk_style_provider_private_may_affect:
+ * @provider: a provider that is emitting ::-gtk-private-changed
+ * @matcher: the matcher for a node
+ *
+ * Checks if the change @provider is currently emitting may change
+ * the style of the node matched by @matcher. Providers that can't
+ * tell affect all nodes.
+ *
+ * Returns: %FALSE if the node doesn't need to be restyled
+ */
+gboolean
+_gtk_style_provider_private_may_affect (GtkStyleProviderPrivate *provider,
+                                        const GtkCssMatcher     *matcher)
+{
+  GtkStyleProviderPrivateInterface *iface;
+
+  gtk_internal_return_val_if_fail (GTK_IS_STYLE_PROVIDER_PRIVATE (provider), TRUE);
+  gtk_internal_return_val_if_fail (matcher != NULL, TRUE);
+
+  iface = GTK_STYLE_PROVIDER_PRIVATE_GET_INTERFACE (provider);
+
+  if (!iface->may_affect)
+    return TRUE;
+
+  return iface->may_affect (provider, matcher);
+}
+
 GtkSettings *
 _gtk_style_provider_private_get_settings (GtkStyleProviderPrivate *provider)
 {
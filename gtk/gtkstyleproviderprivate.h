@@ -52,6 +52,8 @@ struct _GtkStyleProviderPrivateInterface
   void                  (* emit_error)          (GtkStyleProviderPrivate *provider,
                                                  GtkCssSection           *section,
                                                  const GError            *error);
+  gboolean              (* may_affect)          (GtkStyleProviderPrivate *provider,
+                                                 const GtkCssMatcher     *matcher);
   /* signal */
   void                  (* changed)             (GtkStyleProviderPrivate *provider);
 };
@@ -70,6 +72,11 @@ void                    _gtk_style_provider_private_lookup       (GtkStyleProvid
                                                                   GtkCssChange            *out_change);
 
 void                    _gtk_style_provider_private_changed      (GtkStyleProviderPrivate *provider);
+guint                   _gtk_style_provider_private_get_change_serial
+                                                                 (GtkStyleProviderPrivate *provider);
+gboolean                _gtk_style_provider_private_has_users    (GtkStyleProviderPrivate *provider);
+gboolean                _gtk_style_provider_private_may_affect   (GtkStyleProviderPrivate *provider,
+                                                                  const GtkCssMatcher     *matcher);
 
 void                    _gtk_style_provider_private_emit_error   (GtkStyleProviderPrivate *provider,
                                                                   GtkCssSection           *section,
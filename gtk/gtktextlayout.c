@@ -128,6 +128,8 @@ static void gtk_text_layout_emit_changed           (GtkTextLayout     *layout,
 
 static void gtk_text_layout_invalidate_all (GtkTextLayout *layout);
 
+static void line_display_cache_clear (GtkTextLayout *layout);
+
 static PangoAttribute *gtk_text_attr_appearance_new (const GtkTextAppearance *appearance);
 
 static void gtk_text_layout_mark_set_handler    (GtkTextBuffer     *buffer,
@@ -194,12 +196,7 @@ gtk_text_layout_dispose (GObject *object)
   g_clear_object (&layout->ltr_context);
   g_clear_object (&layout->rtl_context);
 
-  if (layout->one_display_cache)
-    {
-      GtkTextLineDisplay *tmp_display = layout->one_display_cache;
-      layout->one_display_cache = NULL;
-      gtk_text_layout_free_line_display (layout, tmp_display);
-    }
+  line_display_cache_clear (layout);
 
   if (layout->preedit_attrs != NULL)
     {
@@ -218,6 +215,7 @@ gtk_text_layout_finalize (GObject *object)
   layout = GTK_TEXT_LAYOUT (object);
 
   g_free (layout->preedit_string);
+  g_hash_table_unref (layout->display_cache_lines);
 
   G_OBJECT_CLASS (gtk_text_layout_parent_class)->finalize (object);
 }
@@ -278,6 +276,9 @@ static void
 gtk_text_layout_init (GtkTextLayout *text_layout)
 {
   text_layout->cursor_visible = TRUE;
+
+  g_queue_init (&text_layout->display_cache);
+  text_layout->display_cache_lines = g_hash_table_new (NULL, NULL);
 }
 
 GtkTextLayout*
@@ -636,8 +637,10 @@ text_layout_changed (GtkTextLayout *layout,
                      gint           new_height,
                      gboolean       cursors_only)
 {
-  /* Check if the range intersects our cached line display,
-   * and invalidate the cached line if so.
+  GList *l, *next;
+
+  /* Check if the range intersects our cached line displays,
+   * and invalidate the cached lines if so.
    */
   if (layout->one_display_cache)
     {
@@ -650,6 +653,18 @@ text_layout_changed (GtkTextLayout *layout,
 	gtk_text_layout_invalidate_cache (layout, line, cursors_only);
     }
 
+  for (l = layout->display_cache.head; l; l = next)
+    {
+      GtkTextLineDisplay *display = l->data;
+      gint cache_y = _gtk_text_btree_find_line_top (_gtk_text_buffer_get_btree (layout->buffer),
+						    display->line, layout);
+
+      next = l->next;
+
+      if (cache_y + display->height > y && cache_y < y + old_height)
+	gtk_text_layout_invalidate_cache (layout, display->line, cursors_only);
+    }
+
   gtk_text_layout_emit_changed (layout, y, old_height, new_height);
 }
 
@@ -814,29 +829,53 @@ gtk_text_layout_invalidate_all (GtkTextLayout *layout)
   gtk_text_layout_invalidate (layout, &start, &end);
 }
 
+static void
+invalidate_display_cursors (GtkTextLineDisplay *display)
+{
+  if (display->cursors)
+    g_array_free (display->cursors, TRUE);
+  display->cursors = NULL;
+  display->cursors_invalid = TRUE;
+  display->has_block_cursor = FALSE;
+}
+
 static void
 gtk_text_layout_invalidate_cache (GtkTextLayout *layout,
                                   GtkTextLine   *line,
 				  gboolean       cursors_only)
 {
+  GList *link;
+
   if (layout->one_display_cache && line == layout->one_display_cache->line)
     {
       GtkTextLineDisplay *display = layout->one_display_cache;
 
       if (cursors_only)
-	{
-          if (display->cursors)
-            g_array_free (display->cursors, TRUE);
-	  display->cursors = NULL;
-	  display->cursors_invalid = TRUE;
-	  display->has_block_cursor = FALSE;
-	}
+        invalidate_display_cursors (display);
       else
 	{
 	  layout->one_display_cache = NULL;
 	  gtk_text_layout_free_line_display (layout, display);
 	}
     }
+
+  if (layout->display_cache.length == 0)
+    return;
+
+  link = g_hash_table_lookup (layout->display_cache_lines, line);
+  if (link)
+    {
+      GtkTextLineDisplay *display = link->data;
+
+      if (cursors_only)
+        invalidate_display_cursors (display);
+      else
+        {
+          g_hash_table_remove (layout->display_cache_lines, line);
+          g_queue_delete_link (&layout->display_cache, link);
+          gtk_text_layout_free_line_display (layout, display);
+        }
+    }
 }
 
 /* Now invalidate the paragraph containing the cursor
@@ -922,37 +961,52 @@ gtk_text_layout_real_invalidate (GtkTextLayout *layout,
   gtk_text_layout_invalidated (layout);
 }
 
+static void
+invalidate_display_cursors_in_range (GtkTextLayout     *layout,
+                                     GtkTextLine       *line,
+                                     const GtkTextIter *start,
+                                     const GtkTextIter *end)
+{
+  GtkTextIter line_start, line_end;
+
+  gtk_text_layout_get_iter_at_line (layout, &line_start, line, 0);
+
+  line_end = line_start;
+  if (!gtk_text_iter_ends_line (&line_end))
+    gtk_text_iter_forward_to_line_end (&line_end);
+
+  if (gtk_text_iter_compare (&line_start, end) <= 0 &&
+      gtk_text_iter_compare (start, &line_end) <= 0)
+    {
+      gtk_text_layout_invalidate_cache (layout, line, TRUE);
+    }
+}
+
 static void
 gtk_text_layout_real_invalidate_cursors (GtkTextLayout     *layout,
 					 const GtkTextIter *start,
 					 const GtkTextIter *end)
 {
-  /* Check if the range intersects our cached line display,
-   * and invalidate the cached line if so.
-   */
-  if (layout->one_display_cache)
-    {
-      GtkTextIter line_start, line_end;
-      GtkTextLine *line = layout->one_display_cache->line;
+  GList *l;
 
-      gtk_text_layout_get_iter_at_line (layout, &line_start, line, 0);
+  if (gtk_text_iter_compare (start, end) > 0)
+    {
+      const GtkTextIter *tmp = start;
+      start = end;
+      end = tmp;
+    }
 
-      line_end = line_start;
-      if (!gtk_text_iter_ends_line (&line_end))
-	gtk_text_iter_forward_to_line_end (&line_end);
+  /* Check if the range intersects our cached line displays,
+   * and invalidate the cached lines if so.
+   */
+  if (layout->one_display_cache)
+    invalidate_display_cursors_in_range (layout, layout->one_display_cache->line, start, end);
 
-      if (gtk_text_iter_compare (start, end) > 0)
-	{
-	  const GtkTextIter *tmp = start;
-	  start = end;
-	  end = tmp;
-	}
+  for (l = layout->display_cache.head; l; l = l->next)
+    {
+      GtkTextLineDisplay *display = l->data;
 
-      if (gtk_text_iter_compare (&line_start, end) <= 0 &&
-	  gtk_text_iter_compare (start, &line_end) <= 0)
-	{
-	  gtk_text_layout_invalidate_cache (layout, line, TRUE);
-	}
+      invalidate_display_cursors_in_range (layout, display->line, start, end);
     }
 
   gtk_text_layout_invalidated (layout);
@@ -2232,6 +2286,67 @@ tags_array_toggle_tag (GPtrArray  *array,
   return array;
 }
 
+/* Large enough for all the lines on a big screen */
+#define MAX_CACHED_LINE_DISPLAYS 256
+
+static GtkTextLineDisplay *
+line_display_cache_lookup (GtkTextLayout *layout,
+                           GtkTextLine   *line)
+{
+  GList *link;
+
+  if (layout->display_cache.length == 0)
+    return NULL;
+
+  link = g_hash_table_lookup (layout->display_cache_lines, line);
+  if (link == NULL)
+    return NULL;
+
+  if (link != layout->display_cache.head)
+    {
+      g_queue_unlink (&layout->display_cache, link);
+      g_queue_push_head_link (&layout->display_cache, link);
+    }
+
+  return link->data;
+}
+
+static void
+line_display_cache_add (GtkTextLayout      *layout,
+                        GtkTextLineDisplay *display)
+{
+  g_queue_push_head (&layout->display_cache, display);
+  g_hash_table_insert (layout->display_cache_lines,
+                       display->line,
+                       layout->display_cache.head);
+
+  while (layout->display_cache.length > MAX_CACHED_LINE_DISPLAYS)
+    {
+      GtkTextLineDisplay *old = g_queue_pop_tail (&layout->display_cache);
+
+      g_hash_table_remove (layout->display_cache_lines, old->line);
+      gtk_text_layout_free_line_display (layout, old);
+    }
+}
+
+static void
+line_display_cache_clear (GtkTextLayout *layout)
+{
+  GtkTextLineDisplay *display;
+
+  if (layout->one_display_cache)
+    {
+      display = layout->one_display_cache;
+      layout->one_display_cache = NULL;
+      gtk_text_layout_free_line_display (layout, display);
+    }
+
+  g_hash_table_remove_all (layout->display_cache_lines);
+
+  while ((display = g_queue_pop_head (&layout->display_cache)) != NULL)
+    gtk_text_layout_free_line_display (layout, display);
+}
+
 GtkTextLineDisplay *
 gtk_text_layout_get_line_display (GtkTextLayout *layout,
                                   GtkTextLine   *line,
@@ -2260,6 +2375,14 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
   
   g_return_val_if_fail (line != NULL, NULL);
 
+  display = line_display_cache_lookup (layout, line);
+  if (display)
+    {
+      if (!size_only)
+        update_text_display_cursors (layout, line, display);
+      return display;
+    }
+
   if (layout->one_display_cache)
     {
       if (line == layout->one_display_cache->line &&
@@ -2602,7 +2725,13 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
   if (tags != NULL)
     g_ptr_array_free (tags, TRUE);
 
-  layout->one_display_cache = display;
+  /* Lines without line data can go away without us being told,
+   * so only keep those until the next line is requested
+   */
+  if (!size_only && _gtk_text_line_get_data (line, layout) != NULL)
+    line_display_cache_add (layout, display);
+  else
+    layout->one_display_cache = display;
 
   if (saw_widget)
     allocate_child_widgets (layout, display);
@@ -2614,7 +2743,13 @@ void
 gtk_text_layout_free_line_display (GtkTextLayout      *layout,
                                    GtkTextLineDisplay *display)
 {
-  if (display != layout->one_display_cache)
+  GList *link;
+
+  if (display == layout->one_display_cache)
+    return;
+
+  link = g_hash_table_lookup (layout->display_cache_lines, display->line);
+  if (link == NULL || link->data != display)
     {
       if (display->layout)
         g_object_unref (display->layout);
@@ -148,11 +148,19 @@ struct _GtkTextLayout
    * over long runs with the same style. */
   GtkTextAttributes *one_style_cache;
 
-  /* A cache of one line display. Getting the same line
-   * many times in a row is the most common case.
+  /* A cache of one line display, for displays that are only
+   * needed once, like the ones created for sizing lines.
    */
   GtkTextLineDisplay *one_display_cache;
 
+  /* Recently used complete line displays, most recently used first,
+   * and their links in the queue by line. Getting the same lines
+   * many times in a row, e.g. for each redraw, is the most common
+   * case.
+   */
+  GQueue display_cache;
+  GHashTable *display_cache_lines;
+
   /* Whether we are allowed to wrap right now */
   gint wrap_loop_count;
   
@@ -4410,15 +4410,53 @@ first_validate_callback (gpointer data)
   return FALSE;
 }
 
+/* How long incremental validation may run per idle, in microseconds */
+#define INCREMENTAL_VALIDATE_TIME 4000
+
+/* Lines near the visible area and near the cursor are the ones that
+ * scrolling and moving the cursor need next, so they are validated
+ * before the rest of the buffer.
+ */
+static void
+gtk_text_view_validate_nearby (GtkTextView *text_view)
+{
+  GtkTextViewPrivate *priv = text_view->priv;
+  GtkTextIter iter;
+  gint height;
+
+  height = SCREEN_HEIGHT (text_view);
+  if (height <= 0)
+    return;
+
+  gtk_text_view_get_first_para_iter (text_view, &iter);
+  gtk_text_layout_validate_yrange (priv->layout, &iter,
+                                   - 2 * height,
+                                   priv->first_para_pixels + 3 * height);
+
+  gtk_text_buffer_get_iter_at_mark (get_buffer (text_view), &iter,
+                                    gtk_text_buffer_get_insert (get_buffer (text_view)));
+  gtk_text_layout_validate_yrange (priv->layout, &iter, - height, height);
+}
+
 static gboolean
 incremental_validate_callback (gpointer data)
 {
   GtkTextView *text_view = data;
   gboolean result = TRUE;
+  gint64 end_time;
 
   DV(g_print(G_STRLOC"\n"));
-  
-  gtk_text_layout_validate (text_view->priv->layout, 2000);
+
+  end_time = g_get_monotonic_time () + INCREMENTAL_VALIDATE_TIME;
+
+  gtk_text_view_validate_nearby (text_view);
+
+  /* Validate in small steps until the time is up, so slow lines
+   * don't block for long and fast ones don't need many idles
+   */
+  while (!gtk_text_layout_is_valid (text_view->priv->layout) &&
+         g_get_monotonic_time () < end_time)
+    gtk_text_layout_validate (text_view->priv->layout, 500);
 
   gtk_text_view_update_adjustments (text_view);
   
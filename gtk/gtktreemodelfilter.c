@@ -287,6 +287,7 @@ struct _GtkTreeModelFilterPrivate
 
   guint in_row_deleted       : 1;
   guint virtual_root_deleted : 1;
+  guint in_refilter          : 1;
 
   /* signal ids */
   gulong changed_id;
@@ -509,6 +510,7 @@ gtk_tree_model_filter_init (GtkTreeModelFilter *filter)
   filter->priv->modify_func_set = FALSE;
   filter->priv->in_row_deleted = FALSE;
   filter->priv->virtual_root_deleted = FALSE;
+  filter->priv->in_refilter = FALSE;
 }
 
 static void
@@ -1232,7 +1234,11 @@ gtk_tree_model_filter_increment_stamp (GtkTreeModelFilter *filter)
     }
   while (filter->priv->stamp == 0);
 
-  gtk_tree_model_filter_clear_cache (filter);
+  /* A refilter walks the cached levels, so it must not have them freed
+   * under its feet.  It clears the cache once it is done instead.
+   */
+  if (!filter->priv->in_refilter)
+    gtk_tree_model_filter_clear_cache (filter);
 }
 
 static gboolean
@@ -1883,6 +1889,68 @@ find_elt_with_offset (GtkTreeModelFilter *filter,
   return TRUE;
 }
 
+/* Makes @elt visible and, if it is visible in the target, emits the
+ * signals for a row that has been inserted.  @emit_inserted is %FALSE
+ * if row-inserted has already been emitted while building the level.
+ */
+static void
+gtk_tree_model_filter_show_elt (GtkTreeModelFilter *filter,
+                                FilterLevel        *level,
+                                FilterElt          *elt,
+                                GtkTreeIter        *c_iter,
+                                gboolean            emit_inserted)
+{
+  GtkTreePath *path;
+  GtkTreeIter iter;
+
+  /* Make sure elt is visible.  elt can already be visible in case
+   * it was pulled in when building the level, so avoid inserting it
+   * into visible_seq twice.
+   */
+  if (!elt->visible_siter)
+    {
+      elt->visible_siter = g_sequence_insert_sorted (level->visible_seq,
+                                                     elt, filter_elt_cmp,
+                                                     NULL);
+    }
+
+  /* Check whether the node and all of its parents are visible */
+  if (!gtk_tree_model_filter_elt_is_visible_in_target (level, elt))
+    return;
+
+  iter.stamp = filter->priv->stamp;
+  iter.user_data = level;
+  iter.user_data2 = elt;
+
+  path = gtk_tree_model_get_path (GTK_TREE_MODEL (filter), &iter);
+
+  if (emit_inserted &&
+      (!level->parent_level || level->ext_ref_count > 0))
+    gtk_tree_model_row_inserted (GTK_TREE_MODEL (filter), path, &iter);
+
+  if (level->parent_level && level->parent_elt->ext_ref_count > 0 &&
+      g_sequence_get_length (level->visible_seq) == 1)
+    {
+      /* We know that this is the first visible node in this level, so
+       * we need to emit row-has-child-toggled on the parent.  This
+       * does not apply to the root level.
+       */
+
+      gtk_tree_path_up (path);
+      gtk_tree_model_get_iter (GTK_TREE_MODEL (filter), &iter, path);
+
+      gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (filter),
+                                            path,
+                                            &iter);
+    }
+
+  gtk_tree_path_free (path);
+
+  if (emit_inserted &&
+      gtk_tree_model_iter_has_child (filter->priv->child_model, c_iter))
+    gtk_tree_model_filter_update_children (filter, level, elt);
+}
+
 /* TreeModel signals */
 static void
 gtk_tree_model_filter_emit_row_inserted_for_path (GtkTreeModelFilter *filter,
@@ -1890,10 +1958,8 @@ gtk_tree_model_filter_emit_row_inserted_for_path (GtkTreeModelFilter *filter,
                                                   GtkTreePath        *c_path,
                                                   GtkTreeIter        *c_iter)
 {
-  FilterLevel *level;
-  FilterElt *elt;
   GtkTreePath *path;
-  GtkTreeIter iter, children;
+  GtkTreeIter iter;
   gboolean signals_emitted = FALSE;
 
   if (!filter->priv->root)
@@ -1929,52 +1995,11 @@ gtk_tree_model_filter_emit_row_inserted_for_path (GtkTreeModelFilter *filter,
 
   gtk_tree_model_filter_get_iter_full (GTK_TREE_MODEL (filter), &iter, path);
 
-  level = FILTER_LEVEL (iter.user_data);
-  elt = FILTER_ELT (iter.user_data2);
-
-  /* Make sure elt is visible.  elt can already be visible in case
-   * it was pulled in above, so avoid inserted it into visible_seq twice.
-   */
-  if (!elt->visible_siter)
-    {
-      elt->visible_siter = g_sequence_insert_sorted (level->visible_seq,
-                                                     elt, filter_elt_cmp,
-                                                     NULL);
-    }
-
-  /* Check whether the node and all of its parents are visible */
-  if (gtk_tree_model_filter_elt_is_visible_in_target (level, elt))
-    {
-      /* visibility changed -- reget path */
-      gtk_tree_path_free (path);
-      path = gtk_tree_model_get_path (GTK_TREE_MODEL (filter), &iter);
-
-      if (!signals_emitted &&
-          (!level->parent_level || level->ext_ref_count > 0))
-        gtk_tree_model_row_inserted (GTK_TREE_MODEL (filter), path, &iter);
-
-      if (level->parent_level && level->parent_elt->ext_ref_count > 0 &&
-          g_sequence_get_length (level->visible_seq) == 1)
-        {
-          /* We know that this is the first visible node in this level, so
-           * we need to emit row-has-child-toggled on the parent.  This
-           * does not apply to the root level.
-           */
-
-          gtk_tree_path_up (path);
-          gtk_tree_model_get_iter (GTK_TREE_MODEL (filter), &iter, path);
-
-          gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (filter),
-                                                path,
-                                                &iter);
-        }
-
-      if (!signals_emitted
-          && gtk_tree_model_iter_children (c_model, &children, c_iter))
-        gtk_tree_model_filter_update_children (filter, level, elt);
-    }
-
   gtk_tree_path_free (path);
+
+  gtk_tree_model_filter_show_elt (filter, FILTER_LEVEL (iter.user_data),
+                                  FILTER_ELT (iter.user_data2), c_iter,
+                                  !signals_emitted);
 }
 
 static void
@@ -2092,7 +2117,7 @@ gtk_tree_model_filter_row_changed (GtkTreeModel *c_model,
     gtk_tree_model_filter_check_ancestors (filter, real_path);
 
   gtk_tree_model_filter_emit_row_inserted_for_path (filter, c_model,
-                                                    c_path, c_iter);
+                                                    c_path, &real_c_iter);
 
 done:
   if (path)
@@ -2281,7 +2306,7 @@ done:
 
   if (emit_row_inserted)
     gtk_tree_model_filter_emit_row_inserted_for_path (filter, c_model,
-                                                      c_path, c_iter);
+                                                      c_path, &real_c_iter);
 
   if (real_path)
     gtk_tree_path_free (real_path);
@@ -4234,6 +4259,131 @@ gtk_tree_model_filter_convert_path_to_child_path (GtkTreeModelFilter *filter,
   return retval;
 }
 
+/* Re-evaluates the visibility of the rows of @level, which are the
+ * children of @c_parent_iter in the child model, and of its cached
+ * child levels.  This has the same effect as a row-changed for each
+ * of these rows, but walks the level and the child model side by side
+ * instead of looking up every row by path.  Rows in levels that are not
+ * cached are skipped, nothing is monitoring them.
+ *
+ * GtkTreeModel has no signals for ranges of rows, and refilter is
+ * documented to emit row-changed for every row that stays visible, so
+ * the view still gets one signal per row.  What is shared is the work
+ * behind them: the path of the rows that stay visible is computed once
+ * per level and then only has its last index updated.
+ */
+static void
+gtk_tree_model_filter_refilter_level (GtkTreeModelFilter *filter,
+                                      FilterLevel        *level,
+                                      GtkTreeIter        *c_parent_iter)
+{
+  GtkTreeModel *c_model = filter->priv->child_model;
+  GSequenceIter *siter;
+  GtkTreeIter c_iter;
+  GtkTreePath *path = NULL;
+  gint offset;
+  gint visible_index = 0;
+
+  if (!gtk_tree_model_iter_children (c_model, &c_iter, c_parent_iter))
+    return;
+
+  siter = g_sequence_get_begin_iter (level->seq);
+
+  for (offset = 0; ; offset++)
+    {
+      FilterElt *elt = NULL;
+      FilterLevel *children = NULL;
+      gboolean requested_state;
+
+      if (!g_sequence_iter_is_end (siter) &&
+          FILTER_ELT (g_sequence_get (siter))->offset == offset)
+        {
+          elt = g_sequence_get (siter);
+          children = elt->children;
+          siter = g_sequence_iter_next (siter);
+        }
+
+      requested_state = gtk_tree_model_filter_visible (filter, &c_iter);
+
+      if (elt && elt->visible_siter && !requested_state)
+        {
+          FilterElt *parent_elt = level->parent_elt;
+          gboolean last = g_sequence_get_length (level->seq) == 1;
+
+          gtk_tree_model_filter_remove_elt_from_level (filter, level, elt);
+
+          /* Removing the last node may have freed the level */
+          if (parent_elt && parent_elt->children != level)
+            {
+              if (path)
+                gtk_tree_path_free (path);
+              return;
+            }
+
+          /* Otherwise elt is gone, unless it was kept as the last node */
+          if (!last)
+            elt = NULL;
+        }
+      else if (elt && elt->visible_siter)
+        {
+          if (gtk_tree_model_filter_elt_is_visible_in_target (level, elt))
+            {
+              if (level->ext_ref_count > 0)
+                {
+                  GtkTreeIter iter;
+
+                  iter.stamp = filter->priv->stamp;
+                  iter.user_data = level;
+                  iter.user_data2 = elt;
+
+                  /* The rows before this one have been refiltered
+                   * already, so its index is the number of visible
+                   * rows we passed
+                   */
+                  if (path == NULL)
+                    path = gtk_tree_model_get_path (GTK_TREE_MODEL (filter), &iter);
+                  else
+                    gtk_tree_path_get_indices (path)[gtk_tree_path_get_depth (path) - 1] = visible_index;
+
+                  gtk_tree_model_row_changed (GTK_TREE_MODEL (filter), path, &iter);
+                }
+
+              if (gtk_tree_model_iter_has_child (c_model, &c_iter))
+                gtk_tree_model_filter_update_children (filter, level, elt);
+            }
+        }
+      else if (requested_state)
+        {
+          if (!elt)
+            {
+              gint index;
+
+              elt = gtk_tree_model_filter_insert_elt_in_level (filter, &c_iter,
+                                                               level, offset,
+                                                               &index);
+            }
+
+          gtk_tree_model_filter_increment_stamp (filter);
+          gtk_tree_model_filter_show_elt (filter, level, elt, &c_iter, TRUE);
+        }
+
+      if (elt && elt->visible_siter)
+        visible_index++;
+
+      /* Levels that were built while showing elt have been filtered
+       * already, only refilter the ones that existed before
+       */
+      if (elt && elt->children && elt->children == children)
+        gtk_tree_model_filter_refilter_level (filter, elt->children, &c_iter);
+
+      if (!gtk_tree_model_iter_next (c_model, &c_iter))
+        break;
+    }
+
+  if (path)
+    gtk_tree_path_free (path);
+}
+
 static gboolean
 gtk_tree_model_filter_refilter_helper (GtkTreeModel *model,
                                        GtkTreePath  *path,
@@ -4250,20 +4400,46 @@ gtk_tree_model_filter_refilter_helper (GtkTreeModel *model,
  * gtk_tree_model_filter_refilter:
  * @filter: A #GtkTreeModelFilter.
  *
- * Emits ::row_changed for each row in the child model, which causes
- * the filter to re-evaluate whether a row is visible or not.
+ * Re-evaluates for each row in the child model whether it is visible
+ * or not, as if ::row_changed had been emitted for it.
  *
  * Since: 2.4
  */
 void
 gtk_tree_model_filter_refilter (GtkTreeModelFilter *filter)
 {
+  GtkTreeIter c_root_iter;
+  GtkTreeIter *c_parent_iter = NULL;
+
   g_return_if_fail (GTK_IS_TREE_MODEL_FILTER (filter));
 
-  /* S L O W */
-  gtk_tree_model_foreach (filter->priv->child_model,
-                          gtk_tree_model_filter_refilter_helper,
-                          filter);
+  if (!filter->priv->root)
+    {
+      /* S L O W, but the first row that becomes visible builds the
+       * root level and everything that matters below it
+       */
+      gtk_tree_model_foreach (filter->priv->child_model,
+                              gtk_tree_model_filter_refilter_helper,
+                              filter);
+      return;
+    }
+
+  if (filter->priv->virtual_root)
+    {
+      if (!gtk_tree_model_get_iter (filter->priv->child_model, &c_root_iter,
+                                    filter->priv->virtual_root))
+        return;
+
+      c_parent_iter = &c_root_iter;
+    }
+
+  filter->priv->in_refilter = TRUE;
+  gtk_tree_model_filter_refilter_level (filter,
+                                        FILTER_LEVEL (filter->priv->root),
+                                        c_parent_iter);
+  filter->priv->in_refilter = FALSE;
+
+  gtk_tree_model_filter_clear_cache (filter);
 }
 
 /**
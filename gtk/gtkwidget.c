@@ -77,6 +77,8 @@
 #include "gtkcssshadowsvalueprivate.h"
 #include "gtkdebugupdatesprivate.h"
 #include "gsk/gskdebugprivate.h"
+#include "gsk/gskrendererprivate.h"
+#include "gsk/gskrendernodeprivate.h"
 #include "gtkeventcontrollerlegacyprivate.h"
 
 #include "inspector/window.h"
@@ -3973,6 +3975,21 @@ gtk_widget_new (GType        type,
   return widget;
 }
 
+/*
+ * gtk_widget_invalidate_render_node:
+ * @widget: a #GtkWidget
+ *
+ * Drops the render node cached by @widget in gtk_widget_snapshot().
+ * Since the nodes of all ancestors include the node of @widget, their
+ * cached nodes are dropped as well.
+ */
+static void
+gtk_widget_invalidate_render_node (GtkWidget *widget)
+{
+  for (; widget != NULL; widget = _gtk_widget_get_parent (widget))
+    g_clear_pointer (&widget->priv->render_node, gsk_render_node_unref);
+}
+
 /**
  * gtk_widget_unparent:
  * @widget: a #GtkWidget
@@ -4010,6 +4027,8 @@ gtk_widget_unparent (GtkWidget *widget)
   if (gtk_widget_get_focus_child (priv->parent) == widget)
     gtk_widget_set_focus_child (priv->parent, NULL);
 
+  gtk_widget_invalidate_render_node (priv->parent);
+
   if (_gtk_widget_is_drawable (priv->parent))
     gtk_widget_queue_draw_area (priv->parent,
 				priv->clip.x,
@@ -4408,6 +4427,7 @@ gtk_widget_map (GtkWidget *widget)
 
       update_cursor_on_state_change (widget);
 
+      gtk_widget_invalidate_render_node (widget);
       if (!_gtk_widget_get_has_window (widget))
         gtk_widget_queue_draw (widget);
 
@@ -4432,6 +4452,7 @@ gtk_widget_unmap (GtkWidget *widget)
       g_object_ref (widget);
       gtk_widget_push_verify_invariants (widget);
 
+      gtk_widget_invalidate_render_node (widget);
       if (!_gtk_widget_get_has_window (widget))
 	gtk_widget_queue_draw (widget);
       _gtk_tooltip_hide (widget);
@@ -4907,6 +4928,9 @@ gtk_widget_unrealize (GtkWidget *widget)
       g_signal_emit (widget, widget_signals[UNREALIZE], 0);
       g_assert (!widget->priv->mapped);
       gtk_widget_set_realized (widget, FALSE);
+
+      /* Nodes may reference resources of the renderer */
+      gtk_widget_invalidate_render_node (widget);
     }
 
   gtk_widget_pop_verify_invariants (widget);
@@ -5254,6 +5278,8 @@ gtk_widget_queue_draw_region (GtkWidget            *widget,
   if (cairo_region_is_empty (region))
     return;
 
+  gtk_widget_invalidate_render_node (widget);
+
   /* Just return if the widget isn't mapped */
   if (!_gtk_widget_get_mapped (widget))
     return;
@@ -8272,6 +8298,9 @@ gtk_widget_reposition_after (GtkWidget *widget,
 
   gtk_widget_push_verify_invariants (widget);
 
+  /* The drawing order of the children is part of the parent's node */
+  gtk_widget_invalidate_render_node (parent);
+
   priv->parent = parent;
 
   if (previous_sibling)
@@ -10242,6 +10271,8 @@ gtk_widget_finalize (GObject *object)
 
   g_clear_object (&priv->context);
 
+  g_clear_pointer (&priv->render_node, gsk_render_node_unref);
+
   _gtk_size_request_cache_free (&priv->requests);
 
   for (l = priv->event_controllers; l; l = l->next)
@@ -13587,6 +13618,9 @@ gtk_widget_send_focus_change (GtkWidget *widget,
 
   widget->priv->has_focus = event->focus_change.in;
 
+  /* The focus outline is part of the widget's node */
+  gtk_widget_invalidate_render_node (widget);
+
   res = gtk_widget_event (widget, event);
 
   g_object_notify_by_pspec (G_OBJECT (widget), widget_props[PROP_HAS_FOCUS]);
@@ -15059,6 +15093,8 @@ gtk_widget_snapshot (GtkWidget   *widget,
   GtkCssStyle *style;
   GtkAllocation allocation;
   GtkBorder margin, border, padding;
+  GskRenderNodeArena *arena = NULL;
+  gboolean use_cache;
 
   if (!_gtk_widget_is_drawable (widget))
     return;
@@ -15081,6 +15117,33 @@ gtk_widget_snapshot (GtkWidget   *widget,
   if (opacity <= 0.0)
     return;
 
+  /* If the widget is drawn completely, we can record its node in widget
+   * coordinates and reuse it until the next gtk_widget_queue_draw().
+   * Recording snapshots (for the inspector) always get fresh nodes
+   * so that they include names.
+   * Toplevels don't cache: every change queues a draw on them, so their
+   * nodes only live for a frame and can come from the frame's arena.
+   */
+  use_cache = !snapshot->record_names &&
+              !GTK_DEBUG_CHECK (NO_RENDER_CACHE) &&
+              priv->parent != NULL &&
+              gtk_snapshot_contains_rect (snapshot, &offset_clip);
+
+  if (use_cache)
+    {
+      if (priv->render_node != NULL)
+        {
+          gtk_snapshot_append_node_at_offset (snapshot, priv->render_node);
+          return;
+        }
+
+      /* The cached node outlives the frame, so it must not pin a chunk
+       * of the frame's arena
+       */
+      arena = gsk_render_node_arena_suspend ();
+      gtk_snapshot_push (snapshot, FALSE, NULL);
+    }
+
   /* Compatibility mode: if the widget does not have a render node, we draw
    * using gtk_widget_draw() on a temporary node
    */
@@ -15178,6 +15241,15 @@ gtk_widget_snapshot (GtkWidget   *widget,
 
   if (GTK_DEBUG_CHECK (SNAPSHOT))
     gtk_snapshot_pop (snapshot);
+
+  if (use_cache)
+    {
+      g_clear_pointer (&priv->render_node, gsk_render_node_unref);
+      priv->render_node = gtk_snapshot_pop_collect (snapshot);
+      gsk_render_node_arena_resume (arena);
+      if (priv->render_node != NULL)
+        gtk_snapshot_append_node_at_offset (snapshot, priv->render_node);
+    }
 }
 
 static gboolean
@@ -15192,11 +15264,12 @@ gtk_widget_render (GtkWidget            *widget,
                    GdkWindow            *window,
                    const cairo_region_t *region)
 {
+  static GskRenderNodeArena *arena = NULL;
   GdkDrawingContext *context;
   GtkSnapshot snapshot;
   GskRenderer *renderer;
   GskRenderNode *root;
-  cairo_region_t *clip;
+  cairo_region_t *redraw_region;
 
   /* We only render double buffered on native windows */
   if (!gdk_window_has_native (window))
@@ -15206,23 +15279,47 @@ gtk_widget_render (GtkWidget            *widget,
   if (renderer == NULL)
     return;
 
-  context = gsk_renderer_begin_draw_frame (renderer, region);
-  clip = gdk_drawing_context_get_clip (context);
+  /* The nodes of a frame that widgets don't cache, like the ones of
+   * the toplevel and of partially drawn widgets, die together with the
+   * next frame, so allocate them from an arena
+   */
+  if (arena == NULL)
+    arena = gsk_render_node_arena_new ();
 
+  /* We snapshot the whole window so that the renderer can compare it
+   * with the previous frame and only redraw what changed. The render
+   * nodes cached by the widgets keep this cheap.
+   */
+  gsk_render_node_arena_push (arena);
   gtk_snapshot_init (&snapshot,
                      renderer,
                      should_record_names (widget),
-                     clip,
+                     NULL,
                      "Render<%s>", G_OBJECT_TYPE_NAME (widget));
-  cairo_region_destroy (clip);
   gtk_widget_snapshot (widget, &snapshot);
   root = gtk_snapshot_finish (&snapshot);
+  gsk_render_node_arena_pop (arena);
+
+  if (root != NULL)
+    redraw_region = gsk_renderer_compute_redraw_region (renderer, root, region);
+  else
+    redraw_region = cairo_region_copy (region);
+
+  if (cairo_region_is_empty (redraw_region))
+    {
+      g_clear_pointer (&root, gsk_render_node_unref);
+      cairo_region_destroy (redraw_region);
+      return;
+    }
+
+  context = gsk_renderer_begin_draw_frame (renderer, redraw_region);
+
   if (root != NULL)
     {
       gtk_inspector_record_render (widget,
                                    renderer,
                                    window,
-                                   region,
+                                   redraw_region,
                                    context,
                                    root);
 
@@ -15230,8 +15327,8 @@ gtk_widget_render (GtkWidget            *widget,
       gsk_render_node_unref (root);
     }
 
-
   gsk_renderer_end_draw_frame (renderer, context);
+  cairo_region_destroy (redraw_region);
 }
 
 /**
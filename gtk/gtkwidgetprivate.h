@@ -164,6 +164,12 @@ struct _GtkWidgetPrivate
 
   /* Pointer cursor */
   GdkCursor *cursor;
+
+  /* The render node produced by the last snapshot, in widget
+   * coordinates. It is reused until the widget or one of its
+   * descendants queues a redraw.
+   */
+  GskRenderNode *render_node;
 };
 
 GtkCssNode *  gtk_widget_get_css_node       (GtkWidget *widget);
@@ -10591,6 +10591,8 @@ gtk_window_set_focus_visible (GtkWindow *window,
   if (priv->focus_visible != setting)
     {
       priv->focus_visible = setting;
+      if (priv->focus_widget)
+        gtk_widget_queue_draw (priv->focus_widget);
       g_object_notify_by_pspec (G_OBJECT (window), window_props[PROP_FOCUS_VISIBLE]);
     }
 }
@@ -29,6 +29,7 @@
 #include "gtkframe.h"
 #include "gtkbutton.h"
 #include "gtkwidgetprivate.h"
+#include "gtkcssnodeprivate.h"
 
 
 struct _GtkInspectorMiscInfoPrivate {
@@ -82,6 +83,8 @@ struct _GtkInspectorMiscInfoPrivate {
   GtkWidget *is_toplevel;
   GtkWidget *child_visible_row;
   GtkWidget *child_visible;
+  GtkWidget *style_sharing_row;
+  GtkWidget *style_sharing;
 
   guint update_source_id;
   gint64 last_frame;
@@ -322,6 +325,21 @@ update_frame_clock (GtkInspectorMiscInfo *sl)
     }
 }
 
+static void
+update_style_sharing (GtkInspectorMiscInfo *sl)
+{
+  GtkStyleProviderPrivate *provider;
+  guint n_styles, hits, misses;
+  gchar *tmp;
+
+  provider = gtk_css_node_get_style_provider (gtk_widget_get_css_node (GTK_WIDGET (sl->priv->object)));
+  gtk_css_node_style_cache_get_shared_stats (provider, &n_styles, &hits, &misses);
+
+  tmp = g_strdup_printf (_("%u styles, %u hits, %u misses"), n_styles, hits, misses);
+  gtk_label_set_label (GTK_LABEL (sl->priv->style_sharing), tmp);
+  g_free (tmp);
+}
+
 static gboolean
 update_info (gpointer data)
 {
@@ -374,6 +392,7 @@ update_info (gpointer data)
       gtk_widget_set_visible (sl->priv->child_visible, gtk_widget_get_child_visible (GTK_WIDGET (sl->priv->object)));
 
       update_frame_clock (sl);
+      update_style_sharing (sl);
     }
 
   if (GTK_IS_BUILDABLE (sl->priv->object))
@@ -466,6 +485,7 @@ gtk_inspector_misc_info_set_object (GtkInspectorMiscInfo *sl,
       gtk_widget_show (sl->priv->is_toplevel_row);
       gtk_widget_show (sl->priv->is_toplevel_row);
       gtk_widget_show (sl->priv->frame_clock_row);
+      gtk_widget_show (sl->priv->style_sharing_row);
 
       g_signal_connect_object (object, "state-flags-changed", G_CALLBACK (state_flags_changed), sl, 0);
       state_flags_changed (GTK_WIDGET (sl->priv->object), 0, sl);
@@ -490,6 +510,7 @@ gtk_inspector_misc_info_set_object (GtkInspectorMiscInfo *sl,
       gtk_widget_hide (sl->priv->is_toplevel_row);
       gtk_widget_hide (sl->priv->child_visible_row);
       gtk_widget_hide (sl->priv->frame_clock_row);
+      gtk_widget_hide (sl->priv->style_sharing_row);
     }
 
   if (GTK_IS_BUILDABLE (object))
@@ -660,6 +681,8 @@ gtk_inspector_misc_info_class_init (GtkInspectorMiscInfoClass *klass)
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorMiscInfo, is_toplevel);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorMiscInfo, child_visible_row);
   gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorMiscInfo, child_visible);
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorMiscInfo, style_sharing_row);
+  gtk_widget_class_bind_template_child_private (widget_class, GtkInspectorMiscInfo, style_sharing);
 
   gtk_widget_class_bind_template_callback (widget_class, show_default_widget);
   gtk_widget_class_bind_template_callback (widget_class, show_focus_widget);
@@ -19,3 +19,4 @@ N_("Mapped");
 N_("Realized");
 N_("Is Toplevel");
 N_("Child Visible");
+N_("Shared Styles");
@@ -1,6 +1,7 @@
 /* -*- mode: C; c-basic-offset: 2; indent-tabs-mode: nil; -*- */
 
 #include <gsk/gskcairoblurprivate.h>
+#include <stdlib.h>
 
 static void
 init_surface (cairo_t *cr)
@@ -16,38 +17,75 @@ init_surface (cairo_t *cr)
   cairo_fill (cr);
 }
 
+static double
+measure (cairo_t      *cr,
+         int           radius,
+         GskBlurFlags  flags,
+         GTimer       *timer)
+{
+  double best = G_MAXDOUBLE;
+  int i;
+
+  /* Keep the best of a few runs to filter out noise */
+  for (i = 0; i < 3; i++)
+    {
+      double msec;
+
+      init_surface (cr);
+      g_timer_start (timer);
+      gsk_cairo_blur_surface (cairo_get_target (cr), radius, flags);
+      msec = g_timer_elapsed (timer, NULL) * 1000;
+      best = MIN (best, msec);
+    }
+
+  return best;
+}
+
 int
 main (int argc, char **argv)
 {
   cairo_surface_t *surface;
   cairo_t *cr;
   GTimer *timer;
-  double msec;
-  int i, j;
+  double msec, msec_x, msec_y;
+  double mpixels;
+  int i;
   int size;
 
   timer = g_timer_new ();
 
   size = 2000;
+  if (argc > 1)
+    size = MAX (atoi (argv[1]), 1);
+
+  mpixels = size * (double) size / 1000000.0;
 
   surface = cairo_image_surface_create (CAIRO_FORMAT_A8, size, size);
 
   cr = cairo_create (surface);
 
-  /* We do everything three times, first two as warmup */
-  for (j = 0; j < 2; j++)
+  /* Warm up; radius 1 is a no-op */
+  for (i = 2; i < 16; i++)
+    measure (cr, i, GSK_BLUR_X | GSK_BLUR_Y, timer);
+
+  g_print ("Blurring %dx%d A8 surface\n", size, size);
+  g_print ("Radius      X+Y msec   X+Y Mpixels/s    X Mpixels/s    Y Mpixels/s\n");
+
+  for (i = 2; i < 16; i++)
     {
-      for (i = 1; i < 16; i++)
-	{
-	  init_surface (cr);
-	  g_timer_start (timer);
-	  gsk_cairo_blur_surface (surface, i, GSK_BLUR_X | GSK_BLUR_Y);
-	  msec = g_timer_elapsed (timer, NULL) * 1000;
-	  if (j == 1)
-	    g_print ("Radius %2d: %.2f msec, %.2f kpixels/msec:\n", i, msec, size*size/(msec*1000));
-	}
+      msec = measure (cr, i, GSK_BLUR_X | GSK_BLUR_Y, timer);
+      msec_x = measure (cr, i, GSK_BLUR_X, timer);
+      msec_y = measure (cr, i, GSK_BLUR_Y, timer);
+
+      g_print ("%6d %14.2f %15.1f %14.1f %14.1f\n",
+               i, msec,
+               mpixels / (msec / 1000),
+               mpixels / (msec_x / 1000),
+               mpixels / (msec_y / 1000));
     }
 
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
   g_timer_destroy (timer);
 
   return 0;
@@ -19,10 +19,9 @@ main(int argc, char **argv)
   cairo_surface_t *surface;
   GskRenderNode *node;
   GError *error = NULL;
+  GMappedFile *mapped_file;
   GBytes *bytes;
   gint64 start, end;
-  char *contents;
-  gsize len;
   int run;
   GOptionContext *context;
 
@@ -47,21 +46,29 @@ main(int argc, char **argv)
       return 1;
     }
 
-  if (!g_file_get_contents (argv[1], &contents, &len, &error))
+  mapped_file = g_mapped_file_new (argv[1], FALSE, &error);
+  if (mapped_file == NULL)
     {
       g_printerr ("Could not open node file: %s\n", error->message);
       return 1;
     }
 
-  bytes = g_bytes_new_take (contents, len);
+  bytes = g_mapped_file_get_bytes (mapped_file);
+  g_mapped_file_unref (mapped_file);
   if (dump_variant)
     {
       GVariant *variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("(suuv)"), bytes, FALSE);
       char *s;
 
-      s = g_variant_print (variant, FALSE);
-      g_print ("%s\n", s);
-      g_free (s);
+      /* Only files written by older versions use GVariant */
+      if (g_variant_is_normal_form (variant))
+        {
+          s = g_variant_print (variant, FALSE);
+          g_print ("%s\n", s);
+          g_free (s);
+        }
+      else
+        g_print ("Not a GVariant node file\n");
       g_variant_unref (variant);
     }
 
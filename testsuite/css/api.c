@@ -33,14 +33,83 @@ gtk_css_provider_load_data_not_null_terminated (void)
   g_object_unref (p);
 }
 
+static GtkWidget *
+label_with_provider (const char     *style_class,
+                     GtkCssProvider *provider)
+{
+  GtkWidget *label;
+  GtkStyleContext *context;
+
+  label = gtk_label_new (style_class);
+  g_object_ref_sink (label);
+  context = gtk_widget_get_style_context (label);
+  gtk_style_context_add_class (context, style_class);
+  gtk_style_context_add_provider (context, GTK_STYLE_PROVIDER (provider),
+                                  GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  return label;
+}
+
+/* Reloading a provider with one changed rule must only restyle the
+ * nodes matching that rule. We can tell because a restyled node picks
+ * up the section of the newly parsed rule.
+ */
+static void
+gtk_css_provider_reload_changed_rule (void)
+{
+  GtkCssProvider *p;
+  GtkWidget *a, *b;
+  GtkStyleContext *context_a, *context_b;
+  GtkCssSection *section_a, *section_b;
+  GdkRGBA color;
+
+  p = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (p, ".a { color: red; }\n"
+                                      ".b { color: blue; }", -1);
+
+  a = label_with_provider ("a", p);
+  b = label_with_provider ("b", p);
+  context_a = gtk_widget_get_style_context (a);
+  context_b = gtk_widget_get_style_context (b);
+
+  section_a = gtk_style_context_get_section (context_a, "color");
+  section_b = gtk_style_context_get_section (context_b, "color");
+  g_assert (section_a != NULL);
+  g_assert (section_b != NULL);
+  gtk_css_section_ref (section_a);
+  gtk_css_section_ref (section_b);
+
+  gtk_css_provider_load_from_data (p, ".a { color: lime; }\n"
+                                      ".b { color: blue; }", -1);
+
+  gtk_style_context_get_color (context_a, &color);
+  g_assert (gdk_rgba_equal (&color, &(GdkRGBA) { 0, 1, 0, 1 }));
+  gtk_style_context_get_color (context_b, &color);
+  g_assert (gdk_rgba_equal (&color, &(GdkRGBA) { 0, 0, 1, 1 }));
+
+  g_assert (gtk_style_context_get_section (context_a, "color") != section_a);
+  g_assert (gtk_style_context_get_section (context_b, "color") == section_b);
+
+  gtk_css_section_unref (section_a);
+  gtk_css_section_unref (section_b);
+  g_object_unref (a);
+  g_object_unref (b);
+  g_object_unref (p);
+}
+
 
 int
 main (int argc, char *argv[])
 {
+  /* Keep sections around, so tests can tell which rule applied */
+  g_setenv ("GTK_CSS_DEBUG", "1", TRUE);
+
   gtk_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/gtk_css_provider_load_data/not_null_terminated",
       gtk_css_provider_load_data_not_null_terminated);
+  g_test_add_func ("/gtk_css_provider/reload/changed_rule",
+      gtk_css_provider_reload_changed_rule);
 
   return g_test_run ();
 }
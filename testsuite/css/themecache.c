@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2017 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+
+/* The theme cache is written to and read from the user's cache
+ * directory, and GTK_NO_DISK_CACHE is only read once, so every load
+ * happens in a subprocess using this directory.
+ */
+static char *cache_dir;
+
+static void
+load_theme (void)
+{
+  GtkCssProvider *named, *parsed;
+  char *named_string, *parsed_string;
+
+  /* Loading by name uses the cache, loading the file directly doesn't */
+  named = gtk_css_provider_get_named ("Adwaita", NULL);
+  parsed = gtk_css_provider_new ();
+  gtk_css_provider_load_from_resource (parsed, "/org/gtk/libgtk/theme/Adwaita/gtk.css");
+
+  named_string = gtk_css_provider_to_string (named);
+  parsed_string = gtk_css_provider_to_string (parsed);
+  g_assert_cmpstr (named_string, ==, parsed_string);
+
+  g_free (named_string);
+  g_free (parsed_string);
+  g_object_unref (parsed);
+}
+
+static GSList *
+list_cache_files (void)
+{
+  GSList *files = NULL;
+  const char *name;
+  char *path;
+  GDir *dir;
+
+  path = g_build_filename (cache_dir, "gtk-4.0", "css", NULL);
+  dir = g_dir_open (path, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+        files = g_slist_prepend (files, g_build_filename (path, name, NULL));
+      g_dir_close (dir);
+    }
+  g_free (path);
+
+  return files;
+}
+
+static void
+remove_cache_files (void)
+{
+  GSList *files, *l;
+
+  files = list_cache_files ();
+  for (l = files; l; l = l->next)
+    g_assert_cmpint (g_unlink (l->data), ==, 0);
+  g_slist_free_full (files, g_free);
+}
+
+static void
+run_load_theme (void)
+{
+  g_test_trap_subprocess ("/theme-cache/subprocess/load", 0, 0);
+  g_test_trap_assert_passed ();
+}
+
+static void
+test_theme_cache_roundtrip (void)
+{
+  GSList *files;
+
+  remove_cache_files ();
+
+  /* Parses the theme and writes the cache */
+  run_load_theme ();
+  files = list_cache_files ();
+  g_assert (files != NULL);
+  g_slist_free_full (files, g_free);
+
+  /* Loads the theme from the cache */
+  run_load_theme ();
+}
+
+static void
+test_theme_cache_corrupt (void)
+{
+  GSList *files, *l;
+
+  remove_cache_files ();
+  run_load_theme ();
+
+  /* A broken cache file must be ignored and replaced */
+  files = list_cache_files ();
+  g_assert (files != NULL);
+  for (l = files; l; l = l->next)
+    g_assert (g_file_set_contents (l->data, "GTK-CSS-THEME-CACHE garbage", -1, NULL));
+  g_slist_free_full (files, g_free);
+
+  run_load_theme ();
+  run_load_theme ();
+}
+
+static void
+test_theme_cache_disabled (void)
+{
+  GSList *files;
+
+  remove_cache_files ();
+
+  g_setenv ("GTK_NO_DISK_CACHE", "themes", TRUE);
+  run_load_theme ();
+  g_unsetenv ("GTK_NO_DISK_CACHE");
+
+  files = list_cache_files ();
+  g_assert (files == NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  if (!g_test_subprocess ())
+    {
+      cache_dir = g_dir_make_tmp ("gtk-theme-cache-XXXXXX", NULL);
+      g_assert (cache_dir != NULL);
+      g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+      g_unsetenv ("GTK_NO_DISK_CACHE");
+      g_unsetenv ("GTK_CSS_DEBUG");
+    }
+
+  g_test_add_func ("/theme-cache/subprocess/load", load_theme);
+  g_test_add_func ("/theme-cache/roundtrip", test_theme_cache_roundtrip);
+  g_test_add_func ("/theme-cache/corrupt", test_theme_cache_corrupt);
+  g_test_add_func ("/theme-cache/disabled", test_theme_cache_disabled);
+
+  return g_test_run ();
+}
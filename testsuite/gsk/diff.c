@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2017 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gsk/gsk.h>
+#include "gsk/gskrendernodeprivate.h"
+
+static GskRenderNode *
+color_node (float x, float y, float width, float height,
+            float r, float g, float b)
+{
+  GdkRGBA color = { r, g, b, 1 };
+
+  return gsk_color_node_new (&color, &GRAPHENE_RECT_INIT (x, y, width, height));
+}
+
+static GskRenderNode *
+container_node (GskRenderNode **children,
+                guint           n_children)
+{
+  GskRenderNode *node;
+  guint i;
+
+  node = gsk_container_node_new (children, n_children);
+  for (i = 0; i < n_children; i++)
+    gsk_render_node_unref (children[i]);
+
+  return node;
+}
+
+static GskRenderNode *
+translate_node (GskRenderNode *child,
+                float          dx,
+                float          dy)
+{
+  GskRenderNode *node;
+  graphene_matrix_t matrix;
+
+  graphene_matrix_init_translate (&matrix, &GRAPHENE_POINT3D_INIT (dx, dy, 0));
+  node = gsk_transform_node_new (child, &matrix);
+  gsk_render_node_unref (child);
+
+  return node;
+}
+
+/* Checks that diffing @node1 against @node2 gives exactly the given
+ * rectangles, and that diffing is symmetric.
+ */
+static void
+assert_diff (GskRenderNode               *node1,
+             GskRenderNode               *node2,
+             const cairo_rectangle_int_t *rects,
+             int                          n_rects)
+{
+  cairo_region_t *expected, *region;
+
+  expected = cairo_region_create_rectangles (rects, n_rects);
+
+  region = cairo_region_create ();
+  gsk_render_node_diff (node1, node2, region);
+  g_assert (cairo_region_equal (region, expected));
+  cairo_region_destroy (region);
+
+  region = cairo_region_create ();
+  gsk_render_node_diff (node2, node1, region);
+  g_assert (cairo_region_equal (region, expected));
+  cairo_region_destroy (region);
+
+  cairo_region_destroy (expected);
+}
+
+static void
+test_same_node (void)
+{
+  GskRenderNode *node;
+
+  node = color_node (0, 0, 10, 10, 1, 0, 0);
+  assert_diff (node, node, NULL, 0);
+  gsk_render_node_unref (node);
+}
+
+static void
+test_equal_nodes (void)
+{
+  GskRenderNode *node1, *node2;
+
+  node1 = color_node (0, 0, 10, 10, 1, 0, 0);
+  node2 = color_node (0, 0, 10, 10, 1, 0, 0);
+  assert_diff (node1, node2, NULL, 0);
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_color_change (void)
+{
+  cairo_rectangle_int_t rects[] = { { 0, 0, 10, 10 } };
+  GskRenderNode *node1, *node2;
+
+  node1 = color_node (0, 0, 10, 10, 1, 0, 0);
+  node2 = color_node (0, 0, 10, 10, 0, 1, 0);
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_move (void)
+{
+  cairo_rectangle_int_t rects[] = { { 0, 0, 10, 10 }, { 20, 0, 10, 10 } };
+  GskRenderNode *node1, *node2;
+
+  node1 = color_node (0, 0, 10, 10, 1, 0, 0);
+  node2 = color_node (20, 0, 10, 10, 1, 0, 0);
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_fractional_bounds (void)
+{
+  cairo_rectangle_int_t rects[] = { { 0, 1, 11, 10 } };
+  GskRenderNode *node1, *node2;
+
+  node1 = color_node (0.5, 1.25, 10, 9.5, 1, 0, 0);
+  node2 = color_node (0.5, 1.25, 10, 9.5, 0, 0, 1);
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_type_change (void)
+{
+  cairo_rectangle_int_t rects[] = { { 0, 0, 20, 20 } };
+  GskRenderNode *node1, *node2, *child;
+
+  node1 = color_node (0, 0, 10, 10, 1, 0, 0);
+  child = color_node (0, 0, 20, 20, 1, 0, 0);
+  node2 = gsk_opacity_node_new (child, 0.5);
+  gsk_render_node_unref (child);
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_container_child_change (void)
+{
+  cairo_rectangle_int_t rects[] = { { 20, 0, 10, 10 } };
+  GskRenderNode *children[3];
+  GskRenderNode *node1, *node2;
+
+  children[0] = color_node (0, 0, 10, 10, 1, 0, 0);
+  children[1] = color_node (20, 0, 10, 10, 1, 0, 0);
+  children[2] = color_node (40, 0, 10, 10, 1, 0, 0);
+  node1 = container_node (children, 3);
+
+  children[0] = color_node (0, 0, 10, 10, 1, 0, 0);
+  children[1] = color_node (20, 0, 10, 10, 0, 1, 0);
+  children[2] = color_node (40, 0, 10, 10, 1, 0, 0);
+  node2 = container_node (children, 3);
+
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_container_shared_children (void)
+{
+  cairo_rectangle_int_t rects[] = { { 20, 0, 10, 10 } };
+  GskRenderNode *first, *last;
+  GskRenderNode *children[3];
+  GskRenderNode *node1, *node2;
+
+  /* Children reused from a cache are skipped by identity */
+  first = color_node (0, 0, 10, 10, 1, 0, 0);
+  last = color_node (40, 0, 10, 10, 1, 0, 0);
+
+  children[0] = gsk_render_node_ref (first);
+  children[1] = gsk_render_node_ref (last);
+  node1 = container_node (children, 2);
+
+  children[0] = gsk_render_node_ref (first);
+  children[1] = color_node (20, 0, 10, 10, 0, 1, 0);
+  children[2] = gsk_render_node_ref (last);
+  node2 = container_node (children, 3);
+
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+  gsk_render_node_unref (first);
+  gsk_render_node_unref (last);
+}
+
+static void
+test_container_children_added (void)
+{
+  cairo_rectangle_int_t rects[] = {
+    { 0, 0, 10, 10 }, { 20, 0, 10, 10 }, { 40, 0, 10, 10 }, { 60, 0, 10, 10 }
+  };
+  GskRenderNode *children[4];
+  GskRenderNode *node1, *node2;
+
+  /* Without shared children to line them up, all children of both
+   * containers count as changed.
+   */
+  children[0] = color_node (0, 0, 10, 10, 1, 0, 0);
+  children[1] = color_node (40, 0, 10, 10, 1, 0, 0);
+  node1 = container_node (children, 2);
+
+  children[0] = color_node (0, 0, 10, 10, 1, 0, 0);
+  children[1] = color_node (20, 0, 10, 10, 0, 1, 0);
+  children[2] = color_node (40, 0, 10, 10, 1, 0, 0);
+  children[3] = color_node (60, 0, 10, 10, 0, 1, 0);
+  node2 = container_node (children, 4);
+
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_translation (void)
+{
+  cairo_rectangle_int_t rects[] = { { 105, 52, 10, 10 } };
+  GskRenderNode *node1, *node2;
+
+  node1 = translate_node (color_node (5, 2, 10, 10, 1, 0, 0), 100, 50);
+  node2 = translate_node (color_node (5, 2, 10, 10, 0, 1, 0), 100, 50);
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_fractional_translation (void)
+{
+  cairo_rectangle_int_t rects[] = { { 0, 0, 11, 10 } };
+  GskRenderNode *node1, *node2;
+
+  /* Changes can't be mapped through fractional translations, so the
+   * whole node counts as changed.
+   */
+  node1 = translate_node (color_node (0, 0, 10, 10, 1, 0, 0), 0.5, 0);
+  node2 = translate_node (color_node (0, 0, 10, 10, 0, 1, 0), 0.5, 0);
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_clip (void)
+{
+  cairo_rectangle_int_t rects[] = { { 0, 0, 5, 10 } };
+  GskRenderNode *node1, *node2, *child;
+
+  child = color_node (0, 0, 10, 10, 1, 0, 0);
+  node1 = gsk_clip_node_new (child, &GRAPHENE_RECT_INIT (0, 0, 5, 20));
+  gsk_render_node_unref (child);
+  child = color_node (0, 0, 10, 10, 0, 1, 0);
+  node2 = gsk_clip_node_new (child, &GRAPHENE_RECT_INIT (0, 0, 5, 20));
+  gsk_render_node_unref (child);
+
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static void
+test_opacity (void)
+{
+  cairo_rectangle_int_t rects[] = { { 20, 0, 10, 10 } };
+  GskRenderNode *children[2];
+  GskRenderNode *node1, *node2, *child;
+
+  children[0] = color_node (0, 0, 10, 10, 1, 0, 0);
+  children[1] = color_node (20, 0, 10, 10, 1, 0, 0);
+  child = container_node (children, 2);
+  node1 = gsk_opacity_node_new (child, 0.5);
+  gsk_render_node_unref (child);
+
+  children[0] = color_node (0, 0, 10, 10, 1, 0, 0);
+  children[1] = color_node (20, 0, 10, 10, 0, 1, 0);
+  child = container_node (children, 2);
+  node2 = gsk_opacity_node_new (child, 0.5);
+  gsk_render_node_unref (child);
+
+  assert_diff (node1, node2, rects, G_N_ELEMENTS (rects));
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/diff/same-node", test_same_node);
+  g_test_add_func ("/diff/equal-nodes", test_equal_nodes);
+  g_test_add_func ("/diff/color-change", test_color_change);
+  g_test_add_func ("/diff/move", test_move);
+  g_test_add_func ("/diff/fractional-bounds", test_fractional_bounds);
+  g_test_add_func ("/diff/type-change", test_type_change);
+  g_test_add_func ("/diff/container/child-change", test_container_child_change);
+  g_test_add_func ("/diff/container/shared-children", test_container_shared_children);
+  g_test_add_func ("/diff/container/children-added", test_container_children_added);
+  g_test_add_func ("/diff/translation", test_translation);
+  g_test_add_func ("/diff/fractional-translation", test_fractional_translation);
+  g_test_add_func ("/diff/clip", test_clip);
+  g_test_add_func ("/diff/opacity", test_opacity);
+
+  return g_test_run ();
+}
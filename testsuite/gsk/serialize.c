@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2017 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+static GskTexture *
+create_texture (void)
+{
+  guchar data[16 * 16 * 4];
+  int x, y;
+
+  for (y = 0; y < 16; y++)
+    for (x = 0; x < 16; x++)
+      {
+        guchar *p = data + (y * 16 + x) * 4;
+
+        p[0] = x * 16;
+        p[1] = y * 16;
+        p[2] = (x ^ y) * 16;
+        p[3] = 0xff;
+      }
+
+  return gsk_texture_new_for_data (data, 16, 16, 16 * 4);
+}
+
+static GskRenderNode *
+create_blend (GskBlendMode mode)
+{
+  GdkRGBA red = { 1, 0, 0, 1 };
+  GdkRGBA blue = { 0, 0, 1, 0.5 };
+  GskRenderNode *bottom, *top, *node;
+
+  bottom = gsk_color_node_new (&red, &GRAPHENE_RECT_INIT (0, 0, 20, 20));
+  top = gsk_color_node_new (&blue, &GRAPHENE_RECT_INIT (10, 10, 20, 20));
+  node = gsk_blend_node_new (bottom, top, mode);
+  gsk_render_node_unref (bottom);
+  gsk_render_node_unref (top);
+
+  return node;
+}
+
+/* A tree using most node types, with the texture shared by two nodes */
+static GskRenderNode *
+create_tree (void)
+{
+  GdkRGBA green = { 0, 1, 0, 1 };
+  GdkRGBA black = { 0, 0, 0, 0.75 };
+  GskColorStop stops[] = {
+    { 0.0, { 1, 1, 0, 1 } },
+    { 1.0, { 0, 1, 1, 1 } }
+  };
+  GdkRGBA border_colors[4] = { green, black, green, black };
+  float border_widths[4] = { 1, 2, 3, 4 };
+  GskRoundedRect outline;
+  graphene_matrix_t matrix;
+  GskRenderNode *children[9];
+  GskRenderNode *node, *child;
+  GskTexture *texture;
+  cairo_t *cr;
+  guint i;
+
+  texture = create_texture ();
+  gsk_rounded_rect_init_from_rect (&outline, &GRAPHENE_RECT_INIT (50, 0, 40, 30), 8);
+
+  children[0] = gsk_color_node_new (&green, &GRAPHENE_RECT_INIT (0, 0, 100, 100));
+  children[1] = gsk_texture_node_new (texture, &GRAPHENE_RECT_INIT (0, 0, 16, 16));
+  children[2] = gsk_texture_node_new (texture, &GRAPHENE_RECT_INIT (20, 0, 32, 32));
+
+  children[3] = gsk_cairo_node_new (&GRAPHENE_RECT_INIT (0, 40, 30, 30));
+  cr = gsk_cairo_node_get_draw_context (children[3], NULL);
+  cairo_set_source_rgb (cr, 0.5, 0, 0.5);
+  cairo_arc (cr, 15, 55, 10, 0, 2 * G_PI);
+  cairo_fill (cr);
+  cairo_destroy (cr);
+
+  children[4] = gsk_linear_gradient_node_new (&GRAPHENE_RECT_INIT (40, 40, 20, 20),
+                                              &GRAPHENE_POINT_INIT (40, 40),
+                                              &GRAPHENE_POINT_INIT (60, 60),
+                                              stops, G_N_ELEMENTS (stops));
+  children[5] = gsk_border_node_new (&outline, border_widths, border_colors);
+  children[6] = gsk_outset_shadow_node_new (&outline, &black, 2, 2, 1, 0);
+
+  child = create_blend (GSK_BLEND_MODE_MULTIPLY);
+  node = gsk_opacity_node_new (child, 0.5);
+  gsk_render_node_unref (child);
+  graphene_matrix_init_translate (&matrix, &GRAPHENE_POINT3D_INIT (60, 60, 0));
+  children[7] = gsk_transform_node_new (node, &matrix);
+  gsk_render_node_unref (node);
+
+  gsk_rounded_rect_init_from_rect (&outline, &GRAPHENE_RECT_INIT (0, 70, 30, 30), 10);
+  child = gsk_color_node_new (&black, &GRAPHENE_RECT_INIT (0, 70, 40, 40));
+  node = gsk_rounded_clip_node_new (child, &outline);
+  gsk_render_node_unref (child);
+  child = gsk_color_node_new (&green, &GRAPHENE_RECT_INIT (0, 70, 30, 30));
+  children[8] = gsk_cross_fade_node_new (node, child, 0.25);
+  gsk_render_node_unref (node);
+  gsk_render_node_unref (child);
+
+  node = gsk_container_node_new (children, G_N_ELEMENTS (children));
+  for (i = 0; i < G_N_ELEMENTS (children); i++)
+    gsk_render_node_unref (children[i]);
+  g_object_unref (texture);
+
+  return node;
+}
+
+static cairo_surface_t *
+draw_node (GskRenderNode *node)
+{
+  cairo_surface_t *surface;
+  cairo_t *cr;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 100, 100);
+  cr = cairo_create (surface);
+  gsk_render_node_draw (node, cr);
+  cairo_destroy (cr);
+  cairo_surface_flush (surface);
+
+  return surface;
+}
+
+static void
+assert_surfaces_equal (cairo_surface_t *surface1,
+                       cairo_surface_t *surface2)
+{
+  int y, stride;
+
+  g_assert_cmpint (cairo_image_surface_get_width (surface1), ==, cairo_image_surface_get_width (surface2));
+  g_assert_cmpint (cairo_image_surface_get_height (surface1), ==, cairo_image_surface_get_height (surface2));
+
+  stride = cairo_image_surface_get_stride (surface1);
+  g_assert_cmpint (stride, ==, cairo_image_surface_get_stride (surface2));
+
+  for (y = 0; y < cairo_image_surface_get_height (surface1); y++)
+    g_assert (memcmp (cairo_image_surface_get_data (surface1) + y * stride,
+                      cairo_image_surface_get_data (surface2) + y * stride,
+                      cairo_image_surface_get_width (surface1) * 4) == 0);
+}
+
+static void
+test_roundtrip (void)
+{
+  GskRenderNode *node, *copy;
+  cairo_surface_t *expected, *result;
+  GBytes *bytes, *bytes2;
+  GError *error = NULL;
+
+  node = create_tree ();
+  bytes = gsk_render_node_serialize (node);
+  g_assert (bytes != NULL);
+
+  copy = gsk_render_node_deserialize (bytes, &error);
+  g_assert_no_error (error);
+  g_assert (copy != NULL);
+
+  /* Serializing the copy must give the same file again */
+  bytes2 = gsk_render_node_serialize (copy);
+  g_assert (g_bytes_equal (bytes, bytes2));
+
+  expected = draw_node (node);
+  result = draw_node (copy);
+  assert_surfaces_equal (expected, result);
+
+  cairo_surface_destroy (expected);
+  cairo_surface_destroy (result);
+  g_bytes_unref (bytes2);
+  g_bytes_unref (bytes);
+  gsk_render_node_unref (copy);
+  gsk_render_node_unref (node);
+}
+
+static void
+test_truncated (void)
+{
+  GskRenderNode *node, *copy;
+  GBytes *bytes, *part;
+  GError *error = NULL;
+  gsize size, len, step;
+
+  node = create_tree ();
+  bytes = gsk_render_node_serialize (node);
+  size = g_bytes_get_size (bytes);
+  step = MAX (1, size / 256);
+
+  for (len = 0; len < size; len += step)
+    {
+      part = g_bytes_new_from_bytes (bytes, 0, len);
+      copy = gsk_render_node_deserialize (part, &error);
+      g_assert (copy == NULL);
+      g_assert (error != NULL);
+      g_clear_error (&error);
+      g_bytes_unref (part);
+    }
+
+  g_bytes_unref (bytes);
+  gsk_render_node_unref (node);
+}
+
+static void
+test_invalid_blend_mode (void)
+{
+  GskRenderNode *node, *copy;
+  GBytes *bytes1, *bytes2, *bad;
+  const guchar *data1, *data2;
+  guchar *data;
+  GError *error = NULL;
+  gsize i, size, diff;
+  guint32 mode = 0xffff;
+
+  /* The two files only differ in the blend mode, which tells us
+   * where it is stored without depending on the record layout
+   */
+  node = create_blend (GSK_BLEND_MODE_MULTIPLY);
+  bytes1 = gsk_render_node_serialize (node);
+  gsk_render_node_unref (node);
+  node = create_blend (GSK_BLEND_MODE_SCREEN);
+  bytes2 = gsk_render_node_serialize (node);
+  gsk_render_node_unref (node);
+
+  data1 = g_bytes_get_data (bytes1, &size);
+  data2 = g_bytes_get_data (bytes2, NULL);
+  g_assert_cmpuint (size, ==, g_bytes_get_size (bytes2));
+
+  diff = size;
+  for (i = 0; i < size; i++)
+    {
+      if (data1[i] != data2[i])
+        {
+          g_assert_cmpuint (diff, ==, size);
+          diff = i;
+        }
+    }
+  g_assert_cmpuint (diff, <, size);
+  diff -= diff % sizeof (guint32);
+
+  data = g_memdup (data1, size);
+  memcpy (data + diff, &mode, sizeof (guint32));
+  bad = g_bytes_new_take (data, size);
+
+  copy = gsk_render_node_deserialize (bad, &error);
+  g_assert (copy == NULL);
+  g_assert (error != NULL);
+
+  g_clear_error (&error);
+  g_bytes_unref (bad);
+  g_bytes_unref (bytes1);
+  g_bytes_unref (bytes2);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/serialize/roundtrip", test_roundtrip);
+  g_test_add_func ("/serialize/truncated", test_truncated);
+  g_test_add_func ("/serialize/invalid-blend-mode", test_invalid_blend_mode);
+
+  return g_test_run ();
+}
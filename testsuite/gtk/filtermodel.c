@@ -6782,6 +6782,110 @@ specific_bug_679910 (void)
   g_object_unref (store);
 }
 
+static gboolean
+specific_refilter_signals_visible_func (GtkTreeModel *model,
+                                        GtkTreeIter  *iter,
+                                        gpointer      data)
+{
+  const gchar **hidden = data;
+  gchar *name;
+  gboolean visible;
+
+  gtk_tree_model_get (model, iter, 0, &name, -1);
+  visible = g_strcmp0 (name, *hidden) != 0;
+  g_free (name);
+
+  return visible;
+}
+
+static void
+ref_node_for_string (GtkTreeModel *model,
+                     const gchar  *path_string,
+                     gboolean      ref)
+{
+  GtkTreeIter iter;
+
+  g_assert (gtk_tree_model_get_iter_from_string (model, &iter, path_string));
+
+  if (ref)
+    gtk_tree_model_ref_node (model, &iter);
+  else
+    gtk_tree_model_unref_node (model, &iter);
+}
+
+static void
+specific_refilter_signals (void)
+{
+  /* Checks the signals emitted by a refilter that hides, shows and
+   * keeps rows, including rows with children that are cached already
+   * and ones that are not.
+   */
+  GtkTreeStore *store;
+  GtkTreeModel *filter;
+  GtkTreeIter c;
+  SignalMonitor *monitor;
+  const gchar *hidden = "c";
+
+  store = gtk_tree_store_new (1, G_TYPE_STRING);
+  gtk_tree_store_insert_with_values (store, NULL, NULL, -1, 0, "a", -1);
+  gtk_tree_store_insert_with_values (store, NULL, NULL, -1, 0, "b", -1);
+  gtk_tree_store_insert_with_values (store, &c, NULL, -1, 0, "c", -1);
+  gtk_tree_store_insert_with_values (store, NULL, &c, -1, 0, "c:0", -1);
+  gtk_tree_store_insert_with_values (store, NULL, &c, -1, 0, "c:1", -1);
+  gtk_tree_store_insert_with_values (store, NULL, NULL, -1, 0, "d", -1);
+
+  filter = gtk_tree_model_filter_new (GTK_TREE_MODEL (store), NULL);
+  gtk_tree_model_filter_set_visible_func (GTK_TREE_MODEL_FILTER (filter),
+                                          specific_refilter_signals_visible_func,
+                                          &hidden, NULL);
+
+  /* Act like a view showing the root level */
+  ref_node_for_string (filter, "0", TRUE);
+  ref_node_for_string (filter, "1", TRUE);
+  ref_node_for_string (filter, "2", TRUE);
+
+  monitor = signal_monitor_new (filter);
+
+  /* Rows that stay visible get row-changed.  The children of "c" are
+   * filtered when "c" is shown, and nothing has referenced them yet,
+   * so there are no signals for them.
+   */
+  hidden = "b";
+  signal_monitor_append_signal (monitor, ROW_CHANGED, "0");
+  signal_monitor_append_signal (monitor, ROW_DELETED, "1");
+  signal_monitor_append_signal (monitor, ROW_INSERTED, "1");
+  signal_monitor_append_signal (monitor, ROW_CHANGED, "2");
+  gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (filter));
+  signal_monitor_assert_is_empty (monitor);
+
+  /* Expand "c" */
+  ref_node_for_string (filter, "1", TRUE);
+  ref_node_for_string (filter, "1:0", TRUE);
+  ref_node_for_string (filter, "1:1", TRUE);
+
+  /* The cached child level of "c" is refiltered in place */
+  hidden = "c:1";
+  signal_monitor_append_signal (monitor, ROW_CHANGED, "0");
+  signal_monitor_append_signal (monitor, ROW_INSERTED, "1");
+  signal_monitor_append_signal (monitor, ROW_CHANGED, "2");
+  signal_monitor_append_signal (monitor, ROW_HAS_CHILD_TOGGLED, "2");
+  signal_monitor_append_signal (monitor, ROW_CHANGED, "2:0");
+  signal_monitor_append_signal (monitor, ROW_DELETED, "2:1");
+  signal_monitor_append_signal (monitor, ROW_CHANGED, "3");
+  gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (filter));
+  signal_monitor_assert_is_empty (monitor);
+
+  /* The references on hidden rows were dropped with them */
+  ref_node_for_string (filter, "0", FALSE);
+  ref_node_for_string (filter, "2", FALSE);
+  ref_node_for_string (filter, "2:0", FALSE);
+  ref_node_for_string (filter, "3", FALSE);
+
+  signal_monitor_free (monitor);
+  g_object_unref (filter);
+  g_object_unref (store);
+}
+
 /* main */
 
 void
@@ -7143,4 +7247,6 @@ register_filter_model_tests (void)
                    specific_bug_659022_row_deleted_free_level);
   g_test_add_func ("/TreeModelFilter/specific/bug-679910",
                    specific_bug_679910);
+  g_test_add_func ("/TreeModelFilter/specific/refilter-signals",
+                   specific_refilter_signals);
 }
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2017 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+/* More lines than the layout keeps line displays for */
+#define N_LINES 600
+
+static char *
+create_text (void)
+{
+  GString *text;
+  int i;
+
+  text = g_string_new (NULL);
+  for (i = 0; i < N_LINES; i++)
+    g_string_append_printf (text, "%sLine %d", i > 0 ? "\n" : "", i);
+
+  return g_string_free (text, FALSE);
+}
+
+static void
+wait_for_layout (void)
+{
+  while (g_main_context_pending (NULL))
+    g_main_context_iteration (NULL, FALSE);
+}
+
+static GtkWidget *
+create_text_view (const char *text)
+{
+  GtkWidget *window, *sw, *view;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (window), 400, 300);
+  sw = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (window), sw);
+  view = gtk_text_view_new ();
+  gtk_container_add (GTK_CONTAINER (sw), view);
+  gtk_text_buffer_set_text (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)), text, -1);
+
+  gtk_widget_show (window);
+  wait_for_layout ();
+
+  return view;
+}
+
+static void
+destroy_text_view (GtkWidget *view)
+{
+  gtk_widget_destroy (gtk_widget_get_toplevel (view));
+}
+
+static void
+get_line_end_location (GtkWidget    *view,
+                       int           line,
+                       GdkRectangle *location)
+{
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_iter_at_line (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)), &iter, line);
+  gtk_text_iter_forward_to_line_end (&iter);
+  gtk_text_view_get_iter_location (GTK_TEXT_VIEW (view), &iter, location);
+}
+
+static int
+get_line_height (GtkWidget *view,
+                 int        line)
+{
+  GtkTextIter iter;
+  int y, height;
+
+  gtk_text_buffer_get_iter_at_line (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)), &iter, line);
+  gtk_text_view_get_line_yrange (GTK_TEXT_VIEW (view), &iter, &y, &height);
+
+  return height;
+}
+
+/* Checks that every line of @view is laid out the same as in @expected */
+static void
+assert_same_layout (GtkWidget *view,
+                    GtkWidget *expected)
+{
+  GtkTextBuffer *buffer, *expected_buffer;
+  GtkTextIter iter, expected_iter;
+  GdkRectangle location, expected_location;
+  int y, height, expected_y, expected_height;
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+  expected_buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (expected));
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), ==,
+                   gtk_text_buffer_get_line_count (expected_buffer));
+
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  gtk_text_buffer_get_start_iter (expected_buffer, &expected_iter);
+  do
+    {
+      gtk_text_view_get_line_yrange (GTK_TEXT_VIEW (view), &iter, &y, &height);
+      gtk_text_view_get_line_yrange (GTK_TEXT_VIEW (expected), &expected_iter, &expected_y, &expected_height);
+      g_assert_cmpint (y, ==, expected_y);
+      g_assert_cmpint (height, ==, expected_height);
+
+      if (!gtk_text_iter_ends_line (&iter))
+        gtk_text_iter_forward_to_line_end (&iter);
+      if (!gtk_text_iter_ends_line (&expected_iter))
+        gtk_text_iter_forward_to_line_end (&expected_iter);
+      gtk_text_view_get_iter_location (GTK_TEXT_VIEW (view), &iter, &location);
+      gtk_text_view_get_iter_location (GTK_TEXT_VIEW (expected), &expected_iter, &expected_location);
+      g_assert_cmpint (location.x, ==, expected_location.x);
+      g_assert_cmpint (location.y, ==, expected_location.y);
+      g_assert_cmpint (location.width, ==, expected_location.width);
+      g_assert_cmpint (location.height, ==, expected_location.height);
+    }
+  while (gtk_text_iter_forward_line (&iter) &&
+         gtk_text_iter_forward_line (&expected_iter));
+}
+
+static void
+apply_big_tag (GtkWidget *view,
+               int        line)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter start, end;
+  GtkTextTag *tag;
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+  tag = gtk_text_buffer_create_tag (buffer, NULL, "scale", 2.0, NULL);
+  gtk_text_buffer_get_iter_at_line (buffer, &start, line);
+  end = start;
+  gtk_text_iter_forward_to_line_end (&end);
+  gtk_text_buffer_apply_tag (buffer, tag, &start, &end);
+}
+
+/* Line displays are kept between redraws; editing lines, also ones
+ * that were laid out long ago, must not reuse their old displays.
+ */
+static void
+test_edit_lines (void)
+{
+  GtkWidget *view, *expected;
+  GtkTextBuffer *buffer;
+  GtkTextIter start, end;
+  GdkRectangle before, after;
+  int height;
+  char *text;
+
+  text = create_text ();
+  view = create_text_view (text);
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+
+  /* Lay out every line once, so the displays of the first lines
+   * are dropped from the cache again.
+   */
+  assert_same_layout (view, view);
+
+  get_line_end_location (view, 300, &before);
+  height = get_line_height (view, 200);
+
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 300);
+  gtk_text_iter_forward_to_line_end (&start);
+  gtk_text_buffer_insert (buffer, &start, " with some more text", -1);
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 5);
+  gtk_text_buffer_insert (buffer, &start, "Longer ", -1);
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 100);
+  end = start;
+  gtk_text_iter_forward_to_line_end (&end);
+  gtk_text_buffer_delete (buffer, &start, &end);
+  apply_big_tag (view, 200);
+  wait_for_layout ();
+
+  get_line_end_location (view, 300, &after);
+  g_assert_cmpint (after.x, >, before.x);
+  g_assert_cmpint (get_line_height (view, 200), >, height);
+
+  /* A new view has nothing cached */
+  g_free (text);
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+  expected = create_text_view (text);
+  apply_big_tag (expected, 200);
+  wait_for_layout ();
+
+  assert_same_layout (view, expected);
+
+  destroy_text_view (view);
+  destroy_text_view (expected);
+  g_free (text);
+}
+
+/* Changing the style of the whole view must not reuse any display */
+static void
+test_change_style (void)
+{
+  GtkWidget *view, *expected;
+  GdkRectangle before, after;
+  char *text;
+
+  text = create_text ();
+  view = create_text_view (text);
+  assert_same_layout (view, view);
+
+  get_line_end_location (view, 500, &before);
+  gtk_text_view_set_left_margin (GTK_TEXT_VIEW (view), 50);
+  wait_for_layout ();
+  get_line_end_location (view, 500, &after);
+  g_assert_cmpint (after.x, ==, before.x + 50);
+
+  expected = create_text_view (text);
+  gtk_text_view_set_left_margin (GTK_TEXT_VIEW (expected), 50);
+  wait_for_layout ();
+
+  assert_same_layout (view, expected);
+
+  destroy_text_view (view);
+  destroy_text_view (expected);
+  g_free (text);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/textview/layout/edit-lines", test_edit_lines);
+  g_test_add_func ("/textview/layout/change-style", test_change_style);
+
+  return g_test_run ();
+}